@@ -53,20 +53,151 @@ CREATE TABLE alerts (
     UNIQUE(device_id, pin_label)
 );
 
+-- A u8/u16 wire field from an event payload, or NULL if it is not a plain
+-- unsigned integer in range. Used by the generated columns below, so a
+-- malformed frame stores NULLs instead of failing its whole batch INSERT.
+CREATE OR REPLACE FUNCTION event_uint16(value TEXT)
+RETURNS INTEGER AS $$
+    -- Nested so the cast only runs on digits (AND does not fix the order)
+    SELECT CASE WHEN value ~ '^[0-9]{1,5}$' THEN
+               CASE WHEN value::INTEGER <= 65535 THEN value::INTEGER END
+           END
+$$ LANGUAGE sql IMMUTABLE;
+
+-- Events are range-partitioned by day (events_pYYYYMMDD). Retention drops
+-- whole partitions instead of deleting rows, so neither the table nor its
+-- indexes bloat. Rows whose day has no partition yet land in events_default.
+--
+-- The typed columns are taken from payload as each row is written (NULL when
+-- the frame has no such field: analog and digital in GNSS frames, RSSI/SNR
+-- without a gateway header), so the rollups below never parse JSON.
 CREATE TABLE events (
-    id SERIAL PRIMARY KEY,
+    id BIGSERIAL,
     device_id INTEGER REFERENCES devices(id) ON DELETE SET NULL,
     node_id BIGINT NOT NULL,
     message_type VARCHAR(10) NOT NULL CHECK (message_type IN ('sensor', 'gnss')),
     payload JSONB NOT NULL,
-    created_at TIMESTAMP DEFAULT NOW()
-);
+    created_at TIMESTAMP NOT NULL DEFAULT NOW(),
+    analog0 INTEGER GENERATED ALWAYS AS (event_uint16(payload->'analog'->>0)) STORED,
+    analog1 INTEGER GENERATED ALWAYS AS (event_uint16(payload->'analog'->>1)) STORED,
+    analog2 INTEGER GENERATED ALWAYS AS (event_uint16(payload->'analog'->>2)) STORED,
+    analog3 INTEGER GENERATED ALWAYS AS (event_uint16(payload->'analog'->>3)) STORED,
+    digital INTEGER GENERATED ALWAYS AS (event_uint16(payload->>'digital')) STORED,
+    battery INTEGER GENERATED ALWAYS AS (event_uint16(payload->>'battery')) STORED,
+    rssi REAL GENERATED ALWAYS AS ((payload->'rx'->>'rssi')::REAL) STORED,     -- dBm
+    snr REAL GENERATED ALWAYS AS ((payload->'rx'->>'snr')::REAL) STORED,       -- dB
+    PRIMARY KEY (id, created_at)
+) PARTITION BY RANGE (created_at);
+
+CREATE TABLE events_default PARTITION OF events DEFAULT;
 
--- Index for fast event lookups
+-- Index for fast event lookups. Rows arrive in time order, so a BRIN index
+-- covers created_at at a fraction of a B-tree's size and write cost.
+-- devices(node_id) is already indexed by its UNIQUE constraint.
 CREATE INDEX idx_events_device_id ON events(device_id);
-CREATE INDEX idx_events_created_at ON events(created_at);
+CREATE INDEX idx_events_created_at ON events USING BRIN (created_at);
 CREATE INDEX idx_events_node_id ON events(node_id);
-CREATE INDEX idx_devices_node_id ON devices(node_id);
+
+-- Per-node rollups of the typed event columns: one row per node per minute
+-- (events_1m) and per hour (events_1h), so a dashboard panel reads one row
+-- per bucket however many events fell in it. Averages are sum / count, with
+-- events as the count for battery, readings for the analog pins and rx_count
+-- for RSSI and SNR.
+CREATE TABLE events_1m (
+    bucket TIMESTAMP NOT NULL,
+    node_id BIGINT NOT NULL,
+    events INTEGER NOT NULL,            -- Sensor and GNSS rows
+    readings INTEGER NOT NULL,          -- Rows with analog values
+    analog0_min INTEGER, analog0_max INTEGER, analog0_sum BIGINT NOT NULL,
+    analog1_min INTEGER, analog1_max INTEGER, analog1_sum BIGINT NOT NULL,
+    analog2_min INTEGER, analog2_max INTEGER, analog2_sum BIGINT NOT NULL,
+    analog3_min INTEGER, analog3_max INTEGER, analog3_sum BIGINT NOT NULL,
+    digital_any INTEGER,                -- Pins high in any reading
+    digital_all INTEGER,                -- Pins high in every reading
+    battery_min INTEGER, battery_max INTEGER, battery_sum BIGINT NOT NULL,
+    rx_count INTEGER NOT NULL,          -- Rows with a gateway RSSI/SNR
+    rssi_min REAL, rssi_max REAL, rssi_sum DOUBLE PRECISION NOT NULL,
+    snr_min REAL, snr_max REAL, snr_sum DOUBLE PRECISION NOT NULL,
+    PRIMARY KEY (bucket, node_id)
+);
+
+CREATE TABLE events_1h (LIKE events_1m INCLUDING ALL);
+
+-- Fold each INSERT or COPY into both rollups, whichever writer it came from
+-- (the Node-RED batch node or the native ingest bridge): one upsert per
+-- rollup per statement, grouped by bucket and node. Keys are upserted in
+-- order, so two writers lock the same bucket rows in the same order.
+CREATE OR REPLACE FUNCTION rollup_events()
+RETURNS TRIGGER AS $$
+DECLARE
+    rollup TEXT[];
+BEGIN
+    FOREACH rollup SLICE 1 IN ARRAY ARRAY[['events_1m', 'minute'], ['events_1h', 'hour']] LOOP
+        EXECUTE format($sql$
+            INSERT INTO %1$I AS r
+            SELECT date_trunc(%2$L, created_at), node_id, COUNT(*), COUNT(analog0),
+                   MIN(analog0), MAX(analog0), COALESCE(SUM(analog0), 0),
+                   MIN(analog1), MAX(analog1), COALESCE(SUM(analog1), 0),
+                   MIN(analog2), MAX(analog2), COALESCE(SUM(analog2), 0),
+                   MIN(analog3), MAX(analog3), COALESCE(SUM(analog3), 0),
+                   bit_or(digital), bit_and(digital),
+                   MIN(battery), MAX(battery), COALESCE(SUM(battery), 0),
+                   COUNT(rssi),
+                   MIN(rssi), MAX(rssi), COALESCE(SUM(rssi), 0),
+                   MIN(snr), MAX(snr), COALESCE(SUM(snr), 0)
+            FROM new_events
+            GROUP BY 1, 2
+            ORDER BY 1, 2
+            ON CONFLICT (bucket, node_id) DO UPDATE SET
+                events = r.events + EXCLUDED.events,
+                readings = r.readings + EXCLUDED.readings,
+                analog0_min = LEAST(r.analog0_min, EXCLUDED.analog0_min),
+                analog0_max = GREATEST(r.analog0_max, EXCLUDED.analog0_max),
+                analog0_sum = r.analog0_sum + EXCLUDED.analog0_sum,
+                analog1_min = LEAST(r.analog1_min, EXCLUDED.analog1_min),
+                analog1_max = GREATEST(r.analog1_max, EXCLUDED.analog1_max),
+                analog1_sum = r.analog1_sum + EXCLUDED.analog1_sum,
+                analog2_min = LEAST(r.analog2_min, EXCLUDED.analog2_min),
+                analog2_max = GREATEST(r.analog2_max, EXCLUDED.analog2_max),
+                analog2_sum = r.analog2_sum + EXCLUDED.analog2_sum,
+                analog3_min = LEAST(r.analog3_min, EXCLUDED.analog3_min),
+                analog3_max = GREATEST(r.analog3_max, EXCLUDED.analog3_max),
+                analog3_sum = r.analog3_sum + EXCLUDED.analog3_sum,
+                digital_any = COALESCE(r.digital_any | EXCLUDED.digital_any, r.digital_any, EXCLUDED.digital_any),
+                digital_all = COALESCE(r.digital_all & EXCLUDED.digital_all, r.digital_all, EXCLUDED.digital_all),
+                battery_min = LEAST(r.battery_min, EXCLUDED.battery_min),
+                battery_max = GREATEST(r.battery_max, EXCLUDED.battery_max),
+                battery_sum = r.battery_sum + EXCLUDED.battery_sum,
+                rx_count = r.rx_count + EXCLUDED.rx_count,
+                rssi_min = LEAST(r.rssi_min, EXCLUDED.rssi_min),
+                rssi_max = GREATEST(r.rssi_max, EXCLUDED.rssi_max),
+                rssi_sum = r.rssi_sum + EXCLUDED.rssi_sum,
+                snr_min = LEAST(r.snr_min, EXCLUDED.snr_min),
+                snr_max = GREATEST(r.snr_max, EXCLUDED.snr_max),
+                snr_sum = r.snr_sum + EXCLUDED.snr_sum
+        $sql$, rollup[1], rollup[2]);
+    END LOOP;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_events_rollup
+    AFTER INSERT ON events
+    REFERENCING NEW TABLE AS new_events
+    FOR EACH STATEMENT EXECUTE FUNCTION rollup_events();
+
+-- Rollup rows for a dashboard time range: minutes up to two days, hours
+-- beyond that, so a panel never reads more than ~2880 buckets per node
+CREATE OR REPLACE FUNCTION event_rollup(range_from TIMESTAMP, range_to TIMESTAMP)
+RETURNS SETOF events_1m AS $$
+    SELECT * FROM events_1m
+    WHERE range_to - range_from <= INTERVAL '2 days'
+      AND bucket >= date_trunc('minute', range_from) AND bucket <= range_to
+    UNION ALL
+    SELECT * FROM events_1h
+    WHERE range_to - range_from > INTERVAL '2 days'
+      AND bucket >= date_trunc('hour', range_from) AND bucket <= range_to
+$$ LANGUAGE sql STABLE;
 
 -- Auto-create 8 digital + 4 analog pins when a device is added
 CREATE OR REPLACE FUNCTION create_device_pins()
@@ -86,14 +217,103 @@ CREATE TRIGGER trg_create_device_pins
     AFTER INSERT ON devices
     FOR EACH ROW EXECUTE FUNCTION create_device_pins();
 
--- Event retention: function to prune old events (call from cron/Node-RED)
+-- Event partitions: one per day, created ahead of time
+CREATE OR REPLACE FUNCTION create_event_partition(day DATE)
+RETURNS VOID AS $$
+DECLARE
+    part_name TEXT := 'events_p' || to_char(day, 'YYYYMMDD');
+BEGIN
+    IF to_regclass(part_name) IS NOT NULL THEN
+        RETURN;
+    END IF;
+    -- A day already written to the default partition stays there (a new
+    -- partition may not overlap its rows); prune_events() deletes it later
+    IF EXISTS (SELECT 1 FROM events_default WHERE created_at >= day AND created_at < day + 1) THEN
+        RAISE NOTICE 'events for % are in events_default, not partitioned', day;
+        RETURN;
+    END IF;
+    EXECUTE format('CREATE TABLE %I PARTITION OF events FOR VALUES FROM (%L) TO (%L)',
+                   part_name, day::TIMESTAMP, (day + 1)::TIMESTAMP);
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE OR REPLACE FUNCTION ensure_event_partitions(days_ahead INTEGER DEFAULT 7)
+RETURNS VOID AS $$
+BEGIN
+    FOR i IN 0..days_ahead LOOP
+        PERFORM create_event_partition(CURRENT_DATE + i);
+    END LOOP;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT ensure_event_partitions();
+
+-- Event retention: drop day partitions older than days_to_keep and create the
+-- coming days' (call from cron/Node-RED). Returns the rows dropped, from the
+-- planner's estimate for whole partitions. The minute rollup goes with the
+-- events; the hour rollup (24 rows per node per day) is kept.
 CREATE OR REPLACE FUNCTION prune_events(days_to_keep INTEGER DEFAULT 30)
 RETURNS INTEGER AS $$
 DECLARE
+    cutoff DATE := CURRENT_DATE - days_to_keep;
+    part RECORD;
+    dropped BIGINT := 0;
     deleted INTEGER;
 BEGIN
-    DELETE FROM events WHERE created_at < NOW() - (days_to_keep || ' days')::INTERVAL;
+    FOR part IN
+        SELECT c.relname, c.reltuples
+        FROM pg_inherits i
+        JOIN pg_class c ON c.oid = i.inhrelid
+        WHERE i.inhparent = 'events'::regclass
+          AND CASE WHEN c.relname ~ '^events_p[0-9]{8}$'
+                   THEN to_date(substring(c.relname FROM 9), 'YYYYMMDD') < cutoff
+                   ELSE FALSE END
+    LOOP
+        dropped := dropped + GREATEST(part.reltuples, 0);
+        EXECUTE format('DROP TABLE %I', part.relname);
+    END LOOP;
+
+    -- Stragglers in the default partition are few enough to delete
+    DELETE FROM events_default WHERE created_at < cutoff;
     GET DIAGNOSTICS deleted = ROW_COUNT;
-    RETURN deleted;
+
+    DELETE FROM events_1m WHERE bucket < cutoff;
+
+    PERFORM ensure_event_partitions();
+    RETURN dropped + deleted;
 END;
 $$ LANGUAGE plpgsql;
+
+-- Configuration changes for the native ingest bridge (host/ingest), which
+-- caches devices and pins: NOTIFY with the device ID that changed, or '' when
+-- an owner did (every device of theirs). Identical notifications within a
+-- transaction are delivered once; last_seen updates do not notify.
+CREATE OR REPLACE FUNCTION notify_config_change()
+RETURNS TRIGGER AS $$
+DECLARE
+    changed JSONB := CASE WHEN TG_OP = 'DELETE' THEN to_jsonb(OLD) ELSE to_jsonb(NEW) END;
+BEGIN
+    PERFORM pg_notify('sensorsentinel_config', CASE TG_TABLE_NAME
+        WHEN 'devices' THEN changed->>'id'
+        WHEN 'owners' THEN ''
+        ELSE changed->>'device_id'
+    END);
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_devices_config
+    AFTER INSERT OR DELETE OR UPDATE OF node_id, display_name, owner_id ON devices
+    FOR EACH ROW EXECUTE FUNCTION notify_config_change();
+
+CREATE TRIGGER trg_digital_pins_config
+    AFTER INSERT OR UPDATE OR DELETE ON digital_pins
+    FOR EACH ROW EXECUTE FUNCTION notify_config_change();
+
+CREATE TRIGGER trg_analog_pins_config
+    AFTER INSERT OR UPDATE OR DELETE ON analog_pins
+    FOR EACH ROW EXECUTE FUNCTION notify_config_change();
+
+CREATE TRIGGER trg_owners_config
+    AFTER UPDATE OR DELETE ON owners
+    FOR EACH ROW EXECUTE FUNCTION notify_config_change();
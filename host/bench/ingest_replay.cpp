@@ -0,0 +1,555 @@
+/**
+ * @file ingest_replay.cpp
+ * @brief ingest_replay: end-to-end latency of broker -> parser -> DB
+ *
+ *   ingest_replay CAPTURE [--rate N] [--loops N] [--offset N] [--via mqtt|db]
+ *                 [--topic T] [--timeout-ms MS] [--poll-ms MS]
+ *
+ * Publishes recorded lora/in payloads to the broker at N payloads a second
+ * (default 100; 0 = as fast as the socket takes them) and times each frame
+ * until the parser has handled it:
+ *
+ *   --via mqtt  its JSON appears on lora/out/sensor or lora/out/gnss
+ *               (Node-RED parser, or the bridge with INGEST_PUBLISH_JSON)
+ *   --via db    its row appears in events (polled every --poll-ms, default
+ *               5); only frames of registered devices get one
+ *
+ * A capture is what
+ *
+ *   mosquitto_sub -t 'lora/in/#' -v -F '%t %x' > capture.txt
+ *
+ * records: one payload per line, the topic, a space and the payload in hex
+ * (a line with only hex is published on --topic, default lora/in/replay).
+ * Bare frames, uplink records and batch envelopes are all accepted.
+ *
+ * Every pass over the capture (--loops, default 1) moves the v1 counters
+ * of each node past those of the pass before, so the dedup stage sees new
+ * frames while copies of one frame from several gateways stay copies;
+ * --offset moves them for the first pass too, for a rerun within the
+ * dedup window. v2 counters are varints and are left alone, so v2 frames
+ * are only timed on the first pass.
+ *
+ * MQTT_HOST, MQTT_PORT, MQTT_USER, MQTT_PASSWORD and the PG* variables
+ * select the broker and the database. The result is one JSON object on
+ * stdout:
+ *
+ *   {"benchmark":"ingest_replay","via":"mqtt","rate":100,...,"frames":...,"received":...,
+ *    "lost":...,"latencyMs":{"min":...,"mean":...,"p50":...,"p90":...,"p99":...,"max":...}}
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <libpq-fe.h>
+
+#include "ingest_frames.h"
+#include "ingest_mqtt.h"
+
+#define REPLAY_DEFAULT_TOPIC  "lora/in/replay"
+#define REPLAY_OUT_TOPIC      "lora/out/+"
+#define REPLAY_CLIENT_ID      "sensorsentinel-replay"
+#define MQTT_KEEPALIVE_SECS   30
+
+typedef struct {
+  size_t offset;               // Frame start in the payload
+  bool v1;                     // Counter can be rewritten
+  uint32_t nodeId;
+  uint32_t counter;
+} replay_frame_t;
+
+typedef struct {
+  std::string topic;
+  std::vector<uint8_t> bytes;
+  std::vector<replay_frame_t> frames;
+} replay_payload_t;
+
+typedef struct {
+  uint64_t sentUs;
+  uint64_t receivedUs;         // 0 until seen
+} replay_sample_t;
+
+typedef struct {
+  const char *capture;
+  double rate;
+  uint32_t loops;
+  uint32_t offset;
+  bool viaDb;
+  const char *topic;
+  uint32_t timeoutMs;
+  uint32_t pollMs;
+} replay_config_t;
+
+// Frames in flight, keyed on (nodeId, counter)
+typedef struct {
+  std::unordered_map<uint64_t, replay_sample_t> samples;
+  uint64_t duplicates = 0;     // Seen again after the first arrival
+  uint64_t unexpected = 0;     // Not sent by this run
+  size_t received = 0;
+  std::mutex lock;
+} replay_tracker_t;
+
+static uint64_t _now_us()
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t _key(uint32_t nodeId, uint32_t counter)
+{
+  return ((uint64_t)nodeId << 32) | counter;
+}
+
+static void _arrived(replay_tracker_t *tracker, uint32_t nodeId, uint32_t counter, uint64_t nowUs)
+{
+  std::lock_guard<std::mutex> guard(tracker->lock);
+  auto it = tracker->samples.find(_key(nodeId, counter));
+  if (it == tracker->samples.end())
+  {
+    tracker->unexpected++;
+  }
+  else if (it->second.receivedUs)
+  {
+    tracker->duplicates++;  // Another reading of an aggregate, or a second copy
+  }
+  else
+  {
+    it->second.receivedUs = nowUs;
+    tracker->received++;
+  }
+}
+
+// ── Capture ───────────────────────────────────────────────────────────────────
+
+static bool _hex(const char *text, size_t length, std::vector<uint8_t> &out)
+{
+  if (length % 2)
+  {
+    return false;
+  }
+  out.clear();
+  for (size_t i = 0; i < length; i += 2)
+  {
+    char byte[3] = {text[i], text[i + 1], 0};
+    char *end;
+    out.push_back((uint8_t)strtoul(byte, &end, 16));
+    if (*end)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void _on_record(void *ctx, const uint8_t *record, size_t length)
+{
+  replay_payload_t *payload = (replay_payload_t *)ctx;
+  size_t header = record[0] == SensorSentinel_UPLINK_VERSION ? SensorSentinel_UPLINK_HEADROOM : 0;
+  if (length <= header || !SensorSentinel_validate_packet(record + header, length - header))
+  {
+    return;  // Sent as recorded, but not timed
+  }
+  uint8_t *frame = (uint8_t *)record + header;  // Points into payload->bytes
+  replay_frame_t f;
+  f.offset = frame - payload->bytes.data();
+  f.v1 = frame[0] == SensorSentinel_MSG_SENSOR || frame[0] == SensorSentinel_MSG_GNSS ||
+         frame[0] == SensorSentinel_MSG_AGGREGATE;
+  f.nodeId = SensorSentinel_extract_node_id_from_packet(frame);
+  f.counter = SensorSentinel_get_message_counter_from_packet(frame);
+  payload->frames.push_back(f);
+}
+
+static bool _load_capture(const replay_config_t *config, std::vector<replay_payload_t> &payloads)
+{
+  FILE *file = fopen(config->capture, "r");
+  if (!file)
+  {
+    perror(config->capture);
+    return false;
+  }
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t length;
+  int lineNo = 0;
+  while ((length = getline(&line, &size, file)) >= 0)
+  {
+    lineNo++;
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' || line[length - 1] == ' '))
+    {
+      line[--length] = 0;
+    }
+    if (length == 0 || line[0] == '#')
+    {
+      continue;
+    }
+
+    replay_payload_t payload;
+    const char *hex = line;
+    const char *space = strrchr(line, ' ');
+    if (space)
+    {
+      payload.topic.assign(line, space - line);
+      hex = space + 1;
+    }
+    if (config->topic || payload.topic.empty())
+    {
+      payload.topic = config->topic ? config->topic : REPLAY_DEFAULT_TOPIC;
+    }
+    if (!_hex(hex, strlen(hex), payload.bytes) || payload.bytes.empty())
+    {
+      fprintf(stderr, "%s:%d: not a hex payload, skipped\n", config->capture, lineNo);
+      continue;
+    }
+    ingest_split_payload(payload.bytes.data(), payload.bytes.size(), _on_record, &payload);
+    payloads.push_back(std::move(payload));
+  }
+  free(line);
+  fclose(file);
+  return true;
+}
+
+// ── Receivers ─────────────────────────────────────────────────────────────────
+
+static long long _json_uint(std::string_view json, const char *key)
+{
+  size_t at = json.find(key);
+  if (at == std::string_view::npos)
+  {
+    return -1;
+  }
+  return strtoll(std::string(json.substr(at + strlen(key), 12)).c_str(), NULL, 10);
+}
+
+static void _on_message(void *ctx, std::string_view topic, const uint8_t *payload, size_t length)
+{
+  (void)topic;
+  std::string_view json((const char *)payload, length);
+  long long nodeId = _json_uint(json, "\"nodeId\":");
+  long long counter = _json_uint(json, "\"counter\":");
+  if (nodeId >= 0 && counter >= 0)
+  {
+    _arrived((replay_tracker_t *)ctx, (uint32_t)nodeId, (uint32_t)counter, _now_us());
+  }
+}
+
+// Poll events for rows newer than those there at the start
+static void _poll_db(replay_tracker_t *tracker, PGconn *conn, uint32_t pollMs, std::atomic<bool> *stop)
+{
+  PGresult *res = PQexec(conn, "SELECT COALESCE(MAX(id), 0) FROM events");
+  std::string lastId = PQresultStatus(res) == PGRES_TUPLES_OK ? PQgetvalue(res, 0, 0) : "0";
+  PQclear(res);
+
+  while (!stop->load())
+  {
+    const char *params[1] = {lastId.c_str()};
+    res = PQexecParams(conn,
+                       "SELECT id, node_id, payload->>'counter' FROM events WHERE id > $1::bigint ORDER BY id",
+                       1, NULL, params, NULL, NULL, 0);
+    uint64_t nowUs = _now_us();
+    if (PQresultStatus(res) == PGRES_TUPLES_OK)
+    {
+      for (int row = 0; row < PQntuples(res); row++)
+      {
+        lastId = PQgetvalue(res, row, 0);
+        if (!PQgetisnull(res, row, 2))
+        {
+          _arrived(tracker, (uint32_t)strtoull(PQgetvalue(res, row, 1), NULL, 10),
+                   (uint32_t)strtoull(PQgetvalue(res, row, 2), NULL, 10), nowUs);
+        }
+      }
+    }
+    else
+    {
+      fprintf(stderr, "events poll failed: %s", PQerrorMessage(conn));
+    }
+    PQclear(res);
+    std::this_thread::sleep_for(std::chrono::milliseconds(pollMs));
+  }
+}
+
+// ── Main ──────────────────────────────────────────────────────────────────────
+
+static std::string _json_string(const char *text)
+{
+  std::string out = "\"";
+  for (const char *c = text; *c; c++)
+  {
+    if (*c == '"' || *c == '\\')
+    {
+      out += '\\';
+    }
+    if ((unsigned char)*c >= 0x20)
+    {
+      out += *c;
+    }
+  }
+  return out + '"';
+}
+
+static double _percentile(const std::vector<double> &sorted, double p)
+{
+  if (sorted.empty())
+  {
+    return 0;
+  }
+  size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+  return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+static bool _parse_args(int argc, char **argv, replay_config_t *c)
+{
+  *c = {NULL, 100, 1, 0, false, NULL, 5000, 5};
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (arg[0] != '-' && !c->capture)
+    {
+      c->capture = arg;
+      continue;
+    }
+    if (!value)
+    {
+      return false;
+    }
+    i++;
+    if (!strcmp(arg, "--rate"))
+      c->rate = strtod(value, NULL);
+    else if (!strcmp(arg, "--loops"))
+      c->loops = (uint32_t)strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--offset"))
+      c->offset = (uint32_t)strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--via") && (!strcmp(value, "mqtt") || !strcmp(value, "db")))
+      c->viaDb = !strcmp(value, "db");
+    else if (!strcmp(arg, "--topic"))
+      c->topic = value;
+    else if (!strcmp(arg, "--timeout-ms"))
+      c->timeoutMs = (uint32_t)strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--poll-ms"))
+      c->pollMs = std::max<uint32_t>(1, (uint32_t)strtoul(value, NULL, 10));
+    else
+      return false;
+  }
+  return c->capture && c->loops > 0;
+}
+
+int main(int argc, char **argv)
+{
+  replay_config_t config;
+  if (!_parse_args(argc, argv, &config))
+  {
+    fprintf(stderr,
+            "usage: %s CAPTURE [--rate N] [--loops N] [--offset N] [--via mqtt|db] [--topic T]\n"
+            "       [--timeout-ms MS] [--poll-ms MS]\n",
+            argv[0]);
+    return 2;
+  }
+
+  std::vector<replay_payload_t> payloads;
+  if (!_load_capture(&config, payloads))
+  {
+    return 1;
+  }
+
+  // Per-node counter range: each pass moves a node's counters past it
+  std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> ranges;
+  size_t capturedFrames = 0;
+  for (const auto &p : payloads)
+  {
+    for (const auto &f : p.frames)
+    {
+      capturedFrames++;
+      if (!f.v1)
+      {
+        continue;
+      }
+      auto it = ranges.find(f.nodeId);
+      if (it == ranges.end())
+      {
+        ranges[f.nodeId] = {f.counter, f.counter};
+      }
+      else
+      {
+        it->second.first = std::min(it->second.first, f.counter);
+        it->second.second = std::max(it->second.second, f.counter);
+      }
+    }
+  }
+  if (capturedFrames == 0)
+  {
+    fprintf(stderr, "%s: no valid frames\n", config.capture);
+    return 1;
+  }
+
+  const char *host = getenv("MQTT_HOST") ? getenv("MQTT_HOST") : "localhost";
+  uint16_t port = (uint16_t)(getenv("MQTT_PORT") ? atoi(getenv("MQTT_PORT")) : 1883);
+  ingest_mqtt_t mqtt;
+  if (!ingest_mqtt_connect(&mqtt, host, port, REPLAY_CLIENT_ID, getenv("MQTT_USER"), getenv("MQTT_PASSWORD"),
+                           MQTT_KEEPALIVE_SECS))
+  {
+    fprintf(stderr, "cannot connect to MQTT broker %s:%u\n", host, port);
+    return 1;
+  }
+
+  replay_tracker_t tracker;
+  std::atomic<bool> stop(false);
+  std::thread poller;
+  PGconn *conn = NULL;
+  if (config.viaDb)
+  {
+    conn = PQconnectdb("");
+    if (PQstatus(conn) != CONNECTION_OK)
+    {
+      fprintf(stderr, "cannot connect to the database: %s", PQerrorMessage(conn));
+      PQfinish(conn);
+      return 1;
+    }
+    poller = std::thread(_poll_db, &tracker, conn, config.pollMs, &stop);
+  }
+  else if (!ingest_mqtt_subscribe(&mqtt, REPLAY_OUT_TOPIC))
+  {
+    fprintf(stderr, "subscribe to %s failed\n", REPLAY_OUT_TOPIC);
+    return 1;
+  }
+  // Let the SUBACK, or the poller's first query, land before timing starts
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  uint64_t intervalUs = config.rate > 0 ? (uint64_t)(1e6 / config.rate) : 0;
+  uint64_t startUs = _now_us(), nextUs = startUs, lastSentUs = startUs;
+  size_t sentPayloads = 0, failedPayloads = 0;
+  bool connected = true;
+  auto service = [&](int timeoutMs) {
+    struct pollfd pfd = {ingest_mqtt_fd(&mqtt), POLLIN, 0};
+    if (poll(&pfd, 1, timeoutMs) > 0 && !ingest_mqtt_read(&mqtt, _on_message, &tracker))
+    {
+      connected = false;
+    }
+    if (connected && !ingest_mqtt_service(&mqtt, ingest_now_ms()))
+    {
+      connected = false;
+    }
+  };
+
+  for (uint32_t loop = 0; loop < config.loops && connected; loop++)
+  {
+    for (auto &p : payloads)
+    {
+      if (!connected)
+      {
+        break;
+      }
+      // Pace the publishes, reading lora/out/+ while waiting
+      for (uint64_t now = _now_us(); now < nextUs; now = _now_us())
+      {
+        service((int)std::min<uint64_t>((nextUs - now) / 1000, 50));
+        if (!connected)
+        {
+          break;
+        }
+      }
+
+      uint64_t sentUs = _now_us();
+      {
+        std::lock_guard<std::mutex> guard(tracker.lock);
+        for (const auto &f : p.frames)
+        {
+          uint32_t counter = f.counter;
+          if (f.v1)
+          {
+            const auto &range = ranges[f.nodeId];
+            counter = f.counter + config.offset + loop * (range.second - range.first + 1);
+            memcpy(&p.bytes[f.offset + offsetof(SensorSentinel_packet_t, header.messageCounter)], &counter,
+                   sizeof(counter));
+          }
+          else if (loop > 0)
+          {
+            continue;
+          }
+          // Copies from several gateways keep the first send time
+          tracker.samples.emplace(_key(f.nodeId, counter), replay_sample_t{sentUs, 0});
+        }
+      }
+      if (ingest_mqtt_publish(&mqtt, p.topic.c_str(), p.bytes.data(), p.bytes.size()))
+      {
+        sentPayloads++;
+      }
+      else
+      {
+        failedPayloads++;
+      }
+      lastSentUs = sentUs;
+      nextUs = (intervalUs ? nextUs : sentUs) + intervalUs;
+    }
+  }
+
+  // Wait for stragglers
+  while (connected && _now_us() - lastSentUs < (uint64_t)config.timeoutMs * 1000)
+  {
+    {
+      std::lock_guard<std::mutex> guard(tracker.lock);
+      if (tracker.received == tracker.samples.size())
+      {
+        break;
+      }
+    }
+    if (config.viaDb)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(config.pollMs));
+    }
+    else
+    {
+      service(10);
+    }
+  }
+  // Stop the poller before reading the samples
+  stop = true;
+  if (poller.joinable())
+  {
+    poller.join();
+  }
+  if (conn)
+  {
+    PQfinish(conn);
+  }
+  ingest_mqtt_close(&mqtt);
+
+  std::vector<double> latencies;
+  for (const auto &s : tracker.samples)
+  {
+    if (s.second.receivedUs)
+    {
+      latencies.push_back((s.second.receivedUs - s.second.sentUs) / 1000.0);
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+  double sum = 0;
+  for (double l : latencies)
+  {
+    sum += l;
+  }
+  double sendSecs = (lastSentUs - startUs) / 1e6;
+  double achievedRate = sendSecs > 0 && sentPayloads > 1 ? (sentPayloads - 1) / sendSecs : 0.0;
+  double minMs = latencies.empty() ? 0 : latencies.front();
+  double maxMs = latencies.empty() ? 0 : latencies.back();
+  double meanMs = latencies.empty() ? 0 : sum / latencies.size();
+
+  printf("{\"benchmark\":\"ingest_replay\",\"capture\":%s,\"via\":\"%s\",\"rate\":%.1f,\"loops\":%u,"
+         "\"payloads\":%zu,\"failedPayloads\":%zu,\"frames\":%zu,\"received\":%zu,\"lost\":%zu,"
+         "\"duplicates\":%llu,\"unexpected\":%llu,\"sendSeconds\":%.3f,\"achievedRate\":%.1f,"
+         "\"latencyMs\":{\"min\":%.3f,\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}}\n",
+         _json_string(config.capture).c_str(), config.viaDb ? "db" : "mqtt", config.rate, config.loops,
+         sentPayloads, failedPayloads, tracker.samples.size(), tracker.received,
+         tracker.samples.size() - tracker.received, (unsigned long long)tracker.duplicates,
+         (unsigned long long)tracker.unexpected, sendSecs, achievedRate, minMs, meanMs,
+         _percentile(latencies, 50), _percentile(latencies, 90), _percentile(latencies, 99), maxMs);
+  return connected ? 0 : 1;
+}
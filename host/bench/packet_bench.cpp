@@ -0,0 +1,348 @@
+/**
+ * @file packet_bench.cpp
+ * @brief packet_bench: throughput of the firmware's packet layer on the host
+ *
+ *   packet_bench [--nodes N] [--min-ms MS] [--filter TEXT]
+ *
+ * Times the frame format code the gateway and the ingest bridge run per
+ * frame: validation, node ID and counter extraction, v1 and v2 encoding
+ * and decoding, the dedup tables, uplink record headers and batch
+ * envelopes. The corpus is generated: N nodes (default 256) with a few
+ * frames each, interleaved as a gateway hears them. v1 encoding is what
+ * the sender does after filling the struct: copy it into the TX buffer and
+ * append the LBT report. v2 encoding runs one node's stream, as on a
+ * sender; v2 decoding runs every node's, so its key frames are looked up.
+ *
+ * Each case runs for at least MS milliseconds (default 300). Results go to
+ * stdout as one JSON object:
+ *
+ *   {"benchmark":"packet_bench","nodes":256,"v2DeltaFrames":...,"v2Frames":...,"results":[
+ *     {"name":"validate_v1","ops":...,"seconds":...,"opsPerSec":...,"nsPerOp":...}, ...]}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SensorSentinel_dedup_helper.h"
+#include "SensorSentinel_packet_helper.h"
+
+#define BENCH_FRAMES_PER_NODE  16      // Frames per node in the corpus
+#define BENCH_ENVELOPE_SIZE    512     // MQTT_MAX_PACKET_SIZE of the gateway envs
+#define BENCH_GATEWAY_ID       0x1234ABCD
+
+typedef struct {
+  std::vector<uint8_t> bytes;
+} bench_frame_t;
+
+typedef struct {
+  const char *name;
+  uint64_t ops;
+  double seconds;
+} bench_result_t;
+
+static volatile uint32_t _sink;        // Keeps results alive under -O2
+
+static double _now_s()
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void _fill_sensor(SensorSentinel_sensor_packet_t *p, uint32_t nodeId, uint32_t counter, std::mt19937 &rng)
+{
+  memset(p, 0, sizeof(*p));
+  p->messageType = SensorSentinel_MSG_SENSOR;
+  p->nodeId = nodeId;
+  p->messageCounter = counter;
+  p->uptime = counter * 30;
+  p->batteryLevel = 80 + rng() % 5;
+  p->batteryVoltage = 3900 + rng() % 50;
+  for (int ch = 0; ch < 4; ch++)
+  {
+    p->pins.analog[ch] = 1000 + ch * 500 + rng() % 40;  // Slow drift: deltas stay short
+  }
+  p->pins.boolean = rng() % 4 == 0 ? 0x05 : 0x01;
+}
+
+static void _fill_gnss(SensorSentinel_gnss_packet_t *p, uint32_t nodeId, uint32_t counter, std::mt19937 &rng)
+{
+  memset(p, 0, sizeof(*p));
+  p->messageType = SensorSentinel_MSG_GNSS;
+  p->nodeId = nodeId;
+  p->messageCounter = counter;
+  p->uptime = counter * 90;
+  p->batteryLevel = 75;
+  p->batteryVoltage = 3850;
+  p->latitude = -33.86f + (rng() % 100) * 1e-5f;
+  p->longitude = 151.21f + (rng() % 100) * 1e-5f;
+  p->speed = (rng() % 500) / 10.0f;
+  p->hdop = 9;
+  p->course = (rng() % 36000) / 100.0f;
+}
+
+// Time fn(i) over i = 0..count-1, repeated until minSecs have passed
+static bench_result_t _run(const char *name, size_t count, double minSecs, const std::function<void(size_t)> &fn)
+{
+  bench_result_t r = {name, 0, 0};
+  double start = _now_s();
+  do
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      fn(i);
+    }
+    r.ops += count;
+    r.seconds = _now_s() - start;
+  } while (r.seconds < minSecs);
+  return r;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t nodes = 256;
+  double minSecs = 0.3;
+  const char *filter = NULL;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--nodes") && i + 1 < argc)
+    {
+      nodes = (uint32_t)strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--min-ms") && i + 1 < argc)
+    {
+      minSecs = strtod(argv[++i], NULL) / 1000.0;
+    }
+    else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+    {
+      filter = argv[++i];
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [--nodes N] [--min-ms MS] [--filter TEXT]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (nodes == 0)
+  {
+    nodes = 1;
+  }
+
+  // ── Corpus ──────────────────────────────────────────────────────────────────
+  std::mt19937 rng(12345);
+  std::vector<uint32_t> nodeIds(nodes);
+  for (uint32_t n = 0; n < nodes; n++)
+  {
+    nodeIds[n] = 0x10000000u + n * 7919u;
+  }
+
+  std::vector<SensorSentinel_sensor_packet_t> sensors;
+  std::vector<SensorSentinel_gnss_packet_t> gnss;
+  for (uint32_t f = 0; f < BENCH_FRAMES_PER_NODE; f++)
+  {
+    for (uint32_t n = 0; n < nodes; n++)
+    {
+      SensorSentinel_sensor_packet_t s;
+      _fill_sensor(&s, nodeIds[n], 1000 + f, rng);
+      sensors.push_back(s);
+      if (f % 4 == 0)
+      {
+        SensorSentinel_gnss_packet_t g;
+        _fill_gnss(&g, nodeIds[n], 1000 + f, rng);
+        gnss.push_back(g);
+      }
+    }
+  }
+
+  std::vector<bench_frame_t> v1Frames;
+  for (const auto &s : sensors)
+  {
+    const uint8_t *b = (const uint8_t *)&s;
+    v1Frames.push_back({std::vector<uint8_t>(b, b + sizeof(s))});
+  }
+  for (const auto &g : gnss)
+  {
+    const uint8_t *b = (const uint8_t *)&g;
+    v1Frames.push_back({std::vector<uint8_t>(b, b + sizeof(g))});
+  }
+
+  // v2 streams are encoded one node at a time, as each sender would, then
+  // interleaved by counter as a gateway hears them
+  std::vector<std::vector<bench_frame_t>> perNode(nodes);
+  for (uint32_t n = 0; n < nodes; n++)
+  {
+    for (uint32_t f = 0; f < BENCH_FRAMES_PER_NODE; f++)
+    {
+      SensorSentinel_packet_t packet;
+      packet.sensor = sensors[f * nodes + n];
+      uint8_t out[SensorSentinel_V2_MAX_FRAME];
+      size_t length = SensorSentinel_encode_packet_v2(&packet, out, sizeof(out));
+      perNode[n].push_back({std::vector<uint8_t>(out, out + length)});
+    }
+  }
+  std::vector<bench_frame_t> v2Frames;
+  size_t v2Deltas = 0;
+  for (uint32_t f = 0; f < BENCH_FRAMES_PER_NODE; f++)
+  {
+    for (uint32_t n = 0; n < nodes; n++)
+    {
+      const bench_frame_t &frame = perNode[n][f];
+      SensorSentinel_v2_header_t h;
+      v2Deltas += SensorSentinel_v2_parse_header(frame.bytes.data(), frame.bytes.size(), &h) && h.delta;
+      v2Frames.push_back(frame);
+    }
+  }
+
+  std::vector<SensorSentinel_rx_slot_t> slots(v1Frames.size() < 1024 ? v1Frames.size() : 1024);
+  for (size_t i = 0; i < slots.size(); i++)
+  {
+    memcpy(slots[i].data, v1Frames[i].bytes.data(), v1Frames[i].bytes.size());
+    slots[i].length = v1Frames[i].bytes.size();
+    slots[i].rssi = -80.5f - (i % 30);
+    slots[i].snr = 7.25f - (i % 10);
+    slots[i].freqError = 1200.0f;
+  }
+
+  // ── Cases ───────────────────────────────────────────────────────────────────
+  std::vector<bench_result_t> results;
+  auto add = [&](const char *name, size_t count, const std::function<void(size_t)> &fn) {
+    if (filter && !strstr(name, filter))
+    {
+      return;
+    }
+    results.push_back(_run(name, count, minSecs, fn));
+  };
+
+  add("validate_v1", v1Frames.size(), [&](size_t i) {
+    _sink += SensorSentinel_validate_packet(v1Frames[i].bytes.data(), v1Frames[i].bytes.size());
+  });
+
+  add("validate_v2", v2Frames.size(), [&](size_t i) {
+    _sink += SensorSentinel_validate_packet(v2Frames[i].bytes.data(), v2Frames[i].bytes.size());
+  });
+
+  add("extract_node_id", v1Frames.size(),
+      [&](size_t i) { _sink += SensorSentinel_extract_node_id_from_packet(v1Frames[i].bytes.data()); });
+
+  add("extract_counter", v1Frames.size(),
+      [&](size_t i) { _sink += SensorSentinel_get_message_counter_from_packet(v1Frames[i].bytes.data()); });
+
+  {
+    const SensorSentinel_tx_report_t report = {2, 0, 340};
+    uint8_t tx[MAX_LORA_PACKET_SIZE];
+    add("v1_encode", sensors.size(), [&](size_t i) {
+      memcpy(tx, &sensors[i], sizeof(sensors[i]));
+      _sink += SensorSentinel_add_tx_report(tx, sizeof(sensors[i]), sizeof(tx), &report);
+    });
+  }
+
+  {
+    SensorSentinel_packet_t out;
+    add("v1_decode", v1Frames.size(), [&](size_t i) {
+      _sink += SensorSentinel_decode_packet(v1Frames[i].bytes.data(), v1Frames[i].bytes.size(), &out);
+    });
+  }
+
+  {
+    // One sender's stream: the first node's frames, over and over
+    std::vector<SensorSentinel_packet_t> stream(BENCH_FRAMES_PER_NODE);
+    for (uint32_t f = 0; f < BENCH_FRAMES_PER_NODE; f++)
+    {
+      stream[f].sensor = sensors[f * nodes];
+    }
+    uint8_t out[SensorSentinel_V2_MAX_FRAME];
+    uint32_t counter = 0;
+    add("v2_encode_sensor", stream.size(), [&](size_t i) {
+      stream[i].sensor.messageCounter = ++counter;
+      _sink += SensorSentinel_encode_packet_v2(&stream[i], out, sizeof(out));
+    });
+
+    std::vector<SensorSentinel_packet_t> gstream(gnss.size() < 64 ? gnss.size() : 64);
+    for (size_t f = 0; f < gstream.size(); f++)
+    {
+      gstream[f].gnss = gnss[f];
+      gstream[f].gnss.nodeId = nodeIds[0];
+    }
+    add("v2_encode_gnss", gstream.size(), [&](size_t i) {
+      gstream[i].gnss.messageCounter = ++counter;
+      _sink += SensorSentinel_encode_packet_v2(&gstream[i], out, sizeof(out));
+    });
+  }
+
+  {
+    SensorSentinel_packet_t out;
+    add("v2_decode_sensor", v2Frames.size(), [&](size_t i) {
+      _sink += SensorSentinel_decode_packet(v2Frames[i].bytes.data(), v2Frames[i].bytes.size(), &out);
+    });
+  }
+
+  {
+    // Every frame new: insert into both tables
+    SensorSentinel_dedup_init();
+    uint32_t nowMs = 0, counter = 0;
+    add("dedup_new", nodes, [&](size_t i) {
+      if (i == 0)
+      {
+        counter++;
+        nowMs += 10;
+      }
+      _sink += SensorSentinel_dedup_check_at(nodeIds[i], counter, nowMs);
+    });
+
+    // Every frame a copy from another gateway: a hit in the frame table
+    SensorSentinel_dedup_init();
+    for (uint32_t n = 0; n < nodes; n++)
+    {
+      SensorSentinel_dedup_check_at(nodeIds[n], 1, 0);
+    }
+    add("dedup_duplicate", nodes,
+        [&](size_t i) { _sink += SensorSentinel_dedup_check_at(nodeIds[i], 1, 1); });
+  }
+
+  add("build_uplink_record", slots.size(), [&](size_t i) {
+    _sink += *SensorSentinel_build_uplink_record(&slots[i], BENCH_GATEWAY_ID, 1700000000000ull + i);
+  });
+
+  {
+    // Records appended until the envelope is full, then a new one started
+    std::vector<const uint8_t *> records(slots.size());
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+      records[i] = SensorSentinel_build_uplink_record(&slots[i], BENCH_GATEWAY_ID, 1700000000000ull);
+    }
+    uint8_t envelope[BENCH_ENVELOPE_SIZE];
+    size_t length = 0;
+    add("batch_append", slots.size(), [&](size_t i) {
+      size_t recordLength = SensorSentinel_UPLINK_HEADROOM + slots[i].length;
+      if (!SensorSentinel_batch_append(envelope, &length, sizeof(envelope), records[i], recordLength))
+      {
+        _sink += length;
+        length = 0;
+        SensorSentinel_batch_append(envelope, &length, sizeof(envelope), records[i], recordLength);
+      }
+    });
+  }
+
+  // ── Report ──────────────────────────────────────────────────────────────────
+  std::string json = "{\"benchmark\":\"packet_bench\",\"nodes\":" + std::to_string(nodes) +
+                     ",\"v2DeltaFrames\":" + std::to_string(v2Deltas) + ",\"v2Frames\":" +
+                     std::to_string(v2Frames.size()) + ",\"results\":[";
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const bench_result_t &r = results[i];
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "%s\n  {\"name\":\"%s\",\"ops\":%llu,\"seconds\":%.3f,\"opsPerSec\":%.0f,\"nsPerOp\":%.2f}",
+             i ? "," : "", r.name, (unsigned long long)r.ops, r.seconds, r.ops / r.seconds,
+             r.seconds * 1e9 / r.ops);
+    json += buf;
+  }
+  json += "\n]}\n";
+  fputs(json.c_str(), stdout);
+  return 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * @file ingest_cache.cpp
+ * @brief Device/pin cache loading and LISTEN/NOTIFY refresh
+ */
+
+#include "ingest_cache.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// $1 is a device ID, or NULL for all devices
+static const char *DEVICES_SQL =
+    "SELECT d.id, d.node_id, d.display_name, o.name, o.email, o.notify_via "
+    "FROM devices d LEFT JOIN owners o ON o.id = d.owner_id "
+    "WHERE $1::int IS NULL OR d.id = $1::int";
+
+static const char *DIGITAL_SQL =
+    "SELECT device_id, pin_index, label, trigger, alert_level FROM digital_pins "
+    "WHERE label <> '' AND trigger IN ('High', 'Low') AND ($1::int IS NULL OR device_id = $1::int)";
+
+static const char *ANALOG_SQL =
+    "SELECT device_id, pin_index, label, low_threshold, high_threshold, alert_level FROM analog_pins "
+    "WHERE label <> '' AND alert_level <> 'None' AND ($1::int IS NULL OR device_id = $1::int)";
+
+static PGresult *_query(ingest_cache_t *cache, const char *sql, const char *deviceId)
+{
+  const char *params[1] = {deviceId};
+  PGresult *result = PQexecParams(cache->conn, sql, 1, NULL, params, NULL, NULL, 0);
+  if (PQresultStatus(result) != PGRES_TUPLES_OK)
+  {
+    fprintf(stderr, "Cache: %s", PQerrorMessage(cache->conn));
+    PQclear(result);
+    return NULL;
+  }
+  return result;
+}
+
+static std::string _text(PGresult *r, int row, int col)
+{
+  return PQgetisnull(r, row, col) ? std::string() : std::string(PQgetvalue(r, row, col));
+}
+
+static void _erase_device(ingest_cache_t *cache, int32_t id)
+{
+  auto it = cache->nodeOf.find(id);
+  if (it != cache->nodeOf.end())
+  {
+    auto device = cache->devices.find(it->second);
+    if (device != cache->devices.end())
+    {
+      threshold_table_clear(&cache->thresholds, device->second.slot);
+      cache->freeSlots.push_back(device->second.slot);
+      cache->devices.erase(device);
+    }
+    cache->nodeOf.erase(it);
+  }
+}
+
+static uint32_t _allocate_slot(ingest_cache_t *cache)
+{
+  if (!cache->freeSlots.empty())
+  {
+    uint32_t slot = cache->freeSlots.back();
+    cache->freeSlots.pop_back();
+    return slot;
+  }
+  if (cache->nextSlot >= cache->thresholds.slots)
+  {
+    threshold_table_resize(&cache->thresholds, std::max<uint32_t>(64, cache->thresholds.slots * 2));
+  }
+  return cache->nextSlot++;
+}
+
+// Write a device's pins into its threshold table slot
+static void _store_thresholds(ingest_cache_t *cache, const ingest_device_t *device)
+{
+  threshold_table_t *table = &cache->thresholds;
+  threshold_table_clear(table, device->slot);
+  for (const ingest_digital_pin_t &pin : device->digital)
+  {
+    threshold_table_set_digital(table, device->slot, pin.index,
+                                pin.high ? THRESHOLD_TRIGGER_HIGH : THRESHOLD_TRIGGER_LOW);
+  }
+  for (const ingest_analog_pin_t &pin : device->analog)
+  {
+    threshold_table_set_analog(table, device->slot, pin.index, pin.hasLow, pin.low, pin.hasHigh, pin.high);
+  }
+}
+
+// Load all devices (deviceId NULL) or one; replaces what was held for them
+static bool _load(ingest_cache_t *cache, const char *deviceId)
+{
+  PGresult *devices = _query(cache, DEVICES_SQL, deviceId);
+  PGresult *digital = devices ? _query(cache, DIGITAL_SQL, deviceId) : NULL;
+  PGresult *analog = digital ? _query(cache, ANALOG_SQL, deviceId) : NULL;
+  if (!analog)
+  {
+    PQclear(devices);
+    PQclear(digital);
+    return false;
+  }
+
+  if (deviceId)
+  {
+    _erase_device(cache, atoi(deviceId));
+  }
+  else
+  {
+    cache->devices.clear();
+    cache->nodeOf.clear();
+    cache->freeSlots.clear();
+    for (uint32_t slot = 0; slot < cache->nextSlot; slot++)
+    {
+      threshold_table_clear(&cache->thresholds, slot);
+    }
+    cache->nextSlot = 0;
+  }
+
+  std::vector<uint32_t> loaded;
+
+  for (int i = 0; i < PQntuples(devices); i++)
+  {
+    ingest_device_t device;
+    device.id = atoi(PQgetvalue(devices, i, 0));
+    device.nodeId = (uint32_t)strtoull(PQgetvalue(devices, i, 1), NULL, 10);
+    device.displayName = _text(devices, i, 2);
+    device.ownerName = _text(devices, i, 3);
+    device.ownerEmail = _text(devices, i, 4);
+    device.notifyVia = _text(devices, i, 5);
+    _erase_device(cache, device.id);
+    auto previous = cache->devices.find(device.nodeId);
+    if (previous != cache->devices.end())
+    {
+      _erase_device(cache, previous->second.id);  // Node ID moved to this device
+    }
+    device.slot = _allocate_slot(cache);
+    loaded.push_back(device.nodeId);
+    cache->nodeOf[device.id] = device.nodeId;
+    cache->devices[device.nodeId] = std::move(device);
+  }
+
+  for (int i = 0; i < PQntuples(digital); i++)
+  {
+    auto node = cache->nodeOf.find(atoi(PQgetvalue(digital, i, 0)));
+    if (node == cache->nodeOf.end())
+    {
+      continue;
+    }
+    ingest_digital_pin_t pin;
+    pin.index = (uint8_t)atoi(PQgetvalue(digital, i, 1));
+    pin.label = _text(digital, i, 2);
+    pin.high = strcmp(PQgetvalue(digital, i, 3), "High") == 0;
+    pin.alertLevel = _text(digital, i, 4);
+    cache->devices[node->second].digital.push_back(std::move(pin));
+  }
+
+  for (int i = 0; i < PQntuples(analog); i++)
+  {
+    auto node = cache->nodeOf.find(atoi(PQgetvalue(analog, i, 0)));
+    if (node == cache->nodeOf.end())
+    {
+      continue;
+    }
+    ingest_analog_pin_t pin;
+    pin.index = (uint8_t)atoi(PQgetvalue(analog, i, 1));
+    pin.label = _text(analog, i, 2);
+    pin.hasLow = !PQgetisnull(analog, i, 3);
+    pin.low = pin.hasLow ? strtod(PQgetvalue(analog, i, 3), NULL) : 0;
+    pin.hasHigh = !PQgetisnull(analog, i, 4);
+    pin.high = pin.hasHigh ? strtod(PQgetvalue(analog, i, 4), NULL) : 0;
+    pin.alertLevel = _text(analog, i, 5);
+    cache->devices[node->second].analog.push_back(std::move(pin));
+  }
+
+  for (uint32_t nodeId : loaded)
+  {
+    _store_thresholds(cache, &cache->devices[nodeId]);
+  }
+
+  PQclear(devices);
+  PQclear(digital);
+  PQclear(analog);
+
+  cache->stats.devices = (uint32_t)cache->devices.size();
+  if (deviceId)
+  {
+    cache->stats.deviceReloads++;
+  }
+  else
+  {
+    cache->stats.fullReloads++;
+  }
+  return true;
+}
+
+static bool _connect(ingest_cache_t *cache)
+{
+  if (cache->conn)
+  {
+    PQfinish(cache->conn);
+  }
+  cache->conn = PQconnectdb(cache->conninfo.c_str());
+  if (PQstatus(cache->conn) != CONNECTION_OK)
+  {
+    fprintf(stderr, "Cache: %s", PQerrorMessage(cache->conn));
+    return false;
+  }
+
+  // LISTEN before loading, so no change can fall between the two
+  PGresult *result = PQexec(cache->conn, "LISTEN " INGEST_CONFIG_CHANNEL);
+  bool ok = PQresultStatus(result) == PGRES_COMMAND_OK;
+  PQclear(result);
+  if (!ok || !_load(cache, NULL))
+  {
+    PQfinish(cache->conn);
+    cache->conn = NULL;
+    return false;
+  }
+  PQsetnonblocking(cache->conn, 1);
+  printf("Cache: %u devices loaded\n", cache->stats.devices);
+  return true;
+}
+
+bool ingest_cache_open(ingest_cache_t *cache, const char *conninfo)
+{
+  cache->conninfo = conninfo ? conninfo : "";
+  return _connect(cache);
+}
+
+const ingest_device_t *ingest_cache_find(const ingest_cache_t *cache, uint32_t nodeId)
+{
+  auto it = cache->devices.find(nodeId);
+  return it == cache->devices.end() ? NULL : &it->second;
+}
+
+int ingest_cache_fd(const ingest_cache_t *cache)
+{
+  return cache->conn && PQstatus(cache->conn) == CONNECTION_OK ? PQsocket(cache->conn) : -1;
+}
+
+bool ingest_cache_poll(ingest_cache_t *cache)
+{
+  if (!cache->conn || PQstatus(cache->conn) != CONNECTION_OK || !PQconsumeInput(cache->conn))
+  {
+    cache->stats.reconnects++;
+    return _connect(cache);
+  }
+
+  // Collect first: several notifications often name the same device
+  bool all = false;
+  std::vector<std::string> ids;
+  PGnotify *n;
+  while ((n = PQnotifies(cache->conn)) != NULL)
+  {
+    cache->stats.notifications++;
+    if (n->extra[0] == '\0')
+    {
+      all = true;
+    }
+    else if (std::find(ids.begin(), ids.end(), n->extra) == ids.end())
+    {
+      ids.push_back(n->extra);
+    }
+    PQfreemem(n);
+  }
+  if (!all && ids.empty())
+  {
+    return true;
+  }
+
+  PQsetnonblocking(cache->conn, 0);
+  bool ok = true;
+  if (all)
+  {
+    ok = _load(cache, NULL);
+  }
+  else
+  {
+    for (const std::string &id : ids)
+    {
+      ok = _load(cache, id.c_str()) && ok;
+    }
+  }
+  PQsetnonblocking(cache->conn, 1);
+  return ok;
+}
+
+void ingest_cache_close(ingest_cache_t *cache)
+{
+  if (cache->conn)
+  {
+    PQfinish(cache->conn);
+    cache->conn = NULL;
+  }
+}
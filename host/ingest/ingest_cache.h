@@ -0,0 +1,107 @@
+/**
+ * @file ingest_cache.h
+ * @brief In-memory copy of devices, owners and alerting pins
+ *
+ * Replaces the per-message "Get Device + Pins" query of the Node-RED flow.
+ * The whole configuration is loaded once; after that the cache LISTENs on
+ * sensorsentinel_config, which triggers in 01_schema.sql notify with the
+ * device ID when a device or one of its pins changes (or '' when an owner
+ * does), and reloads only what changed. Only pins that can raise an alert
+ * are kept: labelled digital pins with a High/Low trigger, labelled analog
+ * pins with an alert level. Their thresholds are also kept in a threshold
+ * engine table, one slot per device, so readings can be checked in batches.
+ *
+ * The cache has its own connection and is used from one thread.
+ */
+
+#ifndef INGEST_CACHE_H
+#define INGEST_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <libpq-fe.h>
+#include "threshold_engine.h"
+
+#define INGEST_CONFIG_CHANNEL "sensorsentinel_config"
+
+typedef struct {
+  uint8_t index;               // 0..7
+  bool high;                   // Trigger 'High' (else 'Low')
+  std::string label;
+  std::string alertLevel;
+} ingest_digital_pin_t;
+
+typedef struct {
+  uint8_t index;               // 0..3
+  bool hasLow;
+  bool hasHigh;
+  double low;
+  double high;
+  std::string label;
+  std::string alertLevel;
+} ingest_analog_pin_t;
+
+typedef struct {
+  int32_t id;                  // devices.id
+  uint32_t nodeId;
+  uint32_t slot;               // Row in ingest_cache_t.thresholds
+  std::string displayName;
+  std::string ownerName;
+  std::string ownerEmail;
+  std::string notifyVia;
+  std::vector<ingest_digital_pin_t> digital;
+  std::vector<ingest_analog_pin_t> analog;
+} ingest_device_t;
+
+typedef struct {
+  uint32_t devices;            // Devices held
+  uint32_t fullReloads;
+  uint32_t deviceReloads;
+  uint32_t notifications;
+  uint32_t reconnects;
+} ingest_cache_stats_t;
+
+typedef struct {
+  std::string conninfo;
+  PGconn *conn = NULL;
+  std::unordered_map<uint32_t, ingest_device_t> devices;  // By node ID
+  std::unordered_map<int32_t, uint32_t> nodeOf;           // devices.id to node ID
+  threshold_table_t thresholds;                           // Every device's pins, by slot
+  std::vector<uint32_t> freeSlots;                        // Slots of removed devices
+  uint32_t nextSlot = 0;
+  ingest_cache_stats_t stats = {};
+} ingest_cache_t;
+
+/**
+ * @brief Connect, LISTEN and load everything
+ * @param conninfo libpq connection string ("" reads the PG* environment)
+ * @return false if the database could not be reached or read
+ */
+bool ingest_cache_open(ingest_cache_t *cache, const char *conninfo);
+
+/**
+ * @brief Look up a device by node ID
+ * @return The device, or NULL if it is not registered. Valid until the next
+ *         ingest_cache_poll().
+ */
+const ingest_device_t *ingest_cache_find(const ingest_cache_t *cache, uint32_t nodeId);
+
+/**
+ * @brief Socket to poll for notifications, or -1 when disconnected
+ */
+int ingest_cache_fd(const ingest_cache_t *cache);
+
+/**
+ * @brief Apply pending notifications; reconnect and reload after a failure
+ * @return false while the database is unreachable (the old contents stay)
+ */
+bool ingest_cache_poll(ingest_cache_t *cache);
+
+/**
+ * @brief Close the connection
+ */
+void ingest_cache_close(ingest_cache_t *cache);
+
+#endif // INGEST_CACHE_H
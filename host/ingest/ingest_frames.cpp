@@ -0,0 +1,397 @@
+/**
+ * @file ingest_frames.cpp
+ * @brief Record splitting, in-place frame views and reading JSON
+ */
+
+#include "ingest_frames.h"
+
+#include <charconv>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "Frames are read in place; the host must be little-endian like the ESP32");
+
+// A summary's means and last digital state have the pin readings layout, so
+// the summary reading can point at them like any other
+static_assert(offsetof(SensorSentinel_aggregate_summary_t, digitalLast) ==
+                  offsetof(SensorSentinel_aggregate_summary_t, analogMean) + offsetof(SensorSentinel_pin_readings_t, boolean),
+              "analogMean/digitalLast must match SensorSentinel_pin_readings_t");
+
+// ── Records ───────────────────────────────────────────────────────────────────
+
+int ingest_split_payload(const uint8_t *payload, size_t length, ingest_record_cb onRecord, void *ctx)
+{
+  if (!payload || length == 0)
+  {
+    return 0;
+  }
+  if (payload[0] != INGEST_BATCH_MARKER)
+  {
+    onRecord(ctx, payload, length);
+    return 1;
+  }
+
+  // [marker][count] then per record [u16 LE length][record]
+  if (length < 2)
+  {
+    return -1;
+  }
+  uint8_t count = payload[1];
+  size_t offset = 2;
+  for (int i = 0; i < count; i++)
+  {
+    if (offset + 2 > length)
+    {
+      return -1;
+    }
+    size_t recordLength = payload[offset] | (payload[offset + 1] << 8);
+    offset += 2;
+    if (recordLength == 0 || offset + recordLength > length)
+    {
+      return -1;
+    }
+    onRecord(ctx, payload + offset, recordLength);
+    offset += recordLength;
+  }
+  return count;
+}
+
+ingest_frame_result_t ingest_parse_record(const uint8_t *record, size_t length, ingest_frame_t *frame)
+{
+  memset(frame, 0, offsetof(ingest_frame_t, decoded));
+  if (!record || length == 0)
+  {
+    return INGEST_FRAME_MALFORMED;
+  }
+
+  const uint8_t *data = record;
+  if (record[0] == SensorSentinel_UPLINK_VERSION)
+  {
+    if (length < SensorSentinel_UPLINK_HEADROOM)
+    {
+      return INGEST_FRAME_MALFORMED;
+    }
+    const SensorSentinel_uplink_header_t *header = (const SensorSentinel_uplink_header_t *)record;
+    if (SensorSentinel_UPLINK_HEADROOM + header->length != length)
+    {
+      return INGEST_FRAME_MALFORMED;
+    }
+    frame->rx.present = true;
+    frame->rx.gatewayId = header->gatewayId;
+    frame->rx.rxEpochMs = header->rxEpochMs;
+    frame->rx.rssi = header->rssi;
+    frame->rx.snr = header->snr;
+    frame->rx.freqError = header->freqError;
+    data += SensorSentinel_UPLINK_HEADROOM;
+    length -= SensorSentinel_UPLINK_HEADROOM;
+  }
+
+  if (length == 0 || !SensorSentinel_validate_packet(data, length))
+  {
+    return INGEST_FRAME_MALFORMED;
+  }
+  frame->messageType = data[0];
+  frame->hasReport = SensorSentinel_get_tx_report(data, length, &frame->report);
+  frame->hasEdges = SensorSentinel_get_pin_edges(data, length, &frame->edges);
+
+  switch (data[0])
+  {
+  case SensorSentinel_MSG_SENSOR:
+    frame->sensor = (const SensorSentinel_sensor_packet_t *)data;
+    break;
+
+  case SensorSentinel_MSG_GNSS:
+    frame->gnss = (const SensorSentinel_gnss_packet_t *)data;
+    break;
+
+  case SensorSentinel_MSG_AGGREGATE:
+    frame->aggregate = (const SensorSentinel_aggregate_header_t *)data;
+    if (frame->aggregate->mode == AGGREGATE_MODE_SUMMARY)
+    {
+      frame->summary = (const SensorSentinel_aggregate_summary_t *)(data + sizeof(*frame->aggregate));
+    }
+    else
+    {
+      frame->samples = (const SensorSentinel_pin_readings_t *)(data + sizeof(*frame->aggregate));
+    }
+    break;
+
+  case SensorSentinel_MSG_SENSOR_V2:
+  case SensorSentinel_MSG_GNSS_V2:
+    if (!SensorSentinel_decode_packet(data, length, &frame->decoded))
+    {
+      memcpy(&frame->nodeId, data + 1, sizeof(frame->nodeId));  // Fixed-width in v2 too
+      return INGEST_FRAME_UNDECODABLE;
+    }
+    if (frame->decoded.header.messageType == SensorSentinel_MSG_SENSOR)
+    {
+      frame->sensor = &frame->decoded.sensor;
+    }
+    else
+    {
+      frame->gnss = &frame->decoded.gnss;
+    }
+    break;
+
+  default:
+    return INGEST_FRAME_MALFORMED;  // validate_packet() only passes the types above
+  }
+
+  // The header fields sit at the same offsets in every v1 layout
+  const SensorSentinel_packet_t *common = frame->sensor ? (const SensorSentinel_packet_t *)frame->sensor
+                                        : frame->gnss   ? (const SensorSentinel_packet_t *)frame->gnss
+                                                        : (const SensorSentinel_packet_t *)frame->aggregate;
+  frame->nodeId = common->header.nodeId;
+  frame->messageCounter = common->header.messageCounter;
+  if (frame->nodeId == 0)
+  {
+    return INGEST_FRAME_INVALID;
+  }
+  if (frame->gnss && (frame->gnss->latitude < -90 || frame->gnss->latitude > 90 ||
+                      frame->gnss->longitude < -180 || frame->gnss->longitude > 180))
+  {
+    return INGEST_FRAME_INVALID;
+  }
+  return INGEST_FRAME_OK;
+}
+
+// ── Readings ──────────────────────────────────────────────────────────────────
+
+int ingest_reading_count(const ingest_frame_t *frame)
+{
+  return frame->samples ? frame->aggregate->sampleCount : 1;
+}
+
+void ingest_get_reading(const ingest_frame_t *frame, int index, ingest_reading_t *reading)
+{
+  reading->frame = frame;
+  reading->isGnss = frame->gnss != NULL;
+  reading->sampleIndex = -1;
+
+  if (frame->aggregate)
+  {
+    reading->uptime = frame->aggregate->uptime;
+    reading->batteryLevel = frame->aggregate->batteryLevel;
+    reading->batteryVoltage = frame->aggregate->batteryVoltage;
+    if (frame->samples)
+    {
+      reading->pins = &frame->samples[index];
+      reading->sampleIndex = index;
+    }
+    else
+    {
+      reading->pins = (const SensorSentinel_pin_readings_t *)frame->summary->analogMean;
+    }
+  }
+  else if (frame->sensor)
+  {
+    reading->uptime = frame->sensor->uptime;
+    reading->batteryLevel = frame->sensor->batteryLevel;
+    reading->batteryVoltage = frame->sensor->batteryVoltage;
+    reading->pins = &frame->sensor->pins;
+  }
+  else
+  {
+    reading->uptime = frame->gnss->uptime;
+    reading->batteryLevel = frame->gnss->batteryLevel;
+    reading->batteryVoltage = frame->gnss->batteryVoltage;
+    reading->pins = NULL;
+  }
+}
+
+const char *ingest_reading_topic(const ingest_reading_t *reading)
+{
+  return reading->isGnss ? "lora/out/gnss" : "lora/out/sensor";
+}
+
+// ── JSON ──────────────────────────────────────────────────────────────────────
+
+static void _uint(std::string &out, uint64_t value)
+{
+  char buf[24];
+  auto r = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, r.ptr);
+}
+
+static void _int(std::string &out, int64_t value)
+{
+  char buf[24];
+  auto r = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, r.ptr);
+}
+
+// Shortest round-trip form, as JavaScript prints numbers
+static void _number(std::string &out, double value)
+{
+  char buf[32];
+  auto r = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, r.ptr);
+}
+
+static void _key(std::string &out, const char *key)
+{
+  if (out.back() != '{')
+  {
+    out += ',';
+  }
+  out += '"';
+  out += key;
+  out += "\":";
+}
+
+static void _u16s(std::string &out, const uint16_t *values, int count = 4)
+{
+  out += '[';
+  for (int i = 0; i < count; i++)
+  {
+    if (i)
+    {
+      out += ',';
+    }
+    _uint(out, values[i]);
+  }
+  out += ']';
+}
+
+// Date.toISOString(): 2024-01-31T12:34:56.789Z
+static void _iso_time(std::string &out, uint64_t epochMs)
+{
+  time_t secs = (time_t)(epochMs / 1000);
+  struct tm tm;
+  gmtime_r(&secs, &tm);
+  char buf[64];
+  snprintf(buf, sizeof(buf), "\"%04d-%02d-%02dT%02d:%02d:%02d.%03uZ\"", tm.tm_year + 1900, tm.tm_mon + 1,
+           tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned)(epochMs % 1000));
+  out += buf;
+}
+
+void ingest_reading_json(const ingest_reading_t *reading, std::string &out)
+{
+  const ingest_frame_t *frame = reading->frame;
+  out += '{';
+  _key(out, "type");
+  out += reading->isGnss ? "\"gnss\"" : "\"sensor\"";
+  _key(out, "nodeId");
+  _uint(out, frame->nodeId);
+  _key(out, "counter");
+  _uint(out, frame->messageCounter);
+  _key(out, "uptime");
+  _uint(out, reading->uptime);
+  _key(out, "battery");
+  _uint(out, reading->batteryLevel);
+  _key(out, "voltage");
+  _uint(out, reading->batteryVoltage);
+
+  if (reading->isGnss)
+  {
+    const SensorSentinel_gnss_packet_t *g = frame->gnss;
+    _key(out, "latitude");
+    _number(out, g->latitude);
+    _key(out, "longitude");
+    _number(out, g->longitude);
+    _key(out, "speed");
+    _number(out, g->speed);
+    _key(out, "hdop");
+    _number(out, g->hdop / 10.0);
+    _key(out, "course");
+    _number(out, g->course);
+  }
+  else
+  {
+    _key(out, "analog");
+    _u16s(out, reading->pins->analog);
+    _key(out, "digital");
+    _uint(out, reading->pins->boolean);
+    if (frame->messageType == SensorSentinel_MSG_SENSOR)
+    {
+      _key(out, "skipped");
+      _uint(out, frame->sensor->skippedCount);
+    }
+    if (frame->hasEdges)
+    {
+      _key(out, "edges");
+      out += '{';
+      _key(out, "changed");
+      _uint(out, frame->edges.changed);
+      _key(out, "pulses");
+      _u16s(out, frame->edges.pulses, SensorSentinel_BOOLEAN_COUNT);
+      out += '}';
+    }
+  }
+
+  if (frame->aggregate)
+  {
+    const SensorSentinel_aggregate_header_t *agg = frame->aggregate;
+    _key(out, "aggregate");
+    out += '{';
+    if (frame->summary)
+    {
+      _key(out, "count");
+      _uint(out, agg->sampleCount);
+      _key(out, "intervalSecs");
+      _uint(out, agg->sampleIntervalSecs);
+      _key(out, "min");
+      _u16s(out, frame->summary->analogMin);
+      _key(out, "max");
+      _u16s(out, frame->summary->analogMax);
+      _key(out, "mean");
+      _u16s(out, frame->summary->analogMean);
+      _key(out, "digitalAny");
+      _uint(out, frame->summary->digitalAny);
+      _key(out, "digitalAll");
+      _uint(out, frame->summary->digitalAll);
+    }
+    else
+    {
+      _key(out, "index");
+      _int(out, reading->sampleIndex);
+      _key(out, "count");
+      _uint(out, agg->sampleCount);
+      _key(out, "intervalSecs");
+      _uint(out, agg->sampleIntervalSecs);
+      _key(out, "ageSecs");
+      _uint(out, (uint32_t)(agg->sampleCount - 1 - reading->sampleIndex) * agg->sampleIntervalSecs);
+    }
+    out += '}';
+  }
+
+  if (frame->hasReport)
+  {
+    _key(out, "lbt");
+    out += '{';
+    _key(out, "busy");
+    _uint(out, frame->report.busy);
+    _key(out, "forced");
+    _uint(out, frame->report.forced);
+    _key(out, "backoffMs");
+    _uint(out, frame->report.backoffMs);
+    out += '}';
+  }
+
+  if (frame->rx.present)
+  {
+    _key(out, "rx");
+    out += '{';
+    _key(out, "gatewayId");
+    _uint(out, frame->rx.gatewayId);
+    _key(out, "time");
+    if (frame->rx.rxEpochMs > 0)
+    {
+      _iso_time(out, frame->rx.rxEpochMs);
+    }
+    else
+    {
+      out += "null";
+    }
+    _key(out, "rssi");
+    _number(out, frame->rx.rssi / 10.0);
+    _key(out, "snr");
+    _number(out, frame->rx.snr / 10.0);
+    _key(out, "freqError");
+    _int(out, frame->rx.freqError);
+    out += '}';
+  }
+  out += '}';
+}
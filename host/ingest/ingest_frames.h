@@ -0,0 +1,131 @@
+/**
+ * @file ingest_frames.h
+ * @brief Uplink payloads to readings: batch envelopes, RX headers, frame views
+ *
+ * Accepts what gateways publish on lora/in/#: a bare frame (older
+ * gateways), an uplink record (SensorSentinel_uplink_header_t + frame), or
+ * a batch envelope of records (MQTT_BATCH_MODE). Frames are checked with
+ * SensorSentinel_validate_packet() and read in place through the packed
+ * firmware structs; only v2 frames are expanded, by
+ * SensorSentinel_decode_packet(). Each frame yields one reading, except an
+ * "all readings" aggregate, which yields one per sample.
+ *
+ * The JSON written for a reading matches what the Node-RED
+ * "Parse Binary to JSON" function produces, so events rows and dashboards
+ * do not depend on which of the two ingested them.
+ */
+
+#ifndef INGEST_FRAMES_H
+#define INGEST_FRAMES_H
+
+#include <string>
+#include "SensorSentinel_packet_helper.h"
+
+#define INGEST_BATCH_MARKER SensorSentinel_BATCH_MARKER
+
+/**
+ * @brief Gateway RX metadata from an uplink record header
+ */
+typedef struct {
+  bool present;                // false for bare frames
+  uint32_t gatewayId;
+  uint64_t rxEpochMs;          // 0 until the gateway synced NTP
+  int16_t rssi;                // dBm x 10
+  int16_t snr;                 // dB x 10
+  int32_t freqError;           // Hz
+} ingest_rx_t;
+
+/**
+ * @brief One validated frame and where its fields live
+ *
+ * The pointers are views into the MQTT payload, or into decoded for v2
+ * frames, and are valid while both are.
+ */
+typedef struct {
+  uint8_t messageType;                              // Frame's own type byte (v1 or v2)
+  uint32_t nodeId;
+  uint32_t messageCounter;
+  const SensorSentinel_sensor_packet_t *sensor;     // Sensor frames
+  const SensorSentinel_gnss_packet_t *gnss;         // GNSS frames
+  const SensorSentinel_aggregate_header_t *aggregate;  // Aggregate frames
+  const SensorSentinel_pin_readings_t *samples;     // Aggregate, AGGREGATE_MODE_SAMPLES
+  const SensorSentinel_aggregate_summary_t *summary;   // Aggregate, AGGREGATE_MODE_SUMMARY
+  bool hasReport;
+  SensorSentinel_tx_report_t report;
+  bool hasEdges;                                    // v2 sensor frames (PINS_EDGE_MODE)
+  SensorSentinel_pin_edges_t edges;
+  ingest_rx_t rx;
+  SensorSentinel_packet_t decoded;                  // Storage for expanded v2 frames
+} ingest_frame_t;
+
+/**
+ * @brief One set of values for thresholds and the events table
+ *
+ * Header fields are copied; pin values point into the frame.
+ */
+typedef struct {
+  const ingest_frame_t *frame;
+  bool isGnss;
+  uint32_t uptime;
+  uint8_t batteryLevel;
+  uint16_t batteryVoltage;
+  const SensorSentinel_pin_readings_t *pins;        // Sensor readings (NULL for GNSS)
+  int sampleIndex;                                  // Aggregate sample, or -1
+} ingest_reading_t;
+
+/**
+ * @brief Why a record was not turned into a frame
+ */
+typedef enum {
+  INGEST_FRAME_OK,
+  INGEST_FRAME_MALFORMED,   // Truncated envelope/header, or failed validation
+  INGEST_FRAME_UNDECODABLE, // v2 delta without its key frame
+  INGEST_FRAME_INVALID      // Parses, but nodeId is 0 or a position is out of range
+} ingest_frame_result_t;
+
+/**
+ * @brief Called for each record in a payload
+ * @param ctx Caller's context
+ * @param record Record bytes (header + frame, or a bare frame)
+ * @param length Record length
+ */
+typedef void (*ingest_record_cb)(void *ctx, const uint8_t *record, size_t length);
+
+/**
+ * @brief Split an MQTT payload into records
+ * @return Records passed to onRecord, or -1 if a batch envelope is truncated
+ *         (the records before the damage are still delivered)
+ */
+int ingest_split_payload(const uint8_t *payload, size_t length, ingest_record_cb onRecord, void *ctx);
+
+/**
+ * @brief Parse one record into a frame view
+ * @param record Record bytes; must outlive frame
+ * @param length Record length
+ * @param frame Filled on INGEST_FRAME_OK
+ */
+ingest_frame_result_t ingest_parse_record(const uint8_t *record, size_t length, ingest_frame_t *frame);
+
+/**
+ * @brief Number of readings in a frame
+ */
+int ingest_reading_count(const ingest_frame_t *frame);
+
+/**
+ * @brief Get one reading of a frame
+ * @param index 0..ingest_reading_count()-1
+ */
+void ingest_get_reading(const ingest_frame_t *frame, int index, ingest_reading_t *reading);
+
+/**
+ * @brief Append the reading's JSON (the parser's payload object) to out
+ */
+void ingest_reading_json(const ingest_reading_t *reading, std::string &out);
+
+/**
+ * @brief Topic the Node-RED flow publishes the reading's JSON on
+ * @return "lora/out/sensor" or "lora/out/gnss"
+ */
+const char *ingest_reading_topic(const ingest_reading_t *reading);
+
+#endif // INGEST_FRAMES_H
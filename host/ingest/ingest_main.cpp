@@ -0,0 +1,401 @@
+/**
+ * @file ingest_main.cpp
+ * @brief sensorsentinel_ingest: lora/in/# to events, alerts and lora/out/<type>
+ *
+ * Native replacement for the Node-RED chain from "Best Copy per Frame" to
+ * "Batch Event Inserts". Per record: parse (ingest_frames), drop gateway
+ * copies already seen (the gateway's dedup tables),
+ * publish the reading JSON and look the device up in the cache. The
+ * readings of one socket read are then checked as a single threshold
+ * engine batch, and their events and alerts queued for the writer thread. Alerts
+ * are published on sentinel/alert for Node-RED to send the notification;
+ * unknown devices are registered and announced on sentinel/new_device.
+ *
+ * Configuration comes from the environment: MQTT_HOST, MQTT_PORT,
+ * MQTT_USER, MQTT_PASSWORD, INGEST_TOPIC, INGEST_CLIENT_ID,
+ * INGEST_BATCH_SIZE, INGEST_BATCH_MS, INGEST_DEDUP_MS, INGEST_PUBLISH_JSON,
+ * INGEST_STATS_SECS, and the PG* variables for the database.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include "SensorSentinel_dedup_helper.h"
+#include "ingest_cache.h"
+#include "ingest_frames.h"
+#include "ingest_mqtt.h"
+#include "ingest_thresholds.h"
+#include "ingest_writer.h"
+
+#define ALERT_TOPIC          "sentinel/alert"
+#define NEW_DEVICE_TOPIC     "sentinel/new_device"
+#define ERROR_TOPIC          "lora/out/error"
+#define MQTT_KEEPALIVE_SECS  30
+#define MQTT_BACKOFF_MAX_MS  30000
+#define CACHE_RETRY_MS       5000
+#define REGISTER_RETRY_MS    60000  // Before a still-unknown node is registered again
+
+typedef struct {
+  uint64_t records;
+  uint64_t malformed;
+  uint64_t undecodable;
+  uint64_t invalid;
+  uint64_t duplicates;
+  uint64_t unknown;            // Records from nodes not in devices
+  uint64_t readings;
+  uint64_t alerts;
+  uint64_t checkBatches;       // threshold_evaluate() calls
+} ingest_stats_t;
+
+typedef struct {
+  const char *mqttHost;
+  uint16_t mqttPort;
+  const char *mqttUser;
+  const char *mqttPassword;
+  const char *topic;
+  const char *clientId;
+  uint32_t batchEvents;
+  uint32_t batchMs;
+  uint32_t dedupMs;
+  bool publishJson;
+  uint32_t statsSecs;
+} ingest_config_t;
+
+// A reading from a known device, held until its read's threshold batch is checked
+typedef struct {
+  const ingest_device_t *device;
+  uint32_t nodeId;
+  bool isGnss;
+  bool hasPins;
+  ingest_checked_t checked;
+  uint32_t batchIndex;         // Frame in the threshold batch, if hasPins
+  size_t jsonStart;            // Reading JSON within pendingJson
+  size_t jsonLength;
+} ingest_pending_t;
+
+typedef struct {
+  ingest_config_t config;
+  ingest_mqtt_t mqtt;
+  ingest_cache_t cache;
+  ingest_writer_t writer;
+  std::unordered_map<uint32_t, uint64_t> registering;  // Node ID to when it was registered
+  std::string json;                                    // Scratch, reused per reading
+  std::string alertJson;
+  std::vector<ingest_alert_t> alerts;
+  std::vector<ingest_pending_t> pending;               // Readings of the current socket read
+  std::string pendingJson;
+  threshold_batch_t batch;
+  std::vector<threshold_alerts_t> masks;
+  ingest_stats_t stats = {};
+} ingest_t;
+
+static volatile sig_atomic_t _stop = 0;
+
+static void _on_signal(int)
+{
+  _stop = 1;
+}
+
+static const char *_env(const char *name, const char *fallback)
+{
+  const char *value = getenv(name);
+  return value && value[0] ? value : fallback;
+}
+
+static uint32_t _env_uint(const char *name, uint32_t fallback)
+{
+  const char *value = getenv(name);
+  return value && value[0] ? (uint32_t)strtoul(value, NULL, 10) : fallback;
+}
+
+static void _publish(ingest_t *in, const char *topic, const std::string &payload)
+{
+  if (ingest_mqtt_fd(&in->mqtt) >= 0)
+  {
+    ingest_mqtt_publish(&in->mqtt, topic, payload.data(), payload.size());
+  }
+}
+
+static void _publish_error(ingest_t *in, const char *error, uint32_t nodeId)
+{
+  if (!in->config.publishJson)
+  {
+    return;
+  }
+  char text[96];
+  snprintf(text, sizeof(text), "{\"error\":\"%s from node %u\"}", error, (unsigned)nodeId);
+  _publish(in, ERROR_TOPIC, text);
+}
+
+// Register an unknown node, at most once per REGISTER_RETRY_MS; the NOTIFY
+// from the insert brings it into the cache
+static void _register(ingest_t *in, uint32_t nodeId)
+{
+  uint64_t now = ingest_now_ms();
+  auto it = in->registering.find(nodeId);
+  if (it != in->registering.end() && now - it->second < REGISTER_RETRY_MS)
+  {
+    return;
+  }
+  in->registering[nodeId] = now;
+
+  char name[16];
+  snprintf(name, sizeof(name), "Node-%08X", (unsigned)nodeId);
+  ingest_writer_register(&in->writer, nodeId, name);
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  struct tm tm;
+  gmtime_r(&ts.tv_sec, &tm);
+  char json[128];
+  snprintf(json, sizeof(json), "{\"nodeId\":%u,\"displayName\":\"%s\",\"firstSeen\":\"%04d-%02d-%02dT%02d:%02d:%02d.%03dZ\"}",
+           (unsigned)nodeId, name, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+           (int)(ts.tv_nsec / 1000000));
+  _publish(in, NEW_DEVICE_TOPIC, json);
+  printf("Ingest: registered new node %s\n", name);
+}
+
+static void _on_record(void *ctx, const uint8_t *record, size_t length)
+{
+  ingest_t *in = (ingest_t *)ctx;
+  in->stats.records++;
+
+  ingest_frame_t frame;
+  switch (ingest_parse_record(record, length, &frame))
+  {
+  case INGEST_FRAME_OK:
+    break;
+  case INGEST_FRAME_MALFORMED:
+    in->stats.malformed++;
+    _publish_error(in, "Malformed record", 0);
+    return;
+  case INGEST_FRAME_UNDECODABLE:
+    in->stats.undecodable++;
+    _publish_error(in, "v2 delta frame without its key frame", frame.nodeId);
+    return;
+  case INGEST_FRAME_INVALID:
+    in->stats.invalid++;
+    _publish_error(in, "Invalid packet data", frame.nodeId);
+    return;
+  }
+
+  // Every gateway in range publishes its own copy; the first one wins
+  if (SensorSentinel_dedup_check_at(frame.nodeId, frame.messageCounter, (uint32_t)ingest_now_ms()) != DEDUP_NEW)
+  {
+    in->stats.duplicates++;
+    return;
+  }
+
+  const ingest_device_t *device = ingest_cache_find(&in->cache, frame.nodeId);
+  if (device)
+  {
+    ingest_writer_touch(&in->writer, frame.nodeId);
+  }
+  else
+  {
+    in->stats.unknown++;
+    _register(in, frame.nodeId);
+  }
+
+  int count = ingest_reading_count(&frame);
+  for (int i = 0; i < count; i++)
+  {
+    ingest_reading_t reading;
+    ingest_get_reading(&frame, i, &reading);
+    in->json.clear();
+    ingest_reading_json(&reading, in->json);
+    in->stats.readings++;
+    if (in->config.publishJson)
+    {
+      _publish(in, ingest_reading_topic(&reading), in->json);
+    }
+    if (!device)
+    {
+      continue;  // As in the flow: no events until the device is registered
+    }
+
+    ingest_pending_t p;
+    p.device = device;
+    p.nodeId = frame.nodeId;
+    p.isGnss = reading.isGnss;
+    p.hasPins = ingest_checked_values(&reading, &p.checked);
+    p.batchIndex = p.hasPins ? ingest_threshold_add(&in->batch, device, &p.checked) : 0;
+    p.jsonStart = in->pendingJson.size();
+    p.jsonLength = in->json.size();
+    in->pendingJson += in->json;
+    in->pending.push_back(p);
+  }
+}
+
+// Check the held readings in one batch, then queue their alerts and events
+static void _check_pending(ingest_t *in)
+{
+  if (in->pending.empty())
+  {
+    return;
+  }
+  in->masks.resize(in->batch.count);
+  threshold_evaluate(&in->cache.thresholds, &in->batch, in->masks.data());
+  in->stats.checkBatches++;
+
+  for (const ingest_pending_t &p : in->pending)
+  {
+    in->alerts.clear();
+    if (p.hasPins)
+    {
+      ingest_threshold_alerts(p.device, &p.checked, in->masks[p.batchIndex], in->alerts);
+    }
+    for (const ingest_alert_t &alert : in->alerts)
+    {
+      ingest_writer_add_alert(&in->writer, p.device->id, *alert.pinLabel, alert.message, *alert.alertLevel);
+      in->alertJson.clear();
+      ingest_alert_json(p.device, &alert, in->alertJson);
+      _publish(in, ALERT_TOPIC, in->alertJson);
+      in->stats.alerts++;
+    }
+    ingest_writer_add_event(&in->writer, p.device->id, p.nodeId, p.isGnss ? "gnss" : "sensor",
+                            std::string_view(in->pendingJson).substr(p.jsonStart, p.jsonLength));
+  }
+  in->pending.clear();
+  in->pendingJson.clear();
+  threshold_batch_clear(&in->batch);
+}
+
+static void _on_message(void *ctx, std::string_view, const uint8_t *payload, size_t length)
+{
+  ingest_t *in = (ingest_t *)ctx;
+  if (length == 0 || ingest_split_payload(payload, length, _on_record, in) < 0)
+  {
+    in->stats.malformed++;
+    _publish_error(in, "Truncated batch envelope", 0);
+  }
+}
+
+static void _print_stats(ingest_t *in)
+{
+  ingest_writer_stats_t w;
+  ingest_writer_get_stats(&in->writer, &w);
+  const ingest_stats_t &s = in->stats;
+  printf("Ingest: %llu msgs, %llu records (%llu malformed, %llu undecodable, %llu invalid, %llu dup, %llu unknown), "
+         "%llu readings, %llu alerts in %llu checks\n",
+         (unsigned long long)in->mqtt.stats.received, (unsigned long long)s.records,
+         (unsigned long long)s.malformed, (unsigned long long)s.undecodable, (unsigned long long)s.invalid,
+         (unsigned long long)s.duplicates, (unsigned long long)s.unknown, (unsigned long long)s.readings,
+         (unsigned long long)s.alerts, (unsigned long long)s.checkBatches);
+  printf("Writer: %llu events in %llu batches (last %u, avg %.1f ms), %llu dropped, %llu failures; "
+         "cache: %u devices, %u reloads\n",
+         (unsigned long long)w.events, (unsigned long long)w.batches, w.lastBatchEvents,
+         w.batches ? (double)w.writeMs / w.batches : 0.0, (unsigned long long)w.dropped,
+         (unsigned long long)w.failures, in->cache.stats.devices,
+         in->cache.stats.fullReloads + in->cache.stats.deviceReloads);
+  fflush(stdout);
+}
+
+int main()
+{
+  static ingest_t in;
+  ingest_config_t &c = in.config;
+  c.mqttHost = _env("MQTT_HOST", "mosquitto");
+  c.mqttPort = (uint16_t)_env_uint("MQTT_PORT", 1883);
+  c.mqttUser = _env("MQTT_USER", NULL);
+  c.mqttPassword = _env("MQTT_PASSWORD", NULL);
+  c.topic = _env("INGEST_TOPIC", "lora/in/#");
+  c.clientId = _env("INGEST_CLIENT_ID", "sensorsentinel-ingest");
+  c.batchEvents = _env_uint("INGEST_BATCH_SIZE", 1000);
+  c.batchMs = _env_uint("INGEST_BATCH_MS", 500);
+  c.dedupMs = _env_uint("INGEST_DEDUP_MS", 30000);
+  c.publishJson = _env_uint("INGEST_PUBLISH_JSON", 1) != 0;
+  c.statsSecs = _env_uint("INGEST_STATS_SECS", 60);
+
+  signal(SIGINT, _on_signal);
+  signal(SIGTERM, _on_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  SensorSentinel_dedup_init(c.dedupMs);
+  ingest_writer_start(&in.writer, "", c.batchEvents, c.batchMs);
+  ingest_cache_open(&in.cache, "");
+  printf("Ingest: %s:%u %s, batches of %u events / %u ms, %s thresholds\n", c.mqttHost, c.mqttPort, c.topic,
+         c.batchEvents, c.batchMs, threshold_isa_name(threshold_isa_resolve(THRESHOLD_ISA_BEST)));
+
+  uint64_t mqttRetryAt = 0;
+  uint32_t mqttBackoffMs = 1000;
+  uint64_t cacheRetryAt = ingest_now_ms() + CACHE_RETRY_MS;
+  uint64_t statsAt = ingest_now_ms() + (uint64_t)c.statsSecs * 1000;
+
+  while (!_stop)
+  {
+    uint64_t now = ingest_now_ms();
+
+    if (ingest_mqtt_fd(&in.mqtt) < 0 && now >= mqttRetryAt)
+    {
+      if (ingest_mqtt_connect(&in.mqtt, c.mqttHost, c.mqttPort, c.clientId, c.mqttUser, c.mqttPassword,
+                              MQTT_KEEPALIVE_SECS) &&
+          ingest_mqtt_subscribe(&in.mqtt, c.topic))
+      {
+        printf("Ingest: connected to %s:%u\n", c.mqttHost, c.mqttPort);
+        mqttBackoffMs = 1000;
+      }
+      else
+      {
+        ingest_mqtt_close(&in.mqtt);
+        mqttRetryAt = now + mqttBackoffMs;
+        mqttBackoffMs = std::min<uint32_t>(mqttBackoffMs * 2, MQTT_BACKOFF_MAX_MS);
+      }
+    }
+
+    if (ingest_cache_fd(&in.cache) < 0 && now >= cacheRetryAt)
+    {
+      ingest_cache_poll(&in.cache);
+      cacheRetryAt = now + CACHE_RETRY_MS;
+    }
+
+    struct pollfd fds[2] = {{ingest_mqtt_fd(&in.mqtt), POLLIN, 0}, {ingest_cache_fd(&in.cache), POLLIN, 0}};
+    if (poll(fds, 2, 1000) < 0 && errno != EINTR)
+    {
+      perror("poll");
+      break;
+    }
+
+    // Configuration changes first, so the readings that follow see them
+    if (fds[1].fd >= 0 && (fds[1].revents & (POLLIN | POLLERR | POLLHUP)))
+    {
+      ingest_cache_poll(&in.cache);
+    }
+    if (fds[0].fd >= 0 && (fds[0].revents & (POLLIN | POLLERR | POLLHUP)))
+    {
+      bool ok = ingest_mqtt_read(&in.mqtt, _on_message, &in);
+      _check_pending(&in);
+      if (!ok)
+      {
+        fprintf(stderr, "Ingest: MQTT connection lost\n");
+        ingest_mqtt_close(&in.mqtt);
+      }
+    }
+
+    now = ingest_now_ms();
+    if (ingest_mqtt_fd(&in.mqtt) >= 0 && !ingest_mqtt_service(&in.mqtt, now))
+    {
+      fprintf(stderr, "Ingest: MQTT keepalive timed out\n");
+      ingest_mqtt_close(&in.mqtt);
+    }
+    if (c.statsSecs && now >= statsAt)
+    {
+      _print_stats(&in);
+      statsAt = now + (uint64_t)c.statsSecs * 1000;
+    }
+  }
+
+  printf("Ingest: stopping\n");
+  ingest_mqtt_close(&in.mqtt);
+  ingest_writer_stop(&in.writer);
+  ingest_cache_close(&in.cache);
+  _print_stats(&in);
+  return 0;
+}
@@ -0,0 +1,452 @@
+/**
+ * @file ingest_mqtt.cpp
+ * @brief MQTT 3.1.1 framing over a non-blocking TCP socket
+ */
+
+#include "ingest_mqtt.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30
+#define MQTT_PUBACK      0x40
+#define MQTT_SUBSCRIBE   0x82  // Reserved flags 0010
+#define MQTT_SUBACK      0x90
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+
+#define MQTT_IO_TIMEOUT_MS 5000  // CONNACK wait and blocked writes
+#define MQTT_RX_CHUNK      65536
+
+uint64_t ingest_now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// ── Encoding ──────────────────────────────────────────────────────────────────
+
+static void _put_u16(std::vector<uint8_t> &out, uint16_t value)
+{
+  out.push_back(value >> 8);
+  out.push_back(value & 0xFF);
+}
+
+static void _put_string(std::vector<uint8_t> &out, const char *s)
+{
+  size_t length = strlen(s);
+  _put_u16(out, (uint16_t)length);
+  out.insert(out.end(), s, s + length);
+}
+
+// Start a packet: fixed header with room for the largest remaining length
+static void _begin(std::vector<uint8_t> &out, uint8_t type)
+{
+  out.clear();
+  out.push_back(type);
+  out.insert(out.end(), 4, 0);
+}
+
+// Write the remaining length and return the packet start (the unused
+// length bytes are skipped so the body does not move)
+static const uint8_t *_finish(std::vector<uint8_t> &out, size_t *length)
+{
+  size_t remaining = out.size() - 5;
+  uint8_t encoded[4];
+  size_t n = 0;
+  do
+  {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    encoded[n++] = digit | (remaining > 0 ? 0x80 : 0);
+  } while (remaining > 0 && n < 4);
+
+  size_t start = 4 - n;
+  out[start] = out[0];
+  memcpy(&out[start + 1], encoded, n);
+  *length = out.size() - start;
+  return &out[start];
+}
+
+// ── Socket ────────────────────────────────────────────────────────────────────
+
+static bool _wait(int fd, short events, int timeoutMs)
+{
+  struct pollfd p = {fd, events, 0};
+  int n;
+  do
+  {
+    n = poll(&p, 1, timeoutMs);
+  } while (n < 0 && errno == EINTR);
+  return n > 0 && !(p.revents & (POLLERR | POLLNVAL));
+}
+
+static bool _send_all(ingest_mqtt_t *client, const uint8_t *data, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t n = send(client->fd, data, length, MSG_NOSIGNAL);
+    if (n > 0)
+    {
+      data += n;
+      length -= n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && _wait(client->fd, POLLOUT, MQTT_IO_TIMEOUT_MS))
+    {
+      continue;
+    }
+    return false;
+  }
+  client->lastSendMs = ingest_now_ms();
+  return true;
+}
+
+static bool _send_packet(ingest_mqtt_t *client)
+{
+  size_t length;
+  const uint8_t *packet = _finish(client->tx, &length);
+  return _send_all(client, packet, length);
+}
+
+static int _open_socket(const char *host, uint16_t port)
+{
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *result = NULL;
+  if (getaddrinfo(host, service, &hints, &result) != 0)
+  {
+    return -1;
+  }
+
+  int fd = -1;
+  for (struct addrinfo *ai = result; ai && fd < 0; ai = ai->ai_next)
+  {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd < 0)
+    {
+      continue;
+    }
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+    {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(result);
+
+  if (fd >= 0)
+  {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  }
+  return fd;
+}
+
+// ── API ───────────────────────────────────────────────────────────────────────
+
+bool ingest_mqtt_connect(ingest_mqtt_t *client, const char *host, uint16_t port, const char *clientId,
+                         const char *user, const char *password, uint16_t keepaliveSecs)
+{
+  ingest_mqtt_close(client);
+  client->fd = _open_socket(host, port);
+  if (client->fd < 0)
+  {
+    return false;
+  }
+  client->keepaliveSecs = keepaliveSecs;
+  client->rx.resize(MQTT_RX_CHUNK);
+  client->rxStart = client->rxEnd = 0;
+  client->pingPending = false;
+
+  bool hasUser = user && *user;
+  bool hasPassword = hasUser && password && *password;
+  _begin(client->tx, MQTT_CONNECT);
+  _put_string(client->tx, "MQTT");
+  client->tx.push_back(4);  // Protocol level 3.1.1
+  client->tx.push_back(0x02 | (hasUser ? 0x80 : 0) | (hasPassword ? 0x40 : 0));  // Clean session
+  _put_u16(client->tx, keepaliveSecs);
+  _put_string(client->tx, clientId);
+  if (hasUser)
+  {
+    _put_string(client->tx, user);
+  }
+  if (hasPassword)
+  {
+    _put_string(client->tx, password);
+  }
+  if (!_send_packet(client))
+  {
+    ingest_mqtt_close(client);
+    return false;
+  }
+
+  // CONNACK is 4 bytes; nothing else may arrive before it
+  uint8_t connack[4];
+  size_t got = 0;
+  while (got < sizeof(connack) && _wait(client->fd, POLLIN, MQTT_IO_TIMEOUT_MS))
+  {
+    ssize_t n = recv(client->fd, connack + got, sizeof(connack) - got, 0);
+    if (n <= 0 && !(n < 0 && (errno == EAGAIN || errno == EINTR)))
+    {
+      break;
+    }
+    got += n > 0 ? n : 0;
+  }
+  if (got < sizeof(connack) || connack[0] != MQTT_CONNACK || connack[1] != 2 || connack[3] != 0)
+  {
+    fprintf(stderr, "MQTT: connection refused (return code %d)\n", got == sizeof(connack) ? connack[3] : -1);
+    ingest_mqtt_close(client);
+    return false;
+  }
+
+  client->lastRecvMs = ingest_now_ms();
+  client->stats.connects++;
+  return true;
+}
+
+bool ingest_mqtt_subscribe(ingest_mqtt_t *client, const char *topicFilter)
+{
+  if (client->fd < 0)
+  {
+    return false;
+  }
+  _begin(client->tx, MQTT_SUBSCRIBE);
+  _put_u16(client->tx, client->nextPacketId++);
+  if (client->nextPacketId == 0)
+  {
+    client->nextPacketId = 1;
+  }
+  _put_string(client->tx, topicFilter);
+  client->tx.push_back(0);  // QoS 0
+  return _send_packet(client);
+}
+
+bool ingest_mqtt_publish(ingest_mqtt_t *client, const char *topic, const void *payload, size_t length)
+{
+  if (client->fd < 0)
+  {
+    return false;
+  }
+  _begin(client->tx, MQTT_PUBLISH);
+  _put_string(client->tx, topic);
+  const uint8_t *bytes = (const uint8_t *)payload;
+  client->tx.insert(client->tx.end(), bytes, bytes + length);
+  if (!_send_packet(client))
+  {
+    return false;
+  }
+  client->stats.published++;
+  return true;
+}
+
+// Handle one complete packet; false on a protocol error
+static bool _dispatch(ingest_mqtt_t *client, uint8_t type, const uint8_t *body, size_t length,
+                      ingest_mqtt_message_cb onMessage, void *ctx)
+{
+  switch (type & 0xF0)
+  {
+  case MQTT_PUBLISH:
+  {
+    uint8_t qos = (type >> 1) & 0x03;
+    if (length < 2)
+    {
+      return false;
+    }
+    size_t topicLength = ((size_t)body[0] << 8) | body[1];
+    size_t offset = 2 + topicLength + (qos ? 2 : 0);
+    if (offset > length || qos > 1)
+    {
+      return false;
+    }
+    if (qos == 1)
+    {
+      // Subscriptions are QoS 0, but acknowledge anything the broker sends at 1
+      _begin(client->tx, MQTT_PUBACK);
+      client->tx.push_back(body[2 + topicLength]);
+      client->tx.push_back(body[3 + topicLength]);
+      _send_packet(client);
+    }
+    client->stats.received++;
+    client->stats.receivedBytes += length - offset;
+    onMessage(ctx, std::string_view((const char *)body + 2, topicLength), body + offset, length - offset);
+    return true;
+  }
+
+  case MQTT_PINGRESP:
+    client->pingPending = false;
+    return true;
+
+  case MQTT_SUBACK:
+    if (length >= 3 && body[length - 1] == 0x80)
+    {
+      fprintf(stderr, "MQTT: subscription refused\n");
+      return false;
+    }
+    return true;
+
+  default:
+    return true;  // Nothing else is expected at QoS 0; ignore it
+  }
+}
+
+bool ingest_mqtt_read(ingest_mqtt_t *client, ingest_mqtt_message_cb onMessage, void *ctx)
+{
+  if (client->fd < 0)
+  {
+    return false;
+  }
+
+  for (;;)
+  {
+    if (client->rxEnd == client->rx.size())
+    {
+      // Make room: drop parsed bytes first, grow only for a large packet
+      memmove(client->rx.data(), client->rx.data() + client->rxStart, client->rxEnd - client->rxStart);
+      client->rxEnd -= client->rxStart;
+      client->rxStart = 0;
+      if (client->rxEnd == client->rx.size())
+      {
+        client->rx.resize(client->rx.size() * 2);
+      }
+    }
+
+    ssize_t n = recv(client->fd, client->rx.data() + client->rxEnd, client->rx.size() - client->rxEnd, 0);
+    if (n == 0)
+    {
+      return false;  // Broker closed the connection
+    }
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    client->rxEnd += n;
+    client->lastRecvMs = ingest_now_ms();
+
+    // Every complete packet in the buffer
+    for (;;)
+    {
+      const uint8_t *p = client->rx.data() + client->rxStart;
+      size_t available = client->rxEnd - client->rxStart;
+      if (available < 2)
+      {
+        break;
+      }
+
+      size_t remaining = 0;
+      size_t header = 1;
+      bool complete = false;
+      for (int shift = 0; header < 5 && header < available; shift += 7)
+      {
+        uint8_t digit = p[header++];
+        remaining |= (size_t)(digit & 0x7F) << shift;
+        if (!(digit & 0x80))
+        {
+          complete = true;
+          break;
+        }
+      }
+      if (!complete)
+      {
+        if (header >= 5)
+        {
+          return false;  // Malformed remaining length
+        }
+        break;
+      }
+      if (remaining > INGEST_MQTT_MAX_PACKET)
+      {
+        fprintf(stderr, "MQTT: %zu byte packet exceeds INGEST_MQTT_MAX_PACKET\n", remaining);
+        return false;
+      }
+      if (available < header + remaining)
+      {
+        break;
+      }
+
+      if (!_dispatch(client, p[0], p + header, remaining, onMessage, ctx))
+      {
+        return false;
+      }
+      client->rxStart += header + remaining;
+    }
+
+    if (client->rxStart == client->rxEnd)
+    {
+      client->rxStart = client->rxEnd = 0;
+    }
+  }
+}
+
+bool ingest_mqtt_service(ingest_mqtt_t *client, uint64_t nowMs)
+{
+  if (client->fd < 0)
+  {
+    return false;
+  }
+  uint64_t keepaliveMs = (uint64_t)client->keepaliveSecs * 1000;
+  if (keepaliveMs == 0)
+  {
+    return true;
+  }
+  if (client->pingPending && nowMs - client->lastRecvMs > keepaliveMs * 3 / 2)
+  {
+    fprintf(stderr, "MQTT: no PINGRESP, reconnecting\n");
+    return false;
+  }
+  if (!client->pingPending && nowMs - client->lastSendMs > keepaliveMs / 2)
+  {
+    _begin(client->tx, MQTT_PINGREQ);
+    if (!_send_packet(client))
+    {
+      return false;
+    }
+    client->pingPending = true;
+  }
+  return true;
+}
+
+int ingest_mqtt_fd(const ingest_mqtt_t *client)
+{
+  return client->fd;
+}
+
+void ingest_mqtt_close(ingest_mqtt_t *client)
+{
+  if (client->fd < 0)
+  {
+    return;
+  }
+  _begin(client->tx, MQTT_DISCONNECT);
+  size_t length;
+  const uint8_t *packet = _finish(client->tx, &length);
+  send(client->fd, packet, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+  close(client->fd);
+  client->fd = -1;
+}
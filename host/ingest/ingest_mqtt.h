@@ -0,0 +1,117 @@
+/**
+ * @file ingest_mqtt.h
+ * @brief Minimal MQTT 3.1.1 client for the ingest bridge
+ *
+ * Subscribes and publishes at QoS 0, which is all the bridge needs. Incoming
+ * PUBLISH packets are parsed in place in the receive buffer: the callback
+ * gets the topic and payload as views into it, valid until it returns, so
+ * a frame is never copied between the socket and the decoder. The socket is
+ * non-blocking; the caller polls ingest_mqtt_fd() and calls
+ * ingest_mqtt_read() when it is readable.
+ */
+
+#ifndef INGEST_MQTT_H
+#define INGEST_MQTT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string_view>
+#include <vector>
+
+#ifndef INGEST_MQTT_MAX_PACKET
+#define INGEST_MQTT_MAX_PACKET (1024 * 1024)  // Larger packets drop the connection
+#endif
+
+/**
+ * @brief Called for every PUBLISH received
+ * @param ctx Context given to ingest_mqtt_read()
+ * @param topic Topic, a view into the receive buffer
+ * @param payload Payload, a view into the receive buffer
+ * @param length Payload length
+ */
+typedef void (*ingest_mqtt_message_cb)(void *ctx, std::string_view topic, const uint8_t *payload, size_t length);
+
+/**
+ * @brief MQTT client counters
+ */
+typedef struct {
+  uint64_t received;       // PUBLISH packets received
+  uint64_t receivedBytes;  // Payload bytes received
+  uint64_t published;      // PUBLISH packets sent
+  uint32_t connects;       // Successful CONNECTs
+} ingest_mqtt_stats_t;
+
+/**
+ * @brief Connection state
+ */
+typedef struct {
+  int fd = -1;
+  uint16_t keepaliveSecs = 60;
+  uint16_t nextPacketId = 1;
+  uint64_t lastSendMs = 0;
+  uint64_t lastRecvMs = 0;
+  bool pingPending = false;
+  std::vector<uint8_t> rx;  // Receive buffer; packets are parsed in place
+  size_t rxStart = 0;
+  size_t rxEnd = 0;
+  std::vector<uint8_t> tx;  // Scratch for outgoing packets
+  ingest_mqtt_stats_t stats = {};
+} ingest_mqtt_t;
+
+/**
+ * @brief Connect and wait for CONNACK (clean session)
+ * @param client Client state; closed first if open
+ * @param host Broker host name or address
+ * @param port Broker port
+ * @param clientId MQTT client identifier
+ * @param user User name, or NULL/empty for none
+ * @param password Password, or NULL/empty for none
+ * @param keepaliveSecs Keepalive interval
+ * @return true once the broker has accepted the connection
+ */
+bool ingest_mqtt_connect(ingest_mqtt_t *client, const char *host, uint16_t port, const char *clientId,
+                         const char *user, const char *password, uint16_t keepaliveSecs);
+
+/**
+ * @brief Subscribe to a topic filter at QoS 0
+ * @return true if the SUBSCRIBE was sent (the SUBACK is not waited for)
+ */
+bool ingest_mqtt_subscribe(ingest_mqtt_t *client, const char *topicFilter);
+
+/**
+ * @brief Publish at QoS 0
+ * @return true if the whole packet was written to the socket
+ */
+bool ingest_mqtt_publish(ingest_mqtt_t *client, const char *topic, const void *payload, size_t length);
+
+/**
+ * @brief Read what the socket has and dispatch the complete packets in it
+ * @param onMessage Called for each PUBLISH
+ * @param ctx Passed to onMessage
+ * @return false if the connection was closed or broke the protocol
+ */
+bool ingest_mqtt_read(ingest_mqtt_t *client, ingest_mqtt_message_cb onMessage, void *ctx);
+
+/**
+ * @brief Keepalive: ping when idle, fail when the broker stops answering
+ * @param nowMs Current time (same clock as ingest_now_ms())
+ * @return false if the connection should be considered dead
+ */
+bool ingest_mqtt_service(ingest_mqtt_t *client, uint64_t nowMs);
+
+/**
+ * @brief Socket to poll for reading, or -1 when disconnected
+ */
+int ingest_mqtt_fd(const ingest_mqtt_t *client);
+
+/**
+ * @brief Send DISCONNECT (if connected) and close the socket
+ */
+void ingest_mqtt_close(ingest_mqtt_t *client);
+
+/**
+ * @brief Milliseconds on a monotonic clock
+ */
+uint64_t ingest_now_ms();
+
+#endif // INGEST_MQTT_H
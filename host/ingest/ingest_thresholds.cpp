@@ -0,0 +1,123 @@
+/**
+ * @file ingest_thresholds.cpp
+ * @brief Engine input from readings, alerts from engine bitmasks, alert JSON
+ */
+
+#include "ingest_thresholds.h"
+
+#include <stdio.h>
+
+static void _add(std::vector<ingest_alert_t> &alerts, const std::string &label, const std::string &level,
+                 const char *format, unsigned value)
+{
+  ingest_alert_t alert;
+  alert.pinLabel = &label;
+  alert.alertLevel = &level;
+  snprintf(alert.message, sizeof(alert.message), format, value);
+  alerts.push_back(alert);
+}
+
+bool ingest_checked_values(const ingest_reading_t *reading, ingest_checked_t *checked)
+{
+  if (!reading->pins)
+  {
+    return false;  // GNSS readings have no pins
+  }
+  const SensorSentinel_aggregate_summary_t *summary = reading->frame->summary;
+  for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+  {
+    checked->low[ch] = summary ? summary->analogMin[ch] : reading->pins->analog[ch];
+    checked->high[ch] = summary ? summary->analogMax[ch] : reading->pins->analog[ch];
+  }
+  checked->highBits = summary ? summary->digitalAny : reading->pins->boolean;
+  checked->lowBits = summary ? summary->digitalAll : reading->pins->boolean;
+  return true;
+}
+
+uint32_t ingest_threshold_add(threshold_batch_t *batch, const ingest_device_t *device,
+                              const ingest_checked_t *checked)
+{
+  return threshold_batch_add(batch, device->slot, checked->low, checked->high, checked->highBits, checked->lowBits);
+}
+
+int ingest_threshold_alerts(const ingest_device_t *device, const ingest_checked_t *checked,
+                            threshold_alerts_t mask, std::vector<ingest_alert_t> &alerts)
+{
+  if (mask == 0)
+  {
+    return 0;
+  }
+  size_t before = alerts.size();
+
+  for (const ingest_digital_pin_t &pin : device->digital)
+  {
+    if (mask & (1u << pin.index))
+    {
+      _add(alerts, pin.label, pin.alertLevel, pin.high ? "Triggered HIGH" : "Triggered LOW", 0);
+    }
+  }
+
+  for (const ingest_analog_pin_t &pin : device->analog)
+  {
+    if (mask & THRESHOLD_LOW_BIT(pin.index))
+    {
+      _add(alerts, pin.label, pin.alertLevel, "Analog value LOW: %u", checked->low[pin.index]);
+    }
+    else if (mask & THRESHOLD_HIGH_BIT(pin.index))
+    {
+      _add(alerts, pin.label, pin.alertLevel, "Analog value HIGH: %u", checked->high[pin.index]);
+    }
+  }
+  return (int)(alerts.size() - before);
+}
+
+static void _string(std::string &out, const std::string &s)
+{
+  out += '"';
+  for (char c : s)
+  {
+    switch (c)
+    {
+    case '"':  out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if ((unsigned char)c < 0x20)
+      {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      }
+      else
+      {
+        out += c;
+      }
+    }
+  }
+  out += '"';
+}
+
+static void _field(std::string &out, const char *key, const std::string &value)
+{
+  out += out.back() == '{' ? "\"" : ",\"";
+  out += key;
+  out += "\":";
+  _string(out, value);
+}
+
+void ingest_alert_json(const ingest_device_t *device, const ingest_alert_t *alert, std::string &out)
+{
+  out += '{';
+  out += "\"deviceId\":" + std::to_string(device->id);
+  _field(out, "ownerName", device->ownerName);
+  _field(out, "ownerEmail", device->ownerEmail);
+  _field(out, "notifyVia", device->notifyVia);
+  _field(out, "deviceName", device->displayName);
+  out += ",\"nodeId\":" + std::to_string(device->nodeId);
+  _field(out, "pinLabel", *alert->pinLabel);
+  _field(out, "alertMessage", alert->message);
+  _field(out, "alertLevel", *alert->alertLevel);
+  out += '}';
+}
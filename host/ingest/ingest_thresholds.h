@@ -0,0 +1,73 @@
+/**
+ * @file ingest_thresholds.h
+ * @brief Alert rules of the Node-RED "Check Thresholds" function
+ *
+ * Digital pins alert on their trigger level ('High' or 'Low'); analog pins
+ * alert below low_threshold or, failing that, above high_threshold. For an
+ * aggregate summary the extremes are checked: digitalAny for 'High',
+ * digitalAll for 'Low', and the min/max of each analog pin.
+ *
+ * The checks themselves run in batches in the threshold engine
+ * (host/threshold), against the table the device cache keeps. These
+ * functions turn readings into engine input and alert bitmasks back into
+ * the alerts the flow would have raised.
+ */
+
+#ifndef INGEST_THRESHOLDS_H
+#define INGEST_THRESHOLDS_H
+
+#include <string>
+#include <vector>
+#include "ingest_cache.h"
+#include "ingest_frames.h"
+#include "threshold_engine.h"
+
+/**
+ * @brief Values of a reading that thresholds are checked against
+ */
+typedef struct {
+  uint16_t low[THRESHOLD_CHANNELS];   // Compared with low_threshold (summary: min)
+  uint16_t high[THRESHOLD_CHANNELS];  // Compared with high_threshold (summary: max)
+  uint8_t highBits;                   // Compared with 'High' triggers (summary: digitalAny)
+  uint8_t lowBits;                    // Compared with 'Low' triggers (summary: digitalAll)
+} ingest_checked_t;
+
+/**
+ * @brief One alert raised by a reading
+ *
+ * pinLabel and alertLevel point into the device cache and are valid until
+ * the next ingest_cache_poll().
+ */
+typedef struct {
+  const std::string *pinLabel;
+  const std::string *alertLevel;
+  char message[40];            // "Triggered HIGH", "Analog value LOW: 12", ...
+} ingest_alert_t;
+
+/**
+ * @brief Get the values a reading's thresholds are checked against
+ * @return false for readings without pins (GNSS)
+ */
+bool ingest_checked_values(const ingest_reading_t *reading, ingest_checked_t *checked);
+
+/**
+ * @brief Add a reading's checked values to an engine batch
+ * @return Index of the frame in the batch
+ */
+uint32_t ingest_threshold_add(threshold_batch_t *batch, const ingest_device_t *device,
+                              const ingest_checked_t *checked);
+
+/**
+ * @brief Expand an engine bitmask into alerts
+ * @param alerts Raised alerts are appended, digital pins then analog
+ * @return Number of alerts raised
+ */
+int ingest_threshold_alerts(const ingest_device_t *device, const ingest_checked_t *checked,
+                            threshold_alerts_t mask, std::vector<ingest_alert_t> &alerts);
+
+/**
+ * @brief Append the alert JSON that "Send Notification" expects in msg.alert
+ */
+void ingest_alert_json(const ingest_device_t *device, const ingest_alert_t *alert, std::string &out);
+
+#endif // INGEST_THRESHOLDS_H
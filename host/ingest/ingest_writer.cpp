@@ -0,0 +1,397 @@
+/**
+ * @file ingest_writer.cpp
+ * @brief Batched, double-buffered database writes
+ */
+
+#include "ingest_writer.h"
+#include "ingest_mqtt.h"  // ingest_now_ms()
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+#define WRITER_RETRY_MS 1000  // Between reconnect attempts while the database is down
+
+static const char *REGISTER_SQL =
+    "INSERT INTO devices (node_id, display_name) "
+    "SELECT * FROM unnest($1::bigint[], $2::text[]) ON CONFLICT (node_id) DO NOTHING";
+
+static const char *COPY_SQL = "COPY events (device_id, node_id, message_type, payload) FROM STDIN";
+
+static const char *TOUCH_SQL = "UPDATE devices SET last_seen = NOW() WHERE node_id = ANY($1::bigint[])";
+
+static const char *ALERTS_SQL =
+    "INSERT INTO alerts (device_id, pin_label, alert_message, alert_level, count) "
+    "SELECT * FROM unnest($1::int[], $2::text[], $3::text[], $4::text[], $5::int[]) "
+    "ON CONFLICT (device_id, pin_label) DO UPDATE SET alert_message = EXCLUDED.alert_message, "
+    "count = alerts.count + EXCLUDED.count, updated_at = NOW()";
+
+// ── Encoding ──────────────────────────────────────────────────────────────────
+
+// COPY text format: backslash escapes for the delimiter, newlines and itself
+static void _copy_text(std::string &out, std::string_view s)
+{
+  for (char c : s)
+  {
+    switch (c)
+    {
+    case '\\': out += "\\\\"; break;
+    case '\t': out += "\\t"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    default:   out += c;
+    }
+  }
+}
+
+// Array literal element, always quoted
+static void _array_text(std::string &out, const std::string &s)
+{
+  out += out.size() > 1 ? ",\"" : "\"";
+  for (char c : s)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out += '\\';
+    }
+    out += c;
+  }
+  out += '"';
+}
+
+template <typename T>
+static void _array_number(std::string &out, T value)
+{
+  if (out.size() > 1)
+  {
+    out += ',';
+  }
+  out += std::to_string(value);
+}
+
+// ── Statements ────────────────────────────────────────────────────────────────
+
+static bool _exec(PGconn *conn, const char *sql, int count = 0, const char *const *params = NULL)
+{
+  PGresult *result = PQexecParams(conn, sql, count, NULL, params, NULL, NULL, 0);
+  ExecStatusType status = PQresultStatus(result);
+  PQclear(result);
+  if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK)
+  {
+    fprintf(stderr, "Writer: %s", PQerrorMessage(conn));
+    return false;
+  }
+  return true;
+}
+
+static bool _copy(PGconn *conn, const std::string &rows)
+{
+  PGresult *result = PQexec(conn, COPY_SQL);
+  bool started = PQresultStatus(result) == PGRES_COPY_IN;
+  PQclear(result);
+  if (!started)
+  {
+    fprintf(stderr, "Writer: %s", PQerrorMessage(conn));
+    return false;
+  }
+
+  bool sent = PQputCopyData(conn, rows.data(), (int)rows.size()) == 1;
+  PQputCopyEnd(conn, sent ? NULL : "ingest writer failed to send rows");
+
+  bool ok = true;
+  while ((result = PQgetResult(conn)) != NULL)
+  {
+    if (PQresultStatus(result) != PGRES_COMMAND_OK)
+    {
+      fprintf(stderr, "Writer: COPY failed: %s", PQerrorMessage(conn));
+      ok = false;
+    }
+    PQclear(result);
+  }
+  return ok && sent;
+}
+
+static bool _write(PGconn *conn, ingest_batch_t &b)
+{
+  if (!_exec(conn, "BEGIN"))
+  {
+    return false;
+  }
+
+  bool ok = true;
+  if (!b.registrations.empty())
+  {
+    std::string nodes = "{", names = "{";
+    for (const auto &r : b.registrations)
+    {
+      _array_number(nodes, r.first);
+      _array_text(names, r.second);
+    }
+    nodes += '}';
+    names += '}';
+    const char *params[] = {nodes.c_str(), names.c_str()};
+    ok = _exec(conn, REGISTER_SQL, 2, params);
+  }
+
+  if (ok && b.events > 0)
+  {
+    ok = _copy(conn, b.copy);
+  }
+
+  if (ok && !b.touched.empty())
+  {
+    std::sort(b.touched.begin(), b.touched.end());
+    b.touched.erase(std::unique(b.touched.begin(), b.touched.end()), b.touched.end());
+    std::string nodes = "{";
+    for (uint32_t nodeId : b.touched)
+    {
+      _array_number(nodes, nodeId);
+    }
+    nodes += '}';
+    const char *params[] = {nodes.c_str()};
+    ok = _exec(conn, TOUCH_SQL, 1, params);
+  }
+
+  if (ok && !b.alerts.empty())
+  {
+    std::string devices = "{", labels = "{", messages = "{", levels = "{", counts = "{";
+    for (const auto &a : b.alerts)
+    {
+      _array_number(devices, a.deviceId);
+      _array_text(labels, a.pinLabel);
+      _array_text(messages, a.message);
+      _array_text(levels, a.level);
+      _array_number(counts, a.count);
+    }
+    devices += '}';
+    labels += '}';
+    messages += '}';
+    levels += '}';
+    counts += '}';
+    const char *params[] = {devices.c_str(), labels.c_str(), messages.c_str(), levels.c_str(), counts.c_str()};
+    ok = _exec(conn, ALERTS_SQL, 5, params);
+  }
+
+  return _exec(conn, ok ? "COMMIT" : "ROLLBACK") && ok;
+}
+
+// ── Batches ───────────────────────────────────────────────────────────────────
+
+static bool _empty(const ingest_batch_t &b)
+{
+  return b.events == 0 && b.touched.empty() && b.registrations.empty() && b.alerts.empty();
+}
+
+static void _clear(ingest_batch_t &b)
+{
+  b.copy.clear();  // Keeps its capacity for the next batch
+  b.events = 0;
+  b.touched.clear();
+  b.registrations.clear();
+  b.alerts.clear();
+  b.alertIndex.clear();
+  b.firstMs = 0;
+}
+
+// Caller holds the lock; note the first row so the batch timer starts
+static void _opened(ingest_writer_t *writer)
+{
+  if (_empty(writer->filling))
+  {
+    writer->filling.firstMs = ingest_now_ms();
+    writer->wake.notify_one();
+  }
+}
+
+static bool _due(const ingest_writer_t *writer, uint64_t nowMs)
+{
+  const ingest_batch_t &b = writer->filling;
+  return b.events >= writer->batchEvents || (!_empty(b) && nowMs - b.firstMs >= writer->batchMs);
+}
+
+static bool _connected(PGconn *conn)
+{
+  return conn && PQstatus(conn) == CONNECTION_OK;
+}
+
+static void _run(ingest_writer_t *writer)
+{
+  writer->conn = PQconnectdb(writer->conninfo.c_str());
+  if (!_connected(writer->conn))
+  {
+    fprintf(stderr, "Writer: %s", PQerrorMessage(writer->conn));
+  }
+
+  std::unique_lock<std::mutex> lk(writer->lock);
+  for (;;)
+  {
+    uint64_t now = ingest_now_ms();
+    while (!writer->stopping && !_due(writer, now))
+    {
+      if (_empty(writer->filling))
+      {
+        writer->wake.wait(lk);
+      }
+      else
+      {
+        uint64_t left = writer->batchMs - (now - writer->filling.firstMs);
+        writer->wake.wait_for(lk, std::chrono::milliseconds(left));
+      }
+      now = ingest_now_ms();
+    }
+    if (_empty(writer->filling))
+    {
+      break;  // Stopping with nothing left
+    }
+
+    // The next batch fills while this one is written
+    std::swap(writer->filling, writer->writing);
+    lk.unlock();
+
+    ingest_batch_t &b = writer->writing;
+    uint64_t started = ingest_now_ms();
+    bool ok = false;
+    uint32_t failures = 0;
+    for (;;)
+    {
+      if (!_connected(writer->conn))
+      {
+        PQreset(writer->conn);
+      }
+      if (_connected(writer->conn))
+      {
+        ok = _write(writer->conn, b);
+        if (ok || _connected(writer->conn))
+        {
+          break;  // Written, or refused by the server: retrying will not help
+        }
+      }
+      failures++;
+      bool stopping;
+      {
+        std::lock_guard<std::mutex> guard(writer->lock);
+        stopping = writer->stopping;
+      }
+      if (stopping)
+      {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_RETRY_MS));
+      if (failures == 1)
+      {
+        fprintf(stderr, "Writer: database unreachable, holding %u events\n", b.events);
+      }
+    }
+
+    lk.lock();
+    if (ok)
+    {
+      writer->stats.events += b.events;
+      writer->stats.batches++;
+      writer->stats.writeMs += ingest_now_ms() - started;
+      writer->stats.lastBatchEvents = b.events;
+    }
+    else
+    {
+      writer->stats.failures++;
+      writer->stats.dropped += b.events;
+    }
+    writer->stats.failures += failures;
+    _clear(b);
+  }
+
+  PQfinish(writer->conn);
+  writer->conn = NULL;
+}
+
+// ── API ───────────────────────────────────────────────────────────────────────
+
+void ingest_writer_start(ingest_writer_t *writer, const char *conninfo, uint32_t batchEvents, uint32_t batchMs)
+{
+  writer->conninfo = conninfo ? conninfo : "";
+  writer->batchEvents = std::max<uint32_t>(batchEvents, 1);
+  writer->batchMs = std::max<uint32_t>(batchMs, 1);
+  writer->stopping = false;
+  writer->thread = std::thread(_run, writer);
+}
+
+void ingest_writer_add_event(ingest_writer_t *writer, int32_t deviceId, uint32_t nodeId, const char *messageType,
+                             std::string_view payload)
+{
+  std::lock_guard<std::mutex> guard(writer->lock);
+  ingest_batch_t &b = writer->filling;
+  if (b.events >= (uint64_t)writer->batchEvents * INGEST_MAX_PENDING_BATCHES)
+  {
+    writer->stats.dropped++;
+    return;
+  }
+  _opened(writer);
+
+  b.copy += std::to_string(deviceId);
+  b.copy += '\t';
+  b.copy += std::to_string(nodeId);
+  b.copy += '\t';
+  b.copy += messageType;
+  b.copy += '\t';
+  _copy_text(b.copy, payload);
+  b.copy += '\n';
+  if (++b.events == writer->batchEvents)
+  {
+    writer->wake.notify_one();
+  }
+}
+
+void ingest_writer_touch(ingest_writer_t *writer, uint32_t nodeId)
+{
+  std::lock_guard<std::mutex> guard(writer->lock);
+  _opened(writer);
+  writer->filling.touched.push_back(nodeId);
+}
+
+void ingest_writer_add_alert(ingest_writer_t *writer, int32_t deviceId, const std::string &pinLabel,
+                             const char *message, const std::string &level)
+{
+  std::lock_guard<std::mutex> guard(writer->lock);
+  _opened(writer);
+  ingest_batch_t &b = writer->filling;
+  writer->stats.alerts++;
+
+  // One row per (device, label) per statement; later alerts update it
+  std::string key = std::to_string(deviceId) + '/' + pinLabel;
+  auto it = b.alertIndex.find(key);
+  if (it != b.alertIndex.end())
+  {
+    b.alerts[it->second].message = message;
+    b.alerts[it->second].count++;
+    return;
+  }
+  b.alertIndex.emplace(std::move(key), b.alerts.size());
+  b.alerts.push_back({deviceId, pinLabel, message, level, 1});
+}
+
+void ingest_writer_register(ingest_writer_t *writer, uint32_t nodeId, const std::string &displayName)
+{
+  std::lock_guard<std::mutex> guard(writer->lock);
+  _opened(writer);
+  writer->filling.registrations.emplace_back(nodeId, displayName);
+  writer->stats.registered++;
+}
+
+void ingest_writer_get_stats(ingest_writer_t *writer, ingest_writer_stats_t *stats)
+{
+  std::lock_guard<std::mutex> guard(writer->lock);
+  *stats = writer->stats;
+}
+
+void ingest_writer_stop(ingest_writer_t *writer)
+{
+  {
+    std::lock_guard<std::mutex> guard(writer->lock);
+    writer->stopping = true;
+  }
+  writer->wake.notify_one();
+  if (writer->thread.joinable())
+  {
+    writer->thread.join();
+  }
+}
@@ -0,0 +1,124 @@
+/**
+ * @file ingest_writer.h
+ * @brief Database writer thread: COPY for events, set-based statements for the rest
+ *
+ * The ingest thread adds rows to the filling batch; the writer thread takes
+ * it once INGEST_BATCH_SIZE events are waiting or INGEST_BATCH_MS after the
+ * first one, and writes it in one transaction while the next batch fills:
+ *
+ *   1. unknown devices:  INSERT ... SELECT FROM unnest() ON CONFLICT DO NOTHING
+ *   2. events:           COPY events FROM STDIN (text format)
+ *   3. last_seen:        one UPDATE for every node heard in the batch
+ *   4. alerts:           one upsert, repeats within the batch folded into its count
+ *
+ * While the database is unreachable the batch is held and retried every
+ * second; a batch the server rejects is dropped and counted. The filling
+ * batch is capped at INGEST_MAX_PENDING_BATCHES batches' worth of events so
+ * an outage cannot exhaust memory.
+ */
+
+#ifndef INGEST_WRITER_H
+#define INGEST_WRITER_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <libpq-fe.h>
+
+#ifndef INGEST_MAX_PENDING_BATCHES
+#define INGEST_MAX_PENDING_BATCHES 50
+#endif
+
+typedef struct {
+  uint64_t events;             // Rows copied into events
+  uint64_t batches;            // Committed batches
+  uint64_t alerts;             // Alerts upserted (before folding)
+  uint64_t registered;         // Device registrations sent
+  uint64_t dropped;            // Events lost: cap reached, batch rejected or stopped while down
+  uint64_t failures;           // Failed write attempts
+  uint64_t writeMs;            // Time spent writing committed batches
+  uint32_t lastBatchEvents;
+} ingest_writer_stats_t;
+
+typedef struct {
+  std::string copy;                                     // COPY text rows
+  uint32_t events = 0;
+  std::vector<uint32_t> touched;                        // Node IDs heard
+  std::vector<std::pair<uint32_t, std::string>> registrations;
+  struct Alert {
+    int32_t deviceId;
+    std::string pinLabel;
+    std::string message;
+    std::string level;
+    uint32_t count;
+  };
+  std::vector<Alert> alerts;
+  std::unordered_map<std::string, size_t> alertIndex;   // "deviceId/label" to alerts slot
+  uint64_t firstMs = 0;                                 // When the first row was added
+} ingest_batch_t;
+
+typedef struct {
+  std::string conninfo;
+  PGconn *conn = NULL;
+  uint32_t batchEvents = 1000;
+  uint32_t batchMs = 500;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  std::thread thread;
+  bool stopping = false;
+  ingest_batch_t filling;      // Guarded by lock
+  ingest_batch_t writing;      // Writer thread only
+  ingest_writer_stats_t stats = {};  // Guarded by lock
+} ingest_writer_t;
+
+/**
+ * @brief Start the writer thread
+ * @param conninfo libpq connection string ("" reads the PG* environment)
+ * @param batchEvents Events that trigger a write
+ * @param batchMs Longest an event waits for its batch
+ */
+void ingest_writer_start(ingest_writer_t *writer, const char *conninfo, uint32_t batchEvents, uint32_t batchMs);
+
+/**
+ * @brief Queue one events row
+ * @param deviceId devices.id
+ * @param nodeId Node the reading came from
+ * @param messageType "sensor" or "gnss"
+ * @param payload Reading JSON
+ */
+void ingest_writer_add_event(ingest_writer_t *writer, int32_t deviceId, uint32_t nodeId, const char *messageType,
+                             std::string_view payload);
+
+/**
+ * @brief Queue a last_seen update for a node
+ */
+void ingest_writer_touch(ingest_writer_t *writer, uint32_t nodeId);
+
+/**
+ * @brief Queue an alert upsert
+ */
+void ingest_writer_add_alert(ingest_writer_t *writer, int32_t deviceId, const std::string &pinLabel,
+                             const char *message, const std::string &level);
+
+/**
+ * @brief Queue registration of a device not in the devices table
+ */
+void ingest_writer_register(ingest_writer_t *writer, uint32_t nodeId, const std::string &displayName);
+
+/**
+ * @brief Get a snapshot of the writer counters
+ */
+void ingest_writer_get_stats(ingest_writer_t *writer, ingest_writer_stats_t *stats);
+
+/**
+ * @brief Write what is queued and stop the thread
+ */
+void ingest_writer_stop(ingest_writer_t *writer);
+
+#endif // INGEST_WRITER_H
@@ -0,0 +1,494 @@
+/**
+ * @file loadgen_main.cpp
+ * @brief sensorsentinel_loadgen: offered load vs. what the gateways and the parser report
+ *
+ *   sensorsentinel_loadgen [--nodes N] [--interval-ms MS] [--jitter-pct P] [--gnss-every N]
+ *                          [--duplicate-pct P] [--gateways G] [--seed S] [--rate FPS]
+ *                          [--sweep START,FACTOR,STEPS] [--step-secs S] [--settle-secs S]
+ *                          [--topic T] [--track-out]
+ *   sensorsentinel_loadgen --observe
+ *
+ * Runs the firmware's virtual node generator (SensorSentinel_loadgen_helper.h)
+ * on the host and publishes each frame as an uplink record on --topic
+ * (default lora/in/v1), once per fake gateway (--gateways, default 1), the
+ * way G gateways in range of every node would. This loads the broker and
+ * the parser (Node-RED or sensorsentinel_ingest) without a radio.
+ *
+ * --sweep offers START frames/s, then START*FACTOR, ... for STEPS steps of
+ * --step-secs (default 60) each, with --settle-secs (default 15) of quiet
+ * after each step; --rate runs one step at a fixed rate; with neither the
+ * profile's --interval-ms sets the rate. Duplicates and gateway copies
+ * come on top of the offered rate.
+ *
+ * Throughout, lora/stats/+ is read for the *_total counters the gateways
+ * export (SensorSentinel_receiver_fwd_mqtt.cpp formatCounters()). The
+ * counters a gateway reported last before a step are subtracted from those
+ * it reported last after the settle pause, so set --settle-secs to at least
+ * the gateways' MQTT_STATS_INTERVAL_SECS. With --track-out the lora/out/+
+ * JSON of the generator's nodes is counted as well.
+ *
+ * --observe sends nothing and follows a loadgen firmware board instead
+ * ([env:loadgen]): its step markers on loadgen/step/+ delimit the steps,
+ * and the gateway counters are paired with them the same way, which is how
+ * the LoRa capacity of a gateway is measured.
+ *
+ * MQTT_HOST, MQTT_PORT, MQTT_USER and MQTT_PASSWORD select the broker. One
+ * JSON object per step goes to stdout:
+ *
+ *   {"benchmark":"loadgen","step":0,"offeredFps":0.5,...,"sent":30,"dropped":0,"duplicates":0,
+ *    "gateways":{"<client ID>":{"sensorsentinel_rx_valid_total":30,...}}}
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_set>
+
+#include "ingest_mqtt.h"
+#include "SensorSentinel_loadgen_helper.h"
+
+#define LOADGEN_DEFAULT_TOPIC   "lora/in/v1"
+#define LOADGEN_STATS_TOPIC     "lora/stats/+"
+#define LOADGEN_STEP_TOPIC      "loadgen/step/+"
+#define LOADGEN_OUT_TOPIC       "lora/out/+"
+#define LOADGEN_CLIENT_ID       "sensorsentinel-loadgen"
+#define LOADGEN_GATEWAY_ID      0x4C47F000u  // Fake gateway g is this + g
+#define MQTT_KEEPALIVE_SECS     30
+
+typedef struct {
+  SensorSentinel_loadgen_profile_t profile;
+  uint32_t gateways;
+  double rate;                 // 0 = from the profile's interval
+  double sweepStart;
+  double sweepFactor;
+  uint32_t sweepSteps;
+  uint32_t stepSecs;
+  uint32_t settleSecs;
+  const char *topic;
+  bool trackOut;
+  bool observe;
+} loadgen_config_t;
+
+// Last *_total values each gateway reported, by client ID
+typedef std::map<std::string, std::map<std::string, double>> loadgen_counters_t;
+
+typedef struct {
+  const loadgen_config_t *config;
+  loadgen_counters_t counters;
+  // --track-out: (nodeId, counter) pairs seen on lora/out this step
+  std::unordered_set<uint64_t> seen;
+  uint64_t outDuplicates = 0;
+  // --observe: markers from the firmware
+  std::string lastEnd;         // "end" marker of the step being settled
+  std::string pendingPhase;    // Marker received but not yet handled
+  std::string pendingJson;
+} loadgen_t;
+
+// Gateway counters that mean a frame was lost on the way in
+static const char *const _dropCounters[] = {
+    "sensorsentinel_ring_overflows_total",
+    "sensorsentinel_ring_missed_total",
+    "sensorsentinel_rx_read_errors_total",
+    "sensorsentinel_spool_dropped_total",
+};
+static const char *const _duplicateCounters[] = {
+    "sensorsentinel_dedup_hits_total",
+};
+
+// ── Messages ──────────────────────────────────────────────────────────────────
+
+static double _json_number(std::string_view json, const char *key, double fallback)
+{
+  std::string needle = std::string("\"") + key + "\":";
+  size_t at = json.find(needle);
+  if (at == std::string_view::npos)
+  {
+    return fallback;
+  }
+  return strtod(std::string(json.substr(at + needle.size(), 24)).c_str(), NULL);
+}
+
+static std::string _json_text(std::string_view json, const char *key)
+{
+  std::string needle = std::string("\"") + key + "\":\"";
+  size_t at = json.find(needle);
+  if (at == std::string_view::npos)
+  {
+    return "";
+  }
+  size_t start = at + needle.size(), end = json.find('"', start);
+  return std::string(json.substr(start, end == std::string_view::npos ? 0 : end - start));
+}
+
+// Prometheus text: keep the unlabelled *_total samples
+static void _parse_stats(std::map<std::string, double> &out, std::string_view text)
+{
+  while (!text.empty())
+  {
+    size_t eol = text.find('\n');
+    std::string_view line = text.substr(0, eol);
+    text = eol == std::string_view::npos ? std::string_view() : text.substr(eol + 1);
+    size_t space = line.find(' ');
+    if (line.empty() || line[0] == '#' || space == std::string_view::npos)
+    {
+      continue;
+    }
+    std::string_view name = line.substr(0, space);
+    if (name.size() > 6 && name.substr(name.size() - 6) == "_total")
+    {
+      out[std::string(name)] = strtod(std::string(line.substr(space + 1)).c_str(), NULL);
+    }
+  }
+}
+
+static void _on_message(void *ctx, std::string_view topic, const uint8_t *payload, size_t length)
+{
+  loadgen_t *lg = (loadgen_t *)ctx;
+  std::string_view text((const char *)payload, length);
+  if (topic.substr(0, 11) == "lora/stats/")
+  {
+    _parse_stats(lg->counters[std::string(topic.substr(11))], text);
+  }
+  else if (topic.substr(0, 13) == "loadgen/step/")
+  {
+    lg->pendingPhase = _json_text(text, "phase");
+    lg->pendingJson.assign(text);
+  }
+  else if (lg->config->trackOut && topic.substr(0, 9) == "lora/out/")
+  {
+    double nodeId = _json_number(text, "nodeId", -1), counter = _json_number(text, "counter", -1);
+    uint32_t base = lg->config->profile.baseNodeId;
+    if (nodeId >= base && nodeId < (double)base + lg->config->profile.nodes && counter >= 0)
+    {
+      if (!lg->seen.insert(((uint64_t)nodeId << 32) | (uint32_t)counter).second)
+      {
+        lg->outDuplicates++;
+      }
+    }
+  }
+}
+
+// ── Report ────────────────────────────────────────────────────────────────────
+
+static double _sum(const std::map<std::string, double> &delta, const char *const *names, size_t count)
+{
+  double total = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    auto it = delta.find(names[i]);
+    total += it == delta.end() ? 0 : it->second;
+  }
+  return total;
+}
+
+/**
+ * "dropped", "duplicates" and "gateways" members: counter deltas since before
+ */
+static std::string _gateway_report(const loadgen_counters_t &before, const loadgen_counters_t &after)
+{
+  double dropped = 0, duplicates = 0;
+  std::string gateways;
+  for (const auto &gw : after)
+  {
+    auto prior = before.find(gw.first);
+    std::map<std::string, double> delta;
+    for (const auto &c : gw.second)
+    {
+      double start = 0;
+      if (prior != before.end())
+      {
+        auto it = prior->second.find(c.first);
+        start = it == prior->second.end() ? 0 : it->second;
+      }
+      // A counter that went down means a reboot: count from zero
+      delta[c.first] = c.second >= start ? c.second - start : c.second;
+    }
+    dropped += _sum(delta, _dropCounters, sizeof(_dropCounters) / sizeof(_dropCounters[0]));
+    duplicates += _sum(delta, _duplicateCounters, sizeof(_duplicateCounters) / sizeof(_duplicateCounters[0]));
+
+    gateways += gateways.empty() ? "\"" : ",\"";
+    gateways += gw.first + "\":{";
+    bool first = true;
+    for (const auto &d : delta)
+    {
+      char value[32];
+      snprintf(value, sizeof(value), "%.0f", d.second);
+      gateways += (first ? "\"" : ",\"") + d.first + "\":" + value;
+      first = false;
+    }
+    gateways += "}";
+  }
+  char head[96];
+  snprintf(head, sizeof(head), "\"dropped\":%.0f,\"duplicates\":%.0f,", dropped, duplicates);
+  return head + ("\"gateways\":{" + gateways + "}");
+}
+
+// ── Run ───────────────────────────────────────────────────────────────────────
+
+static bool _service(ingest_mqtt_t *mqtt, loadgen_t *lg, int timeoutMs)
+{
+  struct pollfd pfd = {ingest_mqtt_fd(mqtt), POLLIN, 0};
+  if (poll(&pfd, 1, timeoutMs) > 0 && !ingest_mqtt_read(mqtt, _on_message, lg))
+  {
+    return false;
+  }
+  return ingest_mqtt_service(mqtt, ingest_now_ms());
+}
+
+static uint64_t _epoch_ms()
+{
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * One step: offer rate frames/s for stepSecs, settle, print the result
+ */
+static bool _run_step(ingest_mqtt_t *mqtt, loadgen_t *lg, uint32_t step, double rate)
+{
+  const loadgen_config_t *c = lg->config;
+  uint32_t intervalMs = SensorSentinel_loadgen_set_rate((float)rate, (uint32_t)ingest_now_ms());
+  SensorSentinel_loadgen_reset_stats();
+  lg->seen.clear();
+  lg->outDuplicates = 0;
+  loadgen_counters_t before = lg->counters;
+
+  uint64_t startMs = ingest_now_ms(), endMs = startMs + (uint64_t)c->stepSecs * 1000;
+  uint64_t published = 0, failed = 0;
+  SensorSentinel_rx_slot_t slot;
+  bool connected = true;
+  for (uint64_t now = startMs; connected && now < endMs; now = ingest_now_ms())
+  {
+    while ((slot.length = SensorSentinel_loadgen_next((uint32_t)now, slot.data, sizeof(slot.data))) > 0)
+    {
+      // One record per gateway in range, each with its own link values
+      for (uint32_t g = 0; g < c->gateways; g++)
+      {
+        slot.rssi = -70.0f - 8.0f * g;
+        slot.snr = 9.0f - 2.0f * g;
+        slot.freqError = 0;
+        slot.rxMillis = (uint32_t)now;
+        uint8_t *record = SensorSentinel_build_uplink_record(&slot, LOADGEN_GATEWAY_ID + g, _epoch_ms());
+        if (ingest_mqtt_publish(mqtt, c->topic, record, SensorSentinel_UPLINK_HEADROOM + slot.length))
+        {
+          published++;
+        }
+        else
+        {
+          failed++;
+        }
+      }
+    }
+    // Read lora/stats while waiting for the next due frame
+    uint32_t waitMs = SensorSentinel_loadgen_ms_until_due((uint32_t)ingest_now_ms());
+    connected = _service(mqtt, lg, (int)std::min<uint32_t>(waitMs, 50));
+  }
+  double seconds = (ingest_now_ms() - startMs) / 1000.0;
+  SensorSentinel_loadgen_stats_t stats;
+  SensorSentinel_loadgen_get_stats(&stats);
+
+  // Quiet while the queues drain and the gateways report once more
+  for (uint64_t settleEnd = ingest_now_ms() + (uint64_t)c->settleSecs * 1000;
+       connected && ingest_now_ms() < settleEnd;)
+  {
+    connected = _service(mqtt, lg, 50);
+  }
+
+  std::string out;
+  if (c->trackOut)
+  {
+    char line[128];
+    uint32_t unique = stats.frames - stats.duplicates;
+    snprintf(line, sizeof(line), "\"out\":{\"received\":%zu,\"duplicates\":%llu,\"lost\":%lld},", lg->seen.size(),
+             (unsigned long long)lg->outDuplicates, (long long)unique - (long long)lg->seen.size());
+    out = line;
+  }
+  printf("{\"benchmark\":\"loadgen\",\"step\":%u,\"offeredFps\":%.3f,\"nodes\":%u,\"intervalMs\":%u,"
+         "\"gatewayCopies\":%u,\"seconds\":%.1f,\"sent\":%u,\"sensor\":%u,\"gnss\":%u,\"sentDuplicates\":%u,"
+         "\"published\":%llu,\"failed\":%llu,\"achievedFps\":%.3f,\"maxLateMs\":%u,%s%s}\n",
+         step, rate, c->profile.nodes > LOADGEN_MAX_NODES ? LOADGEN_MAX_NODES : c->profile.nodes, intervalMs,
+         c->gateways, seconds, stats.frames, stats.sensor, stats.gnss, stats.duplicates,
+         (unsigned long long)published, (unsigned long long)failed, seconds > 0 ? stats.frames / seconds : 0.0,
+         stats.maxLateMs, out.c_str(), _gateway_report(before, lg->counters).c_str());
+  fflush(stdout);
+  return connected;
+}
+
+/**
+ * --observe: pair a firmware board's step markers with the gateway counters
+ */
+static int _observe(ingest_mqtt_t *mqtt, loadgen_t *lg)
+{
+  loadgen_counters_t before = lg->counters;
+  bool started = false;
+  while (_service(mqtt, lg, 200))
+  {
+    if (lg->pendingPhase.empty())
+    {
+      continue;
+    }
+    std::string phase, json;
+    phase.swap(lg->pendingPhase);
+    json.swap(lg->pendingJson);
+    if (phase == "end")
+    {
+      lg->lastEnd = json;  // Reported once the settle pause is over
+      continue;
+    }
+    // "start" and "done" close the step settled last; "progress" (no sweep)
+    // closes one period and opens the next
+    std::string step = phase == "progress" ? json : lg->lastEnd;
+    if (started && !step.empty() && step.back() == '}')
+    {
+      step.pop_back();
+      printf("{\"benchmark\":\"loadgen\",\"observed\":true,%s,%s}\n", step.c_str() + 1,
+             _gateway_report(before, lg->counters).c_str());
+      fflush(stdout);
+    }
+    lg->lastEnd.clear();
+    if (phase == "done")
+    {
+      return 0;
+    }
+    before = lg->counters;
+    started = true;
+  }
+  fprintf(stderr, "MQTT connection lost\n");
+  return 1;
+}
+
+static bool _parse_args(int argc, char **argv, loadgen_config_t *c)
+{
+  *c = {};
+  c->profile.nodes = 32;
+  c->profile.baseNodeId = LOADGEN_BASE_NODE_ID;
+  c->profile.intervalMs = 10000;
+  c->profile.jitterPct = 20;
+  c->profile.seed = (uint32_t)time(NULL);
+  c->gateways = 1;
+  c->stepSecs = 60;
+  c->settleSecs = 15;
+  c->topic = LOADGEN_DEFAULT_TOPIC;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (!strcmp(arg, "--observe"))
+    {
+      c->observe = true;
+      continue;
+    }
+    if (!strcmp(arg, "--track-out"))
+    {
+      c->trackOut = true;
+      continue;
+    }
+    const char *value = i + 1 < argc ? argv[++i] : NULL;
+    if (!value)
+      return false;
+    if (!strcmp(arg, "--nodes"))
+      c->profile.nodes = (uint32_t)strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--interval-ms"))
+      c->profile.intervalMs = (uint32_t)strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--jitter-pct"))
+      c->profile.jitterPct = (uint8_t)std::min(100ul, strtoul(value, NULL, 10));
+    else if (!strcmp(arg, "--gnss-every"))
+      c->profile.gnssEvery = (uint8_t)std::min(255ul, strtoul(value, NULL, 10));
+    else if (!strcmp(arg, "--duplicate-pct"))
+      c->profile.duplicatePct = (uint8_t)std::min(100ul, strtoul(value, NULL, 10));
+    else if (!strcmp(arg, "--gateways"))
+      c->gateways = std::max(1ul, strtoul(value, NULL, 10));
+    else if (!strcmp(arg, "--seed"))
+      c->profile.seed = (uint32_t)strtoul(value, NULL, 0);
+    else if (!strcmp(arg, "--rate"))
+      c->rate = strtod(value, NULL);
+    else if (!strcmp(arg, "--sweep"))
+    {
+      if (sscanf(value, "%lf,%lf,%u", &c->sweepStart, &c->sweepFactor, &c->sweepSteps) != 3 ||
+          c->sweepStart <= 0 || c->sweepFactor <= 0 || c->sweepSteps == 0)
+        return false;
+    }
+    else if (!strcmp(arg, "--step-secs"))
+      c->stepSecs = (uint32_t)strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--settle-secs"))
+      c->settleSecs = (uint32_t)strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--topic"))
+      c->topic = value;
+    else
+      return false;
+  }
+  return c->profile.nodes > 0 && c->profile.intervalMs > 0 && c->stepSecs > 0;
+}
+
+int main(int argc, char **argv)
+{
+  loadgen_config_t config;
+  if (!_parse_args(argc, argv, &config))
+  {
+    fprintf(stderr,
+            "usage: %s [--nodes N] [--interval-ms MS] [--jitter-pct P] [--gnss-every N] [--duplicate-pct P]\n"
+            "       [--gateways G] [--seed S] [--rate FPS] [--sweep START,FACTOR,STEPS] [--step-secs S]\n"
+            "       [--settle-secs S] [--topic T] [--track-out]\n"
+            "   or: %s --observe\n",
+            argv[0], argv[0]);
+    return 2;
+  }
+  if (config.profile.nodes > LOADGEN_MAX_NODES)
+  {
+    fprintf(stderr, "--nodes capped at %u\n", (unsigned)LOADGEN_MAX_NODES);
+  }
+
+  const char *host = getenv("MQTT_HOST") ? getenv("MQTT_HOST") : "localhost";
+  uint16_t port = (uint16_t)(getenv("MQTT_PORT") ? atoi(getenv("MQTT_PORT")) : 1883);
+  ingest_mqtt_t mqtt;
+  if (!ingest_mqtt_connect(&mqtt, host, port, LOADGEN_CLIENT_ID, getenv("MQTT_USER"), getenv("MQTT_PASSWORD"),
+                           MQTT_KEEPALIVE_SECS))
+  {
+    fprintf(stderr, "cannot connect to MQTT broker %s:%u\n", host, port);
+    return 1;
+  }
+  loadgen_t lg;
+  lg.config = &config;
+  if (!ingest_mqtt_subscribe(&mqtt, LOADGEN_STATS_TOPIC) ||
+      (config.observe && !ingest_mqtt_subscribe(&mqtt, LOADGEN_STEP_TOPIC)) ||
+      (config.trackOut && !ingest_mqtt_subscribe(&mqtt, LOADGEN_OUT_TOPIC)))
+  {
+    fprintf(stderr, "subscribe failed\n");
+    return 1;
+  }
+  if (config.observe)
+  {
+    int rc = _observe(&mqtt, &lg);
+    ingest_mqtt_close(&mqtt);
+    return rc;
+  }
+
+  // Retained or recent lora/stats give the first step its baseline
+  for (uint64_t until = ingest_now_ms() + 500; ingest_now_ms() < until;)
+  {
+    _service(&mqtt, &lg, 50);
+  }
+
+  SensorSentinel_loadgen_begin(&config.profile, (uint32_t)ingest_now_ms());
+  uint32_t steps = config.sweepSteps ? config.sweepSteps : 1;
+  double rate = config.sweepSteps ? config.sweepStart
+              : config.rate > 0   ? config.rate
+                                  : SensorSentinel_loadgen_profile()->nodes * 1000.0 / config.profile.intervalMs;
+  int rc = 0;
+  for (uint32_t step = 0; step < steps; step++, rate *= config.sweepFactor)
+  {
+    if (!_run_step(&mqtt, &lg, step, rate))
+    {
+      fprintf(stderr, "MQTT connection lost\n");
+      rc = 1;
+      break;
+    }
+  }
+  ingest_mqtt_close(&mqtt);
+  return rc;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the Arduino core
+ *
+ * Just enough of the core for the board-independent firmware sources
+ * (SensorSentinel_packet_helper.cpp with SensorSentinel_HOST,
+ * SensorSentinel_codec_v2.h) to build on Linux: fixed-width types, min/max,
+ * constrain, millis() and a Serial that writes to stdout. Anything that
+ * needs the chip, the radio or the pins stays out of host builds.
+ */
+
+#ifndef SensorSentinel_HOST_ARDUINO_H
+#define SensorSentinel_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
+
+#define DEC 10
+#define HEX 16
+
+using std::max;
+using std::min;
+
+class String;  // Named in firmware prototypes that host builds never call
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+/**
+ * @brief Milliseconds on a monotonic clock (wraps like the board's)
+ */
+static inline uint32_t millis()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/**
+ * @brief Serial console on stdout
+ */
+class HostSerial
+{
+public:
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n > 0 ? (size_t)n : 0;
+  }
+
+  size_t print(const char *s) { return fputs(s, stdout) >= 0 ? strlen(s) : 0; }
+  size_t print(char c) { return putchar(c) == EOF ? 0 : 1; }
+  size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(int v, int base = DEC) { return base == DEC ? printf("%d", v) : print((unsigned long)(unsigned)v, base); }
+  size_t print(unsigned v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC) { return base == DEC ? printf("%ld", v) : print((unsigned long)v, base); }
+  size_t print(unsigned long v, int base = DEC) { return printf(base == HEX ? "%lX" : "%lu", v); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+  size_t println() { return print('\n'); }
+  template <typename T>
+  size_t println(T v) { return print(v) + println(); }
+};
+
+inline HostSerial Serial;
+
+#endif // SensorSentinel_HOST_ARDUINO_H
@@ -0,0 +1,344 @@
+/**
+ * @file codec_v2_test.cpp
+ * @brief Unit tests for the v2 frame codec (SensorSentinel_codec_v2.h)
+ *
+ * Round trips of key and delta frames with edges and reports, every
+ * truncation of an encoded frame, malformed varints and headers, and the
+ * firmware encoder's key frame fallback.
+ */
+
+#include <string.h>
+
+#include "SensorSentinel_codec_v2.h"
+#include "SensorSentinel_packet_helper.h"
+#include "test_common.h"
+
+#define NODE 0x0A0B0C0D
+
+static SensorSentinel_v2_sensor_t _sensor(uint32_t counter)
+{
+  SensorSentinel_v2_sensor_t f;
+  memset(&f, 0, sizeof(f));
+  f.nodeId = NODE;
+  f.messageCounter = counter;
+  f.uptime = 3600 + counter * 60;
+  f.batteryLevel = 87;
+  f.batteryVoltage = 3987;
+  f.analog[0] = 0;
+  f.analog[1] = 1234;
+  f.analog[2] = 2048 + counter;
+  f.analog[3] = 4095;
+  f.boolean = 0xA5;
+  return f;
+}
+
+static SensorSentinel_v2_gnss_t _gnss(uint32_t counter)
+{
+  SensorSentinel_v2_gnss_t f;
+  memset(&f, 0, sizeof(f));
+  f.nodeId = NODE;
+  f.messageCounter = counter;
+  f.uptime = 600 + counter;
+  f.batteryLevel = 55;
+  f.batteryVoltage = 3700;
+  f.latitudeE7 = -337000000 + (int32_t)counter * 15;
+  f.longitudeE7 = 1511000000 - (int32_t)counter * 9;
+  f.speedX10 = 123;
+  f.hdop = 9;
+  f.courseX100 = 35999;
+  return f;
+}
+
+static bool _same_sensor(const SensorSentinel_v2_sensor_t &a, const SensorSentinel_v2_sensor_t &b)
+{
+  return a.nodeId == b.nodeId && a.messageCounter == b.messageCounter && a.uptime == b.uptime &&
+         a.batteryLevel == b.batteryLevel && a.batteryVoltage == b.batteryVoltage &&
+         memcmp(a.analog, b.analog, sizeof(a.analog)) == 0 && a.boolean == b.boolean &&
+         a.edgesChanged == b.edgesChanged && memcmp(a.pulses, b.pulses, sizeof(a.pulses)) == 0;
+}
+
+static bool _same_gnss(const SensorSentinel_v2_gnss_t &a, const SensorSentinel_v2_gnss_t &b)
+{
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static void test_varint_zigzag()
+{
+  const uint32_t values[] = {0, 1, 127, 128, 16383, 16384, 0x0FFFFFFF, 0xFFFFFFFF};
+  for (uint32_t v : values)
+  {
+    uint8_t buf[5];
+    size_t n = SensorSentinel_v2_put_varint(buf, v);
+    _v2_reader_t r = {buf, buf + n, true};
+    CHECK_EQ(_v2_varint(&r), v);
+    CHECK(r.ok && r.p == r.end);
+  }
+  const int32_t signedValues[] = {0, -1, 1, -64, 63, INT32_MIN, INT32_MAX};
+  for (int32_t v : signedValues)
+  {
+    CHECK_EQ(SensorSentinel_v2_unzigzag(SensorSentinel_v2_zigzag(v)), v);
+  }
+  CHECK_EQ(SensorSentinel_v2_zigzag(-1), 1);
+  CHECK_EQ(SensorSentinel_v2_zigzag(1), 2);
+}
+
+static void test_sensor_key_round_trip()
+{
+  SensorSentinel_v2_sensor_t in = _sensor(1);
+  uint8_t frame[SensorSentinel_V2_MAX_FRAME];
+  bool isKey = false;
+  size_t n = SensorSentinel_v2_encode_sensor(&in, NULL, frame, &isKey);
+  CHECK(isKey);
+  CHECK(n > 0 && n <= SensorSentinel_V2_MAX_FRAME);
+
+  SensorSentinel_v2_sensor_t out;
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(frame, n, NULL, &out), V2_OK);
+  CHECK(_same_sensor(in, out));
+  CHECK(SensorSentinel_v2_is_valid(frame, n));
+
+  // ADC values above 12 bits are clamped, not wrapped
+  in.analog[0] = 5000;
+  n = SensorSentinel_v2_encode_sensor(&in, NULL, frame, NULL);
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(frame, n, NULL, &out), V2_OK);
+  CHECK_EQ(out.analog[0], SensorSentinel_V2_ADC_MAX);
+}
+
+static void test_sensor_delta_round_trip()
+{
+  SensorSentinel_v2_sensor_t key = _sensor(10);
+  SensorSentinel_v2_sensor_t in = _sensor(11);
+  uint8_t keyFrame[SensorSentinel_V2_MAX_FRAME];
+  uint8_t frame[SensorSentinel_V2_MAX_FRAME];
+  size_t keyLength = SensorSentinel_v2_encode_sensor(&key, NULL, keyFrame, NULL);
+  bool isKey = true;
+  size_t n = SensorSentinel_v2_encode_sensor(&in, &key, frame, &isKey);
+  CHECK(!isKey);
+  CHECK(n < keyLength);
+
+  SensorSentinel_v2_header_t h;
+  CHECK(SensorSentinel_v2_parse_header(frame, n, &h));
+  CHECK(h.delta);
+  CHECK_EQ(h.keyCounter, 10);
+
+  SensorSentinel_v2_sensor_t out;
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(frame, n, &key, &out), V2_OK);
+  CHECK(_same_sensor(in, out));
+
+  // Without its key (or with another one) the delta is well-formed but undecodable
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(frame, n, NULL, &out), V2_NEED_KEY);
+  SensorSentinel_v2_sensor_t stale = _sensor(9);
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(frame, n, &stale, &out), V2_NEED_KEY);
+  CHECK(SensorSentinel_v2_is_valid(frame, n));
+}
+
+static void test_key_interval_and_other_node()
+{
+  SensorSentinel_v2_sensor_t key = _sensor(100);
+  uint8_t frame[SensorSentinel_V2_MAX_FRAME];
+  bool isKey = false;
+
+  SensorSentinel_v2_sensor_t in = _sensor(100 + SensorSentinel_V2_KEY_INTERVAL - 1);
+  SensorSentinel_v2_encode_sensor(&in, &key, frame, &isKey);
+  CHECK(!isKey);
+
+  in = _sensor(100 + SensorSentinel_V2_KEY_INTERVAL);
+  SensorSentinel_v2_encode_sensor(&in, &key, frame, &isKey);
+  CHECK(isKey);
+
+  // Same counter as the key (a reboot) and another node's key both force a key frame
+  in = _sensor(100);
+  SensorSentinel_v2_encode_sensor(&in, &key, frame, &isKey);
+  CHECK(isKey);
+  in = _sensor(101);
+  key.nodeId = NODE + 1;
+  SensorSentinel_v2_encode_sensor(&in, &key, frame, &isKey);
+  CHECK(isKey);
+}
+
+static void test_edges_and_report()
+{
+  SensorSentinel_v2_sensor_t key = _sensor(20);
+  SensorSentinel_v2_sensor_t in = _sensor(21);
+  in.edgesChanged = 0x81;
+  in.pulses[0] = 3;
+  in.pulses[7] = 300;
+
+  uint8_t frame[SensorSentinel_V2_MAX_FRAME];
+  size_t n = SensorSentinel_v2_encode_sensor(&in, &key, frame, NULL);
+  n = SensorSentinel_v2_add_edges(frame, n, in.edgesChanged, in.pulses);
+  CHECK(n > 0);
+  const uint8_t report[SensorSentinel_V2_REPORT_SIZE] = {1, 2, 3, 4};
+  n = SensorSentinel_v2_add_report(frame, n, report);
+  CHECK(n > 0 && n <= SensorSentinel_V2_MAX_FRAME);
+  CHECK_EQ(memcmp(frame + n - SensorSentinel_V2_REPORT_SIZE, report, sizeof(report)), 0);
+
+  SensorSentinel_v2_header_t h;
+  CHECK(SensorSentinel_v2_parse_header(frame, n, &h));
+  CHECK(h.edges && h.report && h.delta);
+
+  SensorSentinel_v2_sensor_t out;
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(frame, n, &key, &out), V2_OK);
+  CHECK(_same_sensor(in, out));
+
+  // Edges go before the report, and only once
+  CHECK_EQ(SensorSentinel_v2_add_edges(frame, n, 1, in.pulses), 0);
+  CHECK_EQ(SensorSentinel_v2_add_report(frame, n, report), 0);
+}
+
+static void test_gnss_round_trip()
+{
+  SensorSentinel_v2_gnss_t key = _gnss(7);
+  SensorSentinel_v2_gnss_t in = _gnss(8);
+  uint8_t keyFrame[SensorSentinel_V2_MAX_FRAME];
+  uint8_t frame[SensorSentinel_V2_MAX_FRAME];
+  bool isKey = false;
+
+  size_t keyLength = SensorSentinel_v2_encode_gnss(&key, NULL, keyFrame, &isKey);
+  CHECK(isKey);
+  SensorSentinel_v2_gnss_t out;
+  CHECK_EQ(SensorSentinel_v2_decode_gnss(keyFrame, keyLength, NULL, &out), V2_OK);
+  CHECK(_same_gnss(key, out));
+
+  size_t n = SensorSentinel_v2_encode_gnss(&in, &key, frame, &isKey);
+  CHECK(!isKey);
+  CHECK_EQ(SensorSentinel_v2_decode_gnss(frame, n, &key, &out), V2_OK);
+  CHECK(_same_gnss(in, out));
+  CHECK_EQ(SensorSentinel_v2_decode_gnss(frame, n, NULL, &out), V2_NEED_KEY);
+
+  // GNSS frames carry no edges
+  const uint16_t pulses[8] = {1};
+  CHECK_EQ(SensorSentinel_v2_add_edges(frame, n, 1, pulses), 0);
+}
+
+static void test_truncation()
+{
+  SensorSentinel_v2_sensor_t key = _sensor(30);
+  SensorSentinel_v2_sensor_t in = _sensor(31);
+  in.edgesChanged = 0x02;
+  in.pulses[1] = 200;
+  const uint8_t report[SensorSentinel_V2_REPORT_SIZE] = {9, 8, 7, 6};
+
+  uint8_t frames[3][SensorSentinel_V2_MAX_FRAME + 1];
+  size_t lengths[3];
+  lengths[0] = SensorSentinel_v2_encode_sensor(&key, NULL, frames[0], NULL);
+  lengths[1] = SensorSentinel_v2_encode_sensor(&in, &key, frames[1], NULL);
+  lengths[1] = SensorSentinel_v2_add_edges(frames[1], lengths[1], in.edgesChanged, in.pulses);
+  lengths[1] = SensorSentinel_v2_add_report(frames[1], lengths[1], report);
+  SensorSentinel_v2_gnss_t gnss = _gnss(1);
+  lengths[2] = SensorSentinel_v2_encode_gnss(&gnss, NULL, frames[2], NULL);
+
+  for (int f = 0; f < 3; f++)
+  {
+    CHECK(SensorSentinel_v2_is_valid(frames[f], lengths[f]));
+    for (size_t n = 0; n < lengths[f]; n++)
+    {
+      SensorSentinel_v2_sensor_t sensor;
+      SensorSentinel_v2_gnss_t g;
+      CHECK(!SensorSentinel_v2_is_valid(frames[f], n));
+      if (frames[f][0] == SensorSentinel_MSG_SENSOR_V2)
+      {
+        CHECK_EQ(SensorSentinel_v2_decode_sensor(frames[f], n, &key, &sensor), V2_MALFORMED);
+      }
+      else
+      {
+        CHECK_EQ(SensorSentinel_v2_decode_gnss(frames[f], n, NULL, &g), V2_MALFORMED);
+      }
+    }
+
+    // A trailing byte is as bad as a missing one
+    frames[f][lengths[f]] = 0;
+    CHECK(!SensorSentinel_v2_is_valid(frames[f], lengths[f] + 1));
+  }
+}
+
+static void test_malformed_header()
+{
+  SensorSentinel_v2_sensor_t in = _sensor(5);
+  uint8_t frame[SensorSentinel_V2_MAX_FRAME + 8];
+  size_t n = SensorSentinel_v2_encode_sensor(&in, NULL, frame, NULL);
+  SensorSentinel_v2_sensor_t out;
+
+  // Counter varint running past 5 bytes
+  uint8_t overlong[32];
+  memcpy(overlong, frame, 5);
+  memset(overlong + 5, 0xFF, 5);
+  overlong[10] = 0x01;
+  memcpy(overlong + 11, frame + 6, n - 6);
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(overlong, n + 5, NULL, &out), V2_MALFORMED);
+  CHECK(!SensorSentinel_v2_is_valid(overlong, n + 5));
+
+  // Key distance of 0 and unknown flag bits
+  size_t flags = _v2_flags_offset(frame);
+  uint8_t zeroDistance[SensorSentinel_V2_MAX_FRAME + 1];
+  memcpy(zeroDistance, frame, flags + 1);
+  zeroDistance[flags] = SensorSentinel_V2_FLAG_DELTA;
+  zeroDistance[flags + 1] = 0;
+  memcpy(zeroDistance + flags + 2, frame + flags + 1, n - flags - 1);
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(zeroDistance, n + 1, NULL, &out), V2_MALFORMED);
+
+  uint8_t saved = frame[flags];
+  frame[flags] = 0x80;
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(frame, n, NULL, &out), V2_MALFORMED);
+  frame[flags] = saved;
+
+  // Edges flag with an empty mask, wrong type, zero node ID
+  frame[flags] = SensorSentinel_V2_FLAG_EDGES;
+  frame[n] = 0;
+  CHECK_EQ(SensorSentinel_v2_decode_sensor(frame, n + 1, NULL, &out), V2_MALFORMED);
+  frame[flags] = saved;
+  SensorSentinel_v2_gnss_t gnss;
+  CHECK_EQ(SensorSentinel_v2_decode_gnss(frame, n, NULL, &gnss), V2_MALFORMED);
+  memset(frame + 1, 0, 4);
+  CHECK(!SensorSentinel_v2_is_valid(frame, n));
+  CHECK(!SensorSentinel_v2_is_valid(NULL, n));
+}
+
+static void test_firmware_force_key()
+{
+  SensorSentinel_packet_t packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.sensor.messageType = SensorSentinel_MSG_SENSOR;
+  packet.sensor.nodeId = NODE;
+  packet.sensor.batteryLevel = 90;
+  packet.sensor.batteryVoltage = 4000;
+
+  uint8_t frame[SensorSentinel_V2_MAX_FRAME];
+  SensorSentinel_v2_header_t h;
+  for (uint32_t counter = 1; counter <= 3; counter++)
+  {
+    packet.sensor.messageCounter = counter;
+    packet.sensor.uptime = counter * 60;
+    size_t n = SensorSentinel_encode_packet_v2(&packet, frame, sizeof(frame));
+    CHECK(SensorSentinel_v2_parse_header(frame, n, &h));
+    CHECK_EQ(h.delta, counter > 1);
+  }
+
+  SensorSentinel_force_key_frame_v2();
+  packet.sensor.messageCounter = 4;
+  size_t n = SensorSentinel_encode_packet_v2(&packet, frame, sizeof(frame));
+  CHECK(SensorSentinel_v2_parse_header(frame, n, &h));
+  CHECK(!h.delta);
+
+  // The gateway side decodes the stream with its key cache
+  SensorSentinel_packet_t out;
+  CHECK(SensorSentinel_decode_packet(frame, n, &out));
+  CHECK_EQ(out.sensor.messageCounter, 4);
+  packet.sensor.messageCounter = 5;
+  packet.sensor.uptime = 300;
+  n = SensorSentinel_encode_packet_v2(&packet, frame, sizeof(frame));
+  CHECK(SensorSentinel_v2_parse_header(frame, n, &h) && h.delta);
+  CHECK(SensorSentinel_decode_packet(frame, n, &out));
+  CHECK_EQ(out.sensor.uptime, 300);
+}
+
+TEST_MAIN(
+  TEST(test_varint_zigzag),
+  TEST(test_sensor_key_round_trip),
+  TEST(test_sensor_delta_round_trip),
+  TEST(test_key_interval_and_other_node),
+  TEST(test_edges_and_report),
+  TEST(test_gnss_round_trip),
+  TEST(test_truncation),
+  TEST(test_malformed_header),
+  TEST(test_firmware_force_key)
+)
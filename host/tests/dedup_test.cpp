@@ -0,0 +1,152 @@
+/**
+ * @file dedup_test.cpp
+ * @brief Unit tests for the duplicate-frame tables (SensorSentinel_dedup_helper.h)
+ *
+ * Built twice: with the firmware's DEDUP_REJECT_STALE=1 and with the
+ * ingest bridge's 0, both on small tables so probe windows fill up.
+ * Covers duplicates, TTL expiry of frames and nodes, the two restart
+ * rules, stale frames, and evictions.
+ */
+
+#include <string.h>
+
+#include "SensorSentinel_dedup_helper.h"
+#include "test_common.h"
+
+#define NODE 0x5EED0001
+#define TTL  1000
+
+static SensorSentinel_dedup_stats_t _stats()
+{
+  SensorSentinel_dedup_stats_t stats;
+  SensorSentinel_dedup_get_stats(&stats);
+  return stats;
+}
+
+static void test_new_and_duplicate()
+{
+  SensorSentinel_dedup_init(TTL);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 100, 0), DEDUP_NEW);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 100, 10), DEDUP_DUPLICATE);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 101, 20), DEDUP_NEW);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE + 1, 100, 30), DEDUP_NEW);
+
+  // A late copy of an older frame is still a duplicate
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 100, 40), DEDUP_DUPLICATE);
+
+  SensorSentinel_dedup_stats_t stats = _stats();
+  CHECK_EQ(stats.lookups, 5);
+  CHECK_EQ(stats.hits, 2);
+  CHECK_EQ(stats.misses, 3);
+  CHECK_EQ(stats.fastPath, 1);
+  CHECK_EQ(stats.stale, 0);
+}
+
+static void test_ttl()
+{
+  SensorSentinel_dedup_init(TTL);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 100, 0), DEDUP_NEW);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 100, TTL), DEDUP_DUPLICATE);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 100, TTL + 1), DEDUP_NEW);
+
+  // Once the node has expired too, an older counter starts it over rather than being stale
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 300, 5000), DEDUP_NEW);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 200, 5000 + TTL + 1), DEDUP_NEW);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 201, 5000 + TTL + 2), DEDUP_NEW);
+  CHECK_EQ(_stats().fastPath, 1);
+
+  // The clock may wrap
+  SensorSentinel_dedup_init(TTL);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 7, 0xFFFFFF00u), DEDUP_NEW);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 7, 0x00000100u), DEDUP_DUPLICATE);
+}
+
+static void test_restart()
+{
+  SensorSentinel_dedup_init(TTL);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 500, 0), DEDUP_NEW);
+
+  // Back near zero
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, DEDUP_RESTART_COUNTER - 1, 10), DEDUP_NEW);
+  CHECK_EQ(_stats().restarts, 1);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, DEDUP_RESTART_COUNTER, 20), DEDUP_NEW);
+  CHECK_EQ(_stats().fastPath, 1);  // The restart moved the highest counter down
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, DEDUP_RESTART_COUNTER - 1, 30), DEDUP_DUPLICATE);
+
+  // Far below the highest
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 5000, 40), DEDUP_NEW);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 5000 - DEDUP_REBOOT_GAP - 1, 50), DEDUP_NEW);
+  CHECK_EQ(_stats().restarts, 2);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 5000 - DEDUP_REBOOT_GAP, 60), DEDUP_NEW);
+  CHECK_EQ(_stats().stale, 0);
+}
+
+static void test_stale()
+{
+  SensorSentinel_dedup_init(TTL);
+  for (uint32_t counter = 100; counter <= 105; counter++)
+  {
+    CHECK_EQ(SensorSentinel_dedup_check_at(NODE, counter, counter), DEDUP_NEW);
+  }
+
+  // Never seen, older than the highest, within DEDUP_REBOOT_GAP
+  SensorSentinel_dedup_result_t result = SensorSentinel_dedup_check_at(NODE, 50, 200);
+#if DEDUP_REJECT_STALE
+  CHECK_EQ(result, DEDUP_STALE);
+  CHECK_EQ(_stats().stale, 1);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 50, 210), DEDUP_STALE);
+#else
+  CHECK_EQ(result, DEDUP_NEW);
+  CHECK_EQ(_stats().stale, 0);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 50, 210), DEDUP_DUPLICATE);
+#endif
+
+  // Either way the highest counter stays put
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 104, 220), DEDUP_DUPLICATE);
+  uint32_t fastPath = _stats().fastPath;
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 106, 230), DEDUP_NEW);
+  CHECK_EQ(_stats().fastPath, fastPath + 1);
+}
+
+static void test_evictions()
+{
+  // One node's frames overflow the frame table: the newest are kept
+  SensorSentinel_dedup_init(TTL);
+  for (uint32_t counter = 1000; counter < 1000 + 4 * DEDUP_TABLE_SIZE; counter++)
+  {
+    CHECK_EQ(SensorSentinel_dedup_check_at(NODE, counter, counter - 1000), DEDUP_NEW);
+  }
+  CHECK(_stats().evictions > 0);
+  uint32_t last = 1000 + 4 * DEDUP_TABLE_SIZE - 1;
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, last, last - 1000 + 10), DEDUP_DUPLICATE);
+
+  // More nodes than node slots: an evicted node's live frames are still found,
+  // and a duplicate does not leave the slot it probed with another node's counter
+  SensorSentinel_dedup_init(TTL);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 776, 0), DEDUP_NEW);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 777, 0), DEDUP_NEW);
+  for (uint32_t i = 1; i <= 8 * DEDUP_NODE_TABLE_SIZE; i++)
+  {
+    CHECK_EQ(SensorSentinel_dedup_check_at(NODE + i, 100, 1 + i / 16), DEDUP_NEW);
+  }
+  CHECK(_stats().nodeEvictions > 0);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 777, 600), DEDUP_DUPLICATE);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 776, 610), DEDUP_DUPLICATE);
+  CHECK_EQ(SensorSentinel_dedup_check_at(NODE, 778, 620), DEDUP_NEW);
+}
+
+static void test_result_strings()
+{
+  CHECK(strcmp(SensorSentinel_dedup_result_to_string(DEDUP_NEW), "New") == 0);
+  CHECK(strcmp(SensorSentinel_dedup_result_to_string(DEDUP_DUPLICATE), "Duplicate") == 0);
+  CHECK(strcmp(SensorSentinel_dedup_result_to_string(DEDUP_STALE), "Stale") == 0);
+}
+
+TEST_MAIN(
+  TEST(test_new_and_duplicate),
+  TEST(test_ttl),
+  TEST(test_restart),
+  TEST(test_stale),
+  TEST(test_evictions),
+  TEST(test_result_strings)
+)
@@ -0,0 +1,380 @@
+/**
+ * @file ingest_frames_test.cpp
+ * @brief Unit tests for the ingest bridge's frame parser (ingest_frames.h)
+ *
+ * Payload splitting (bare frames, batch envelopes, truncation), uplink
+ * record headers, every frame type including v2 deltas without their key
+ * frame, the validity rules, and the reading JSON the Node-RED parser
+ * would produce for the same frame.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ingest_frames.h"
+#include "test_common.h"
+
+#define NODE    0x0BADCAFE
+#define GATEWAY 0x00C0FFEE
+
+static SensorSentinel_sensor_packet_t _sensor(uint32_t counter)
+{
+  SensorSentinel_sensor_packet_t p;
+  memset(&p, 0, sizeof(p));
+  p.messageType = SensorSentinel_MSG_SENSOR;
+  p.nodeId = NODE;
+  p.messageCounter = counter;
+  p.uptime = 3600;
+  p.batteryLevel = 87;
+  p.batteryVoltage = 3987;
+  p.pins.analog[0] = 1;
+  p.pins.analog[1] = 22;
+  p.pins.analog[2] = 333;
+  p.pins.analog[3] = 4095;
+  p.pins.boolean = 0xA5;
+  p.skippedCount = 2;
+  return p;
+}
+
+static SensorSentinel_gnss_packet_t _gnss(uint32_t counter)
+{
+  SensorSentinel_gnss_packet_t p;
+  memset(&p, 0, sizeof(p));
+  p.messageType = SensorSentinel_MSG_GNSS;
+  p.nodeId = NODE;
+  p.messageCounter = counter;
+  p.uptime = 60;
+  p.batteryLevel = 50;
+  p.batteryVoltage = 3700;
+  p.latitude = -33.5f;
+  p.longitude = 151.25f;
+  p.speed = 12.5f;
+  p.hdop = 9;
+  p.course = 270.0f;
+  return p;
+}
+
+// Header + frame, as the gateway's SensorSentinel_build_uplink_record() lays it out
+static std::vector<uint8_t> _record(const void *frame, size_t length, uint64_t rxEpochMs = 1706704496789ULL)
+{
+  SensorSentinel_rx_slot_t slot;
+  memset(&slot, 0, sizeof(slot));
+  memcpy(slot.data, frame, length);
+  slot.length = length;
+  slot.rssi = -97.5f;
+  slot.snr = 6.25f;
+  slot.freqError = -1234.4f;
+  const uint8_t *record = SensorSentinel_build_uplink_record(&slot, GATEWAY, rxEpochMs);
+  return std::vector<uint8_t>(record, record + SensorSentinel_UPLINK_HEADROOM + length);
+}
+
+static std::string _json(const ingest_frame_t *frame, int index = 0)
+{
+  ingest_reading_t reading;
+  ingest_get_reading(frame, index, &reading);
+  std::string out;
+  ingest_reading_json(&reading, out);
+  return out;
+}
+
+typedef struct {
+  std::vector<std::vector<uint8_t>> records;
+} _collected_t;
+
+static void _collect(void *ctx, const uint8_t *record, size_t length)
+{
+  ((_collected_t *)ctx)->records.emplace_back(record, record + length);
+}
+
+static void test_split_payload()
+{
+  SensorSentinel_sensor_packet_t sensor = _sensor(1);
+  _collected_t got;
+
+  // A bare frame or uplink record is one record
+  CHECK_EQ(ingest_split_payload((const uint8_t *)&sensor, sizeof(sensor), _collect, &got), 1);
+  CHECK_EQ(got.records.size(), 1);
+  CHECK_EQ(got.records[0].size(), sizeof(sensor));
+  CHECK_EQ(ingest_split_payload(NULL, 0, _collect, &got), 0);
+
+  // A batch envelope delivers its records in order
+  uint8_t envelope[512];
+  size_t length = 0;
+  std::vector<uint8_t> a = _record(&sensor, sizeof(sensor));
+  SensorSentinel_gnss_packet_t gnss = _gnss(2);
+  std::vector<uint8_t> b = _record(&gnss, sizeof(gnss));
+  CHECK_EQ(SensorSentinel_batch_append(envelope, &length, sizeof(envelope), a.data(), a.size()), 1);
+  CHECK_EQ(SensorSentinel_batch_append(envelope, &length, sizeof(envelope), b.data(), b.size()), 2);
+  got.records.clear();
+  CHECK_EQ(ingest_split_payload(envelope, length, _collect, &got), 2);
+  CHECK_EQ(got.records.size(), 2);
+  CHECK(got.records[0] == a);
+  CHECK(got.records[1] == b);
+
+  // Truncated anywhere: the records before the damage still arrive
+  for (size_t cut = 1; cut < length; cut++)
+  {
+    got.records.clear();
+    int result = ingest_split_payload(envelope, cut, _collect, &got);
+    CHECK_EQ(result, -1);
+    CHECK_EQ(got.records.size(), cut >= 2 + 2 + a.size() ? 1 : 0);
+  }
+
+  // A zero-length record is damage too
+  uint8_t empty[] = {INGEST_BATCH_MARKER, 1, 0, 0};
+  CHECK_EQ(ingest_split_payload(empty, sizeof(empty), _collect, &got), -1);
+  uint8_t none[] = {INGEST_BATCH_MARKER, 0};
+  CHECK_EQ(ingest_split_payload(none, sizeof(none), _collect, &got), 0);
+}
+
+static void test_uplink_header()
+{
+  SensorSentinel_sensor_packet_t sensor = _sensor(7);
+  std::vector<uint8_t> record = _record(&sensor, sizeof(sensor));
+  ingest_frame_t frame;
+  CHECK_EQ(ingest_parse_record(record.data(), record.size(), &frame), INGEST_FRAME_OK);
+  CHECK(frame.rx.present);
+  CHECK_EQ(frame.rx.gatewayId, GATEWAY);
+  CHECK_EQ(frame.rx.rxEpochMs, 1706704496789ULL);
+  CHECK_EQ(frame.rx.rssi, -975);
+  CHECK_EQ(frame.rx.snr, 63);
+  CHECK_EQ(frame.rx.freqError, -1234);
+  CHECK(frame.sensor == (const SensorSentinel_sensor_packet_t *)(record.data() + SensorSentinel_UPLINK_HEADROOM));
+
+  // A bare frame has no RX metadata
+  CHECK_EQ(ingest_parse_record((const uint8_t *)&sensor, sizeof(sensor), &frame), INGEST_FRAME_OK);
+  CHECK(!frame.rx.present);
+
+  // The header's length must cover exactly the rest of the record
+  CHECK_EQ(ingest_parse_record(record.data(), record.size() - 1, &frame), INGEST_FRAME_MALFORMED);
+  CHECK_EQ(ingest_parse_record(record.data(), SensorSentinel_UPLINK_HEADROOM - 1, &frame), INGEST_FRAME_MALFORMED);
+  record.push_back(0);
+  CHECK_EQ(ingest_parse_record(record.data(), record.size(), &frame), INGEST_FRAME_MALFORMED);
+
+  // A header with nothing behind it
+  std::vector<uint8_t> bare = _record(&sensor, 0);
+  CHECK_EQ(ingest_parse_record(bare.data(), bare.size(), &frame), INGEST_FRAME_MALFORMED);
+}
+
+static void test_sensor_frame()
+{
+  SensorSentinel_sensor_packet_t sensor = _sensor(41);
+  ingest_frame_t frame;
+  CHECK_EQ(ingest_parse_record((const uint8_t *)&sensor, sizeof(sensor), &frame), INGEST_FRAME_OK);
+  CHECK_EQ(frame.messageType, SensorSentinel_MSG_SENSOR);
+  CHECK_EQ(frame.nodeId, NODE);
+  CHECK_EQ(frame.messageCounter, 41);
+  CHECK(!frame.hasReport && !frame.hasEdges);
+  CHECK_EQ(ingest_reading_count(&frame), 1);
+
+  ingest_reading_t reading;
+  ingest_get_reading(&frame, 0, &reading);
+  CHECK(!reading.isGnss);
+  CHECK_EQ(reading.sampleIndex, -1);
+  CHECK(reading.pins == &frame.sensor->pins);
+  CHECK(strcmp(ingest_reading_topic(&reading), "lora/out/sensor") == 0);
+  CHECK(_json(&frame) == "{\"type\":\"sensor\",\"nodeId\":195939070,\"counter\":41,\"uptime\":3600,"
+                         "\"battery\":87,\"voltage\":3987,\"analog\":[1,22,333,4095],\"digital\":165,"
+                         "\"skipped\":2}");
+
+  // With an LBT report and RX metadata
+  uint8_t buf[sizeof(sensor) + SensorSentinel_TX_REPORT_SIZE];
+  memcpy(buf, &sensor, sizeof(sensor));
+  SensorSentinel_tx_report_t report = {3, 1, 650};
+  size_t n = SensorSentinel_add_tx_report(buf, sizeof(sensor), sizeof(buf), &report);
+  CHECK_EQ(n, sizeof(buf));
+  std::vector<uint8_t> record = _record(buf, n);
+  CHECK_EQ(ingest_parse_record(record.data(), record.size(), &frame), INGEST_FRAME_OK);
+  CHECK(frame.hasReport);
+  std::string json = _json(&frame);
+  CHECK(json.find(",\"lbt\":{\"busy\":3,\"forced\":1,\"backoffMs\":650},\"rx\":{\"gatewayId\":12648430,"
+                  "\"time\":\"2024-01-31T12:34:56.789Z\",\"rssi\":-97.5,\"snr\":6.3,\"freqError\":-1234}}") !=
+        std::string::npos);
+
+  // Before NTP the receive time is null
+  record = _record(&sensor, sizeof(sensor), 0);
+  CHECK_EQ(ingest_parse_record(record.data(), record.size(), &frame), INGEST_FRAME_OK);
+  CHECK(_json(&frame).find("\"time\":null") != std::string::npos);
+}
+
+static void test_gnss_frame()
+{
+  SensorSentinel_gnss_packet_t gnss = _gnss(5);
+  ingest_frame_t frame;
+  CHECK_EQ(ingest_parse_record((const uint8_t *)&gnss, sizeof(gnss), &frame), INGEST_FRAME_OK);
+  CHECK(frame.gnss && !frame.sensor && !frame.aggregate);
+
+  ingest_reading_t reading;
+  ingest_get_reading(&frame, 0, &reading);
+  CHECK(reading.isGnss);
+  CHECK(reading.pins == NULL);
+  CHECK_EQ(reading.batteryVoltage, 3700);
+  CHECK(strcmp(ingest_reading_topic(&reading), "lora/out/gnss") == 0);
+  CHECK(_json(&frame) == "{\"type\":\"gnss\",\"nodeId\":195939070,\"counter\":5,\"uptime\":60,"
+                         "\"battery\":50,\"voltage\":3700,\"latitude\":-33.5,\"longitude\":151.25,"
+                         "\"speed\":12.5,\"hdop\":0.9,\"course\":270}");
+
+  // Positions out of range
+  const float bad[][2] = {{90.5f, 0}, {-91, 0}, {0, 180.5f}, {0, -181}};
+  for (const auto &pos : bad)
+  {
+    gnss.latitude = pos[0];
+    gnss.longitude = pos[1];
+    CHECK_EQ(ingest_parse_record((const uint8_t *)&gnss, sizeof(gnss), &frame), INGEST_FRAME_INVALID);
+  }
+  gnss.latitude = 90;
+  gnss.longitude = -180;
+  CHECK_EQ(ingest_parse_record((const uint8_t *)&gnss, sizeof(gnss), &frame), INGEST_FRAME_OK);
+}
+
+static void test_aggregate_frames()
+{
+  uint8_t buf[SensorSentinel_AGGREGATE_MAX_SIZE];
+  SensorSentinel_aggregate_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.messageType = SensorSentinel_MSG_AGGREGATE;
+  header.nodeId = NODE;
+  header.messageCounter = 9;
+  header.uptime = 900;
+  header.batteryLevel = 70;
+  header.batteryVoltage = 3800;
+  header.mode = AGGREGATE_MODE_SAMPLES;
+  header.sampleCount = 3;
+  header.sampleIntervalSecs = 300;
+  memcpy(buf, &header, sizeof(header));
+  SensorSentinel_pin_readings_t samples[3];
+  for (int i = 0; i < 3; i++)
+  {
+    samples[i] = {{(uint16_t)(100 + i), 200, 300, 400}, (uint8_t)(1 << i)};
+  }
+  memcpy(buf + sizeof(header), samples, sizeof(samples));
+  size_t n = sizeof(header) + sizeof(samples);
+
+  // Every sample is a reading; the oldest is furthest back
+  ingest_frame_t frame;
+  CHECK_EQ(ingest_parse_record(buf, n, &frame), INGEST_FRAME_OK);
+  CHECK_EQ(ingest_reading_count(&frame), 3);
+  for (int i = 0; i < 3; i++)
+  {
+    ingest_reading_t reading;
+    ingest_get_reading(&frame, i, &reading);
+    CHECK_EQ(reading.sampleIndex, i);
+    CHECK_EQ(reading.pins->analog[0], 100 + i);
+    CHECK_EQ(reading.uptime, 900);
+  }
+  CHECK(_json(&frame, 0).find(",\"analog\":[100,200,300,400],\"digital\":1,\"aggregate\":{\"index\":0,"
+                              "\"count\":3,\"intervalSecs\":300,\"ageSecs\":600}}") != std::string::npos);
+  CHECK(_json(&frame, 2).find("\"ageSecs\":0") != std::string::npos);
+  CHECK(_json(&frame, 0).find("skipped") == std::string::npos);
+
+  // A body shorter than the header says
+  CHECK_EQ(ingest_parse_record(buf, n - 1, &frame), INGEST_FRAME_MALFORMED);
+
+  // Summary: one reading, the means and last digital state
+  header.mode = AGGREGATE_MODE_SUMMARY;
+  header.sampleCount = 12;
+  memcpy(buf, &header, sizeof(header));
+  SensorSentinel_aggregate_summary_t summary = {{1, 2, 3, 4}, {9, 8, 7, 6}, {5, 5, 5, 5}, 0x0F, 0x3F, 0x01};
+  memcpy(buf + sizeof(header), &summary, sizeof(summary));
+  n = sizeof(header) + sizeof(summary);
+  CHECK_EQ(ingest_parse_record(buf, n, &frame), INGEST_FRAME_OK);
+  CHECK_EQ(ingest_reading_count(&frame), 1);
+  ingest_reading_t reading;
+  ingest_get_reading(&frame, 0, &reading);
+  CHECK_EQ(reading.sampleIndex, -1);
+  CHECK_EQ(reading.pins->analog[3], 5);
+  CHECK_EQ(reading.pins->boolean, 0x0F);
+  CHECK(_json(&frame).find(",\"analog\":[5,5,5,5],\"digital\":15,\"aggregate\":{\"count\":12,"
+                           "\"intervalSecs\":300,\"min\":[1,2,3,4],\"max\":[9,8,7,6],\"mean\":[5,5,5,5],"
+                           "\"digitalAny\":63,\"digitalAll\":1}}") != std::string::npos);
+}
+
+static void test_v2_frames()
+{
+  SensorSentinel_packet_t packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.sensor = _sensor(100);
+  packet.sensor.nodeId = NODE + 1;  // Not yet seen by the decoder
+  SensorSentinel_force_key_frame_v2();
+
+  uint8_t key[SensorSentinel_V2_MAX_FRAME], delta[SensorSentinel_V2_MAX_FRAME + sizeof(SensorSentinel_pin_edges_t)];
+  size_t keyLength = SensorSentinel_encode_packet_v2(&packet, key, sizeof(key));
+  packet.sensor.messageCounter = 101;
+  packet.sensor.pins.analog[2] = 334;
+  size_t deltaLength = SensorSentinel_encode_packet_v2(&packet, delta, sizeof(delta));
+  SensorSentinel_pin_edges_t edges;
+  memset(&edges, 0, sizeof(edges));
+  edges.changed = 0x81;
+  edges.pulses[0] = 4;
+  edges.pulses[7] = 1;
+  deltaLength = SensorSentinel_add_pin_edges(delta, deltaLength, sizeof(delta), &edges);
+  CHECK(keyLength > 0 && deltaLength > 0);
+
+  // The delta before its key frame: counted against the node, but not decoded
+  ingest_frame_t frame;
+  CHECK_EQ(ingest_parse_record(delta, deltaLength, &frame), INGEST_FRAME_UNDECODABLE);
+  CHECK_EQ(frame.nodeId, NODE + 1);
+
+  CHECK_EQ(ingest_parse_record(key, keyLength, &frame), INGEST_FRAME_OK);
+  CHECK_EQ(frame.messageType, SensorSentinel_MSG_SENSOR_V2);
+  CHECK(frame.sensor == &frame.decoded.sensor);
+  CHECK_EQ(frame.messageCounter, 100);
+
+  CHECK_EQ(ingest_parse_record(delta, deltaLength, &frame), INGEST_FRAME_OK);
+  CHECK_EQ(frame.messageCounter, 101);
+  CHECK_EQ(frame.sensor->pins.analog[2], 334);
+  CHECK(frame.hasEdges);
+  std::string json = _json(&frame);
+  CHECK(json.find("\"analog\":[1,22,334,4095],\"digital\":165,\"edges\":{\"changed\":129,"
+                  "\"pulses\":[4,0,0,0,0,0,0,1]}}") != std::string::npos);
+  CHECK(json.find("skipped") == std::string::npos);  // v1 sensor frames only
+
+  // GNSS v2 comes out as a GNSS reading
+  memset(&packet, 0, sizeof(packet));
+  packet.gnss = _gnss(3);
+  size_t n = SensorSentinel_encode_packet_v2(&packet, key, sizeof(key));
+  CHECK_EQ(ingest_parse_record(key, n, &frame), INGEST_FRAME_OK);
+  CHECK_EQ(frame.messageType, SensorSentinel_MSG_GNSS_V2);
+  CHECK(frame.gnss == &frame.decoded.gnss);
+  CHECK(fabsf(frame.gnss->latitude + 33.5f) < 1e-5f);
+}
+
+static void test_rejected_frames()
+{
+  ingest_frame_t frame;
+  SensorSentinel_sensor_packet_t sensor = _sensor(1);
+  const uint8_t *raw = (const uint8_t *)&sensor;
+
+  CHECK_EQ(ingest_parse_record(NULL, 0, &frame), INGEST_FRAME_MALFORMED);
+  CHECK_EQ(ingest_parse_record(raw, 0, &frame), INGEST_FRAME_MALFORMED);
+  CHECK_EQ(ingest_parse_record(raw, sizeof(sensor) - 1, &frame), INGEST_FRAME_MALFORMED);
+  CHECK_EQ(ingest_parse_record(raw, sizeof(sensor) + 1, &frame), INGEST_FRAME_MALFORMED);
+
+  // Types that are not uplinks
+  const uint8_t types[] = {0x00, SensorSentinel_MSG_LINK_HINT, 0x7F, INGEST_BATCH_MARKER};
+  for (uint8_t type : types)
+  {
+    sensor.messageType = type;
+    CHECK_EQ(ingest_parse_record(raw, sizeof(sensor), &frame), INGEST_FRAME_MALFORMED);
+  }
+  sensor.messageType = SensorSentinel_MSG_SENSOR;
+
+  // Node 0 is never assigned
+  sensor.nodeId = 0;
+  CHECK_EQ(ingest_parse_record(raw, sizeof(sensor), &frame), INGEST_FRAME_INVALID);
+
+  // A failed parse leaves no stale views behind
+  CHECK(frame.gnss == NULL && frame.aggregate == NULL && !frame.rx.present);
+}
+
+TEST_MAIN(
+  TEST(test_split_payload),
+  TEST(test_uplink_header),
+  TEST(test_sensor_frame),
+  TEST(test_gnss_frame),
+  TEST(test_aggregate_frames),
+  TEST(test_v2_frames),
+  TEST(test_rejected_frames)
+)
@@ -0,0 +1,216 @@
+/**
+ * @file mesh_test.cpp
+ * @brief Unit tests for the repeater mesh header and forwarding rules (SensorSentinel_mesh_helper.h)
+ *
+ * Header wrap/unwrap/strip and the frames they refuse, allowlist parsing,
+ * the TTL, RSSI and allowlist decisions, next-hop headers and suppression.
+ */
+
+#include <string.h>
+
+#include "SensorSentinel_mesh_helper.h"
+#include "test_common.h"
+
+#define NODE     0x1A2B3C4D
+#define REPEATER 0x0BADF00D
+
+static const uint8_t FRAME[] = {0x11, 0x4D, 0x3C, 0x2B, 0x1A, 0x07, 0x00, 0x01, 0x02, 0x03};
+
+static SensorSentinel_mesh_header_t _header(uint8_t hops, uint8_t ttl, int8_t originRssi)
+{
+  SensorSentinel_mesh_header_t h;
+  h.messageType = SensorSentinel_MSG_MESH;
+  h.hops = hops;
+  h.ttl = ttl;
+  h.originRssi = originRssi;
+  h.lastRepeaterId = REPEATER;
+  return h;
+}
+
+static void test_unwrap_and_strip()
+{
+  SensorSentinel_mesh_header_t h;
+  size_t innerLength = 0;
+
+  // A bare frame is its own inner frame, at hop 0
+  const uint8_t *inner = SensorSentinel_mesh_unwrap(FRAME, sizeof(FRAME), &h, &innerLength);
+  CHECK(inner == FRAME);
+  CHECK_EQ(innerLength, sizeof(FRAME));
+  CHECK_EQ(h.hops, 0);
+  CHECK_EQ(h.originRssi, 0);
+
+  uint8_t wrapped[64];
+  SensorSentinel_mesh_header_t sent = _header(2, 3, -101);
+  sent.messageType = 0;  // Set by wrap
+  size_t n = SensorSentinel_mesh_wrap(wrapped, sizeof(wrapped), &sent, FRAME, sizeof(FRAME));
+  CHECK_EQ(n, SensorSentinel_MESH_HEADER_SIZE + sizeof(FRAME));
+  CHECK_EQ(wrapped[0], SensorSentinel_MSG_MESH);
+  CHECK_EQ(SensorSentinel_mesh_wrap(wrapped, n - 1, &sent, FRAME, sizeof(FRAME)), 0);
+
+  inner = SensorSentinel_mesh_unwrap(wrapped, n, &h, &innerLength);
+  CHECK(inner == wrapped + SensorSentinel_MESH_HEADER_SIZE);
+  CHECK_EQ(innerLength, sizeof(FRAME));
+  CHECK_EQ(h.hops, 2);
+  CHECK_EQ(h.ttl, 3);
+  CHECK_EQ(h.originRssi, -101);
+  CHECK_EQ(h.lastRepeaterId, REPEATER);
+
+  // Header only, hop 0 in a header, and a header wrapping a header are broken
+  CHECK(SensorSentinel_mesh_unwrap(wrapped, SensorSentinel_MESH_HEADER_SIZE, &h, &innerLength) == NULL);
+  CHECK(SensorSentinel_mesh_unwrap(NULL, n, &h, &innerLength) == NULL);
+  CHECK(SensorSentinel_mesh_unwrap(wrapped, 0, &h, &innerLength) == NULL);
+  wrapped[1] = 0;
+  CHECK(SensorSentinel_mesh_unwrap(wrapped, n, &h, &innerLength) == NULL);
+  wrapped[1] = 2;
+  uint8_t nested[80];
+  size_t nestedLength = SensorSentinel_mesh_wrap(nested, sizeof(nested), &sent, wrapped, n);
+  CHECK(SensorSentinel_mesh_unwrap(nested, nestedLength, &h, &innerLength) == NULL);
+
+  // Strip moves the frame to the front; a bare frame is left alone
+  CHECK_EQ(SensorSentinel_mesh_strip(nested, nestedLength, NULL), 0);
+  memset(&h, 0, sizeof(h));
+  CHECK_EQ(SensorSentinel_mesh_strip(wrapped, n, &h), sizeof(FRAME));
+  CHECK_EQ(memcmp(wrapped, FRAME, sizeof(FRAME)), 0);
+  CHECK_EQ(h.hops, 2);
+  CHECK_EQ(SensorSentinel_mesh_strip(wrapped, sizeof(FRAME), &h), sizeof(FRAME));
+  CHECK_EQ(h.hops, 0);
+  CHECK_EQ(memcmp(wrapped, FRAME, sizeof(FRAME)), 0);
+}
+
+static void test_parse_allowlist()
+{
+  uint32_t ids[MESH_ALLOW_MAX];
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist("0x1a2b3c4d, 305419896", ids), 2);
+  CHECK_EQ(ids[0], 0x1A2B3C4D);
+  CHECK_EQ(ids[1], 305419896);
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist(" 1\t2,,3 ,", ids), 3);
+  CHECK_EQ(ids[2], 3);
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist("", ids), 0);
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist(NULL, ids), 0);
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist("0xFFFFFFFF", NULL), 1);
+
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist("12abc", ids), -1);
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist("0", ids), -1);
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist("1;2", ids), -1);
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist("node", ids), -1);
+
+  char list[256] = "";
+  for (int i = 1; i <= MESH_ALLOW_MAX; i++)
+  {
+    size_t used = strlen(list);
+    snprintf(list + used, sizeof(list) - used, "%d,", i);
+  }
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist(list, ids), MESH_ALLOW_MAX);
+  strcat(list, "99");
+  CHECK_EQ(SensorSentinel_mesh_parse_allowlist(list, ids), -1);
+}
+
+static void test_decide()
+{
+  SensorSentinel_mesh_stats_t before, after;
+  SensorSentinel_mesh_get_stats(&before);
+  SensorSentinel_mesh_header_t direct = _header(0, 0, 0);
+  SensorSentinel_mesh_header_t repeated = _header(1, 3, -115);
+  SensorSentinel_mesh_header_t lastHop = _header(3, 3, -115);
+
+  // No rules: everything within the TTL is repeated
+  SensorSentinel_mesh_configure(0, "");
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &direct, -40.0f), MESH_REPEAT);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &repeated, -40.0f), MESH_REPEAT);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &lastHop, -40.0f), MESH_SKIP_TTL);
+
+  // Threshold: hop 0 goes by this copy's RSSI, later hops by the origin's
+  SensorSentinel_mesh_configure(-100, NULL);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &direct, -90.0f), MESH_SKIP_RSSI);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &direct, -100.0f), MESH_SKIP_RSSI);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &direct, -110.0f), MESH_REPEAT);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &repeated, -40.0f), MESH_REPEAT);
+
+  // Allowlisted nodes bypass the threshold, but not the TTL
+  SensorSentinel_mesh_configure(-100, "0x1A2B3C4D");
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &direct, -40.0f), MESH_REPEAT);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE + 1, &direct, -40.0f), MESH_SKIP_RSSI);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &lastHop, -40.0f), MESH_SKIP_TTL);
+
+  // Allowlist alone: only the listed nodes
+  SensorSentinel_mesh_configure(0, "1, 0x1A2B3C4D");
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE, &direct, -120.0f), MESH_REPEAT);
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE + 1, &direct, -120.0f), MESH_SKIP_ALLOW);
+
+  // An invalid list is ignored rather than blocking everything
+  SensorSentinel_mesh_configure(0, "1, two");
+  CHECK_EQ(SensorSentinel_mesh_decide(NODE + 1, &direct, -40.0f), MESH_REPEAT);
+
+  SensorSentinel_mesh_get_stats(&after);
+  CHECK_EQ(after.repeated - before.repeated, 7);
+  CHECK_EQ(after.skippedTtl - before.skippedTtl, 2);
+  CHECK_EQ(after.skippedRssi - before.skippedRssi, 3);
+  CHECK_EQ(after.skippedAllow - before.skippedAllow, 1);
+  SensorSentinel_mesh_configure(0, NULL);
+}
+
+static void test_next_hop()
+{
+  SensorSentinel_mesh_header_t direct = _header(0, 0, 0);
+  SensorSentinel_mesh_header_t out;
+  SensorSentinel_mesh_next_hop(&direct, -97.6f, REPEATER + 1, &out);
+  CHECK_EQ(out.messageType, SensorSentinel_MSG_MESH);
+  CHECK_EQ(out.hops, 1);
+  CHECK_EQ(out.ttl, MESH_TTL);
+  CHECK_EQ(out.originRssi, -97);
+  CHECK_EQ(out.lastRepeaterId, REPEATER + 1);
+
+  SensorSentinel_mesh_next_hop(&direct, -140.0f, REPEATER, &out);
+  CHECK_EQ(out.originRssi, -128);
+
+  // Later hops keep the first repeater's TTL and origin RSSI
+  SensorSentinel_mesh_header_t repeated = _header(1, 5, -120);
+  SensorSentinel_mesh_next_hop(&repeated, -60.0f, REPEATER + 2, &out);
+  CHECK_EQ(out.hops, 2);
+  CHECK_EQ(out.ttl, 5);
+  CHECK_EQ(out.originRssi, -120);
+  CHECK_EQ(out.lastRepeaterId, REPEATER + 2);
+}
+
+static void test_suppression()
+{
+  uint32_t tagA = SensorSentinel_mesh_tag(NODE, 7);
+  uint32_t tagB = SensorSentinel_mesh_tag(NODE, 8);
+  CHECK(tagA != 0 && tagB != 0 && tagA != tagB);
+  CHECK_EQ(tagA, SensorSentinel_mesh_tag(NODE, 7));
+  CHECK(tagA & 1);
+
+  SensorSentinel_mesh_stats_t before, after;
+  SensorSentinel_mesh_get_stats(&before);
+
+  // A copy overheard while ours waits cancels it, once
+  SensorSentinel_mesh_note_queued(tagA, 1000);
+  CHECK(!SensorSentinel_mesh_note_overheard(tagB, 1100));
+  CHECK_EQ(SensorSentinel_mesh_note_overheard(tagA, 1200), MESH_SUPPRESS_COPIES == 1);
+  CHECK(!SensorSentinel_mesh_note_overheard(tagA, 1300) || MESH_SUPPRESS_COPIES > 1);
+
+  // After MESH_PENDING_TTL_MS our copy is long gone
+  SensorSentinel_mesh_note_queued(tagB, 2000);
+  CHECK(!SensorSentinel_mesh_note_overheard(tagB, 2000 + MESH_PENDING_TTL_MS + 1));
+
+  // More repeats than slots: the oldest is given up, the newest still watched
+  for (uint32_t i = 0; i <= MESH_PENDING_SIZE; i++)
+  {
+    SensorSentinel_mesh_note_queued(SensorSentinel_mesh_tag(NODE, 100 + i), 3000 + i);
+  }
+  CHECK(!SensorSentinel_mesh_note_overheard(SensorSentinel_mesh_tag(NODE, 100), 3100));
+  CHECK(SensorSentinel_mesh_note_overheard(SensorSentinel_mesh_tag(NODE, 100 + MESH_PENDING_SIZE), 3100));
+
+  SensorSentinel_mesh_note_suppressed();
+  SensorSentinel_mesh_get_stats(&after);
+  CHECK_EQ(after.suppressed - before.suppressed, 1);
+  CHECK_EQ(after.overheard - before.overheard, 2);
+}
+
+TEST_MAIN(
+  TEST(test_unwrap_and_strip),
+  TEST(test_parse_allowlist),
+  TEST(test_decide),
+  TEST(test_next_hop),
+  TEST(test_suppression)
+)
@@ -0,0 +1,126 @@
+/**
+ * @file packet_test.cpp
+ * @brief Unit tests for the gateway's uplink records and batch envelopes
+ *        (SensorSentinel_packet_helper.h)
+ *
+ * The uplink header built in a slot's headroom, and envelope building up
+ * to its capacity and frame limits. The ingest side of both is covered by
+ * ingest_frames_test.cpp.
+ */
+
+#include <string.h>
+#include <vector>
+
+#include "SensorSentinel_packet_helper.h"
+#include "test_common.h"
+
+static void test_uplink_record()
+{
+  SensorSentinel_rx_slot_t slot;
+  memset(&slot, 0xEE, sizeof(slot));
+  for (int i = 0; i < 20; i++)
+  {
+    slot.data[i] = (uint8_t)i;
+  }
+  slot.length = 20;
+  slot.rssi = -120.04f;
+  slot.snr = -7.25f;
+  slot.freqError = 2500.6f;
+
+  // Written in place, right in front of the frame
+  uint8_t *record = SensorSentinel_build_uplink_record(&slot, 0x12345678, 1700000000123ULL);
+  CHECK(record == slot.data - SensorSentinel_UPLINK_HEADROOM);
+  CHECK(record > slot.headroom);
+  CHECK_EQ(slot.headroom[0], 0xEE);  // Room left for the MQTT header
+
+  SensorSentinel_uplink_header_t header;
+  memcpy(&header, record, sizeof(header));
+  CHECK_EQ(header.version, SensorSentinel_UPLINK_VERSION);
+  CHECK_EQ(header.gatewayId, 0x12345678);
+  CHECK_EQ(header.rxEpochMs, 1700000000123ULL);
+  CHECK_EQ(header.rssi, -1200);
+  CHECK_EQ(header.snr, -73);  // Rounded half away from zero
+  CHECK_EQ(header.freqError, 2501);
+  CHECK_EQ(header.length, 20);
+  CHECK_EQ(record[SensorSentinel_UPLINK_HEADROOM + 19], 19);
+
+  // Rebuilding for another gateway overwrites the header only
+  record = SensorSentinel_build_uplink_record(&slot, 1, 0);
+  memcpy(&header, record, sizeof(header));
+  CHECK_EQ(header.gatewayId, 1);
+  CHECK_EQ(header.rxEpochMs, 0);
+  CHECK_EQ(slot.data[0], 0);
+}
+
+static void test_batch_append()
+{
+  uint8_t record[300];
+  for (size_t i = 0; i < sizeof(record); i++)
+  {
+    record[i] = (uint8_t)(i * 7);
+  }
+
+  // Records are prefixed with their u16 LE length
+  uint8_t envelope[1024];
+  size_t length = 0;
+  CHECK_EQ(SensorSentinel_batch_append(envelope, &length, sizeof(envelope), record, 10), 1);
+  CHECK_EQ(length, 2 + 2 + 10);
+  CHECK_EQ(envelope[0], SensorSentinel_BATCH_MARKER);
+  CHECK_EQ(envelope[1], 1);
+  CHECK_EQ(envelope[2], 10);
+  CHECK_EQ(envelope[3], 0);
+  CHECK(memcmp(&envelope[4], record, 10) == 0);
+
+  CHECK_EQ(SensorSentinel_batch_append(envelope, &length, sizeof(envelope), record, 300), 2);
+  CHECK_EQ(length, 14 + 2 + 300);
+  CHECK_EQ(envelope[14], 300 & 0xFF);
+  CHECK_EQ(envelope[15], 300 >> 8);
+  CHECK(memcmp(&envelope[16], record, 300) == 0);
+
+  // A record that does not fit leaves the envelope as it was
+  std::vector<uint8_t> before(envelope, envelope + length);
+  size_t room = sizeof(envelope) - length - 2;
+  CHECK_EQ(SensorSentinel_batch_append(envelope, &length, length + 2 + 299, record, 300), 0);
+  CHECK_EQ(length, before.size());
+  CHECK(memcmp(envelope, before.data(), length) == 0);
+
+  // One that fits exactly is accepted
+  std::vector<uint8_t> big(room, 0x5A);
+  CHECK_EQ(SensorSentinel_batch_append(envelope, &length, sizeof(envelope), big.data(), big.size()), 3);
+  CHECK_EQ(length, sizeof(envelope));
+  CHECK_EQ(SensorSentinel_batch_append(envelope, &length, sizeof(envelope), record, 0), 0);
+
+  // The first record must fit behind the two header bytes
+  length = 0;
+  CHECK_EQ(SensorSentinel_batch_append(envelope, &length, 2 + 2 + 9, record, 10), 0);
+  CHECK_EQ(length, 0);
+}
+
+static void test_batch_frame_limit()
+{
+  std::vector<uint8_t> envelope(2 + 256 * 3);
+  size_t length = 0;
+  uint8_t record = 0x42;
+  for (int i = 1; i <= SensorSentinel_BATCH_MAX_FRAMES; i++)
+  {
+    CHECK_EQ(SensorSentinel_batch_append(envelope.data(), &length, envelope.size(), &record, 1), i);
+  }
+  CHECK_EQ(length, 2 + SensorSentinel_BATCH_MAX_FRAMES * 3);
+
+  // The count byte would wrap: refused although there is room
+  CHECK_EQ(SensorSentinel_batch_append(envelope.data(), &length, envelope.size(), &record, 1), 0);
+  CHECK_EQ(envelope[1], SensorSentinel_BATCH_MAX_FRAMES);
+  CHECK_EQ(length, 2 + SensorSentinel_BATCH_MAX_FRAMES * 3);
+
+  // Neither can a record's length exceed its u16 prefix
+  std::vector<uint8_t> huge(0x10000 + 4);
+  length = 0;
+  CHECK_EQ(SensorSentinel_batch_append(huge.data(), &length, huge.size(), huge.data(), 0x10000), 0);
+  CHECK_EQ(length, 0);
+}
+
+TEST_MAIN(
+  TEST(test_uplink_record),
+  TEST(test_batch_append),
+  TEST(test_batch_frame_limit)
+)
@@ -0,0 +1,185 @@
+/**
+ * @file seq_test.cpp
+ * @brief Unit tests for the gateway's per-node sequence table (SensorSentinel_seq_helper.h)
+ *
+ * Classification of each counter (next, gap, late, repeat, reboot), the
+ * lost/reorder bookkeeping behind it, the link EWMA and the JSON pages.
+ */
+
+#include <string.h>
+
+#include "SensorSentinel_dedup_helper.h"
+#include "SensorSentinel_seq_helper.h"
+#include "test_common.h"
+
+#define NODE 0x11223344
+
+static SensorSentinel_seq_event_t _see(uint32_t counter, uint32_t uptime = 0, uint32_t nowMs = 0)
+{
+  return SensorSentinel_seq_observe(NODE, counter, uptime, -80.0f, 7.5f, nowMs);
+}
+
+static SensorSentinel_seq_node_t _node(uint32_t nowMs = 0)
+{
+  SensorSentinel_seq_node_t node;
+  memset(&node, 0, sizeof(node));
+  uint32_t cursor = 0;
+  while (SensorSentinel_seq_next_node(&cursor, nowMs, &node) && node.nodeId != NODE)
+  {
+  }
+  return node;
+}
+
+static void test_next_and_gap()
+{
+  SensorSentinel_seq_init();
+  CHECK_EQ(_see(100), SEQ_FIRST);
+  CHECK_EQ(_see(101), SEQ_NEXT);
+  CHECK_EQ(_see(105), SEQ_GAP);
+
+  SensorSentinel_seq_node_t node = _node();
+  CHECK_EQ(node.lastCounter, 105);
+  CHECK_EQ(node.frames, 3);
+  CHECK_EQ(node.lost, 3);
+  CHECK_EQ(node.gaps, 1);
+  CHECK_EQ(node.reorders, 0);
+
+  // A gap wider than the window is counted in full
+  CHECK_EQ(_see(105 + SEQ_WINDOW + 10), SEQ_GAP);
+  CHECK_EQ(_node().lost, 3 + SEQ_WINDOW + 9);
+}
+
+static void test_late_and_repeat()
+{
+  SensorSentinel_seq_init();
+  _see(110);
+  _see(114);  // 111-113 lost
+  CHECK_EQ(_see(112), SEQ_LATE);
+  CHECK_EQ(_node().lost, 2);
+  CHECK_EQ(_see(112), SEQ_REPEAT);
+  CHECK_EQ(_see(114), SEQ_REPEAT);
+  CHECK_EQ(_see(111), SEQ_LATE);
+  CHECK_EQ(_see(113), SEQ_LATE);
+
+  SensorSentinel_seq_node_t node = _node();
+  CHECK_EQ(node.lost, 0);
+  CHECK_EQ(node.reorders, 3);
+  CHECK_EQ(node.lastCounter, 114);
+
+  // Gaps stay tracked as the window slides forward
+  _see(116);  // 115 lost
+  _see(117);
+  CHECK_EQ(_see(115), SEQ_LATE);
+  CHECK_EQ(_node().lost, 0);
+
+  // Further back than the window, but not a reboot: late, lost unknown
+  _see(300);
+  uint32_t lost = _node().lost;
+  CHECK_EQ(_see(300 - SEQ_WINDOW - 5), SEQ_LATE);
+  CHECK_EQ(_node().lost, lost);
+
+  SensorSentinel_seq_stats_t stats;
+  SensorSentinel_seq_get_stats(&stats);
+  CHECK_EQ(stats.nodes, 1);
+  CHECK_EQ(stats.repeats, 2);
+  CHECK_EQ(stats.reorders, 5);
+  CHECK_EQ(stats.lost, lost);
+}
+
+static void test_reboot()
+{
+  SensorSentinel_seq_init();
+  _see(500, 5000);
+  _see(505, 5050);
+
+  // Counter back near zero: gaps of the old boot are dropped
+  CHECK_EQ(_see(DEDUP_RESTART_COUNTER - 1, 10), SEQ_REBOOT);
+  SensorSentinel_seq_node_t node = _node();
+  CHECK_EQ(node.reboots, 1);
+  CHECK_EQ(node.lastCounter, DEDUP_RESTART_COUNTER - 1);
+  CHECK_EQ(_see(DEDUP_RESTART_COUNTER), SEQ_NEXT);
+
+  // Counter far below the last
+  _see(5000, 200);
+  CHECK_EQ(_see(5000 - DEDUP_REBOOT_GAP - 1, 300), SEQ_REBOOT);
+  CHECK_EQ(_node().lastCounter, 5000 - DEDUP_REBOOT_GAP - 1);
+
+  // Counter advanced but uptime went backwards (counter kept in RTC memory)
+  uint32_t counter = _node().lastCounter;
+  CHECK_EQ(_see(counter + 1, 20), SEQ_REBOOT);
+  CHECK_EQ(_see(counter + 2, 80), SEQ_NEXT);
+  CHECK_EQ(_node().reboots, 3);
+
+  // No uptime on either frame: the counter alone decides
+  CHECK_EQ(_see(counter + 3, 0), SEQ_NEXT);
+}
+
+static void test_link_ewma_and_age()
+{
+  SensorSentinel_seq_init();
+  SensorSentinel_seq_observe(NODE, 1, 0, -80.0f, 8.0f, 1000);
+  SensorSentinel_seq_node_t node = _node(1000);
+  CHECK(node.rssi == -80.0f);
+  CHECK(node.snr == 8.0f);
+
+  SensorSentinel_seq_observe(NODE, 2, 0, -96.0f, 0.0f, 2000);
+  node = _node(7000);
+  CHECK(node.rssi == -82.0f);  // 1/8 of the way
+  CHECK(node.snr == 7.0f);
+  CHECK_EQ(node.ageMs, 5000);
+}
+
+static void test_many_nodes_and_json()
+{
+  SensorSentinel_seq_init();
+  for (uint32_t id = 1; id <= 40; id++)
+  {
+    CHECK_EQ(SensorSentinel_seq_observe(id, 7, 0, -90.0f, 2.0f, 0), SEQ_FIRST);
+  }
+  for (uint32_t id = 1; id <= 40; id++)
+  {
+    CHECK_EQ(SensorSentinel_seq_observe(id, 8, 0, -90.0f, 2.0f, 0), SEQ_NEXT);
+  }
+
+  // Pages of 16 cover every node once
+  char page[16 * 200];
+  uint32_t cursor = 0;
+  int pages = 0, records = 0;
+  while (cursor < SEQ_NODE_TABLE_SIZE)
+  {
+    size_t n = SensorSentinel_seq_format_json(page, sizeof(page), &cursor, 16, 3000);
+    CHECK(n >= 2 && page[0] == '[' && page[n - 1] == ']' && strlen(page) == n);
+    for (const char *p = page; (p = strstr(p, "\"nodeId\":")) != NULL; p++)
+    {
+      records++;
+    }
+    pages++;
+  }
+  CHECK_EQ(records, 40);
+  CHECK(pages >= 3);
+  cursor = 0;
+  SensorSentinel_seq_format_json(page, sizeof(page), &cursor, 1, 3000);
+  CHECK(strstr(page, "\"counter\":8,\"uptime\":0,\"ageSecs\":3,\"frames\":2,\"lost\":0") != NULL);
+
+  // A buffer with room for one record still makes progress
+  cursor = 0;
+  records = 0;
+  char small[200];
+  while (cursor < SEQ_NODE_TABLE_SIZE)
+  {
+    if (SensorSentinel_seq_format_json(small, sizeof(small), &cursor, 16, 0) > 2)
+    {
+      records++;
+    }
+  }
+  CHECK_EQ(records, 40);
+  CHECK_EQ(SensorSentinel_seq_format_json(small, 2, &cursor, 16, 0), 0);
+}
+
+TEST_MAIN(
+  TEST(test_next_and_gap),
+  TEST(test_late_and_repeat),
+  TEST(test_reboot),
+  TEST(test_link_ewma_and_age),
+  TEST(test_many_nodes_and_json)
+)
@@ -0,0 +1,70 @@
+/**
+ * @file test_common.h
+ * @brief Minimal check macros for the host unit tests
+ *
+ * Each test is a plain function; CHECK() reports a failure and carries on,
+ * so one run lists every broken expectation. TEST_MAIN() runs the listed
+ * functions and exits non-zero if any check failed, which is what ctest
+ * looks at.
+ */
+
+#ifndef SensorSentinel_TEST_COMMON_H
+#define SensorSentinel_TEST_COMMON_H
+
+#include <stdio.h>
+
+static int _testFailures = 0;
+static int _testChecks = 0;
+
+#define CHECK(cond)                                                          \
+  do                                                                         \
+  {                                                                          \
+    _testChecks++;                                                           \
+    if (!(cond))                                                             \
+    {                                                                        \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      _testFailures++;                                                       \
+    }                                                                        \
+  } while (0)
+
+#define CHECK_EQ(actual, expected)                                           \
+  do                                                                         \
+  {                                                                          \
+    _testChecks++;                                                           \
+    long long _a = (long long)(actual), _e = (long long)(expected);          \
+    if (_a != _e)                                                            \
+    {                                                                        \
+      fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, _a, _e); \
+      _testFailures++;                                                       \
+    }                                                                        \
+  } while (0)
+
+typedef void (*test_fn_t)();
+
+typedef struct {
+  const char *name;
+  test_fn_t fn;
+} test_case_t;
+
+#define TEST(fn) {#fn, fn}
+
+static int _test_run(const test_case_t *tests, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    int before = _testFailures;
+    tests[i].fn();
+    printf("%s %s\n", _testFailures == before ? "ok  " : "FAIL", tests[i].name);
+  }
+  printf("%d checks, %d failed\n", _testChecks, _testFailures);
+  return _testFailures == 0 ? 0 : 1;
+}
+
+#define TEST_MAIN(...)                                                       \
+  int main()                                                                 \
+  {                                                                          \
+    static const test_case_t tests[] = {__VA_ARGS__};                        \
+    return _test_run(tests, sizeof(tests) / sizeof(tests[0]));               \
+  }
+
+#endif // SensorSentinel_TEST_COMMON_H
@@ -0,0 +1,359 @@
+/**
+ * @file threshold_test.cpp
+ * @brief Unit tests for the batch threshold engine (threshold_engine.h)
+ *
+ * Every kernel this CPU supports is run on the same cases: the flow's
+ * rules at their boundaries, rounding of fractional thresholds,
+ * saturation, cleared and out-of-range slots, batch tails, and random
+ * tables checked against an independent model of the "Check Thresholds"
+ * function rather than against the scalar kernel.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+#include "threshold_engine.h"
+#include "test_common.h"
+
+static const threshold_isa_t _isas[] = {THRESHOLD_ISA_SCALAR, THRESHOLD_ISA_SSE2, THRESHOLD_ISA_AVX2,
+                                        THRESHOLD_ISA_NEON, THRESHOLD_ISA_BEST};
+
+// One device's rules as the flow holds them
+typedef struct {
+  bool hasLow[THRESHOLD_CHANNELS];
+  double low[THRESHOLD_CHANNELS];
+  bool hasHigh[THRESHOLD_CHANNELS];
+  double high[THRESHOLD_CHANNELS];
+  threshold_trigger_t trigger[THRESHOLD_DIGITAL_PINS];
+} _rules_t;
+
+// One frame as the flow sees it
+typedef struct {
+  uint32_t slot;
+  uint16_t lowValues[THRESHOLD_CHANNELS];
+  uint16_t highValues[THRESHOLD_CHANNELS];
+  uint8_t highBits;
+  uint8_t lowBits;
+} _frame_t;
+
+static threshold_alerts_t _model(const _rules_t *rules, const _frame_t *f)
+{
+  unsigned alerts = 0;
+  if (!rules)
+  {
+    return 0;
+  }
+  for (int pin = 0; pin < THRESHOLD_DIGITAL_PINS; pin++)
+  {
+    if ((rules->trigger[pin] == THRESHOLD_TRIGGER_HIGH && (f->highBits >> pin & 1)) ||
+        (rules->trigger[pin] == THRESHOLD_TRIGGER_LOW && !(f->lowBits >> pin & 1)))
+    {
+      alerts |= 1u << pin;
+    }
+  }
+  for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+  {
+    if (rules->hasLow[ch] && f->lowValues[ch] < rules->low[ch])
+    {
+      alerts |= THRESHOLD_LOW_BIT(ch);
+    }
+    else if (rules->hasHigh[ch] && f->highValues[ch] > rules->high[ch])
+    {
+      alerts |= THRESHOLD_HIGH_BIT(ch);
+    }
+  }
+  return (threshold_alerts_t)alerts;
+}
+
+static void _set(threshold_table_t *table, uint32_t slot, const _rules_t *rules)
+{
+  for (uint8_t ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+  {
+    threshold_table_set_analog(table, slot, ch, rules->hasLow[ch], rules->low[ch], rules->hasHigh[ch],
+                               rules->high[ch]);
+  }
+  for (uint8_t pin = 0; pin < THRESHOLD_DIGITAL_PINS; pin++)
+  {
+    threshold_table_set_digital(table, slot, pin, rules->trigger[pin]);
+  }
+}
+
+static void _add(threshold_batch_t *batch, const _frame_t *f)
+{
+  threshold_batch_add(batch, f->slot, f->lowValues, f->highValues, f->highBits, f->lowBits);
+}
+
+static _frame_t _reading(uint32_t slot, uint16_t a0, uint16_t a1, uint16_t a2, uint16_t a3, uint8_t digital)
+{
+  _frame_t f = {slot, {a0, a1, a2, a3}, {a0, a1, a2, a3}, digital, digital};
+  return f;
+}
+
+// Evaluates with every supported ISA; each must give expected
+static void _check_all(const threshold_table_t *table, const threshold_batch_t *batch,
+                       const std::vector<threshold_alerts_t> &expected)
+{
+  uint32_t expectedAlerting = 0;
+  for (threshold_alerts_t a : expected)
+  {
+    expectedAlerting += a != 0;
+  }
+  for (threshold_isa_t isa : _isas)
+  {
+    if (!threshold_isa_supported(isa))
+    {
+      continue;
+    }
+    // One spare entry after the batch must not be written
+    std::vector<threshold_alerts_t> alerts(batch->count + 1, 0xBEEF);
+    CHECK_EQ(threshold_evaluate(table, batch, alerts.data(), isa), expectedAlerting);
+    for (uint32_t i = 0; i < batch->count; i++)
+    {
+      if (alerts[i] != expected[i])
+      {
+        fprintf(stderr, "%s: frame %u alerts 0x%04X, expected 0x%04X\n", threshold_isa_name(isa), i, alerts[i],
+                expected[i]);
+      }
+      CHECK_EQ(alerts[i], expected[i]);
+    }
+    CHECK_EQ(alerts[batch->count], 0xBEEF);
+  }
+}
+
+static void test_digital_rules()
+{
+  threshold_table_t table;
+  threshold_table_resize(&table, 4);
+  threshold_table_set_digital(&table, 1, 0, THRESHOLD_TRIGGER_HIGH);
+  threshold_table_set_digital(&table, 1, 7, THRESHOLD_TRIGGER_LOW);
+  threshold_table_set_digital(&table, 2, 3, THRESHOLD_TRIGGER_HIGH);
+  threshold_table_set_digital(&table, 2, 3, THRESHOLD_TRIGGER_LOW);  // Replaces High
+  threshold_table_set_digital(&table, 3, 5, THRESHOLD_TRIGGER_HIGH);
+  threshold_table_set_digital(&table, 3, 5, THRESHOLD_TRIGGER_NONE);
+
+  threshold_batch_t batch;
+  _frame_t frames[] = {
+    _reading(1, 0, 0, 0, 0, 0x00),  // Pin 7 low
+    _reading(1, 0, 0, 0, 0, 0x81),  // Pin 0 high
+    _reading(1, 0, 0, 0, 0, 0x80),  // Neither
+    _reading(2, 0, 0, 0, 0, 0x08),
+    _reading(2, 0, 0, 0, 0, 0xF7),
+    _reading(3, 0, 0, 0, 0, 0xFF),
+    _reading(0, 0, 0, 0, 0, 0x00),  // No triggers
+  };
+  for (const _frame_t &f : frames)
+  {
+    _add(&batch, &f);
+  }
+
+  // Summary: High triggers look at digitalAny, Low ones at digitalAll
+  _frame_t summary = {1, {0}, {0}, 0x01, 0x00};
+  _add(&batch, &summary);
+  summary.highBits = 0x80;
+  summary.lowBits = 0x80;
+  _add(&batch, &summary);
+
+  _check_all(&table, &batch, {0x80, 0x01, 0x00, 0x00, 0x08, 0x00, 0x00, 0x81, 0x00});
+}
+
+static void test_analog_rules()
+{
+  threshold_table_t table;
+  threshold_table_resize(&table, 3);
+  threshold_table_set_analog(&table, 0, 0, true, 100, true, 200);
+  threshold_table_set_analog(&table, 0, 1, true, 100, false, 0);
+  threshold_table_set_analog(&table, 0, 2, false, 0, true, 200);
+  threshold_table_set_analog(&table, 0, 3, true, 4000, true, 50);  // Crossed: low wins
+
+  // Fractional thresholds round to the same comparison
+  threshold_table_set_analog(&table, 1, 0, true, 10.5, true, 20.5);
+  threshold_table_set_analog(&table, 1, 1, true, -0.5, true, -0.5);
+  // Beyond int16 saturates, which only matters past the ADC's range
+  threshold_table_set_analog(&table, 1, 2, true, 1e9, false, 0);
+  threshold_table_set_analog(&table, 1, 3, false, 0, true, 40000);
+  threshold_table_set_analog(&table, 2, 0, false, 0, true, -1e9);
+
+  threshold_batch_t batch;
+  _frame_t frames[] = {
+    _reading(0, 100, 100, 200, 4000, 0),  // Equal never alerts (but ch3 is above 50)
+    _reading(0, 99, 99, 201, 10, 0),
+    _reading(0, 201, 0, 0, 3999, 0),
+    _reading(0, 150, 65535, 65535, 4000, 0),
+    _reading(1, 10, 0, 0, 0, 0),
+    _reading(1, 11, 0, 4095, 4095, 0),
+    _reading(1, 20, 0, 0, 0, 0),
+    _reading(1, 21, 0, 4095, 0, 0),
+    _reading(2, 0, 0, 0, 0, 0),
+  };
+  for (const _frame_t &f : frames)
+  {
+    _add(&batch, &f);
+  }
+
+  // Summary: low checks the minimum, high the maximum; low still wins
+  _frame_t summary = {0, {100, 100, 0, 0}, {201, 200, 201, 0}, 0, 0};
+  _add(&batch, &summary);
+  summary.lowValues[0] = 99;
+  _add(&batch, &summary);
+
+  _check_all(&table, &batch,
+             {
+               THRESHOLD_HIGH_BIT(3),
+               THRESHOLD_LOW_BIT(0) | THRESHOLD_LOW_BIT(1) | THRESHOLD_HIGH_BIT(2) | THRESHOLD_LOW_BIT(3),
+               THRESHOLD_HIGH_BIT(0) | THRESHOLD_LOW_BIT(1) | THRESHOLD_LOW_BIT(3),
+               THRESHOLD_HIGH_BIT(2) | THRESHOLD_HIGH_BIT(3),
+               THRESHOLD_LOW_BIT(0) | THRESHOLD_HIGH_BIT(1) | THRESHOLD_LOW_BIT(2),
+               THRESHOLD_HIGH_BIT(1) | THRESHOLD_LOW_BIT(2),
+               THRESHOLD_HIGH_BIT(1) | THRESHOLD_LOW_BIT(2),
+               THRESHOLD_HIGH_BIT(0) | THRESHOLD_HIGH_BIT(1) | THRESHOLD_LOW_BIT(2),
+               THRESHOLD_HIGH_BIT(0),
+               THRESHOLD_HIGH_BIT(0) | THRESHOLD_HIGH_BIT(2) | THRESHOLD_LOW_BIT(3),
+               THRESHOLD_LOW_BIT(0) | THRESHOLD_HIGH_BIT(2) | THRESHOLD_LOW_BIT(3),
+             });
+}
+
+static void test_slots()
+{
+  threshold_table_t table;
+  threshold_batch_t batch;
+  _frame_t f = _reading(0, 0, 0, 0, 0, 0);
+
+  // A table that was never sized alerts for nobody
+  _add(&batch, &f);
+  _check_all(&table, &batch, {0});
+
+  threshold_table_resize(&table, 2);
+  threshold_table_set_analog(&table, 0, 0, true, 10, false, 0);
+  threshold_table_set_analog(&table, 1, 0, true, 10, false, 0);
+  threshold_table_set_digital(&table, 1, 2, THRESHOLD_TRIGGER_LOW);
+
+  // Out-of-range slots read the neutral entry
+  threshold_batch_clear(&batch);
+  const uint32_t slots[] = {0, 1, 2, 3, 1000000, UINT32_MAX};
+  for (uint32_t slot : slots)
+  {
+    f.slot = slot;
+    _add(&batch, &f);
+  }
+  _check_all(&table, &batch, {THRESHOLD_LOW_BIT(0), THRESHOLD_LOW_BIT(0) | 0x04, 0, 0, 0, 0});
+
+  // Cleared, shrunk and regrown slots never alert
+  threshold_table_clear(&table, 0);
+  threshold_table_resize(&table, 1);
+  threshold_table_resize(&table, 3);
+  _check_all(&table, &batch, {0, 0, 0, 0, 0, 0});
+
+  // Growing keeps the slots that were set
+  threshold_table_set_analog(&table, 2, 0, true, 10, false, 0);
+  threshold_table_resize(&table, 100);
+  _check_all(&table, &batch, {0, 0, THRESHOLD_LOW_BIT(0), 0, 0, 0});
+}
+
+static void test_batch_tails()
+{
+  threshold_table_t table;
+  threshold_table_resize(&table, 1);
+  threshold_table_set_analog(&table, 0, 1, false, 0, true, 1000);
+
+  // Every length around the vector step, so padding lanes are exercised
+  threshold_batch_t batch;
+  for (uint32_t count = 0; count <= 3 * THRESHOLD_LANES + 1; count++)
+  {
+    threshold_batch_clear(&batch);
+    std::vector<threshold_alerts_t> expected;
+    for (uint32_t i = 0; i < count; i++)
+    {
+      _frame_t f = _reading(0, 0, (uint16_t)(i % 3 == 0 ? 2000 : 500), 0, 0, 0);
+      _add(&batch, &f);
+      expected.push_back(i % 3 == 0 ? THRESHOLD_HIGH_BIT(1) : 0);
+    }
+    CHECK_EQ(batch.count, count);
+    CHECK_EQ(batch.slot.size() % THRESHOLD_LANES, 0);
+    _check_all(&table, &batch, expected);
+  }
+}
+
+static void test_random_against_model()
+{
+  std::mt19937 rng(2024);
+  std::uniform_int_distribution<int> coin(0, 3), trigger(0, 5), adc(0, 4095), wide(0, 65535), bit(0, 255);
+  std::uniform_real_distribution<double> limit(-100.0, 4200.0);
+  const uint32_t devices = 257;
+
+  threshold_table_t table;
+  threshold_table_resize(&table, devices);
+  std::vector<_rules_t> rules(devices);
+  for (uint32_t slot = 0; slot < devices; slot++)
+  {
+    _rules_t &r = rules[slot];
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      r.hasLow[ch] = coin(rng) < 2;
+      r.low[ch] = coin(rng) == 0 ? floor(limit(rng)) : limit(rng);
+      r.hasHigh[ch] = coin(rng) < 2;
+      r.high[ch] = coin(rng) == 0 ? floor(limit(rng)) : limit(rng);
+    }
+    for (int pin = 0; pin < THRESHOLD_DIGITAL_PINS; pin++)
+    {
+      int t = trigger(rng);
+      r.trigger[pin] = t == 0 ? THRESHOLD_TRIGGER_HIGH : t == 1 ? THRESHOLD_TRIGGER_LOW : THRESHOLD_TRIGGER_NONE;
+    }
+    _set(&table, slot, &r);
+  }
+
+  threshold_batch_t batch;
+  std::vector<threshold_alerts_t> expected;
+  for (int i = 0; i < 4093; i++)
+  {
+    _frame_t f;
+    f.slot = coin(rng) == 0 ? devices + (uint32_t)wide(rng) : (uint32_t)(wide(rng) % devices);
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      uint16_t a = (uint16_t)(coin(rng) == 0 ? wide(rng) : adc(rng));
+      uint16_t b = (uint16_t)(coin(rng) == 0 ? a : adc(rng));
+      f.lowValues[ch] = a < b ? a : b;
+      f.highValues[ch] = a < b ? b : a;
+    }
+    f.highBits = (uint8_t)bit(rng);
+    f.lowBits = coin(rng) == 0 ? f.highBits : (uint8_t)(f.highBits & bit(rng));
+    _add(&batch, &f);
+    expected.push_back(_model(f.slot < devices ? &rules[f.slot] : NULL, &f));
+  }
+  _check_all(&table, &batch, expected);
+}
+
+static void test_isa_names()
+{
+  CHECK(threshold_isa_supported(THRESHOLD_ISA_SCALAR));
+  threshold_isa_t best = threshold_isa_resolve(THRESHOLD_ISA_BEST);
+  CHECK(best != THRESHOLD_ISA_BEST && threshold_isa_supported(best));
+  CHECK_EQ(threshold_isa_resolve(THRESHOLD_ISA_SSE2), THRESHOLD_ISA_SSE2);
+  CHECK(strcmp(threshold_isa_name(THRESHOLD_ISA_SCALAR), "scalar") == 0);
+  CHECK(strcmp(threshold_isa_name(THRESHOLD_ISA_AVX2), "avx2") == 0);
+  CHECK(strcmp(threshold_isa_name(THRESHOLD_ISA_BEST), "best") == 0);
+
+  // Unsupported ISAs fall back to scalar and still give the right answer
+  threshold_table_t table;
+  threshold_table_resize(&table, 1);
+  threshold_table_set_digital(&table, 0, 1, THRESHOLD_TRIGGER_HIGH);
+  threshold_batch_t batch;
+  _frame_t f = _reading(0, 0, 0, 0, 0, 0x02);
+  _add(&batch, &f);
+  for (threshold_isa_t isa : _isas)
+  {
+    threshold_alerts_t alerts = 0;
+    CHECK_EQ(threshold_evaluate(&table, &batch, &alerts, isa), 1);
+    CHECK_EQ(alerts, 0x02);
+  }
+}
+
+TEST_MAIN(
+  TEST(test_digital_rules),
+  TEST(test_analog_rules),
+  TEST(test_slots),
+  TEST(test_batch_tails),
+  TEST(test_random_against_model),
+  TEST(test_isa_names)
+)
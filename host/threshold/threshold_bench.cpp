@@ -0,0 +1,137 @@
+/**
+ * @file threshold_bench.cpp
+ * @brief threshold_bench: frames/second of threshold_evaluate() per ISA
+ *
+ *   threshold_bench [devices...]      (default: 10000 100000)
+ *
+ * Each device gets random thresholds and triggers; batches of BENCH_BATCH
+ * frames come from random devices (the gateway-interleaved case) or from
+ * consecutive ones. Every ISA's alert masks are checked against the scalar
+ * kernel's before it is timed; a mismatch exits with status 1.
+ */
+
+#include "threshold_engine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+
+#define BENCH_BATCH   4096    // Frames per threshold_evaluate() call
+#define BENCH_MIN_MS  300     // Time each case for at least this long
+
+static double _now_ms()
+{
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void _fill_table(threshold_table_t *table, uint32_t devices, std::mt19937 &rng)
+{
+  threshold_table_resize(table, devices);
+  std::uniform_int_distribution<int> low(0, 400), high(3700, 4095), coin(0, 3), trigger(0, 7);
+  for (uint32_t slot = 0; slot < devices; slot++)
+  {
+    // About half the channels have each threshold and a quarter of the pins
+    // a trigger, with limits near the ends of the ADC range
+    for (uint8_t ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      threshold_table_set_analog(table, slot, ch, coin(rng) < 2, low(rng), coin(rng) < 2, high(rng));
+    }
+    for (uint8_t pin = 0; pin < THRESHOLD_DIGITAL_PINS; pin++)
+    {
+      int t = trigger(rng);
+      threshold_table_set_digital(table, slot, pin,
+                                  t == 0 ? THRESHOLD_TRIGGER_HIGH : t == 1 ? THRESHOLD_TRIGGER_LOW : THRESHOLD_TRIGGER_NONE);
+    }
+  }
+}
+
+static void _fill_batch(threshold_batch_t *batch, uint32_t devices, bool random, std::mt19937 &rng)
+{
+  threshold_batch_clear(batch);
+  std::uniform_int_distribution<uint32_t> slot(0, devices - 1);
+  std::uniform_int_distribution<int> adc(0, 4095), bit(0, 31);
+  uint32_t next = slot(rng);
+  for (int i = 0; i < BENCH_BATCH; i++)
+  {
+    uint16_t values[THRESHOLD_CHANNELS];
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      values[ch] = (uint16_t)adc(rng);
+    }
+    // Digital inputs mostly idle low, each pin occasionally high
+    uint8_t digital = 0;
+    for (int pin = 0; pin < THRESHOLD_DIGITAL_PINS; pin++)
+    {
+      digital |= (bit(rng) == 0) << pin;
+    }
+    threshold_batch_add(batch, random ? slot(rng) : next, values, values, digital, digital);
+    next = (next + 1) % devices;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<uint32_t> deviceCounts;
+  for (int i = 1; i < argc; i++)
+  {
+    deviceCounts.push_back((uint32_t)strtoul(argv[i], NULL, 10));
+  }
+  if (deviceCounts.empty())
+  {
+    deviceCounts = {10000, 100000};
+  }
+
+  const threshold_isa_t isas[] = {THRESHOLD_ISA_SCALAR, THRESHOLD_ISA_SSE2, THRESHOLD_ISA_AVX2, THRESHOLD_ISA_NEON};
+  std::mt19937 rng(12345);
+  threshold_table_t table;
+  threshold_batch_t batch;
+  std::vector<threshold_alerts_t> expected(BENCH_BATCH), alerts(BENCH_BATCH);
+
+  printf("%-8s %-10s %-7s %14s %9s\n", "devices", "order", "isa", "frames/s", "alerting");
+  for (uint32_t devices : deviceCounts)
+  {
+    if (devices == 0)
+    {
+      continue;
+    }
+    _fill_table(&table, devices, rng);
+    for (bool random : {true, false})
+    {
+      _fill_batch(&batch, devices, random, rng);
+      uint32_t alerting = threshold_evaluate(&table, &batch, expected.data(), THRESHOLD_ISA_SCALAR);
+
+      for (threshold_isa_t isa : isas)
+      {
+        if (!threshold_isa_supported(isa))
+        {
+          continue;
+        }
+        threshold_evaluate(&table, &batch, alerts.data(), isa);
+        if (memcmp(alerts.data(), expected.data(), BENCH_BATCH * sizeof(alerts[0])) != 0)
+        {
+          fprintf(stderr, "%s alert masks differ from scalar\n", threshold_isa_name(isa));
+          return 1;
+        }
+
+        uint64_t frames = 0;
+        double start = _now_ms(), elapsed;
+        do
+        {
+          for (int rep = 0; rep < 16; rep++)
+          {
+            threshold_evaluate(&table, &batch, alerts.data(), isa);
+          }
+          frames += 16 * BENCH_BATCH;
+          elapsed = _now_ms() - start;
+        } while (elapsed < BENCH_MIN_MS);
+
+        printf("%-8u %-10s %-7s %14.0f %8.1f%%\n", devices, random ? "random" : "sequential",
+               threshold_isa_name(isa), frames / (elapsed / 1000.0), 100.0 * alerting / BENCH_BATCH);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,376 @@
+/**
+ * @file threshold_engine.cpp
+ * @brief Threshold table, batches and the scalar/SSE2/AVX2/NEON kernels
+ */
+
+#include "threshold_engine.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define THRESHOLD_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define THRESHOLD_ARM 1
+#include <arm_neon.h>
+#endif
+
+// ── Table ─────────────────────────────────────────────────────────────────────
+
+void threshold_table_resize(threshold_table_t *table, uint32_t slots)
+{
+  // Two entries past the last slot: a neutral one for out-of-range slots
+  // and a spare, since 32-bit gathers read a neighbour
+  for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+  {
+    table->low[ch].resize(slots + 2, INT16_MIN);
+    table->high[ch].resize(slots + 2, INT16_MAX);
+  }
+  table->highMask.resize(slots + 2, 0);
+  table->lowMask.resize(slots + 2, 0);
+  uint32_t old = table->slots;
+  table->slots = slots;
+  for (uint32_t slot = slots < old ? slots : old; slot < slots + 2; slot++)
+  {
+    threshold_table_clear(table, slot);
+  }
+}
+
+void threshold_table_clear(threshold_table_t *table, uint32_t slot)
+{
+  for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+  {
+    table->low[ch][slot] = INT16_MIN;
+    table->high[ch][slot] = INT16_MAX;
+  }
+  table->highMask[slot] = 0;
+  table->lowMask[slot] = 0;
+}
+
+static int16_t _saturate(double value)
+{
+  return value <= INT16_MIN ? INT16_MIN : value >= INT16_MAX ? INT16_MAX : (int16_t)value;
+}
+
+void threshold_table_set_analog(threshold_table_t *table, uint32_t slot, uint8_t channel, bool hasLow, double low,
+                                bool hasHigh, double high)
+{
+  // For integer readings, v < low is v < ceil(low) and v > high is v > floor(high)
+  table->low[channel][slot] = hasLow ? _saturate(ceil(low)) : INT16_MIN;
+  table->high[channel][slot] = hasHigh ? _saturate(floor(high)) : INT16_MAX;
+}
+
+void threshold_table_set_digital(threshold_table_t *table, uint32_t slot, uint8_t pin, threshold_trigger_t trigger)
+{
+  uint16_t bit = (uint16_t)(1u << pin);
+  table->highMask[slot] &= ~bit;
+  table->lowMask[slot] &= ~bit;
+  if (trigger == THRESHOLD_TRIGGER_HIGH)
+  {
+    table->highMask[slot] |= bit;
+  }
+  else if (trigger == THRESHOLD_TRIGGER_LOW)
+  {
+    table->lowMask[slot] |= bit;
+  }
+}
+
+// ── Batch ─────────────────────────────────────────────────────────────────────
+
+void threshold_batch_clear(threshold_batch_t *batch)
+{
+  batch->count = 0;
+}
+
+uint32_t threshold_batch_add(threshold_batch_t *batch, uint32_t slot, const uint16_t *lowValues,
+                             const uint16_t *highValues, uint8_t highBits, uint8_t lowBits)
+{
+  uint32_t i = batch->count;
+  if (i == batch->slot.size())
+  {
+    // Grow a whole vector step at a time so kernels can always load full lanes
+    size_t size = i + THRESHOLD_LANES;
+    batch->slot.resize(size, UINT32_MAX);
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      batch->lowValue[ch].resize(size, 0);
+      batch->highValue[ch].resize(size, 0);
+    }
+    batch->highBits.resize(size, 0);
+    batch->lowBits.resize(size, 0);
+  }
+
+  batch->slot[i] = slot;
+  for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+  {
+    batch->lowValue[ch][i] = (int16_t)(lowValues[ch] > INT16_MAX ? INT16_MAX : lowValues[ch]);
+    batch->highValue[ch][i] = (int16_t)(highValues[ch] > INT16_MAX ? INT16_MAX : highValues[ch]);
+  }
+  batch->highBits[i] = highBits;
+  batch->lowBits[i] = lowBits;
+  batch->count = i + 1;
+  return i;
+}
+
+// ── Kernels ───────────────────────────────────────────────────────────────────
+
+// Thresholds of one vector step's devices, in lane order
+typedef struct {
+  alignas(32) int16_t low[THRESHOLD_CHANNELS][THRESHOLD_LANES];
+  alignas(32) int16_t high[THRESHOLD_CHANNELS][THRESHOLD_LANES];
+  alignas(32) uint16_t highMask[THRESHOLD_LANES];
+  alignas(32) uint16_t lowMask[THRESHOLD_LANES];
+} threshold_lanes_t;
+
+typedef void (*threshold_kernel_t)(const threshold_lanes_t *t, const threshold_batch_t *b, size_t i,
+                                   threshold_alerts_t *out);
+
+// Each lane's device is different, so this is a gather whatever the ISA.
+// Out-of-range slots (and batch padding) read the neutral entry at
+// table->slots.
+static void _gather(const threshold_table_t *table, const threshold_batch_t *b, size_t i, threshold_lanes_t *t)
+{
+  for (int lane = 0; lane < THRESHOLD_LANES; lane++)
+  {
+    uint32_t slot = b->slot[i + lane] < table->slots ? b->slot[i + lane] : table->slots;
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      t->low[ch][lane] = table->low[ch][slot];
+      t->high[ch][lane] = table->high[ch][slot];
+    }
+    t->highMask[lane] = table->highMask[slot];
+    t->lowMask[lane] = table->lowMask[slot];
+  }
+}
+
+static void _kernel_scalar(const threshold_lanes_t *t, const threshold_batch_t *b, size_t i,
+                           threshold_alerts_t *out)
+{
+  for (int lane = 0; lane < THRESHOLD_LANES; lane++)
+  {
+    size_t f = i + lane;
+    unsigned alerts = (b->highBits[f] & t->highMask[lane]) | (~b->lowBits[f] & t->lowMask[lane]);
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      if (b->lowValue[ch][f] < t->low[ch][lane])
+      {
+        alerts |= THRESHOLD_LOW_BIT(ch);
+      }
+      else if (b->highValue[ch][f] > t->high[ch][lane])
+      {
+        alerts |= THRESHOLD_HIGH_BIT(ch);
+      }
+    }
+    out[lane] = (threshold_alerts_t)alerts;
+  }
+}
+
+#if THRESHOLD_X86
+static void _kernel_sse2(const threshold_lanes_t *t, const threshold_batch_t *b, size_t i, threshold_alerts_t *out)
+{
+  for (int half = 0; half < THRESHOLD_LANES; half += 8)
+  {
+    size_t f = i + half;
+    __m128i hb = _mm_loadu_si128((const __m128i *)&b->highBits[f]);
+    __m128i lb = _mm_loadu_si128((const __m128i *)&b->lowBits[f]);
+    __m128i hm = _mm_load_si128((const __m128i *)&t->highMask[half]);
+    __m128i lm = _mm_load_si128((const __m128i *)&t->lowMask[half]);
+    __m128i acc = _mm_or_si128(_mm_and_si128(hb, hm), _mm_andnot_si128(lb, lm));
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      __m128i lv = _mm_loadu_si128((const __m128i *)&b->lowValue[ch][f]);
+      __m128i hv = _mm_loadu_si128((const __m128i *)&b->highValue[ch][f]);
+      __m128i isLow = _mm_cmplt_epi16(lv, _mm_load_si128((const __m128i *)&t->low[ch][half]));
+      __m128i isHigh = _mm_andnot_si128(isLow, _mm_cmpgt_epi16(hv, _mm_load_si128((const __m128i *)&t->high[ch][half])));
+      acc = _mm_or_si128(acc, _mm_and_si128(isLow, _mm_set1_epi16((short)THRESHOLD_LOW_BIT(ch))));
+      acc = _mm_or_si128(acc, _mm_and_si128(isHigh, _mm_set1_epi16((short)THRESHOLD_HIGH_BIT(ch))));
+    }
+    _mm_storeu_si128((__m128i *)&out[half], acc);
+  }
+}
+
+// 16 int16 table entries by slot: two 32-bit gathers at 2-byte scale, low halves kept
+__attribute__((target("avx2")))
+static inline __m256i _gather16(const void *base, __m256i slotsLo, __m256i slotsHi)
+{
+  const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+  __m256i a = _mm256_and_si256(_mm256_i32gather_epi32((const int *)base, slotsLo, 2), low16);
+  __m256i b = _mm256_and_si256(_mm256_i32gather_epi32((const int *)base, slotsHi, 2), low16);
+  return _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+}
+
+// AVX2 loads the thresholds with hardware gathers instead of the lane buffer
+__attribute__((target("avx2")))
+static uint32_t _evaluate_avx2(const threshold_table_t *table, const threshold_batch_t *b,
+                                      threshold_alerts_t *alerts)
+{
+  const __m256i last = _mm256_set1_epi32((int)table->slots);
+  alignas(32) threshold_alerts_t out[THRESHOLD_LANES];
+  uint32_t alerting = 0;
+
+  for (size_t i = 0; i < b->count; i += THRESHOLD_LANES)
+  {
+    __m256i slotsLo = _mm256_min_epu32(_mm256_loadu_si256((const __m256i *)&b->slot[i]), last);
+    __m256i slotsHi = _mm256_min_epu32(_mm256_loadu_si256((const __m256i *)&b->slot[i + 8]), last);
+
+    __m256i hb = _mm256_loadu_si256((const __m256i *)&b->highBits[i]);
+    __m256i lb = _mm256_loadu_si256((const __m256i *)&b->lowBits[i]);
+    __m256i hm = _gather16(table->highMask.data(), slotsLo, slotsHi);
+    __m256i lm = _gather16(table->lowMask.data(), slotsLo, slotsHi);
+    __m256i acc = _mm256_or_si256(_mm256_and_si256(hb, hm), _mm256_andnot_si256(lb, lm));
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      __m256i lv = _mm256_loadu_si256((const __m256i *)&b->lowValue[ch][i]);
+      __m256i hv = _mm256_loadu_si256((const __m256i *)&b->highValue[ch][i]);
+      __m256i isLow = _mm256_cmpgt_epi16(_gather16(table->low[ch].data(), slotsLo, slotsHi), lv);
+      __m256i isHigh = _mm256_andnot_si256(isLow, _mm256_cmpgt_epi16(hv, _gather16(table->high[ch].data(), slotsLo, slotsHi)));
+      acc = _mm256_or_si256(acc, _mm256_and_si256(isLow, _mm256_set1_epi16((short)THRESHOLD_LOW_BIT(ch))));
+      acc = _mm256_or_si256(acc, _mm256_and_si256(isHigh, _mm256_set1_epi16((short)THRESHOLD_HIGH_BIT(ch))));
+    }
+    _mm256_store_si256((__m256i *)out, acc);
+
+    size_t n = b->count - i < THRESHOLD_LANES ? b->count - i : THRESHOLD_LANES;
+    memcpy(&alerts[i], out, n * sizeof(out[0]));
+    for (size_t lane = 0; lane < n; lane++)
+    {
+      alerting += out[lane] != 0;
+    }
+  }
+  return alerting;
+}
+#endif // THRESHOLD_X86
+
+#if THRESHOLD_ARM
+static void _kernel_neon(const threshold_lanes_t *t, const threshold_batch_t *b, size_t i, threshold_alerts_t *out)
+{
+  for (int half = 0; half < THRESHOLD_LANES; half += 8)
+  {
+    size_t f = i + half;
+    uint16x8_t hb = vld1q_u16(&b->highBits[f]);
+    uint16x8_t lb = vld1q_u16(&b->lowBits[f]);
+    uint16x8_t acc = vorrq_u16(vandq_u16(hb, vld1q_u16(&t->highMask[half])), vbicq_u16(vld1q_u16(&t->lowMask[half]), lb));
+    for (int ch = 0; ch < THRESHOLD_CHANNELS; ch++)
+    {
+      uint16x8_t isLow = vcltq_s16(vld1q_s16(&b->lowValue[ch][f]), vld1q_s16(&t->low[ch][half]));
+      uint16x8_t isHigh = vbicq_u16(vcgtq_s16(vld1q_s16(&b->highValue[ch][f]), vld1q_s16(&t->high[ch][half])), isLow);
+      acc = vorrq_u16(acc, vandq_u16(isLow, vdupq_n_u16(THRESHOLD_LOW_BIT(ch))));
+      acc = vorrq_u16(acc, vandq_u16(isHigh, vdupq_n_u16(THRESHOLD_HIGH_BIT(ch))));
+    }
+    vst1q_u16(&out[half], acc);
+  }
+}
+#endif // THRESHOLD_ARM
+
+// ── API ───────────────────────────────────────────────────────────────────────
+
+bool threshold_isa_supported(threshold_isa_t isa)
+{
+  switch (isa)
+  {
+  case THRESHOLD_ISA_SCALAR:
+  case THRESHOLD_ISA_BEST:
+    return true;
+#if THRESHOLD_X86
+  case THRESHOLD_ISA_SSE2:
+    return true;  // Baseline on x86-64
+  case THRESHOLD_ISA_AVX2:
+  {
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return avx2;
+  }
+#endif
+#if THRESHOLD_ARM
+  case THRESHOLD_ISA_NEON:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+threshold_isa_t threshold_isa_resolve(threshold_isa_t isa)
+{
+  if (isa != THRESHOLD_ISA_BEST)
+  {
+    return isa;
+  }
+  if (threshold_isa_supported(THRESHOLD_ISA_AVX2))
+  {
+    return THRESHOLD_ISA_AVX2;
+  }
+  if (threshold_isa_supported(THRESHOLD_ISA_SSE2))
+  {
+    return THRESHOLD_ISA_SSE2;
+  }
+  if (threshold_isa_supported(THRESHOLD_ISA_NEON))
+  {
+    return THRESHOLD_ISA_NEON;
+  }
+  return THRESHOLD_ISA_SCALAR;
+}
+
+const char *threshold_isa_name(threshold_isa_t isa)
+{
+  switch (isa)
+  {
+  case THRESHOLD_ISA_SCALAR: return "scalar";
+  case THRESHOLD_ISA_SSE2:   return "sse2";
+  case THRESHOLD_ISA_AVX2:   return "avx2";
+  case THRESHOLD_ISA_NEON:   return "neon";
+  default:                   return "best";
+  }
+}
+
+static threshold_kernel_t _kernel(threshold_isa_t isa)
+{
+  isa = threshold_isa_resolve(isa);
+  if (!threshold_isa_supported(isa))
+  {
+    return _kernel_scalar;
+  }
+  switch (isa)
+  {
+#if THRESHOLD_X86
+  case THRESHOLD_ISA_SSE2: return _kernel_sse2;
+#endif
+#if THRESHOLD_ARM
+  case THRESHOLD_ISA_NEON: return _kernel_neon;
+#endif
+  default:                 return _kernel_scalar;
+  }
+}
+
+uint32_t threshold_evaluate(const threshold_table_t *table, const threshold_batch_t *batch,
+                            threshold_alerts_t *alerts, threshold_isa_t isa)
+{
+  if (table->highMask.empty())
+  {
+    memset(alerts, 0, batch->count * sizeof(alerts[0]));  // Never sized: no device has thresholds
+    return 0;
+  }
+#if THRESHOLD_X86
+  if (threshold_isa_resolve(isa) == THRESHOLD_ISA_AVX2 && threshold_isa_supported(THRESHOLD_ISA_AVX2))
+  {
+    return _evaluate_avx2(table, batch, alerts);
+  }
+#endif
+  threshold_kernel_t kernel = _kernel(isa);
+  threshold_lanes_t lanes;
+  alignas(32) threshold_alerts_t out[THRESHOLD_LANES];
+  uint32_t alerting = 0;
+
+  for (size_t i = 0; i < batch->count; i += THRESHOLD_LANES)
+  {
+    _gather(table, batch, i, &lanes);
+    kernel(&lanes, batch, i, out);
+
+    size_t n = batch->count - i < THRESHOLD_LANES ? batch->count - i : THRESHOLD_LANES;
+    memcpy(&alerts[i], out, n * sizeof(out[0]));
+    for (size_t lane = 0; lane < n; lane++)
+    {
+      alerting += out[lane] != 0;
+    }
+  }
+  return alerting;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file threshold_engine.h
+ * @brief Batch threshold checks for many devices, vectorised
+ *
+ * The rules are those of the Node-RED "Check Thresholds" function, for
+ * every frame of a batch at once:
+ *
+ *   - digital pin with trigger High: alert if its bit is set
+ *   - digital pin with trigger Low:  alert if its bit is clear
+ *   - analog channel: alert if below its low threshold, otherwise if above
+ *     its high threshold
+ *
+ * Thresholds live in a table with one slot per device, stored as
+ * structure-of-arrays (one int16 array per channel for low and high, one
+ * array each for the High and Low trigger masks). A batch is also SoA: the
+ * device slot, the values checked against low and against high (the same
+ * for a plain reading; min and max for an aggregate summary) and the bits
+ * checked against High and Low triggers (digitalAny and digitalAll for a
+ * summary).
+ *
+ * threshold_evaluate() processes THRESHOLD_LANES frames at a time: the
+ * thresholds of their devices are gathered into lane order (AVX2 uses its
+ * gather instructions, the others scalar loads), then compared with AVX2,
+ * SSE2 or NEON where available, or a scalar loop otherwise. Each frame
+ * yields one threshold_alerts_t bitmask.
+ *
+ * Values and thresholds are int16: readings saturate at 32767, which the
+ * 12-bit ADC never reaches.
+ */
+
+#ifndef THRESHOLD_ENGINE_H
+#define THRESHOLD_ENGINE_H
+
+#include <stdint.h>
+#include <vector>
+
+#define THRESHOLD_CHANNELS      4
+#define THRESHOLD_DIGITAL_PINS  8
+#define THRESHOLD_LANES         16      // Frames per vector step (one AVX2 register of int16)
+
+// threshold_alerts_t layout
+#define THRESHOLD_DIGITAL_MASK  0x00FF  // Bit n: digital pin n at its trigger level
+#define THRESHOLD_LOW_SHIFT     8       // Bits 8..11: analog channel below its low threshold
+#define THRESHOLD_HIGH_SHIFT    12      // Bits 12..15: analog channel above its high threshold
+
+#define THRESHOLD_LOW_BIT(ch)   (1u << (THRESHOLD_LOW_SHIFT + (ch)))
+#define THRESHOLD_HIGH_BIT(ch)  (1u << (THRESHOLD_HIGH_SHIFT + (ch)))
+
+typedef uint16_t threshold_alerts_t;
+
+typedef enum {
+  THRESHOLD_TRIGGER_NONE,
+  THRESHOLD_TRIGGER_HIGH,
+  THRESHOLD_TRIGGER_LOW
+} threshold_trigger_t;
+
+typedef enum {
+  THRESHOLD_ISA_SCALAR,
+  THRESHOLD_ISA_SSE2,
+  THRESHOLD_ISA_AVX2,
+  THRESHOLD_ISA_NEON,
+  THRESHOLD_ISA_BEST      // The fastest this CPU supports
+} threshold_isa_t;
+
+/**
+ * @brief Per-device thresholds, one slot per device
+ *
+ * A cleared slot never alerts: low is INT16_MIN, high is INT16_MAX and
+ * both trigger masks are empty.
+ */
+typedef struct {
+  uint32_t slots = 0;
+  std::vector<int16_t> low[THRESHOLD_CHANNELS];    // Alert when value < low
+  std::vector<int16_t> high[THRESHOLD_CHANNELS];   // Alert when value > high
+  std::vector<uint16_t> highMask;                  // Pins with trigger High (low byte)
+  std::vector<uint16_t> lowMask;                   // Pins with trigger Low (low byte)
+} threshold_table_t;
+
+/**
+ * @brief Frames to evaluate, in SoA form
+ *
+ * Arrays are padded to a multiple of THRESHOLD_LANES.
+ */
+typedef struct {
+  uint32_t count = 0;
+  std::vector<uint32_t> slot;
+  std::vector<int16_t> lowValue[THRESHOLD_CHANNELS];   // Checked against low (summary: min)
+  std::vector<int16_t> highValue[THRESHOLD_CHANNELS];  // Checked against high (summary: max)
+  std::vector<uint16_t> highBits;                      // Checked against High triggers (summary: digitalAny)
+  std::vector<uint16_t> lowBits;                       // Checked against Low triggers (summary: digitalAll)
+} threshold_batch_t;
+
+/**
+ * @brief Size the table; new slots are cleared
+ */
+void threshold_table_resize(threshold_table_t *table, uint32_t slots);
+
+/**
+ * @brief Clear a slot so it never alerts
+ */
+void threshold_table_clear(threshold_table_t *table, uint32_t slot);
+
+/**
+ * @brief Set an analog channel's thresholds
+ * @param hasLow false for no low threshold (likewise hasHigh)
+ *
+ * Fractional thresholds are rounded so that the integer comparison matches
+ * the flow's "value < low" and "value > high".
+ */
+void threshold_table_set_analog(threshold_table_t *table, uint32_t slot, uint8_t channel, bool hasLow, double low,
+                                bool hasHigh, double high);
+
+/**
+ * @brief Set a digital pin's trigger
+ */
+void threshold_table_set_digital(threshold_table_t *table, uint32_t slot, uint8_t pin, threshold_trigger_t trigger);
+
+/**
+ * @brief Empty a batch, keeping its storage
+ */
+void threshold_batch_clear(threshold_batch_t *batch);
+
+/**
+ * @brief Append a frame
+ * @param slot Device slot in the table
+ * @param lowValues Values checked against the low thresholds
+ * @param highValues Values checked against the high thresholds
+ * @param highBits Digital bits checked against High triggers
+ * @param lowBits Digital bits checked against Low triggers
+ * @return Index of the frame in the batch
+ */
+uint32_t threshold_batch_add(threshold_batch_t *batch, uint32_t slot, const uint16_t *lowValues,
+                             const uint16_t *highValues, uint8_t highBits, uint8_t lowBits);
+
+/**
+ * @brief Evaluate every frame of a batch
+ * @param alerts One bitmask per frame (batch->count entries)
+ * @param isa Implementation to use; an unsupported one falls back to scalar
+ * @return Number of frames with at least one alert
+ */
+uint32_t threshold_evaluate(const threshold_table_t *table, const threshold_batch_t *batch,
+                            threshold_alerts_t *alerts, threshold_isa_t isa = THRESHOLD_ISA_BEST);
+
+/**
+ * @brief Whether this CPU can run an implementation
+ */
+bool threshold_isa_supported(threshold_isa_t isa);
+
+/**
+ * @brief Resolve THRESHOLD_ISA_BEST (other values are returned as they are)
+ */
+threshold_isa_t threshold_isa_resolve(threshold_isa_t isa);
+
+/**
+ * @brief "scalar", "sse2", "avx2" or "neon"
+ */
+const char *threshold_isa_name(threshold_isa_t isa);
+
+#endif // THRESHOLD_ENGINE_H
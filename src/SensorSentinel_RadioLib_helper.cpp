@@ -4,22 +4,87 @@
  */
 
 #include "SensorSentinel_RadioLib_helper.h"
+#include "SensorSentinel_metrics_helper.h"
+#include "SensorSentinel_lbt_helper.h"
+#include <atomic>
 
 // Packet subscription system
 PacketCallback _packetCallback = NULL;
 BinaryPacketCallback _binaryPacketCallback = NULL;
-volatile bool _packetReceived = false;
 String _packetData;
-uint8_t _binaryPacketBuffer[256]; // Buffer for binary packet data
-size_t _binaryPacketLength = 0;
-float _packetRssi;
-float _packetSnr;
+
+// Receive slot pool. Slot indices travel through two single-producer /
+// single-consumer rings: _rxReady (radio service -> consumer) carries filled
+// slots, _rxFree (consumer -> radio service) returns them. Indices run
+// freely and are masked on access, so head - tail is the depth.
+static_assert((SensorSentinel_RX_RING_SIZE & (SensorSentinel_RX_RING_SIZE - 1)) == 0,
+              "SensorSentinel_RX_RING_SIZE must be a power of two");
+static SensorSentinel_rx_slot_t _rxPool[SensorSentinel_RX_RING_SIZE];
+static SensorSentinel_rx_slot_t *_currentSlot = NULL;  // Slot inside _dispatch_slot()
+static uint8_t _rxReady[SensorSentinel_RX_RING_SIZE];
+static std::atomic<uint32_t> _rxHead(0);  // Written only by the producer
+static std::atomic<uint32_t> _rxTail(0);  // Written only by the consumer
+static uint8_t _rxFree[SensorSentinel_RX_RING_SIZE];
+static std::atomic<uint32_t> _rxFreeHead(0);  // Written only by the consumer
+static std::atomic<uint32_t> _rxFreeTail(0);  // Written only by the producer
+static uint32_t _rxFresh = 0;                 // Slots never handed out yet (producer only)
+static SensorSentinel_rx_slot_t *_rxSpare = NULL;  // Allocated but unused after a read error
+static volatile uint32_t _rxIrqMillis = 0;
+static std::atomic<uint32_t> _rxIrqCount(0);  // RX-done interrupts not yet read; taken with exchange()
+static SensorSentinel_rx_stats_t _rxStats = {};
+static TaskHandle_t _rxNotifyTask = NULL;
+
+// Transmit queue: filled by any task, drained by the radio owner
+typedef struct {
+  uint8_t  data[MAX_LORA_PACKET_SIZE];
+  size_t   length;
+  uint8_t  priority;
+  uint32_t dueMillis;
+  uint32_t airtimeMs;
+  uint32_t seq;       // Enqueue order, used as the final tie-break
+  uint32_t tag;       // For SensorSentinel_tx_cancel(); 0 = none
+  uint8_t  attempts;  // Busy CAD checks so far
+  bool     used;
+} TxQueueEntry;
+
+static TxQueueEntry _txQueue[SensorSentinel_TX_QUEUE_SIZE];
+static portMUX_TYPE _txMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t _txSeq = 0;
+static TxQueueEntry _txFrame;                 // Frame currently on air
+static volatile bool _txActive = false;
+static volatile bool _txDone = false;
+static volatile bool _cadActive = false;      // scanChannel() polls DIO1 itself
+static uint32_t _txStartMillis = 0;
+static SensorSentinel_tx_stats_t _txStats = {};
+static SensorSentinel_tx_done_callback_t _txDoneCallback = NULL;
 
 // ====== Internal helper functions ======
 // Interrupt handler for packet reception
-void _handleLoRaRx()
+void IRAM_ATTR _handleLoRaRx()
 {
-  _packetReceived = true;
+  // CAD-done: not a frame
+  if (_cadActive)
+  {
+    return;
+  }
+
+  // DIO1 signals TX-done while a queued frame is on air, RX-done otherwise
+  if (_txActive)
+  {
+    _txDone = true;
+  }
+  else
+  {
+    _rxIrqMillis = millis();
+    _rxIrqCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (_rxNotifyTask)
+  {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(_rxNotifyTask, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
 }
 
 // ====== Radio functions ======
@@ -49,8 +114,8 @@ bool SensorSentinel_subscribe(PacketCallback packetCallback, BinaryPacketCallbac
     _binaryPacketCallback = binaryPacketCallback;
   }
 
-  // Reset received flag to ensure clean state
-  _packetReceived = false;
+  // Drop interrupts counted before this subscription
+  _rxIrqCount = 0;
 
   // Clear any previous action
   radio.clearDio1Action();
@@ -97,8 +162,8 @@ bool SensorSentinel_unsubscribe(bool packetCallback, bool binaryPacketCallback)
   // If neither callback is active, fully disable reception
   if (_packetCallback == NULL && _binaryPacketCallback == NULL)
   {
-    // Reset received flag to ensure clean state
-    _packetReceived = false;
+    // Drop interrupts that will not be read
+    _rxIrqCount = 0;
 
     // Clear the interrupt
     radio.clearDio1Action();
@@ -122,57 +187,581 @@ bool SensorSentinel_unsubscribe(bool packetCallback, bool binaryPacketCallback)
   return true;
 }
 
+// Finish the frame on air once TX-done fires (or it is clearly overdue)
+static void _tx_complete()
+{
+  if (!_txActive)
+  {
+    return;
+  }
+
+  uint32_t elapsed = millis() - _txStartMillis;
+  bool overdue = elapsed > (2 * _txFrame.airtimeMs + 100);
+  if (!_txDone && !overdue)
+  {
+    return;
+  }
+
+  int state = _txDone ? radio.finishTransmit() : RADIOLIB_ERR_RX_TIMEOUT;
+  _txActive = false;
+  _txDone = false;
+  radio.startReceive();
+
+  uint32_t deafMs = millis() - _txStartMillis;
+  if (state == RADIOLIB_ERR_NONE)
+  {
+    _txStats.sent++;
+    _txStats.totalDeafMs += deafMs;
+    _txStats.avgDeafMs = _txStats.totalDeafMs / _txStats.sent;
+    if (deafMs > _txStats.maxDeafMs)
+    {
+      _txStats.maxDeafMs = deafMs;
+    }
+  }
+  else
+  {
+    _txStats.failed++;
+  }
+
+  if (_txDoneCallback && _txFrame.tag)
+  {
+    _txDoneCallback(_txFrame.tag, state);
+  }
+}
+
+// Remove the best due frame from the queue into _txFrame
+static bool _tx_pick_due()
+{
+  uint32_t now = millis();
+  int best = -1;
+
+  portENTER_CRITICAL(&_txMux);
+  for (int i = 0; i < SensorSentinel_TX_QUEUE_SIZE; i++)
+  {
+    const TxQueueEntry &e = _txQueue[i];
+    if (!e.used || (int32_t)(now - e.dueMillis) < 0)
+    {
+      continue;
+    }
+    if (best < 0)
+    {
+      best = i;
+      continue;
+    }
+    const TxQueueEntry &b = _txQueue[best];
+    if (e.priority != b.priority ? e.priority > b.priority
+        : e.airtimeMs != b.airtimeMs ? e.airtimeMs < b.airtimeMs
+        : (int32_t)(e.seq - b.seq) < 0)
+    {
+      best = i;
+    }
+  }
+  if (best >= 0)
+  {
+    _txFrame = _txQueue[best];
+    _txQueue[best].used = false;
+    _txStats.depth--;
+  }
+  portEXIT_CRITICAL(&_txMux);
+
+  return best >= 0;
+}
+
+// Put _txFrame back into the queue; false if its slot was taken meanwhile
+static bool _tx_requeue(uint32_t delayMs)
+{
+  bool queued = false;
+
+  portENTER_CRITICAL(&_txMux);
+  for (int i = 0; i < SensorSentinel_TX_QUEUE_SIZE && !queued; i++)
+  {
+    if (!_txQueue[i].used)
+    {
+      _txQueue[i] = _txFrame;
+      _txQueue[i].dueMillis = millis() + delayMs;
+      _txStats.depth++;
+      queued = true;
+    }
+  }
+  portEXIT_CRITICAL(&_txMux);
+
+  return queued;
+}
+
+#if LBT_MODE
+// Listen before talk: true if _txFrame was deferred because CAD heard a frame
+static bool _tx_defer_if_busy()
+{
+  if (_txFrame.priority >= SensorSentinel_TX_PRIORITY_URGENT)
+  {
+    return false;
+  }
+  if (_txFrame.attempts >= LBT_MAX_ATTEMPTS)
+  {
+    SensorSentinel_lbt_note_forced();
+    return false;
+  }
+
+  _cadActive = true;
+  bool busy = SensorSentinel_lbt_channel_busy();
+  _cadActive = false;
+  if (!busy)
+  {
+    return false;
+  }
+
+  uint32_t wait = SensorSentinel_lbt_backoff_ms(_txFrame.attempts++, _txFrame.airtimeMs);
+  if (!_tx_requeue(wait))
+  {
+    SensorSentinel_lbt_note_forced();
+    return false;
+  }
+  SensorSentinel_lbt_note_backoff(wait);
+
+  // Back to RX straight away: the preamble CAD found may be a frame for us
+  radio.startReceive();
+  return true;
+}
+#endif
+
+// Start the next due frame if the radio is free
+static void _tx_start_next()
+{
+  // Never step on a frame that still has to be read out of the radio
+  if (_txActive || _rxIrqCount.load(std::memory_order_relaxed) != 0 || !_tx_pick_due())
+  {
+    return;
+  }
+
+#if LBT_MODE
+  if (_tx_defer_if_busy())
+  {
+    return;
+  }
+#endif
+
+  _txStartMillis = millis();
+  _txDone = false;
+  _txActive = true;
+  int state = radio.startTransmit(_txFrame.data, _txFrame.length);
+  if (state != RADIOLIB_ERR_NONE)
+  {
+    _txActive = false;
+    _txStats.failed++;
+    radio.startReceive();
+    if (_txDoneCallback && _txFrame.tag)
+    {
+      _txDoneCallback(_txFrame.tag, state);
+    }
+  }
+}
+
+// Producer side: take a slot from the pool, or NULL if all are in use
+static SensorSentinel_rx_slot_t *_rx_alloc()
+{
+  if (_rxSpare)
+  {
+    SensorSentinel_rx_slot_t *slot = _rxSpare;
+    _rxSpare = NULL;
+    return slot;
+  }
+
+  if (_rxFresh < SensorSentinel_RX_RING_SIZE)
+  {
+    return &_rxPool[_rxFresh++];
+  }
+
+  uint32_t tail = _rxFreeTail.load(std::memory_order_relaxed);
+  if (tail == _rxFreeHead.load(std::memory_order_acquire))
+  {
+    return NULL;
+  }
+  SensorSentinel_rx_slot_t *slot = &_rxPool[_rxFree[tail & (SensorSentinel_RX_RING_SIZE - 1)]];
+  _rxFreeTail.store(tail + 1, std::memory_order_release);
+  return slot;
+}
+
+// Read a pending frame into a pool slot, queue it and re-arm the receiver
+static bool _rx_read()
+{
+  // The count is the only signal: an interrupt that lands after the
+  // exchange stays counted for the next pass and is not read twice
+  uint32_t irqCount = _rxIrqCount.exchange(0);
+  if (irqCount == 0)
+  {
+    return false;
+  }
+  uint32_t irqMillis = _rxIrqMillis;
+
+  // More than one interrupt since the last read: the radio's single FIFO
+  // has already been overwritten by the newer frame
+  if (irqCount > 1)
+  {
+    _rxStats.missed += irqCount - 1;
+  }
+
+  // Read into a free pool slot; if every slot is in use the frame still has
+  // to be drained from the radio, so read it into a scratch slot and drop it
+  static SensorSentinel_rx_slot_t scratch;
+  SensorSentinel_rx_slot_t *slot = _rx_alloc();
+  bool full = (slot == NULL);
+  if (full)
+  {
+    slot = &scratch;
+  }
+
+  int state = radio.readData(slot->data, sizeof(slot->data));
+  slot->length = radio.getPacketLength();
+  slot->rssi = radio.getRSSI();
+  slot->snr = radio.getSNR();
+  slot->freqError = radio.getFrequencyError();
+  slot->rxMillis = irqMillis;
+
+  // Re-arm immediately so the next frame can be received
+  radio.startReceive();
+
+  if (state != RADIOLIB_ERR_NONE || slot->length == 0)
+  {
+    _rxStats.readErrors++;
+    if (!full)
+    {
+      _rxSpare = slot;  // Reuse for the next frame
+    }
+    return false;
+  }
+
+  if (full)
+  {
+    _rxStats.overflows++;
+    return false;
+  }
+
+  uint32_t head = _rxHead.load(std::memory_order_relaxed);
+  _rxReady[head & (SensorSentinel_RX_RING_SIZE - 1)] = slot - _rxPool;
+  _rxHead.store(head + 1, std::memory_order_release);
+  _rxStats.received++;
+
+  uint8_t depth = (uint8_t)(head + 1 - _rxTail.load(std::memory_order_acquire));
+  if (depth > _rxStats.highWater)
+  {
+    _rxStats.highWater = depth;
+  }
+  return true;
+}
+
 /**
- * @brief Process any received packets in the main loop
+ * @brief Read a pending frame into the ring, then run the TX queue
  */
-void SensorSentinel_process_packets()
+bool SensorSentinel_radio_service()
+{
+  _tx_complete();
+  bool captured = _rx_read();
+  _tx_start_next();
+  return captured;
+}
+
+/**
+ * @brief LoRa time-on-air (Semtech SX126x datasheet, explicit header, CRC on)
+ */
+uint32_t SensorSentinel_time_on_air_ms(size_t length)
 {
-  if (_packetReceived)
+  const float symbolMs = (float)(1UL << HELTEC_LORA_SF) / HELTEC_LORA_BW;
+  const int lowDataRate = (symbolMs >= 16.0f) ? 1 : 0;  // RadioLib enables LDRO here
+
+  int numerator = 8 * (int)length - 4 * HELTEC_LORA_SF + 28 + 16;
+  int denominator = 4 * (HELTEC_LORA_SF - 2 * lowDataRate);
+  int blocks = (numerator > 0) ? (numerator + denominator - 1) / denominator : 0;
+  int payloadSymbols = 8 + blocks * HELTEC_LORA_CR;
+
+  float totalMs = (SensorSentinel_LORA_PREAMBLE + 4.25f + payloadSymbols) * symbolMs;
+  return (uint32_t)ceilf(totalMs);
+}
+
+/**
+ * @brief Queue a frame for non-blocking transmission
+ */
+bool SensorSentinel_tx_enqueue(const uint8_t *data, size_t length, uint8_t priority, uint32_t delayMs,
+                               uint32_t tag)
+{
+  if (!data || length == 0 || length > MAX_LORA_PACKET_SIZE)
   {
-    _packetReceived = false;
-    radio.clearDio1Action();
+    return false;
+  }
 
-    bool hasCallbacks = (_packetCallback || _binaryPacketCallback);
+  uint32_t airtime = SensorSentinel_time_on_air_ms(length);
+  bool queued = false;
 
-    if (hasCallbacks)
+  portENTER_CRITICAL(&_txMux);
+  for (int i = 0; i < SensorSentinel_TX_QUEUE_SIZE; i++)
+  {
+    TxQueueEntry &e = _txQueue[i];
+    if (e.used)
+    {
+      continue;
+    }
+    memcpy(e.data, data, length);
+    e.length = length;
+    e.priority = priority;
+    e.dueMillis = millis() + delayMs;
+    e.airtimeMs = airtime;
+    e.seq = _txSeq++;
+    e.tag = tag;
+    e.attempts = 0;
+    e.used = true;
+    queued = true;
+    _txStats.queued++;
+    if (++_txStats.depth > _txStats.maxDepth)
     {
-      _packetRssi = radio.getRSSI();
-      _packetSnr = radio.getSNR();
-
-      // Read all packets as binary
-      int state = radio.readData(_binaryPacketBuffer, sizeof(_binaryPacketBuffer));
-      _binaryPacketLength = radio.getPacketLength();
-
-      if (state == RADIOLIB_ERR_NONE && _binaryPacketLength > 0)
-      {
-        // Handle string callback
-        if (_packetCallback)
-        {
-          // Convert buffer to String using length-based constructor
-          _packetData = String((char *)_binaryPacketBuffer, _binaryPacketLength);
-          _packetCallback(_packetData, _packetRssi, _packetSnr);
-        }
-
-        // Handle binary callback
-        if (_binaryPacketCallback)
-        {
-          _binaryPacketCallback(_binaryPacketBuffer, _binaryPacketLength, _packetRssi, _packetSnr);
-        }
-      }
-      else
-      {
-        Serial.printf("Error reading LoRa packet or empty packet: %d\n", state);
-      }
+      _txStats.maxDepth = _txStats.depth;
     }
+    break;
+  }
+  if (!queued)
+  {
+    _txStats.dropped++;
+  }
+  portEXIT_CRITICAL(&_txMux);
 
-    radio.standby();
-    delay(10);
+  // Let a radio task recompute its wake-up time
+  if (queued && _rxNotifyTask)
+  {
+    xTaskNotifyGive(_rxNotifyTask);
+  }
+  return queued;
+}
+
+/**
+ * @brief Take a queued frame back out before it goes on air
+ */
+bool SensorSentinel_tx_cancel(uint32_t tag)
+{
+  if (tag == 0)
+  {
+    return false;
+  }
+
+  bool cancelled = false;
 
-    if (_packetCallback || _binaryPacketCallback)
+  portENTER_CRITICAL(&_txMux);
+  for (int i = 0; i < SensorSentinel_TX_QUEUE_SIZE; i++)
+  {
+    TxQueueEntry &e = _txQueue[i];
+    if (e.used && e.tag == tag)
     {
-      radio.startReceive();
-      delay(10);
-      radio.setDio1Action(_handleLoRaRx);
+      e.used = false;
+      _txStats.depth--;
+      _txStats.cancelled++;
+      cancelled = true;
+      break;
     }
   }
-}
\ No newline at end of file
+  portEXIT_CRITICAL(&_txMux);
+
+  return cancelled;
+}
+
+/**
+ * @brief Register the callback for tagged frames that went on air or failed to
+ */
+void SensorSentinel_set_tx_done_callback(SensorSentinel_tx_done_callback_t callback)
+{
+  _txDoneCallback = callback;
+}
+
+/**
+ * @brief Time until the next queued frame is due
+ */
+uint32_t SensorSentinel_tx_next_due_ms()
+{
+  uint32_t now = millis();
+  uint32_t next = UINT32_MAX;
+
+  portENTER_CRITICAL(&_txMux);
+  for (int i = 0; i < SensorSentinel_TX_QUEUE_SIZE; i++)
+  {
+    if (!_txQueue[i].used)
+    {
+      continue;
+    }
+    int32_t wait = (int32_t)(_txQueue[i].dueMillis - now);
+    uint32_t due = (wait > 0) ? (uint32_t)wait : 0;
+    if (due < next)
+    {
+      next = due;
+    }
+  }
+  portEXIT_CRITICAL(&_txMux);
+
+  return next;
+}
+
+/**
+ * @brief Check whether a queued transmission is on air
+ */
+bool SensorSentinel_tx_busy()
+{
+  return _txActive;
+}
+
+/**
+ * @brief Get a snapshot of the transmit queue counters
+ */
+void SensorSentinel_get_tx_stats(SensorSentinel_tx_stats_t *stats)
+{
+  if (!stats)
+    return;
+
+  portENTER_CRITICAL(&_txMux);
+  *stats = _txStats;
+  portEXIT_CRITICAL(&_txMux);
+}
+
+/**
+ * @brief Get the oldest waiting slot without removing it
+ */
+SensorSentinel_rx_slot_t *SensorSentinel_rx_peek()
+{
+  uint32_t tail = _rxTail.load(std::memory_order_relaxed);
+  if (tail == _rxHead.load(std::memory_order_acquire))
+  {
+    return NULL;
+  }
+  return &_rxPool[_rxReady[tail & (SensorSentinel_RX_RING_SIZE - 1)]];
+}
+
+/**
+ * @brief Remove the oldest waiting slot; the caller now owns it
+ */
+SensorSentinel_rx_slot_t *SensorSentinel_rx_take()
+{
+  SensorSentinel_rx_slot_t *slot = SensorSentinel_rx_peek();
+  if (slot)
+  {
+    _rxTail.store(_rxTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    _rxStats.dispatched++;
+  }
+  return slot;
+}
+
+/**
+ * @brief Return a taken slot to the pool
+ */
+void SensorSentinel_rx_free(SensorSentinel_rx_slot_t *slot)
+{
+  if (!slot || slot < _rxPool || slot >= _rxPool + SensorSentinel_RX_RING_SIZE)
+  {
+    return;
+  }
+
+  uint32_t head = _rxFreeHead.load(std::memory_order_relaxed);
+  _rxFree[head & (SensorSentinel_RX_RING_SIZE - 1)] = slot - _rxPool;
+  _rxFreeHead.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Hand the oldest slot back to the pool
+ */
+void SensorSentinel_rx_release()
+{
+  SensorSentinel_rx_free(SensorSentinel_rx_take());
+}
+
+
+
+/**
+ * @brief Register a task to be notified from the DIO1 interrupt
+ */
+void SensorSentinel_set_rx_notify_task(TaskHandle_t task)
+{
+  _rxNotifyTask = task;
+}
+
+/**
+ * @brief Get a snapshot of the receive ring counters
+ */
+void SensorSentinel_get_rx_stats(SensorSentinel_rx_stats_t *stats)
+{
+  if (!stats)
+    return;
+
+  *stats = _rxStats;
+  stats->depth = (uint8_t)(_rxHead.load(std::memory_order_acquire) -
+                           _rxTail.load(std::memory_order_acquire));
+}
+
+// Hand one taken slot to whichever callbacks are registered, then free it
+static void _dispatch_slot(SensorSentinel_rx_slot_t *slot)
+{
+  _currentSlot = slot;
+
+  // Handle string callback
+  if (_packetCallback)
+  {
+    // Convert buffer to String using length-based constructor
+    _packetData = String((char *)slot->data, slot->length);
+    _packetCallback(_packetData, slot->rssi, slot->snr);
+  }
+
+  // Handle binary callback - the slot itself is handed over, no copy
+  if (_binaryPacketCallback)
+  {
+    _binaryPacketCallback(slot->data, slot->length, slot->rssi, slot->snr);
+  }
+
+  _currentSlot = NULL;
+  SensorSentinel_rx_free(slot);
+}
+
+SensorSentinel_rx_slot_t *SensorSentinel_rx_current()
+{
+  return _currentSlot;
+}
+
+/**
+ * @brief Hand waiting ring slots to the callbacks without touching the radio
+ */
+void SensorSentinel_dispatch_packets()
+{
+  uint32_t start = SensorSentinel_metrics_start();
+  bool dispatched = false;
+
+  SensorSentinel_rx_slot_t *slot;
+  while ((slot = SensorSentinel_rx_take()) != NULL)
+  {
+    _dispatch_slot(slot);
+    dispatched = true;
+  }
+
+  // Empty polls would swamp the histogram's first bucket
+  if (dispatched)
+  {
+    SensorSentinel_metrics_record(METRIC_PROCESS_PACKETS, start);
+  }
+}
+
+/**
+ * @brief Process any received packets in the main loop
+ */
+void SensorSentinel_process_packets()
+{
+  uint32_t start = SensorSentinel_metrics_start();
+  bool dispatched = false;
+
+  SensorSentinel_radio_service();
+
+  SensorSentinel_rx_slot_t *slot;
+  while ((slot = SensorSentinel_rx_take()) != NULL)
+  {
+    _dispatch_slot(slot);
+    dispatched = true;
+
+    // Pick up anything that arrived while the callbacks were running
+    SensorSentinel_radio_service();
+  }
+
+  // Empty polls would swamp the histogram's first bucket
+  if (dispatched)
+  {
+    SensorSentinel_metrics_record(METRIC_PROCESS_PACKETS, start);
+  }
+}
@@ -7,6 +7,58 @@
 #define SensorSentinel_RadioLib_HELPER_H 
 
 #include <heltec_unofficial_revised.h>
+#include "SensorSentinel_packet_helper.h"  // For MAX_LORA_PACKET_SIZE
+
+// Number of preallocated receive slots in the pool (must be a power of two)
+#ifndef SensorSentinel_RX_RING_SIZE
+#define SensorSentinel_RX_RING_SIZE 8
+#endif
+
+// Pool slots are SensorSentinel_rx_slot_t (see SensorSentinel_packet_helper.h):
+// the radio reads each frame straight into a free slot together with its
+// link metadata. Filled slots are queued in arrival order and handed to the
+// consumer by pointer; the consumer frees them back to the pool.
+
+// Number of pending transmissions the TX queue can hold
+#ifndef SensorSentinel_TX_QUEUE_SIZE
+#define SensorSentinel_TX_QUEUE_SIZE 4
+#endif
+
+// Frames at or above this priority skip listen-before-talk: they answer a
+// node that is listening only briefly (SensorSentinel_lbt_helper.h)
+#define SensorSentinel_TX_PRIORITY_URGENT 2
+
+// LoRa preamble length in symbols (RadioLib default)
+#define SensorSentinel_LORA_PREAMBLE 8
+
+/**
+ * @brief Transmit queue counters
+ */
+typedef struct {
+  uint32_t queued;       // Frames accepted by SensorSentinel_tx_enqueue()
+  uint32_t sent;         // Frames whose TX-done interrupt has been seen
+  uint32_t failed;       // startTransmit()/finishTransmit() errors
+  uint32_t dropped;      // Frames rejected because the queue was full
+  uint32_t cancelled;    // Frames taken back out by SensorSentinel_tx_cancel()
+  uint32_t totalDeafMs;  // Sum of RX-off windows (start of TX to RX re-armed)
+  uint32_t avgDeafMs;    // totalDeafMs / sent
+  uint32_t maxDeafMs;    // Longest single RX-off window
+  uint8_t  depth;        // Frames currently waiting
+  uint8_t  maxDepth;     // Deepest the queue has been since boot
+} SensorSentinel_tx_stats_t;
+
+/**
+ * @brief Receive ring counters
+ */
+typedef struct {
+  uint32_t received;    // Frames captured into the ring
+  uint32_t dispatched;  // Frames released by the consumer
+  uint32_t overflows;   // Frames dropped because every slot was full
+  uint32_t missed;      // Interrupts that fired again before the frame was read
+  uint32_t readErrors;  // CRC or SPI errors from readData()
+  uint8_t  depth;       // Slots currently waiting for the consumer
+  uint8_t  highWater;   // Deepest the ring has been since boot
+} SensorSentinel_rx_stats_t;
 
 /**
  * @brief Callback function type for string packet reception
@@ -28,12 +80,7 @@ typedef void (*BinaryPacketCallback)(uint8_t* data, size_t length, float rssi, f
 // Global variables for packet subscription system
 extern PacketCallback _packetCallback;
 extern BinaryPacketCallback _binaryPacketCallback;
-extern volatile bool _packetReceived;
 extern String _packetData;
-extern uint8_t _binaryPacketBuffer[256]; // Buffer for binary packet data
-extern size_t _binaryPacketLength;
-extern float _packetRssi;
-extern float _packetSnr;
 
 // Packet handling functions
 /**
@@ -61,7 +108,158 @@ bool SensorSentinel_unsubscribe(bool packetCallback, bool binaryPacketCallback);
 /**
  * @brief Process any received packets in the main loop
  * This should be called in every iteration of loop()
+ *
+ * Services the radio (see SensorSentinel_radio_service()) and then hands
+ * every waiting ring slot to the registered callbacks.
  */
 void SensorSentinel_process_packets();
 
+/**
+ * @brief Hand waiting ring slots to the callbacks without touching the radio
+ *
+ * Consumer-only half of SensorSentinel_process_packets(), for use when a
+ * separate task owns the radio and calls SensorSentinel_radio_service().
+ */
+void SensorSentinel_dispatch_packets();
+
+/**
+ * @brief Producer side of the receive ring
+ *
+ * If the DIO1 interrupt has fired, reads the frame directly into the next
+ * free slot and re-arms the receiver straight away. Also completes a
+ * finished transmission and starts the next due one from the TX queue.
+ * @return true if a frame was captured into the ring
+ */
+bool SensorSentinel_radio_service();
+
+/**
+ * @brief Consumer side: get the oldest waiting slot without removing it
+ * @return Pointer to the slot, or NULL if none is waiting
+ */
+SensorSentinel_rx_slot_t* SensorSentinel_rx_peek();
+
+/**
+ * @brief Consumer side: free the slot obtained from SensorSentinel_rx_peek()
+ */
+void SensorSentinel_rx_release();
+
+/**
+ * @brief Consumer side: remove the oldest waiting slot and take ownership
+ *
+ * The slot stays valid (and out of the radio's reach) until it is passed
+ * to SensorSentinel_rx_free(), so it can be carried through validation,
+ * dedup and publish without copying.
+ *
+ * @return Pointer to the slot, or NULL if none is waiting
+ */
+SensorSentinel_rx_slot_t* SensorSentinel_rx_take();
+
+/**
+ * @brief Consumer side: return a slot obtained from SensorSentinel_rx_take()
+ * @param slot Slot to free
+ */
+void SensorSentinel_rx_free(SensorSentinel_rx_slot_t *slot);
+
+/**
+ * @brief Slot currently being handed to the subscribed callbacks
+ *
+ * Lets a binary callback reach the full slot (headroom, frequency error,
+ * RX timestamp) behind the data pointer it was given.
+ *
+ * @return Pointer to the slot, or NULL outside a callback
+ */
+SensorSentinel_rx_slot_t* SensorSentinel_rx_current();
+
+/**
+ * @brief Compute LoRa time-on-air for a frame with the configured modem settings
+ *
+ * Uses HELTEC_LORA_SF, HELTEC_LORA_BW and HELTEC_LORA_CR with an explicit
+ * header, CRC on and SensorSentinel_LORA_PREAMBLE preamble symbols.
+ *
+ * @param length Payload length in bytes
+ * @return Time-on-air in milliseconds (rounded up)
+ */
+uint32_t SensorSentinel_time_on_air_ms(size_t length);
+
+/**
+ * @brief Queue a frame for non-blocking transmission
+ *
+ * The frame is copied, so the caller's buffer can be reused immediately.
+ * The radio keeps listening until the frame is due; SensorSentinel_radio_service()
+ * then starts the TX with startTransmit() and re-arms RX on the TX-done
+ * interrupt. Among due frames, higher priority goes first, then the
+ * shorter time-on-air, then the oldest.
+ *
+ * With LBT_MODE a due frame below SensorSentinel_TX_PRIORITY_URGENT is sent
+ * only when CAD finds the channel clear; otherwise it goes back into the
+ * queue with a jittered backoff, up to LBT_MAX_ATTEMPTS times.
+ *
+ * @param data Frame bytes
+ * @param length Frame length in bytes
+ * @param priority Larger values are sent first
+ * @param delayMs Earliest time to start, relative to now
+ * @param tag Nonzero to be able to cancel the frame with SensorSentinel_tx_cancel()
+ *            and to hear how it went (SensorSentinel_set_tx_done_callback())
+ * @return true if the frame was queued, false if the queue was full
+ */
+bool SensorSentinel_tx_enqueue(const uint8_t *data, size_t length, uint8_t priority, uint32_t delayMs,
+                               uint32_t tag = 0);
+
+/**
+ * @brief Take a queued frame back out before it goes on air
+ * @param tag Tag it was queued with (nonzero)
+ * @return true if a waiting frame was removed; false if there was none, or
+ *         it is already on air or in its channel check
+ */
+bool SensorSentinel_tx_cancel(uint32_t tag);
+
+/**
+ * @brief Outcome of a tagged frame, from the task that owns the radio
+ * @param tag Tag the frame was queued with
+ * @param state RADIOLIB_ERR_NONE once its TX-done interrupt fired, the
+ *        startTransmit() error, or RADIOLIB_ERR_RX_TIMEOUT if TX-done never came
+ */
+typedef void (*SensorSentinel_tx_done_callback_t)(uint32_t tag, int state);
+
+/**
+ * @brief Register the callback for tagged frames that went on air or failed to
+ *
+ * Not called for frames taken back with SensorSentinel_tx_cancel(), nor for
+ * ones SensorSentinel_tx_enqueue() refused. Runs in the radio task (or
+ * loop()), so it must not block.
+ *
+ * @param callback Function to call, or NULL
+ */
+void SensorSentinel_set_tx_done_callback(SensorSentinel_tx_done_callback_t callback);
+
+/**
+ * @brief Time until the next queued frame is due
+ * @return Milliseconds (0 if one is due now), or UINT32_MAX if the queue is empty
+ */
+uint32_t SensorSentinel_tx_next_due_ms();
+
+/**
+ * @brief Check whether a queued transmission is on air
+ * @return true between startTransmit() and the TX-done interrupt
+ */
+bool SensorSentinel_tx_busy();
+
+/**
+ * @brief Get a snapshot of the transmit queue counters
+ * @param stats Pointer to the structure to fill
+ */
+void SensorSentinel_get_tx_stats(SensorSentinel_tx_stats_t *stats);
+
+/**
+ * @brief Register a task to be notified from the DIO1 interrupt
+ * @param task Task handle to wake with vTaskNotifyGiveFromISR(), or NULL
+ */
+void SensorSentinel_set_rx_notify_task(TaskHandle_t task);
+
+/**
+ * @brief Get a snapshot of the receive ring counters
+ * @param stats Pointer to the structure to fill
+ */
+void SensorSentinel_get_rx_stats(SensorSentinel_rx_stats_t* stats);
+
 #endif // SensorSentinel_RadioLib_HELPER_H
\ No newline at end of file
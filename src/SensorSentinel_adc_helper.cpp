@@ -0,0 +1,278 @@
+/**
+ * @file SensorSentinel_adc_helper.cpp
+ * @brief Oversampled, calibrated ADC bursts (continuous driver on the ESP32-S3)
+ */
+
+#include "SensorSentinel_adc_helper.h"
+#include "SensorSentinel_log_helper.h"
+#include "heltec_unofficial_revised.h"
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+
+#define ADC_DMA (ADC_DMA_MODE && CONFIG_IDF_TARGET_ESP32S3)
+
+#if ADC_DMA
+#define ADC_SAMPLE_HZ     80000  // Below SOC_ADC_SAMPLE_FREQ_THRES_HIGH
+#define ADC_FRAME_BYTES   (64 * SOC_ADC_DIGI_RESULT_BYTES)
+#define ADC_TIMEOUT_MS    20
+#endif
+
+static esp_adc_cal_characteristics_t _chars;
+static esp_adc_cal_value_t _calSource;
+static bool _charsReady = false;
+
+static uint16_t _vbatMv = 0;
+static uint32_t _vbatAt = 0;
+static bool _vbatValid = false;
+
+static void _characterize()
+{
+  if (_charsReady)
+  {
+    return;
+  }
+  _calSource = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &_chars);
+  _charsReady = true;
+  SensorSentinel_log_d("ADC: calibration %s\n", SensorSentinel_adc_calibrated() ? "from eFuse" : "default Vref");
+}
+
+#if ADC_DMA
+// SAR ADC1 channel of a pin, or -1
+static int8_t _adc1Channel(uint8_t pin)
+{
+  int8_t channel = digitalPinToAnalogChannel(pin);
+  return (channel >= 0 && channel < SOC_ADC_MAX_CHANNEL_NUM) ? channel : -1;
+}
+
+/**
+ * @brief Run one continuous-mode burst over the ADC1 channels in mask
+ * @param sums Per-channel sum of raw conversions
+ * @param counts Per-channel number of conversions in sums
+ * @return false if the driver could not be started
+ */
+static bool _dmaBurst(uint32_t mask, uint32_t *sums, uint16_t *counts)
+{
+  adc_digi_pattern_config_t pattern[ADC_MAX_PINS];
+  uint8_t patternCount = 0;
+  for (uint8_t ch = 0; ch < SOC_ADC_MAX_CHANNEL_NUM && patternCount < ADC_MAX_PINS; ch++)
+  {
+    if (mask & (1UL << ch))
+    {
+      pattern[patternCount].atten = ADC_ATTEN_DB_11;  // analogRead() default
+      pattern[patternCount].channel = ch;
+      pattern[patternCount].unit = 0;  // ADC1
+      pattern[patternCount].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+      patternCount++;
+    }
+  }
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = 2 * ADC_FRAME_BYTES;
+  init.conv_num_each_intr = ADC_FRAME_BYTES;
+  init.adc1_chan_mask = mask;
+  init.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init) != ESP_OK)
+  {
+    return false;
+  }
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = false;
+  config.conv_limit_num = 250;
+  config.pattern_num = patternCount;
+  config.adc_pattern = pattern;
+  config.sample_freq_hz = ADC_SAMPLE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK)
+  {
+    adc_digi_deinitialize();
+    return false;
+  }
+
+  uint8_t frame[ADC_FRAME_BYTES];
+  uint8_t remaining = patternCount;
+  uint32_t started = millis();
+  while (remaining > 0 && millis() - started < ADC_TIMEOUT_MS)
+  {
+    uint32_t length = 0;
+    if (adc_digi_read_bytes(frame, sizeof(frame), &length, ADC_TIMEOUT_MS) != ESP_OK)
+    {
+      break;
+    }
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES)
+    {
+      const adc_digi_output_data_t *result = (const adc_digi_output_data_t *)&frame[i];
+      uint8_t ch = result->type2.channel;
+      if (result->type2.unit != 0 || ch >= SOC_ADC_MAX_CHANNEL_NUM || counts[ch] >= ADC_OVERSAMPLE)
+      {
+        continue;
+      }
+      sums[ch] += result->type2.data;
+      if (++counts[ch] == ADC_OVERSAMPLE)
+      {
+        remaining--;
+      }
+    }
+  }
+
+  adc_digi_stop();
+  adc_digi_deinitialize();
+  return true;
+}
+#endif
+
+static uint16_t _readSingle(uint8_t pin)
+{
+  uint32_t sum = 0;
+  for (int n = 0; n < ADC_OVERSAMPLE; n++)
+  {
+    sum += analogReadMilliVolts(pin);  // eFuse-calibrated by the core
+  }
+  return (uint16_t)((sum + ADC_OVERSAMPLE / 2) / ADC_OVERSAMPLE);
+}
+
+bool SensorSentinel_adc_read_pins(const uint8_t *pins, uint8_t count, uint16_t *millivolts)
+{
+  if (!pins || !millivolts || count > ADC_MAX_PINS)
+  {
+    return false;
+  }
+  _characterize();
+
+  bool ok = true;
+  bool done[ADC_MAX_PINS] = {false};
+
+#if ADC_DMA
+  uint32_t mask = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    int8_t ch = _adc1Channel(pins[i]);
+    if (ch >= 0)
+    {
+      mask |= 1UL << ch;
+    }
+  }
+
+  uint32_t sums[SOC_ADC_MAX_CHANNEL_NUM] = {0};
+  uint16_t counts[SOC_ADC_MAX_CHANNEL_NUM] = {0};
+  if (mask && _dmaBurst(mask, sums, counts))
+  {
+    for (uint8_t i = 0; i < count; i++)
+    {
+      int8_t ch = _adc1Channel(pins[i]);
+      if (ch >= 0 && counts[ch] > 0)
+      {
+        uint32_t raw = (sums[ch] + counts[ch] / 2) / counts[ch];
+        millivolts[i] = (uint16_t)esp_adc_cal_raw_to_voltage(raw, &_chars);
+        done[i] = true;
+      }
+    }
+  }
+  else if (mask)
+  {
+    SensorSentinel_log_w("ADC: continuous driver unavailable, reading pins singly\n");
+  }
+#endif
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (done[i])
+    {
+      continue;
+    }
+    if (digitalPinToAnalogChannel(pins[i]) < 0)
+    {
+      millivolts[i] = 0;
+      ok = false;
+      continue;
+    }
+    millivolts[i] = _readSingle(pins[i]);
+  }
+  return ok;
+}
+
+static bool _vbatFresh()
+{
+  return _vbatValid && millis() - _vbatAt < ADC_VBAT_CACHE_MS;
+}
+
+static void _vbatOn(bool on)
+{
+  if (on)
+  {
+    pinMode(VBAT_CTRL, OUTPUT);
+    digitalWrite(VBAT_CTRL, LOW);
+    delay(ADC_VBAT_SETTLE_MS);
+  }
+  else
+  {
+    pinMode(VBAT_CTRL, INPUT);
+  }
+}
+
+static void _vbatStore(uint16_t millivolts)
+{
+  _vbatMv = millivolts;
+  _vbatAt = millis();
+  _vbatValid = true;
+}
+
+bool SensorSentinel_adc_read_with_vbat(const uint8_t *pins, uint8_t count, uint16_t *millivolts)
+{
+  if (!pins || !millivolts || count >= ADC_MAX_PINS)
+  {
+    return false;
+  }
+
+  bool shared = false;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    shared |= (pins[i] == VBAT_ADC);
+  }
+  if (_vbatFresh() || shared)
+  {
+    bool ok = SensorSentinel_adc_read_pins(pins, count, millivolts);
+    SensorSentinel_adc_vbat_mv();  // Second burst only when stale
+    return ok;
+  }
+
+  uint8_t all[ADC_MAX_PINS];
+  uint16_t mv[ADC_MAX_PINS];
+  memcpy(all, pins, count);
+  all[count] = VBAT_ADC;
+
+  _vbatOn(true);
+  bool ok = SensorSentinel_adc_read_pins(all, count + 1, mv);
+  _vbatOn(false);
+
+  memcpy(millivolts, mv, count * sizeof(uint16_t));
+  _vbatStore(mv[count]);
+  return ok;
+}
+
+uint16_t SensorSentinel_adc_vbat_mv()
+{
+  if (!_vbatFresh())
+  {
+    uint8_t pin = VBAT_ADC;
+    uint16_t mv = 0;
+    _vbatOn(true);
+    SensorSentinel_adc_read_pins(&pin, 1, &mv);
+    _vbatOn(false);
+    _vbatStore(mv);
+  }
+  return _vbatMv;
+}
+
+uint16_t SensorSentinel_adc_mv_to_counts(uint16_t millivolts)
+{
+  uint32_t counts = ((uint32_t)millivolts * 4095 + ADC_FULL_SCALE_MV / 2) / ADC_FULL_SCALE_MV;
+  return counts > 4095 ? 4095 : (uint16_t)counts;
+}
+
+bool SensorSentinel_adc_calibrated()
+{
+  _characterize();
+  return _calSource != ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
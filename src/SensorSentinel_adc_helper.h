@@ -0,0 +1,95 @@
+/**
+ * @file SensorSentinel_adc_helper.h
+ * @brief Oversampled, calibrated ADC bursts for the analog pins and VBAT
+ *
+ * One call converts every requested pin ADC_OVERSAMPLE times and averages
+ * the results. On the ESP32-S3 the conversions run back to back on the
+ * continuous (DMA) ADC driver, so a burst over four pins takes well under a
+ * millisecond; elsewhere, or when the driver cannot be started, each pin is
+ * read with analogReadMilliVolts(). Raw averages are converted with the
+ * eFuse calibration (esp_adc_cal) of the chip.
+ *
+ * Readings are returned in calibrated millivolts. The packets keep 12-bit
+ * counts, so SensorSentinel_adc_mv_to_counts() maps millivolts back onto the
+ * ideal 0..4095 scale of the default 11 dB attenuation; thresholds set
+ * against analogRead() values stay valid.
+ *
+ * The battery voltage (VBAT_ADC with the VBAT_CTRL divider switched on) is
+ * measured once per wake and cached for ADC_VBAT_CACHE_MS, so the divider
+ * settle delay is paid once however many packets call heltec_vbat().
+ * SensorSentinel_adc_read_with_vbat() adds it to the pin burst; on boards
+ * where VBAT_ADC is also an analog pin (GPIO1 on the V3) it takes a second
+ * burst, since the divider must be off while the pin is read.
+ *
+ * Set via platformio.ini build flags: -DADC_OVERSAMPLE=16, -DADC_DMA_MODE=0
+ */
+
+#ifndef SensorSentinel_ADC_HELPER_H
+#define SensorSentinel_ADC_HELPER_H
+
+#include <Arduino.h>
+
+#ifndef ADC_OVERSAMPLE
+#define ADC_OVERSAMPLE 16  // Conversions averaged per pin (1 = single read)
+#endif
+
+#ifndef ADC_DMA_MODE
+#define ADC_DMA_MODE 1  // Use the continuous ADC driver where the chip has one
+#endif
+
+#ifndef ADC_VBAT_CACHE_MS
+#define ADC_VBAT_CACHE_MS 10000  // Reuse a battery reading for this long
+#endif
+
+#ifndef ADC_VBAT_SETTLE_MS
+#define ADC_VBAT_SETTLE_MS 5  // Divider settle time after VBAT_CTRL is switched on
+#endif
+
+#define ADC_MAX_PINS      8     // Pins in one burst
+#define ADC_FULL_SCALE_MV 3100  // Input at 4095 counts with 11 dB attenuation
+
+/**
+ * @brief Read several pins in one oversampled burst
+ *
+ * @param pins GPIO numbers; ADC1 pins share one DMA burst, others are read singly
+ * @param count Number of pins (at most ADC_MAX_PINS)
+ * @param millivolts Calibrated, averaged reading of each pin
+ * @return true if every pin was read, false if a pin has no ADC channel (its
+ *         reading is 0)
+ */
+bool SensorSentinel_adc_read_pins(const uint8_t *pins, uint8_t count, uint16_t *millivolts);
+
+/**
+ * @brief Read several pins and refresh the cached battery reading in the same burst
+ *
+ * Skips the battery when the cache is still fresh.
+ *
+ * @param pins GPIO numbers
+ * @param count Number of pins (at most ADC_MAX_PINS - 1)
+ * @param millivolts Calibrated, averaged reading of each pin
+ * @return As SensorSentinel_adc_read_pins()
+ */
+bool SensorSentinel_adc_read_with_vbat(const uint8_t *pins, uint8_t count, uint16_t *millivolts);
+
+/**
+ * @brief Get the voltage at VBAT_ADC with the divider on, measuring only when
+ *        the cached reading is older than ADC_VBAT_CACHE_MS
+ * @return Calibrated millivolts at the pin (not the battery voltage)
+ */
+uint16_t SensorSentinel_adc_vbat_mv();
+
+/**
+ * @brief Convert a calibrated reading to 12-bit counts on the ideal ADC scale
+ * @param millivolts Output of SensorSentinel_adc_read_pins()
+ * @return 0..4095
+ */
+uint16_t SensorSentinel_adc_mv_to_counts(uint16_t millivolts);
+
+/**
+ * @brief Check whether the chip has eFuse ADC calibration
+ * @return true for two-point or Vref eFuse values, false when esp_adc_cal
+ *         falls back to the default reference
+ */
+bool SensorSentinel_adc_calibrated();
+
+#endif // SensorSentinel_ADC_HELPER_H
@@ -0,0 +1,346 @@
+/**
+ * @file SensorSentinel_adr_helper.cpp
+ * @brief Gateway link tables and sender SF/power adjustment for ADR
+ */
+
+#include "SensorSentinel_adr_helper.h"
+#include "SensorSentinel_packet_helper.h"
+#include "SensorSentinel_log_helper.h"
+
+#ifndef NO_RADIOLIB
+#include "SensorSentinel_RadioLib_helper.h"
+#include "SensorSentinel_tasks_helper.h"
+#endif
+
+#if ADR_MODE && !defined(NO_RADIOLIB)
+
+#if (ADR_NODE_TABLE_SIZE & (ADR_NODE_TABLE_SIZE - 1)) != 0
+#error "ADR_NODE_TABLE_SIZE must be a power of 2"
+#endif
+
+#if defined(ARDUINO_heltec_wireless_stick) || defined(ARDUINO_heltec_wireless_stick_lite)
+#define ADR_MAX_POWER ((int8_t)HELTEC_SX1276_POWER)
+#else
+#define ADR_MAX_POWER ((int8_t)HELTEC_SX1262_POWER)
+#endif
+
+#define ADR_HINT_PRIORITY SensorSentinel_TX_PRIORITY_URGENT  // No LBT: the node is listening now
+
+// ── Gateway ───────────────────────────────────────────────────────────────────
+
+// Link stats for one node since its last hint
+typedef struct {
+  uint32_t nodeId;
+  uint32_t seenMs;
+  float snrMax;
+  float snrSum;
+  float rssiSum;
+  uint16_t frames;
+  bool used;
+} _link_entry_t;
+
+static _link_entry_t _links[ADR_NODE_TABLE_SIZE];
+static SensorSentinel_adr_stats_t _stats;
+
+// 32-bit finalizer (murmur3 fmix32), as in the dedup tables
+static inline uint32_t _mix(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+static inline bool _expired(uint32_t seenMs, uint32_t nowMs)
+{
+  return (uint32_t)(nowMs - seenMs) > ADR_TTL_MS;
+}
+
+// Find the node's entry, or claim a free/expired/oldest slot for it
+static _link_entry_t *_link_lookup(uint32_t nodeId, uint32_t nowMs)
+{
+  uint32_t base = _mix(nodeId);
+  _link_entry_t *victim = NULL;
+
+  for (uint32_t i = 0; i < ADR_PROBE_LIMIT; i++)
+  {
+    _link_entry_t *e = &_links[(base + i) & (ADR_NODE_TABLE_SIZE - 1)];
+
+    if (e->used && e->nodeId == nodeId)
+    {
+      if (_expired(e->seenMs, nowMs))
+      {
+        e->frames = 0;  // Old stats say nothing about the link now
+      }
+      return e;
+    }
+
+    if (!e->used || _expired(e->seenMs, nowMs))
+    {
+      if (!victim || victim->used)
+      {
+        victim = e;
+      }
+    }
+    else if (!victim || (victim->used && (int32_t)(e->seenMs - victim->seenMs) < 0))
+    {
+      victim = e;
+    }
+  }
+
+  if (victim->used && !_expired(victim->seenMs, nowMs))
+  {
+    _stats.evictions++;
+  }
+  memset(victim, 0, sizeof(*victim));
+  victim->used = true;
+  victim->nodeId = nodeId;
+  return victim;
+}
+
+static int8_t _clampInt8(float value)
+{
+  return (int8_t)constrain(lroundf(value), -128L, 127L);
+}
+
+bool SensorSentinel_adr_observe(uint32_t nodeId, uint32_t counter, float rssi, float snr, bool first)
+{
+  uint32_t nowMs = millis();
+  _link_entry_t *e = _link_lookup(nodeId, nowMs);
+  e->seenMs = nowMs;
+  if (e->frames == 0 || snr > e->snrMax)
+  {
+    e->snrMax = snr;
+  }
+  if (e->frames == 0)
+  {
+    e->snrSum = 0;
+    e->rssiSum = 0;
+  }
+  e->snrSum += snr;
+  e->rssiSum += rssi;
+  if (e->frames < UINT16_MAX)
+  {
+    e->frames++;
+  }
+  _stats.observed++;
+
+  if (!first || counter % ADR_ACK_EVERY != 0)
+  {
+    return false;
+  }
+
+  SensorSentinel_link_hint_t hint;
+  hint.messageType = SensorSentinel_MSG_LINK_HINT;
+  hint.nodeId = nodeId;
+  hint.messageCounter = counter;
+  hint.gatewayId = SensorSentinel_generate_node_id();
+  hint.snrMax = _clampInt8(e->snrMax * 4.0f);
+  hint.snrMean = _clampInt8(e->snrSum / e->frames * 4.0f);
+  hint.rssiMean = _clampInt8(e->rssiSum / e->frames);
+  hint.frames = (uint8_t)min<uint16_t>(e->frames, 255);
+  e->frames = 0;
+
+  if (!SensorSentinel_tx_enqueue((const uint8_t *)&hint, sizeof(hint), ADR_HINT_PRIORITY, 0))
+  {
+    _stats.dropped++;
+    SensorSentinel_log_w("ADR: TX queue full, hint for %u dropped\n", nodeId);
+    return false;
+  }
+  _stats.hints++;
+  SensorSentinel_log_i("ADR: hint for %u #%u (best SNR %.1f dB over %u frames)\n",
+                       nodeId, counter, hint.snrMax / 4.0f, hint.frames);
+  return true;
+}
+
+void SensorSentinel_adr_get_stats(SensorSentinel_adr_stats_t *stats)
+{
+  if (!stats)
+  {
+    return;
+  }
+  uint32_t nowMs = millis();
+  _stats.nodes = 0;
+  for (uint32_t i = 0; i < ADR_NODE_TABLE_SIZE; i++)
+  {
+    if (_links[i].used && !_expired(_links[i].seenMs, nowMs))
+    {
+      _stats.nodes++;
+    }
+  }
+  *stats = _stats;
+}
+
+// ── Sender ────────────────────────────────────────────────────────────────────
+
+// Current settings; 0 until the first wake after power-on
+static RTC_DATA_ATTR uint8_t _sf = 0;
+static RTC_DATA_ATTR int8_t _power = 0;
+static RTC_DATA_ATTR uint8_t _missed = 0;
+
+static void _defaults()
+{
+  if (_sf == 0)
+  {
+    _sf = constrain(HELTEC_LORA_SF, ADR_MIN_SF, ADR_MAX_SF);
+    _power = ADR_MAX_POWER;
+  }
+}
+
+// Lowest SNR (dB) at which a LoRa frame still demodulates
+static float _floorSnr(uint8_t sf)
+{
+  return -5.0f - 2.5f * (sf - 6);
+}
+
+// Spend (steps > 0) or recover (steps < 0) margin, ADR_STEP_DB per step
+static void _step(int steps)
+{
+  while (steps > 0 && _sf > ADR_MIN_SF)
+  {
+    _sf--;
+    steps--;
+  }
+  while (steps > 0 && _power > ADR_MIN_POWER)
+  {
+    _power = max(_power - ADR_STEP_DB, ADR_MIN_POWER);
+    steps--;
+  }
+  while (steps < 0 && _power < ADR_MAX_POWER)
+  {
+    _power = min(_power + ADR_STEP_DB, (int)ADR_MAX_POWER);
+    steps++;
+  }
+  while (steps < 0 && _sf < ADR_MAX_SF)
+  {
+    _sf++;
+    steps++;
+  }
+}
+
+void SensorSentinel_adr_apply()
+{
+  _defaults();
+  SensorSentinel_radio_lock();
+  radio.setSpreadingFactor(_sf);
+  radio.setOutputPower(_power);
+  SensorSentinel_radio_unlock();
+}
+
+// Wait for a hint answering counter; other frames are skipped
+static bool _receiveHint(uint32_t counter, SensorSentinel_link_hint_t *hint)
+{
+  uint32_t windowMs = ADR_RX_WINDOW_MS + SensorSentinel_time_on_air_ms(sizeof(*hint));
+  uint32_t start = millis();
+  if (radio.startReceive() != RADIOLIB_ERR_NONE)
+  {
+    return false;
+  }
+
+  while (millis() - start < windowMs)
+  {
+    if (!digitalRead(DIO1))
+    {
+      delay(1);
+      continue;
+    }
+
+    uint8_t buffer[MAX_LORA_PACKET_SIZE];
+    size_t length = radio.getPacketLength();
+    if (length > sizeof(buffer))
+    {
+      length = sizeof(buffer);
+    }
+    int state = radio.readData(buffer, length);
+    if (state == RADIOLIB_ERR_NONE && length == sizeof(*hint))
+    {
+      memcpy(hint, buffer, sizeof(*hint));
+      if (hint->messageType == SensorSentinel_MSG_LINK_HINT &&
+          hint->nodeId == SensorSentinel_generate_node_id() && hint->messageCounter == counter)
+      {
+        return true;
+      }
+    }
+    radio.startReceive();  // Someone else's frame: keep listening
+  }
+  return false;
+}
+
+bool SensorSentinel_adr_listen(uint32_t counter)
+{
+  if (counter % ADR_ACK_EVERY != 0)
+  {
+    return false;
+  }
+  _defaults();
+
+  SensorSentinel_radio_lock();
+  if (_sf != HELTEC_LORA_SF)
+  {
+    radio.setSpreadingFactor(HELTEC_LORA_SF);  // The gateway answers on its own SF
+  }
+  SensorSentinel_link_hint_t hint;
+  bool heard = _receiveHint(counter, &hint);
+  radio.standby();
+  SensorSentinel_radio_unlock();
+
+  uint8_t oldSf = _sf;
+  int8_t oldPower = _power;
+  if (heard)
+  {
+    _missed = 0;
+    float margin = hint.snrMax / 4.0f - _floorSnr(_sf) - ADR_MARGIN_DB;
+    _step((int)floorf(margin / ADR_STEP_DB));
+    SensorSentinel_log_i("ADR: hint from %u, best SNR %.1f dB, margin %.1f dB\n",
+                         hint.gatewayId, hint.snrMax / 4.0f, margin);
+  }
+  else if (++_missed >= ADR_MAX_MISSED)
+  {
+    _missed = 0;
+    _step(-1);
+    SensorSentinel_log_w("ADR: no hint for %u windows, stepping up\n", ADR_MAX_MISSED);
+  }
+  else
+  {
+    SensorSentinel_log_d("ADR: no hint (%u/%u)\n", _missed, ADR_MAX_MISSED);
+  }
+
+  if (_sf != oldSf || _power != oldPower)
+  {
+    SensorSentinel_log_i("ADR: SF%u %d dBm -> SF%u %d dBm\n", oldSf, oldPower, _sf, _power);
+  }
+
+  // Fewer frames in the window than were sent (or no hint at all) means
+  // uplinks were lost, possibly the key frame the next deltas refer to
+  if (!heard || hint.frames < ADR_ACK_EVERY)
+  {
+    SensorSentinel_force_key_frame_v2();
+  }
+  return heard;
+}
+
+#else
+
+bool SensorSentinel_adr_observe(uint32_t nodeId, uint32_t counter, float rssi, float snr, bool first)
+{
+  return false;
+}
+
+void SensorSentinel_adr_get_stats(SensorSentinel_adr_stats_t *stats)
+{
+  if (stats)
+  {
+    memset(stats, 0, sizeof(*stats));
+  }
+}
+
+void SensorSentinel_adr_apply() {}
+
+bool SensorSentinel_adr_listen(uint32_t counter)
+{
+  return false;
+}
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * @file SensorSentinel_adr_helper.h
+ * @brief Adaptive data rate: per-node link margins at the gateway, SF and
+ *        TX power tuning at the sender
+ *
+ * Gateway half: every frame heard updates a per-node record (best and mean
+ * SNR, mean RSSI) in a bounded-probe hash table laid out like the dedup node
+ * table, so the cost per frame does not grow with the number of nodes. When
+ * the first copy of a frame whose counter is a multiple of ADR_ACK_EVERY
+ * arrives, the gateway queues a SensorSentinel_MSG_LINK_HINT downlink with
+ * the stats since its previous hint and starts a new window. Downlink
+ * airtime is therefore 1/ADR_ACK_EVERY of the uplinks, whatever the node
+ * count.
+ *
+ * Sender half: after transmitting such a frame the deep-sleep sender listens
+ * for up to ADR_RX_WINDOW_MS plus the hint's airtime, at HELTEC_LORA_SF (the
+ * gateway's). The margin is the hint's best SNR over the demodulation floor
+ * of the SF the node used, less ADR_MARGIN_DB. Every ADR_STEP_DB of margin
+ * buys one SF step down (to ADR_MIN_SF), then ADR_STEP_DB less power (to
+ * ADR_MIN_POWER); a negative margin raises power first, then SF (to
+ * ADR_MAX_SF). After ADR_MAX_MISSED windows with no hint the node steps back
+ * up the same way, so a node that loses its gateway returns to the defaults.
+ * The settings are kept in RTC memory across deep sleep.
+ *
+ * The gateways in this tree receive on a single SF, so ADR_MIN_SF and
+ * ADR_MAX_SF default to HELTEC_LORA_SF and only TX power is tuned. Widen the
+ * range only when every gateway in range demodulates the extra SFs. Hints
+ * are not repeated; a node that is heard only through a repeater gets none
+ * and stays at full power.
+ *
+ * Enable via platformio.ini build flag on gateways and senders: -DADR_MODE=1
+ */
+
+#ifndef SensorSentinel_ADR_HELPER_H
+#define SensorSentinel_ADR_HELPER_H
+
+#include <Arduino.h>
+#include "heltec_unofficial_revised.h"
+
+#ifndef ADR_MODE
+#define ADR_MODE 0
+#endif
+
+#ifndef ADR_ACK_EVERY
+#define ADR_ACK_EVERY 8  // Uplinks per hint (counter % ADR_ACK_EVERY == 0 is answered)
+#endif
+#ifndef ADR_MARGIN_DB
+#define ADR_MARGIN_DB 10  // Fade margin kept above the demodulation floor
+#endif
+#define ADR_STEP_DB   3   // Margin per SF step; also the power step
+
+#ifndef ADR_MAX_MISSED
+#define ADR_MAX_MISSED 3  // Windows without a hint before stepping back up
+#endif
+#ifndef ADR_RX_WINDOW_MS
+#define ADR_RX_WINDOW_MS 400  // Gateway turnaround allowance, on top of the hint's airtime
+#endif
+
+#ifndef NO_RADIOLIB
+#ifndef ADR_MIN_SF
+#define ADR_MIN_SF HELTEC_LORA_SF
+#endif
+#ifndef ADR_MAX_SF
+#define ADR_MAX_SF HELTEC_LORA_SF
+#endif
+#endif
+#ifndef ADR_MIN_POWER
+#define ADR_MIN_POWER 2  // dBm
+#endif
+
+// Gateway node table (power of two)
+#ifndef ADR_NODE_TABLE_SIZE
+#define ADR_NODE_TABLE_SIZE 256
+#endif
+#define ADR_PROBE_LIMIT 8
+#ifndef ADR_TTL_MS
+#define ADR_TTL_MS 3600000  // Forget nodes not heard for an hour
+#endif
+
+/**
+ * @brief Gateway ADR counters
+ */
+typedef struct {
+  uint32_t observed;   // Frames folded into the tables
+  uint32_t hints;      // Hints queued for transmission
+  uint32_t dropped;    // Hints lost because the TX queue was full
+  uint32_t evictions;  // Live nodes pushed out by a full probe window
+  uint16_t nodes;      // Nodes heard within ADR_TTL_MS
+} SensorSentinel_adr_stats_t;
+
+/**
+ * @brief Gateway: fold one received frame into its node's link stats
+ *
+ * Call for every valid frame, duplicates included (a repeated copy may have
+ * the better link). Queues a hint when first is true and the counter is on
+ * the ADR_ACK_EVERY schedule.
+ *
+ * @param nodeId Sender of the frame
+ * @param counter Frame's message counter
+ * @param rssi Signal strength (dBm)
+ * @param snr Signal-to-noise ratio (dB)
+ * @param first true for the first copy of this frame (DEDUP_NEW)
+ * @return true if a hint was queued
+ */
+bool SensorSentinel_adr_observe(uint32_t nodeId, uint32_t counter, float rssi, float snr, bool first);
+
+/**
+ * @brief Gateway: get a snapshot of the ADR counters
+ * @param stats Pointer to the structure to fill
+ */
+void SensorSentinel_adr_get_stats(SensorSentinel_adr_stats_t *stats);
+
+/**
+ * @brief Sender: set the radio to this node's current SF and TX power
+ *
+ * Call after the radio is initialised and before each transmission.
+ */
+void SensorSentinel_adr_apply();
+
+/**
+ * @brief Sender: listen for a hint after a transmission and adjust
+ *
+ * Does nothing unless counter is on the ADR_ACK_EVERY schedule. Leaves the
+ * radio in standby. A hint counting fewer than ADR_ACK_EVERY frames, or no
+ * hint, makes the next v2 frame a key frame (duplicates heard through a
+ * repeater count too, so not every gap is seen).
+ *
+ * @param counter Message counter of the frame just sent
+ * @return true if a hint for this frame was received
+ */
+bool SensorSentinel_adr_listen(uint32_t counter);
+
+#endif // SensorSentinel_ADR_HELPER_H
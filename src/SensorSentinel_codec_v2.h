@@ -0,0 +1,667 @@
+/**
+ * @file SensorSentinel_codec_v2.h
+ * @brief Compact v2 frame encoding (varints, packed ADC, fixed-point position)
+ *
+ * Header-only and free of Arduino dependencies so it can be built and
+ * exercised on the host. The firmware wraps it in SensorSentinel_packet_helper.
+ *
+ * All multi-byte fixed fields are little-endian. Varints are LEB128
+ * (7 bits per byte, low bits first, at most 5 bytes); signed deltas are
+ * zigzag-encoded first.
+ *
+ * Common header:
+ *   u8      messageType    SensorSentinel_MSG_SENSOR_V2 / SensorSentinel_MSG_GNSS_V2
+ *   u32     nodeId         Fixed: a hash of the MAC does not compress
+ *   varint  messageCounter
+ *   u8      flags          bit 0: delta frame, bit 1: TX report trailer,
+ *                          bit 2: pin edges (sensor frames)
+ *   varint  keyDistance    Delta frames only: messageCounter - key frame's counter
+ *
+ * With flag bit 1 the body is followed by SensorSentinel_V2_REPORT_SIZE
+ * bytes of listen-before-talk counters (SensorSentinel_tx_report_t in
+ * SensorSentinel_packet_helper.h). The codec only strips them;
+ * SensorSentinel_v2_add_report() appends them to an encoded frame.
+ *
+ * With flag bit 2 a sensor body is followed by the boolean pin edges
+ * latched since the previous frame (PINS_EDGE_MODE, SensorSentinel_pin_edges_t
+ * in SensorSentinel_pins_helper.h): a u8 mask of the pins that changed, then
+ * a varint rising-edge count for each set bit, lowest pin first. The counts
+ * are per frame, never deltas. SensorSentinel_v2_add_edges() appends them;
+ * it has to run before SensorSentinel_v2_add_report(), as the report is
+ * always last.
+ *
+ * A key frame carries every field in full. A delta frame carries the
+ * difference to the node's last key frame, so it can only be decoded by a
+ * receiver that holds that key frame; losing a delta frame costs nothing
+ * else, losing a key frame costs the deltas that refer to it. The encoder
+ * sends a key frame at least every SensorSentinel_V2_KEY_INTERVAL frames
+ * and whenever a delta would not be shorter.
+ *
+ * Sensor body (key / delta):
+ *   uptime s          varint            / zigzag varint
+ *   battery %         u8                / zigzag varint
+ *   battery mV        varint            / zigzag varint
+ *   analog[4]         4 x 12 bits in 6  / 4 x zigzag varint
+ *   digital           u8                / u8
+ *
+ * GNSS body (key / delta):
+ *   uptime s          varint            / zigzag varint
+ *   battery %         u8                / zigzag varint
+ *   battery mV        varint            / zigzag varint
+ *   lat, lon 1e-7 deg 2 x i32           / 2 x zigzag varint
+ *   speed 0.1 km/h    varint            / zigzag varint
+ *   hdop x10          u8                / u8
+ *   course 0.01 deg   u16               / zigzag varint
+ */
+
+#ifndef SensorSentinel_CODEC_V2_H
+#define SensorSentinel_CODEC_V2_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define SensorSentinel_MSG_SENSOR_V2  0x11  // Compact sensor frame
+#define SensorSentinel_MSG_GNSS_V2    0x12  // Compact GNSS frame
+
+#define SensorSentinel_V2_FLAG_DELTA  0x01
+#define SensorSentinel_V2_FLAG_REPORT 0x02
+#define SensorSentinel_V2_FLAG_EDGES  0x04
+
+#define SensorSentinel_V2_REPORT_SIZE 4
+
+#ifndef SensorSentinel_V2_KEY_INTERVAL
+#define SensorSentinel_V2_KEY_INTERVAL 4  // Key frame at least every N frames (1 = never delta)
+#endif
+
+#define SensorSentinel_V2_MAX_FRAME   56  // Longest possible encoding of either type, edges and report included
+#define SensorSentinel_V2_ADC_MAX     4095
+
+/**
+ * @brief Decoded v2 sensor frame
+ */
+typedef struct {
+  uint32_t nodeId;
+  uint32_t messageCounter;
+  uint32_t uptime;          // Seconds since boot
+  uint8_t batteryLevel;     // 0-100 %
+  uint16_t batteryVoltage;  // mV
+  uint16_t analog[4];       // 12-bit ADC readings
+  uint8_t boolean;          // 8 digital pins, one per bit
+  uint8_t edgesChanged;     // Pins that changed since the last frame; 0 without edges
+  uint16_t pulses[8];       // Rising edges per pin since the last frame
+} SensorSentinel_v2_sensor_t;
+
+/**
+ * @brief Decoded v2 GNSS frame
+ */
+typedef struct {
+  uint32_t nodeId;
+  uint32_t messageCounter;
+  uint32_t uptime;          // Seconds since boot
+  uint8_t batteryLevel;     // 0-100 %
+  uint16_t batteryVoltage;  // mV
+  int32_t latitudeE7;       // Degrees x 1e7
+  int32_t longitudeE7;      // Degrees x 1e7
+  uint16_t speedX10;        // km/h x 10
+  uint8_t hdop;             // HDOP x 10
+  uint16_t courseX100;      // Degrees x 100 (0-35999)
+} SensorSentinel_v2_gnss_t;
+
+/**
+ * @brief Common header fields of a v2 frame
+ */
+typedef struct {
+  uint8_t messageType;
+  uint32_t nodeId;
+  uint32_t messageCounter;
+  bool delta;
+  bool report;              // Followed by a TX report trailer
+  bool edges;               // Sensor body followed by pin edges
+  uint32_t keyCounter;      // Counter of the key frame a delta refers to
+  size_t headerLength;      // Bytes up to the body
+} SensorSentinel_v2_header_t;
+
+/**
+ * @brief Result of decoding a v2 frame
+ */
+typedef enum {
+  V2_OK,         ///< Decoded
+  V2_NEED_KEY,   ///< Well-formed delta frame, but the matching key frame was not supplied
+  V2_MALFORMED   ///< Truncated, overlong or unknown type
+} SensorSentinel_v2_status_t;
+
+// ── Primitives ───────────────────────────────────────────────────────────────
+
+static inline size_t SensorSentinel_v2_put_varint(uint8_t *out, uint32_t value)
+{
+  size_t n = 0;
+  while (value >= 0x80)
+  {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+static inline uint32_t SensorSentinel_v2_zigzag(int32_t value)
+{
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t SensorSentinel_v2_unzigzag(uint32_t value)
+{
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Bounds-checked reader; ok turns false on the first short or overlong read
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+  bool ok;
+} _v2_reader_t;
+
+static inline uint8_t _v2_u8(_v2_reader_t *r)
+{
+  if (r->p >= r->end)
+  {
+    r->ok = false;
+    return 0;
+  }
+  return *r->p++;
+}
+
+static inline uint32_t _v2_fixed(_v2_reader_t *r, size_t bytes)
+{
+  uint32_t value = 0;
+  for (size_t i = 0; i < bytes; i++)
+  {
+    value |= (uint32_t)_v2_u8(r) << (8 * i);
+  }
+  return value;
+}
+
+static inline uint32_t _v2_varint(_v2_reader_t *r)
+{
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    uint8_t b = _v2_u8(r);
+    value |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+    {
+      return value;
+    }
+  }
+  r->ok = false;  // More than 5 bytes
+  return 0;
+}
+
+static inline int32_t _v2_svarint(_v2_reader_t *r)
+{
+  return SensorSentinel_v2_unzigzag(_v2_varint(r));
+}
+
+static inline size_t _v2_put_fixed(uint8_t *out, uint32_t value, size_t bytes)
+{
+  for (size_t i = 0; i < bytes; i++)
+  {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+  return bytes;
+}
+
+static inline size_t _v2_put_svarint(uint8_t *out, int32_t value)
+{
+  return SensorSentinel_v2_put_varint(out, SensorSentinel_v2_zigzag(value));
+}
+
+static inline uint16_t _v2_clamp_adc(uint16_t value)
+{
+  return value > SensorSentinel_V2_ADC_MAX ? SensorSentinel_V2_ADC_MAX : value;
+}
+
+// Two 12-bit values in three bytes: a[7:0] | a[11:8] b[3:0] | b[11:4]
+static inline void _v2_pack12(uint8_t *out, uint16_t a, uint16_t b)
+{
+  out[0] = (uint8_t)a;
+  out[1] = (uint8_t)(((a >> 8) & 0x0F) | ((b & 0x0F) << 4));
+  out[2] = (uint8_t)(b >> 4);
+}
+
+static inline void _v2_unpack12(const uint8_t *in, uint16_t *a, uint16_t *b)
+{
+  *a = (uint16_t)(in[0] | ((in[1] & 0x0F) << 8));
+  *b = (uint16_t)((in[1] >> 4) | (in[2] << 4));
+}
+
+// ── Header ───────────────────────────────────────────────────────────────────
+
+static inline size_t _v2_put_header(uint8_t *out, uint8_t type, uint32_t nodeId, uint32_t counter,
+                                    uint32_t keyDistance)
+{
+  size_t n = 0;
+  out[n++] = type;
+  n += _v2_put_fixed(out + n, nodeId, 4);
+  n += SensorSentinel_v2_put_varint(out + n, counter);
+  out[n++] = keyDistance ? SensorSentinel_V2_FLAG_DELTA : 0;
+  if (keyDistance)
+  {
+    n += SensorSentinel_v2_put_varint(out + n, keyDistance);
+  }
+  return n;
+}
+
+static inline bool _v2_read_header(_v2_reader_t *r, SensorSentinel_v2_header_t *h)
+{
+  const uint8_t *start = r->p;
+  h->messageType = _v2_u8(r);
+  h->nodeId = _v2_fixed(r, 4);
+  h->messageCounter = _v2_varint(r);
+  uint8_t flags = _v2_u8(r);
+  h->delta = (flags & SensorSentinel_V2_FLAG_DELTA) != 0;
+  h->report = (flags & SensorSentinel_V2_FLAG_REPORT) != 0;
+  h->edges = (flags & SensorSentinel_V2_FLAG_EDGES) != 0;
+  h->keyCounter = h->messageCounter;
+  if (h->delta)
+  {
+    uint32_t distance = _v2_varint(r);
+    if (distance == 0)
+    {
+      r->ok = false;
+    }
+    h->keyCounter = h->messageCounter - distance;
+  }
+  h->headerLength = (size_t)(r->p - start);
+  return r->ok &&
+         (flags & ~(SensorSentinel_V2_FLAG_DELTA | SensorSentinel_V2_FLAG_REPORT | SensorSentinel_V2_FLAG_EDGES)) == 0;
+}
+
+// Leave a TX report trailer out of the body
+static inline bool _v2_strip_report(_v2_reader_t *r, const SensorSentinel_v2_header_t *h)
+{
+  if (!h->report)
+  {
+    return true;
+  }
+  if ((size_t)(r->end - r->p) < SensorSentinel_V2_REPORT_SIZE)
+  {
+    return false;
+  }
+  r->end -= SensorSentinel_V2_REPORT_SIZE;
+  return true;
+}
+
+/**
+ * @brief Parse the common header of a v2 frame
+ * @param data Frame bytes
+ * @param length Frame length
+ * @param header Filled on success
+ * @return true if the header is well-formed
+ */
+static inline bool SensorSentinel_v2_parse_header(const uint8_t *data, size_t length,
+                                                  SensorSentinel_v2_header_t *header)
+{
+  _v2_reader_t r = {data, data + length, data != NULL};
+  return _v2_read_header(&r, header) &&
+         (header->messageType == SensorSentinel_MSG_SENSOR_V2 || header->messageType == SensorSentinel_MSG_GNSS_V2);
+}
+
+// Key distance to use for frame against key, or 0 for a key frame
+static inline uint32_t _v2_key_distance(uint32_t nodeId, uint32_t counter, const uint32_t *keyNodeId,
+                                        const uint32_t *keyCounter)
+{
+  if (!keyNodeId || *keyNodeId != nodeId)
+  {
+    return 0;
+  }
+  uint32_t distance = counter - *keyCounter;
+  return (distance > 0 && distance < SensorSentinel_V2_KEY_INTERVAL) ? distance : 0;
+}
+
+// ── Sensor frames ────────────────────────────────────────────────────────────
+
+static inline size_t _v2_encode_sensor_body(const SensorSentinel_v2_sensor_t *f,
+                                            const SensorSentinel_v2_sensor_t *key, uint8_t *out)
+{
+  size_t n = 0;
+  if (!key)
+  {
+    n += SensorSentinel_v2_put_varint(out + n, f->uptime);
+    out[n++] = f->batteryLevel;
+    n += SensorSentinel_v2_put_varint(out + n, f->batteryVoltage);
+    _v2_pack12(out + n, _v2_clamp_adc(f->analog[0]), _v2_clamp_adc(f->analog[1]));
+    _v2_pack12(out + n + 3, _v2_clamp_adc(f->analog[2]), _v2_clamp_adc(f->analog[3]));
+    n += 6;
+  }
+  else
+  {
+    n += _v2_put_svarint(out + n, (int32_t)(f->uptime - key->uptime));
+    n += _v2_put_svarint(out + n, (int32_t)f->batteryLevel - key->batteryLevel);
+    n += _v2_put_svarint(out + n, (int32_t)f->batteryVoltage - key->batteryVoltage);
+    for (int i = 0; i < 4; i++)
+    {
+      n += _v2_put_svarint(out + n, (int32_t)_v2_clamp_adc(f->analog[i]) - key->analog[i]);
+    }
+  }
+  out[n++] = f->boolean;
+  return n;
+}
+
+/**
+ * @brief Encode a sensor frame
+ *
+ * Emits a delta against key when key is from the same node, less than
+ * SensorSentinel_V2_KEY_INTERVAL frames old and the delta is shorter;
+ * otherwise a key frame.
+ *
+ * @param frame Values to encode
+ * @param key Last key frame sent by this node, or NULL
+ * @param out Destination, at least SensorSentinel_V2_MAX_FRAME bytes
+ * @param isKey Set to true when a key frame was written (optional)
+ * @return Encoded length
+ */
+static inline size_t SensorSentinel_v2_encode_sensor(const SensorSentinel_v2_sensor_t *frame,
+                                                     const SensorSentinel_v2_sensor_t *key,
+                                                     uint8_t *out, bool *isKey)
+{
+  size_t n = _v2_put_header(out, SensorSentinel_MSG_SENSOR_V2, frame->nodeId, frame->messageCounter, 0);
+  n += _v2_encode_sensor_body(frame, NULL, out + n);
+
+  uint32_t distance = key ? _v2_key_distance(frame->nodeId, frame->messageCounter, &key->nodeId,
+                                             &key->messageCounter) : 0;
+  if (distance)
+  {
+    uint8_t delta[SensorSentinel_V2_MAX_FRAME];
+    size_t d = _v2_put_header(delta, SensorSentinel_MSG_SENSOR_V2, frame->nodeId, frame->messageCounter, distance);
+    d += _v2_encode_sensor_body(frame, key, delta + d);
+    if (d < n)
+    {
+      memcpy(out, delta, d);
+      if (isKey) *isKey = false;
+      return d;
+    }
+  }
+  if (isKey) *isKey = true;
+  return n;
+}
+
+/**
+ * @brief Decode a sensor frame
+ * @param data Frame bytes
+ * @param length Frame length (must be exactly one frame)
+ * @param key The node's key frame the delta refers to, or NULL
+ * @param out Decoded values (header fields are set even for V2_NEED_KEY)
+ * @return V2_OK, V2_NEED_KEY or V2_MALFORMED
+ */
+static inline SensorSentinel_v2_status_t SensorSentinel_v2_decode_sensor(const uint8_t *data, size_t length,
+                                                                        const SensorSentinel_v2_sensor_t *key,
+                                                                        SensorSentinel_v2_sensor_t *out)
+{
+  _v2_reader_t r = {data, data + length, data != NULL};
+  SensorSentinel_v2_header_t h;
+  if (!_v2_read_header(&r, &h) || h.messageType != SensorSentinel_MSG_SENSOR_V2 || !_v2_strip_report(&r, &h))
+  {
+    return V2_MALFORMED;
+  }
+
+  memset(out, 0, sizeof(*out));
+  out->nodeId = h.nodeId;
+  out->messageCounter = h.messageCounter;
+  bool haveKey = key && key->nodeId == h.nodeId && key->messageCounter == h.keyCounter;
+
+  if (!h.delta)
+  {
+    out->uptime = _v2_varint(&r);
+    out->batteryLevel = _v2_u8(&r);
+    out->batteryVoltage = (uint16_t)_v2_varint(&r);
+    uint8_t adc[6];
+    for (int i = 0; i < 6; i++)
+    {
+      adc[i] = _v2_u8(&r);
+    }
+    _v2_unpack12(adc, &out->analog[0], &out->analog[1]);
+    _v2_unpack12(adc + 3, &out->analog[2], &out->analog[3]);
+  }
+  else
+  {
+    SensorSentinel_v2_sensor_t zero;
+    memset(&zero, 0, sizeof(zero));
+    const SensorSentinel_v2_sensor_t *base = haveKey ? key : &zero;
+    out->uptime = base->uptime + (uint32_t)_v2_svarint(&r);
+    out->batteryLevel = (uint8_t)(base->batteryLevel + _v2_svarint(&r));
+    out->batteryVoltage = (uint16_t)(base->batteryVoltage + _v2_svarint(&r));
+    for (int i = 0; i < 4; i++)
+    {
+      out->analog[i] = (uint16_t)(base->analog[i] + _v2_svarint(&r));
+    }
+  }
+  out->boolean = _v2_u8(&r);
+  if (h.edges)
+  {
+    out->edgesChanged = _v2_u8(&r);
+    for (int i = 0; i < 8; i++)
+    {
+      if (out->edgesChanged & (1 << i))
+      {
+        uint32_t pulses = _v2_varint(&r);
+        r.ok = r.ok && pulses <= 0xFFFF;
+        out->pulses[i] = (uint16_t)pulses;
+      }
+    }
+    r.ok = r.ok && out->edgesChanged != 0;
+  }
+
+  if (!r.ok || r.p != r.end)
+  {
+    return V2_MALFORMED;
+  }
+  return (h.delta && !haveKey) ? V2_NEED_KEY : V2_OK;
+}
+
+// ── GNSS frames ──────────────────────────────────────────────────────────────
+
+static inline size_t _v2_encode_gnss_body(const SensorSentinel_v2_gnss_t *f,
+                                          const SensorSentinel_v2_gnss_t *key, uint8_t *out)
+{
+  size_t n = 0;
+  if (!key)
+  {
+    n += SensorSentinel_v2_put_varint(out + n, f->uptime);
+    out[n++] = f->batteryLevel;
+    n += SensorSentinel_v2_put_varint(out + n, f->batteryVoltage);
+    n += _v2_put_fixed(out + n, (uint32_t)f->latitudeE7, 4);
+    n += _v2_put_fixed(out + n, (uint32_t)f->longitudeE7, 4);
+    n += SensorSentinel_v2_put_varint(out + n, f->speedX10);
+    out[n++] = f->hdop;
+    n += _v2_put_fixed(out + n, f->courseX100, 2);
+  }
+  else
+  {
+    n += _v2_put_svarint(out + n, (int32_t)(f->uptime - key->uptime));
+    n += _v2_put_svarint(out + n, (int32_t)f->batteryLevel - key->batteryLevel);
+    n += _v2_put_svarint(out + n, (int32_t)f->batteryVoltage - key->batteryVoltage);
+    n += _v2_put_svarint(out + n, (int32_t)((uint32_t)f->latitudeE7 - (uint32_t)key->latitudeE7));
+    n += _v2_put_svarint(out + n, (int32_t)((uint32_t)f->longitudeE7 - (uint32_t)key->longitudeE7));
+    n += _v2_put_svarint(out + n, (int32_t)f->speedX10 - key->speedX10);
+    out[n++] = f->hdop;
+    n += _v2_put_svarint(out + n, (int32_t)f->courseX100 - key->courseX100);
+  }
+  return n;
+}
+
+/**
+ * @brief Encode a GNSS frame (see SensorSentinel_v2_encode_sensor())
+ */
+static inline size_t SensorSentinel_v2_encode_gnss(const SensorSentinel_v2_gnss_t *frame,
+                                                   const SensorSentinel_v2_gnss_t *key,
+                                                   uint8_t *out, bool *isKey)
+{
+  size_t n = _v2_put_header(out, SensorSentinel_MSG_GNSS_V2, frame->nodeId, frame->messageCounter, 0);
+  n += _v2_encode_gnss_body(frame, NULL, out + n);
+
+  uint32_t distance = key ? _v2_key_distance(frame->nodeId, frame->messageCounter, &key->nodeId,
+                                             &key->messageCounter) : 0;
+  if (distance)
+  {
+    uint8_t delta[SensorSentinel_V2_MAX_FRAME];
+    size_t d = _v2_put_header(delta, SensorSentinel_MSG_GNSS_V2, frame->nodeId, frame->messageCounter, distance);
+    d += _v2_encode_gnss_body(frame, key, delta + d);
+    if (d < n)
+    {
+      memcpy(out, delta, d);
+      if (isKey) *isKey = false;
+      return d;
+    }
+  }
+  if (isKey) *isKey = true;
+  return n;
+}
+
+/**
+ * @brief Decode a GNSS frame (see SensorSentinel_v2_decode_sensor())
+ */
+static inline SensorSentinel_v2_status_t SensorSentinel_v2_decode_gnss(const uint8_t *data, size_t length,
+                                                                      const SensorSentinel_v2_gnss_t *key,
+                                                                      SensorSentinel_v2_gnss_t *out)
+{
+  _v2_reader_t r = {data, data + length, data != NULL};
+  SensorSentinel_v2_header_t h;
+  if (!_v2_read_header(&r, &h) || h.messageType != SensorSentinel_MSG_GNSS_V2 || h.edges ||
+      !_v2_strip_report(&r, &h))
+  {
+    return V2_MALFORMED;
+  }
+
+  memset(out, 0, sizeof(*out));
+  out->nodeId = h.nodeId;
+  out->messageCounter = h.messageCounter;
+  bool haveKey = key && key->nodeId == h.nodeId && key->messageCounter == h.keyCounter;
+
+  if (!h.delta)
+  {
+    out->uptime = _v2_varint(&r);
+    out->batteryLevel = _v2_u8(&r);
+    out->batteryVoltage = (uint16_t)_v2_varint(&r);
+    out->latitudeE7 = (int32_t)_v2_fixed(&r, 4);
+    out->longitudeE7 = (int32_t)_v2_fixed(&r, 4);
+    out->speedX10 = (uint16_t)_v2_varint(&r);
+    out->hdop = _v2_u8(&r);
+    out->courseX100 = (uint16_t)_v2_fixed(&r, 2);
+  }
+  else
+  {
+    SensorSentinel_v2_gnss_t zero;
+    memset(&zero, 0, sizeof(zero));
+    const SensorSentinel_v2_gnss_t *base = haveKey ? key : &zero;
+    out->uptime = base->uptime + (uint32_t)_v2_svarint(&r);
+    out->batteryLevel = (uint8_t)(base->batteryLevel + _v2_svarint(&r));
+    out->batteryVoltage = (uint16_t)(base->batteryVoltage + _v2_svarint(&r));
+    out->latitudeE7 = (int32_t)((uint32_t)base->latitudeE7 + (uint32_t)_v2_svarint(&r));
+    out->longitudeE7 = (int32_t)((uint32_t)base->longitudeE7 + (uint32_t)_v2_svarint(&r));
+    out->speedX10 = (uint16_t)(base->speedX10 + _v2_svarint(&r));
+    out->hdop = _v2_u8(&r);
+    out->courseX100 = (uint16_t)(base->courseX100 + _v2_svarint(&r));
+  }
+
+  if (!r.ok || r.p != r.end)
+  {
+    return V2_MALFORMED;
+  }
+  return (h.delta && !haveKey) ? V2_NEED_KEY : V2_OK;
+}
+
+/**
+ * @brief Check that data holds exactly one well-formed v2 frame
+ *
+ * Needs no key frame: delta frames are self-delimiting.
+ *
+ * @return true if the frame parses and length matches
+ */
+static inline bool SensorSentinel_v2_is_valid(const uint8_t *data, size_t length)
+{
+  if (!data || length == 0)
+  {
+    return false;
+  }
+  if (data[0] == SensorSentinel_MSG_SENSOR_V2)
+  {
+    SensorSentinel_v2_sensor_t frame;
+    return SensorSentinel_v2_decode_sensor(data, length, NULL, &frame) != V2_MALFORMED && frame.nodeId != 0;
+  }
+  if (data[0] == SensorSentinel_MSG_GNSS_V2)
+  {
+    SensorSentinel_v2_gnss_t frame;
+    return SensorSentinel_v2_decode_gnss(data, length, NULL, &frame) != V2_MALFORMED && frame.nodeId != 0;
+  }
+  return false;
+}
+
+// Flags follow the type, the node ID and the counter varint
+static inline size_t _v2_flags_offset(const uint8_t *frame)
+{
+  size_t flags = 5;
+  while (frame[flags] & 0x80)
+  {
+    flags++;
+  }
+  return flags + 1;
+}
+
+/**
+ * @brief Append a TX report trailer to an encoded frame and set its flag
+ * @param frame Encoded frame, with room for SensorSentinel_V2_REPORT_SIZE more bytes
+ * @param length Frame length
+ * @param report Trailer bytes
+ * @return New length, or 0 if the frame is malformed or already has a report
+ */
+static inline size_t SensorSentinel_v2_add_report(uint8_t *frame, size_t length, const uint8_t *report)
+{
+  SensorSentinel_v2_header_t h;
+  if (!SensorSentinel_v2_parse_header(frame, length, &h) || h.report)
+  {
+    return 0;
+  }
+  frame[_v2_flags_offset(frame)] |= SensorSentinel_V2_FLAG_REPORT;
+  memcpy(frame + length, report, SensorSentinel_V2_REPORT_SIZE);
+  return length + SensorSentinel_V2_REPORT_SIZE;
+}
+
+/**
+ * @brief Append pin edges to an encoded sensor frame and set its flag
+ * @param frame Encoded sensor frame without a report, with room for
+ *        1 + 3 x (bits set in changed) more bytes
+ * @param length Frame length
+ * @param changed Pins that changed, one per bit; 0 appends nothing
+ * @param pulses Rising edges per pin (8 entries)
+ * @return New length; length unchanged when changed is 0, 0 if the frame is
+ *         not a sensor frame or already has edges or a report
+ */
+static inline size_t SensorSentinel_v2_add_edges(uint8_t *frame, size_t length, uint8_t changed,
+                                                 const uint16_t *pulses)
+{
+  SensorSentinel_v2_header_t h;
+  if (!SensorSentinel_v2_parse_header(frame, length, &h) || h.messageType != SensorSentinel_MSG_SENSOR_V2 ||
+      h.edges || h.report)
+  {
+    return 0;
+  }
+  if (changed == 0)
+  {
+    return length;
+  }
+  frame[_v2_flags_offset(frame)] |= SensorSentinel_V2_FLAG_EDGES;
+  size_t n = length;
+  frame[n++] = changed;
+  for (int i = 0; i < 8; i++)
+  {
+    if (changed & (1 << i))
+    {
+      n += SensorSentinel_v2_put_varint(frame + n, pulses[i]);
+    }
+  }
+  return n;
+}
+
+#endif // SensorSentinel_CODEC_V2_H
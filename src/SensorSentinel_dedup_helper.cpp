@@ -0,0 +1,239 @@
+/**
+ * @file SensorSentinel_dedup_helper.cpp
+ * @brief Implementation of the bounded-probe duplicate-frame tables
+ */
+
+#include "SensorSentinel_dedup_helper.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+#if (DEDUP_TABLE_SIZE & (DEDUP_TABLE_SIZE - 1)) != 0
+#error "DEDUP_TABLE_SIZE must be a power of 2"
+#endif
+#if (DEDUP_NODE_TABLE_SIZE & (DEDUP_NODE_TABLE_SIZE - 1)) != 0
+#error "DEDUP_NODE_TABLE_SIZE must be a power of 2"
+#endif
+
+// One remembered (nodeId, counter) pair
+typedef struct {
+  uint32_t nodeId;
+  uint32_t counter;
+  uint32_t seenMs;
+  bool used;
+} _frame_entry_t;
+
+// Highest counter seen from one node
+typedef struct {
+  uint32_t nodeId;
+  uint32_t highest;
+  uint32_t seenMs;
+  bool used;
+} _node_entry_t;
+
+static _frame_entry_t _frames[DEDUP_TABLE_SIZE];
+static _node_entry_t _nodes[DEDUP_NODE_TABLE_SIZE];
+static uint32_t _ttlMs = DEDUP_TTL_MS;
+static SensorSentinel_dedup_stats_t _stats;
+
+// 32-bit finalizer (murmur3 fmix32) - spreads sequential IDs/counters
+static inline uint32_t _mix(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+static inline bool _expired(uint32_t seenMs, uint32_t nowMs)
+{
+  return (uint32_t)(nowMs - seenMs) > _ttlMs;
+}
+
+// Find the node entry, or claim a free/expired/oldest slot for it.
+// Sets *fresh when the returned entry was (re)initialised for this node.
+static _node_entry_t *_node_lookup(uint32_t nodeId, uint32_t nowMs, bool *fresh)
+{
+  uint32_t base = _mix(nodeId);
+  _node_entry_t *victim = NULL;
+
+  for (uint32_t i = 0; i < DEDUP_PROBE_LIMIT; i++)
+  {
+    _node_entry_t *e = &_nodes[(base + i) & (DEDUP_NODE_TABLE_SIZE - 1)];
+
+    if (e->used && e->nodeId == nodeId)
+    {
+      *fresh = _expired(e->seenMs, nowMs);
+      return e;
+    }
+
+    // Prefer an empty or expired slot; otherwise remember the oldest
+    if (!e->used || _expired(e->seenMs, nowMs))
+    {
+      if (!victim || victim->used)
+      {
+        victim = e;
+      }
+    }
+    else if (!victim || (victim->used && (int32_t)(e->seenMs - victim->seenMs) < 0))
+    {
+      victim = e;
+    }
+  }
+
+  if (victim->used && !_expired(victim->seenMs, nowMs))
+  {
+    _stats.nodeEvictions++;
+  }
+
+  victim->used = true;
+  victim->nodeId = nodeId;
+  *fresh = true;
+  return victim;
+}
+
+// Probe the frame table for (nodeId, counter)
+static bool _frame_find(uint32_t base, uint32_t nodeId, uint32_t counter, uint32_t nowMs)
+{
+  for (uint32_t i = 0; i < DEDUP_PROBE_LIMIT; i++)
+  {
+    const _frame_entry_t *e = &_frames[(base + i) & (DEDUP_TABLE_SIZE - 1)];
+
+    if (e->used && e->nodeId == nodeId && e->counter == counter && !_expired(e->seenMs, nowMs))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Record (nodeId, counter) in the first free/expired slot, or over the oldest
+static void _frame_insert(uint32_t base, uint32_t nodeId, uint32_t counter, uint32_t nowMs)
+{
+  _frame_entry_t *victim = NULL;
+
+  for (uint32_t i = 0; i < DEDUP_PROBE_LIMIT; i++)
+  {
+    _frame_entry_t *e = &_frames[(base + i) & (DEDUP_TABLE_SIZE - 1)];
+
+    if (!e->used || _expired(e->seenMs, nowMs))
+    {
+      victim = e;
+      break;
+    }
+    if (!victim || (int32_t)(e->seenMs - victim->seenMs) < 0)
+    {
+      victim = e;
+    }
+  }
+
+  if (victim->used && !_expired(victim->seenMs, nowMs))
+  {
+    _stats.evictions++;
+  }
+
+  victim->used = true;
+  victim->nodeId = nodeId;
+  victim->counter = counter;
+  victim->seenMs = nowMs;
+}
+
+void SensorSentinel_dedup_init(uint32_t ttlMs)
+{
+  memset(_frames, 0, sizeof(_frames));
+  memset(_nodes, 0, sizeof(_nodes));
+  memset(&_stats, 0, sizeof(_stats));
+  _ttlMs = ttlMs;
+}
+
+SensorSentinel_dedup_result_t SensorSentinel_dedup_check_at(uint32_t nodeId, uint32_t messageCounter,
+                                                            uint32_t nowMs)
+{
+  _stats.lookups++;
+
+  bool fresh = false;
+  _node_entry_t *node = _node_lookup(nodeId, nowMs, &fresh);
+  uint32_t base = _mix(nodeId ^ _mix(messageCounter));
+
+  // Newer than anything seen from this node: cannot be in the frame table.
+  // A node entry that was just (re)claimed may have been evicted while its
+  // frames are still live, so that case always probes.
+  bool advance = true;
+  if (!fresh && messageCounter > node->highest)
+  {
+    _stats.fastPath++;
+  }
+  else if (_frame_find(base, nodeId, messageCounter, nowMs))
+  {
+    // A slot claimed just for this lookup still holds its previous node's
+    // counter; give it back so the node's next frame probes as well
+    if (fresh)
+    {
+      node->used = false;
+    }
+    _stats.hits++;
+    return DEDUP_DUPLICATE;
+  }
+  else if (fresh)
+  {
+    // First frame from this node within the TTL
+  }
+  else if (messageCounter < DEDUP_RESTART_COUNTER || node->highest - messageCounter > DEDUP_REBOOT_GAP)
+  {
+    // Counter went back to (near) zero: the node rebooted
+    _stats.restarts++;
+  }
+  else if (DEDUP_REJECT_STALE)
+  {
+    _stats.stale++;
+    return DEDUP_STALE;
+  }
+  else
+  {
+    advance = false;
+  }
+
+  if (advance)
+  {
+    node->highest = messageCounter;
+  }
+  node->seenMs = nowMs;
+
+  _frame_insert(base, nodeId, messageCounter, nowMs);
+  _stats.misses++;
+  return DEDUP_NEW;
+}
+
+#ifdef ARDUINO
+SensorSentinel_dedup_result_t SensorSentinel_dedup_check(uint32_t nodeId, uint32_t messageCounter)
+{
+  return SensorSentinel_dedup_check_at(nodeId, messageCounter, millis());
+}
+#endif
+
+void SensorSentinel_dedup_get_stats(SensorSentinel_dedup_stats_t *stats)
+{
+  if (stats)
+  {
+    *stats = _stats;
+  }
+}
+
+const char *SensorSentinel_dedup_result_to_string(SensorSentinel_dedup_result_t result)
+{
+  switch (result)
+  {
+  case DEDUP_NEW:
+    return "New";
+  case DEDUP_DUPLICATE:
+    return "Duplicate";
+  case DEDUP_STALE:
+    return "Stale";
+  default:
+    return "Unknown";
+  }
+}
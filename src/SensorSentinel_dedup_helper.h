@@ -0,0 +1,105 @@
+/**
+ * @file SensorSentinel_dedup_helper.h
+ * @brief Duplicate-frame detection shared by the gateway and the repeater
+ *
+ * Two fixed-size open-addressing hash tables with bounded probing, so every
+ * lookup touches at most DEDUP_PROBE_LIMIT slots regardless of table size:
+ *
+ * 1. Frame table keyed on (nodeId, messageCounter). Entries expire after
+ *    the TTL; when a probe window is full the oldest entry is evicted.
+ * 2. Node table keyed on nodeId, holding the highest counter seen. A frame
+ *    newer than that is accepted without probing the frame table, and an
+ *    older frame that is no longer in the frame table is rejected as stale.
+ *
+ * A counter that drops to near zero, or far below the highest seen, is
+ * treated as a node restart rather than a stale frame.
+ *
+ * The implementation has no Arduino dependency apart from millis() in
+ * SensorSentinel_dedup_check(), so the tables can be exercised on the host.
+ */
+
+#ifndef SensorSentinel_DEDUP_HELPER_H
+#define SensorSentinel_DEDUP_HELPER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Table sizes (must be powers of two)
+#ifndef DEDUP_TABLE_SIZE
+#define DEDUP_TABLE_SIZE       512     // Remembered (nodeId, counter) pairs
+#endif
+#ifndef DEDUP_NODE_TABLE_SIZE
+#define DEDUP_NODE_TABLE_SIZE  512     // Tracked nodes
+#endif
+#define DEDUP_PROBE_LIMIT      8       // Slots examined per lookup
+
+#ifndef DEDUP_TTL_MS
+#define DEDUP_TTL_MS           600000  // Forget frames/nodes after 10 minutes
+#endif
+#define DEDUP_RESTART_COUNTER  16      // Counters below this may mean a reboot
+#define DEDUP_REBOOT_GAP       1024    // Drop larger than this means a reboot
+#ifndef DEDUP_REJECT_STALE
+#define DEDUP_REJECT_STALE     1       // 0 = accept out-of-order frames as new
+#endif
+
+/**
+ * @brief Result of a duplicate check
+ */
+typedef enum {
+  DEDUP_NEW,        ///< First time this frame is seen (now recorded)
+  DEDUP_DUPLICATE,  ///< Frame is in the table
+  DEDUP_STALE       ///< Older than the node's highest counter and not in the table
+} SensorSentinel_dedup_result_t;
+
+/**
+ * @brief Dedup table counters
+ */
+typedef struct {
+  uint32_t lookups;        // Frames checked
+  uint32_t hits;           // Duplicates found in the frame table
+  uint32_t misses;         // New frames
+  uint32_t stale;          // Frames rejected as stale
+  uint32_t fastPath;       // New frames accepted on the highest-counter check alone
+  uint32_t restarts;       // Node counter resets detected
+  uint32_t evictions;      // Live frame entries overwritten before their TTL
+  uint32_t nodeEvictions;  // Live node entries overwritten before their TTL
+} SensorSentinel_dedup_stats_t;
+
+/**
+ * @brief Clear both tables and the statistics
+ * @param ttlMs Time after which frame and node entries expire
+ */
+void SensorSentinel_dedup_init(uint32_t ttlMs = DEDUP_TTL_MS);
+
+/**
+ * @brief Check a frame and record it if new, using millis() as the clock
+ * @param nodeId Node ID from the frame
+ * @param messageCounter Message counter from the frame
+ * @return Whether the frame is new, a duplicate or stale
+ */
+SensorSentinel_dedup_result_t SensorSentinel_dedup_check(uint32_t nodeId, uint32_t messageCounter);
+
+/**
+ * @brief Check a frame and record it if new, with an explicit clock
+ * @param nodeId Node ID from the frame
+ * @param messageCounter Message counter from the frame
+ * @param nowMs Current time in milliseconds
+ * @return Whether the frame is new, a duplicate or stale
+ */
+SensorSentinel_dedup_result_t SensorSentinel_dedup_check_at(uint32_t nodeId, uint32_t messageCounter,
+                                                            uint32_t nowMs);
+
+/**
+ * @brief Get a snapshot of the dedup counters
+ * @param stats Pointer to the structure to fill
+ */
+void SensorSentinel_dedup_get_stats(SensorSentinel_dedup_stats_t *stats);
+
+/**
+ * @brief Convert a dedup result to a human-readable string
+ * @param result The dedup result
+ * @return "New", "Duplicate" or "Stale"
+ */
+const char *SensorSentinel_dedup_result_to_string(SensorSentinel_dedup_result_t result);
+
+#endif // SensorSentinel_DEDUP_HELPER_H
@@ -7,6 +7,8 @@
 #include "heltec_unofficial_revised.h"
 #include "SensorSentinel_pins_helper.h"
 #include "SensorSentinel_packet_helper.h"
+#include "SensorSentinel_metrics_helper.h"
+#include "SensorSentinel_mesh_helper.h"
 #include <WiFi.h>
 #include <WebServer.h>
 #include <Preferences.h>
@@ -18,8 +20,18 @@ static const char* NVS_NAMESPACE           = "sentinel";
 static const char* NVS_KEY_INTERVAL        = "interval";
 static const char* NVS_KEY_SENSOR_INTERVAL = "sensor_ivl";
 static const char* NVS_KEY_MQTT_SERVER     = "mqtt_srv";
+static const char* NVS_KEY_AGGREGATE_COUNT = "agg_n";
+static const char* NVS_KEY_AGGREGATE_MODE  = "agg_mode";
+static const char* NVS_KEY_HEARTBEAT       = "heartbeat";
+static const char* NVS_KEY_DEADBAND        = "deadband";   // + pin index
+static const char* NVS_KEY_REPEAT_RSSI     = "rpt_rssi";
+static const char* NVS_KEY_REPEAT_ALLOW    = "rpt_allow";
 static const int   DEFAULT_INTERVAL        = 30;   // sender sleep interval (s)
 static const int   DEFAULT_SENSOR_INTERVAL = 60;   // repeater sensor TX interval (s)
+static const int   DEFAULT_AGGREGATE_COUNT = 1;    // readings per TX (1 = no aggregation)
+static const int   DEFAULT_HEARTBEAT       = 1;    // max wakes per TX (1 = send every wake)
+static const int   DEFAULT_DEADBAND        = 16;   // ADC counts of change ignored
+static const int   DEFAULT_REPEAT_RSSI     = 0;    // repeater RSSI threshold (0 = repeat any RSSI)
 
 int SensorSentinel_diag_get_interval() {
   prefs.begin(NVS_NAMESPACE, true);
@@ -47,6 +59,32 @@ static void SensorSentinel_diag_set_sensor_interval(int seconds) {
   prefs.end();
 }
 
+int SensorSentinel_diag_get_repeat_rssi() {
+  prefs.begin(NVS_NAMESPACE, true);
+  int val = prefs.getInt(NVS_KEY_REPEAT_RSSI, DEFAULT_REPEAT_RSSI);
+  prefs.end();
+  return val;
+}
+
+static void SensorSentinel_diag_set_repeat_rssi(int dbm) {
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putInt(NVS_KEY_REPEAT_RSSI, dbm);
+  prefs.end();
+}
+
+String SensorSentinel_diag_get_repeat_allowlist() {
+  prefs.begin(NVS_NAMESPACE, true);
+  String val = prefs.getString(NVS_KEY_REPEAT_ALLOW, "");
+  prefs.end();
+  return val;
+}
+
+static void SensorSentinel_diag_set_repeat_allowlist(const String &list) {
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putString(NVS_KEY_REPEAT_ALLOW, list);
+  prefs.end();
+}
+
 String SensorSentinel_diag_get_mqtt_server() {
   prefs.begin(NVS_NAMESPACE, true);
   String val = prefs.getString(NVS_KEY_MQTT_SERVER, MQTT_SERVER);
@@ -60,6 +98,61 @@ static void SensorSentinel_diag_set_mqtt_server(const String& server) {
   prefs.end();
 }
 
+int SensorSentinel_diag_get_aggregate_count() {
+  prefs.begin(NVS_NAMESPACE, true);
+  int val = prefs.getInt(NVS_KEY_AGGREGATE_COUNT, DEFAULT_AGGREGATE_COUNT);
+  prefs.end();
+  return constrain(val, 1, AGGREGATE_MAX_SAMPLES);
+}
+
+static void SensorSentinel_diag_set_aggregate_count(int count) {
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putInt(NVS_KEY_AGGREGATE_COUNT, count);
+  prefs.end();
+}
+
+int SensorSentinel_diag_get_aggregate_mode() {
+  prefs.begin(NVS_NAMESPACE, true);
+  int val = prefs.getInt(NVS_KEY_AGGREGATE_MODE, AGGREGATE_MODE_SAMPLES);
+  prefs.end();
+  return val;
+}
+
+static void SensorSentinel_diag_set_aggregate_mode(int mode) {
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putInt(NVS_KEY_AGGREGATE_MODE, mode);
+  prefs.end();
+}
+
+int SensorSentinel_diag_get_heartbeat() {
+  prefs.begin(NVS_NAMESPACE, true);
+  int val = prefs.getInt(NVS_KEY_HEARTBEAT, DEFAULT_HEARTBEAT);
+  prefs.end();
+  return max(val, 1);
+}
+
+static void SensorSentinel_diag_set_heartbeat(int wakes) {
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putInt(NVS_KEY_HEARTBEAT, wakes);
+  prefs.end();
+}
+
+void SensorSentinel_diag_get_deadbands(uint16_t deadbands[SensorSentinel_ANALOG_COUNT]) {
+  prefs.begin(NVS_NAMESPACE, true);
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++) {
+    String key = String(NVS_KEY_DEADBAND) + i;
+    deadbands[i] = (uint16_t)prefs.getInt(key.c_str(), DEFAULT_DEADBAND);
+  }
+  prefs.end();
+}
+
+static void SensorSentinel_diag_set_deadband(int pin, int counts) {
+  prefs.begin(NVS_NAMESPACE, false);
+  String key = String(NVS_KEY_DEADBAND) + pin;
+  prefs.putInt(key.c_str(), counts);
+  prefs.end();
+}
+
 static String buildPage() {
   uint32_t nodeId = SensorSentinel_generate_node_id();
   float vbat = heltec_vbat();
@@ -102,6 +195,31 @@ static String buildPage() {
     html += ">" + String(sensorLabels[i]) + "</button>";
   }
   html += "</form>";
+
+  // Repeater: which frames to forward
+  int currentRepeatRssi = SensorSentinel_diag_get_repeat_rssi();
+  String currentAllow = SensorSentinel_diag_get_repeat_allowlist();
+  html += "<h2>Repeat Rules</h2>";
+  html += "<p>Repeat only frames heard below the RSSI threshold; listed node IDs are always repeated. "
+          "With a list and no threshold only those nodes are repeated.</p>";
+  html += "<p>Current: <span class='val'>";
+  html += (currentRepeatRssi == 0) ? String("any RSSI") : "below " + String(currentRepeatRssi) + " dBm";
+  html += currentAllow.length() ? ", always " + currentAllow : String("");
+  html += "</span></p>";
+  html += "<form method='POST' action='/setmode'>";
+  int rssiOpts[] = {0, -80, -90, -100, -110};
+  for (int i = 0; i < 5; i++) {
+    html += "<button type='submit' name='rpt_rssi' value='" + String(rssiOpts[i]) + "'";
+    if (currentRepeatRssi == rssiOpts[i]) html += " class='active'";
+    html += ">" + (rssiOpts[i] == 0 ? String("Any") : "&lt;" + String(rssiOpts[i])) + "</button>";
+  }
+  html += "</form>";
+  html += "<form method='POST' action='/setmode'>";
+  html += "<input type='text' name='rpt_allow' value='" + currentAllow + "' placeholder='0x1a2b3c4d, ...' "
+          "style='font-family:monospace;background:#111;color:#0f0;border:1px solid #0af;"
+          "padding:6px;width:260px;font-size:14px;'>";
+  html += " <button type='submit'>Set</button>";
+  html += "</form>";
 #else
   // Sender: show sleep interval
   html += "<h2>Send Interval</h2>";
@@ -116,6 +234,64 @@ static String buildPage() {
   if (currentInterval == 300) html += " class='active'";
   html += ">Slow (5min)</button>";
   html += "</form>";
+
+  // Sender: readings per transmission
+  int currentAggCount = SensorSentinel_diag_get_aggregate_count();
+  int currentAggMode = SensorSentinel_diag_get_aggregate_mode();
+  html += "<h2>Aggregation</h2>";
+  html += "<p>Read the pins every wake, transmit every Nth. A digital pin change sends at once.</p>";
+  html += "<p>Current: <span class='val'>";
+  if (currentAggCount <= 1) {
+    html += "every wake";
+  } else {
+    html += "every " + String(currentAggCount) + " wakes, ";
+    html += (currentAggMode == AGGREGATE_MODE_SUMMARY) ? "min/max/mean" : "all readings";
+  }
+  html += "</span></p>";
+  html += "<form method='POST' action='/setmode'>";
+  int aggOpts[] = {1, 4, 8, AGGREGATE_MAX_SAMPLES};
+  for (int i = 0; i < 4; i++) {
+    html += "<button type='submit' name='agg_n' value='" + String(aggOpts[i]) + "'";
+    if (currentAggCount == aggOpts[i]) html += " class='active'";
+    html += ">N=" + String(aggOpts[i]) + "</button>";
+  }
+  html += "</form>";
+  html += "<form method='POST' action='/setmode'>";
+  html += "<button type='submit' name='agg_mode' value='0'";
+  if (currentAggMode == AGGREGATE_MODE_SAMPLES) html += " class='active'";
+  html += ">All readings</button>";
+  html += "<button type='submit' name='agg_mode' value='1'";
+  if (currentAggMode == AGGREGATE_MODE_SUMMARY) html += " class='active'";
+  html += ">Min/max/mean</button>";
+  html += "</form>";
+
+  // Sender: report-by-exception
+  int currentHeartbeat = SensorSentinel_diag_get_heartbeat();
+  uint16_t deadbands[SensorSentinel_ANALOG_COUNT];
+  SensorSentinel_diag_get_deadbands(deadbands);
+  html += "<h2>Report by Exception</h2>";
+  html += "<p>Skip TX while every analog pin stays within its deadband of the last sent value "
+          "and no digital pin changes. A heartbeat is sent at least every K wakes.</p>";
+  html += "<p>Current: <span class='val'>";
+  html += (currentHeartbeat <= 1) ? String("off (send every wake)") : "K=" + String(currentHeartbeat);
+  html += "</span></p>";
+  html += "<form method='POST' action='/setmode'>";
+  int heartbeatOpts[] = {1, 5, 10, 30};
+  for (int i = 0; i < 4; i++) {
+    html += "<button type='submit' name='heartbeat' value='" + String(heartbeatOpts[i]) + "'";
+    if (currentHeartbeat == heartbeatOpts[i]) html += " class='active'";
+    html += ">" + (heartbeatOpts[i] == 1 ? String("Off") : "K=" + String(heartbeatOpts[i])) + "</button>";
+  }
+  html += "</form>";
+  html += "<form method='POST' action='/setmode'>";
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++) {
+    html += "A" + String(i) + " &plusmn;<input type='number' min='0' max='4095' name='deadband" + String(i) +
+            "' value='" + String(deadbands[i]) + "' "
+            "style='font-family:monospace;background:#111;color:#0f0;border:1px solid #0af;"
+            "padding:6px;width:70px;font-size:14px;margin-right:8px;'>";
+  }
+  html += " <button type='submit'>Set</button>";
+  html += "</form>";
 #endif
 
   // MQTT server
@@ -145,8 +321,10 @@ static String buildPage() {
   // Analog pins
   html += "<h2>Analog Pins</h2><table>";
   html += "<tr><th>Pin</th><th>GPIO</th><th>Value</th></tr>";
+  uint16_t analog[SensorSentinel_ANALOG_COUNT];
+  SensorSentinel_read_all_analog(analog, SensorSentinel_ANALOG_COUNT);
   for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++) {
-    uint16_t val = analogRead(SensorSentinel_analog_pins[i]);
+    uint16_t val = analog[i];
     html += "<tr><td>A" + String(i) + "</td>";
     html += "<td>" + String(SensorSentinel_analog_pins[i]) + "</td>";
     html += "<td class='val'>" + String(val) + "</td></tr>";
@@ -212,6 +390,67 @@ static void handleSetMode() {
     } else {
       server.send(400, "text/plain", "Invalid sensor interval");
     }
+  } else if (server.hasArg("rpt_rssi")) {
+    int v = server.arg("rpt_rssi").toInt();
+    if (v == 0 || (v >= -140 && v <= -20)) {
+      SensorSentinel_diag_set_repeat_rssi(v);
+      Serial.printf("Repeat RSSI threshold set to %d dBm\n", v);
+      redirectOk(v == 0 ? String("Repeating any RSSI.") : "Repeating below " + String(v) + " dBm.");
+    } else {
+      server.send(400, "text/plain", "Invalid RSSI threshold");
+    }
+  } else if (server.hasArg("rpt_allow")) {
+    String v = server.arg("rpt_allow");
+    v.trim();
+    if (v.length() < 192 && SensorSentinel_mesh_parse_allowlist(v.c_str(), NULL) >= 0) {
+      SensorSentinel_diag_set_repeat_allowlist(v);
+      Serial.printf("Repeat allowlist set to [%s]\n", v.c_str());
+      redirectOk(v.length() ? "Allowlist set." : "Allowlist cleared.");
+    } else {
+      server.send(400, "text/plain", "Invalid allowlist");
+    }
+  } else if (server.hasArg("agg_n")) {
+    int v = server.arg("agg_n").toInt();
+    if (v >= 1 && v <= AGGREGATE_MAX_SAMPLES) {
+      SensorSentinel_diag_set_aggregate_count(v);
+      Serial.printf("Aggregate count set to %d\n", v);
+      redirectOk("Sending every " + String(v) + " wakes.");
+    } else {
+      server.send(400, "text/plain", "Invalid aggregate count");
+    }
+  } else if (server.hasArg("agg_mode")) {
+    int v = server.arg("agg_mode").toInt();
+    if (v == AGGREGATE_MODE_SAMPLES || v == AGGREGATE_MODE_SUMMARY) {
+      SensorSentinel_diag_set_aggregate_mode(v);
+      Serial.printf("Aggregate mode set to %d\n", v);
+      redirectOk(v == AGGREGATE_MODE_SUMMARY ? "Sending min/max/mean." : "Sending all readings.");
+    } else {
+      server.send(400, "text/plain", "Invalid aggregate mode");
+    }
+  } else if (server.hasArg("heartbeat")) {
+    int v = server.arg("heartbeat").toInt();
+    if (v >= 1 && v <= 255) {
+      SensorSentinel_diag_set_heartbeat(v);
+      Serial.printf("Heartbeat set to %d wakes\n", v);
+      redirectOk(v <= 1 ? String("Sending every wake.") : "Heartbeat every " + String(v) + " wakes.");
+    } else {
+      server.send(400, "text/plain", "Invalid heartbeat");
+    }
+  } else if (server.hasArg("deadband0")) {
+    int values[SensorSentinel_ANALOG_COUNT];
+    for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++) {
+      String arg = "deadband" + String(i);
+      values[i] = server.hasArg(arg) ? server.arg(arg).toInt() : -1;
+      if (values[i] < 0 || values[i] > 4095) {
+        server.send(400, "text/plain", "Invalid deadband");
+        return;
+      }
+    }
+    for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++) {
+      SensorSentinel_diag_set_deadband(i, values[i]);
+    }
+    Serial.printf("Deadbands set to %d/%d/%d/%d\n", values[0], values[1], values[2], values[3]);
+    redirectOk("Deadbands set.");
   } else if (server.hasArg("mqtt_server")) {
     String v = server.arg("mqtt_server");
     v.trim();
@@ -227,6 +466,28 @@ static void handleSetMode() {
   }
 }
 
+static void handleMetrics() {
+  server.send(200, "text/plain; version=0.0.4", SensorSentinel_metrics_format());
+}
+
+static bool _metricsServing = false;
+
+void SensorSentinel_diag_metrics_begin() {
+#if METRICS_MODE
+  if (_metricsServing) return;
+  server.on("/metrics", handleMetrics);
+  server.begin();
+  _metricsServing = true;
+  Serial.println("Metrics at http://<ip>/metrics");
+#endif
+}
+
+void SensorSentinel_diag_metrics_loop() {
+  if (_metricsServing) {
+    server.handleClient();
+  }
+}
+
 void SensorSentinel_diag_check() {
   // Show prompt on display
   heltec_clear_display();
@@ -280,6 +541,7 @@ void SensorSentinel_diag_run() {
   // Start web server
   server.on("/", handleRoot);
   server.on("/setmode", HTTP_POST, handleSetMode);
+  server.on("/metrics", handleMetrics);
   server.begin();
 
   Serial.printf("Diagnostic AP started: %s\n", ssid);
@@ -37,10 +37,62 @@ int SensorSentinel_diag_get_interval();
  */
 int SensorSentinel_diag_get_sensor_interval();
 
+/**
+ * @brief Get the repeat RSSI threshold (repeater mode)
+ * @return Only frames first heard below this many dBm are repeated; 0 = no threshold (default)
+ */
+int SensorSentinel_diag_get_repeat_rssi();
+
+/**
+ * @brief Get the node IDs always repeated (repeater mode)
+ * @return Comma-separated list (see SensorSentinel_mesh_parse_allowlist()); empty by default
+ */
+String SensorSentinel_diag_get_repeat_allowlist();
+
+/**
+ * @brief Get the number of wakes per aggregate transmission (sender mode)
+ * @return 1..AGGREGATE_MAX_SAMPLES (default 1: send every wake, no aggregation)
+ */
+int SensorSentinel_diag_get_aggregate_count();
+
+/**
+ * @brief Get the aggregate body format (sender mode)
+ * @return AGGREGATE_MODE_SAMPLES (default) or AGGREGATE_MODE_SUMMARY
+ */
+int SensorSentinel_diag_get_aggregate_mode();
+
+/**
+ * @brief Get the report-by-exception heartbeat (sender mode)
+ *
+ * While nothing changes the sender transmits at least every this many wakes.
+ *
+ * @return Wakes (default 1: send every wake, report-by-exception off)
+ */
+int SensorSentinel_diag_get_heartbeat();
+
+/**
+ * @brief Get the per-pin report-by-exception deadbands (sender mode)
+ * @param deadbands Filled with the ADC counts of change ignored on each analog pin (default 16)
+ */
+void SensorSentinel_diag_get_deadbands(uint16_t deadbands[4]);
+
 /**
  * @brief Get the configured MQTT server from NVS
  * @return MQTT server string (falls back to compile-time MQTT_SERVER if not set)
  */
 String SensorSentinel_diag_get_mqtt_server();
 
+/**
+ * @brief Serve /metrics (Prometheus text) during normal operation
+ *
+ * Starts the diagnostic web server on the station interface with only the
+ * /metrics route. No-op when built with -DMETRICS_MODE=0.
+ */
+void SensorSentinel_diag_metrics_begin();
+
+/**
+ * @brief Handle pending /metrics requests; call from the main loop
+ */
+void SensorSentinel_diag_metrics_loop();
+
 #endif // SensorSentinel_DIAG_H
@@ -0,0 +1,176 @@
+/**
+ * @file SensorSentinel_lbt_helper.cpp
+ * @brief CAD, backoff and per-node PRNG for listen-before-talk
+ */
+
+#include "SensorSentinel_lbt_helper.h"
+#include "SensorSentinel_log_helper.h"
+#include "heltec_unofficial_revised.h"
+
+// PRNG state, 0 until seeded; kept across deep sleep so wakes do not repeat
+static RTC_DATA_ATTR uint32_t _rng = 0;
+
+// Counts not yet carried by an uplink, and totals since power-on
+static RTC_DATA_ATTR SensorSentinel_tx_report_t _pending = {};
+static RTC_DATA_ATTR SensorSentinel_lbt_stats_t _stats = {};
+
+// The radio task (repeaters with THREADED_RUNTIME) counts, the uplink side reports
+static portMUX_TYPE _lbtMux = portMUX_INITIALIZER_UNLOCKED;
+
+// murmur3 fmix32, as in the dedup tables; spreads similar node IDs apart
+static inline uint32_t _mix(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+uint32_t SensorSentinel_lbt_random(uint32_t bound)
+{
+  if (bound == 0)
+  {
+    return 0;
+  }
+
+  portENTER_CRITICAL(&_lbtMux);
+  if (_rng == 0)
+  {
+    _rng = _mix(SensorSentinel_generate_node_id()) | 1;  // xorshift32 must not start at 0
+  }
+  // xorshift32
+  uint32_t x = _rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  _rng = x;
+  portEXIT_CRITICAL(&_lbtMux);
+
+  return (uint32_t)(((uint64_t)x * bound) >> 32);
+}
+
+uint64_t SensorSentinel_lbt_sleep_ms(uint32_t intervalSecs)
+{
+  uint64_t nominal = (uint64_t)intervalSecs * 1000;
+  uint32_t span = (uint32_t)(nominal * LBT_SLEEP_JITTER_PCT / 100);
+  if (span == 0)
+  {
+    return nominal;
+  }
+  return nominal - span + SensorSentinel_lbt_random(2 * span + 1);
+}
+
+uint32_t SensorSentinel_lbt_backoff_ms(uint8_t attempt, uint32_t airtimeMs)
+{
+  uint32_t window = max<uint32_t>(airtimeMs, 1);
+  for (uint8_t i = 0; i < attempt && window < LBT_MAX_BACKOFF_MS; i++)
+  {
+    window <<= 1;
+  }
+  window = min<uint32_t>(window, LBT_MAX_BACKOFF_MS);
+  // At least one frame's airtime, so a busy channel has time to clear
+  return min<uint32_t>(airtimeMs + SensorSentinel_lbt_random(window), LBT_MAX_BACKOFF_MS);
+}
+
+bool SensorSentinel_lbt_channel_busy()
+{
+#if LBT_MODE && !defined(NO_RADIOLIB)
+  int state = radio.scanChannel();
+  bool busy = (state == RADIOLIB_LORA_DETECTED || state == RADIOLIB_PREAMBLE_DETECTED);
+
+  portENTER_CRITICAL(&_lbtMux);
+  _stats.checks++;
+  if (busy)
+  {
+    _stats.busy++;
+    if (_pending.busy < UINT8_MAX)
+    {
+      _pending.busy++;
+    }
+  }
+  portEXIT_CRITICAL(&_lbtMux);
+  return busy;
+#else
+  return false;
+#endif
+}
+
+void SensorSentinel_lbt_note_backoff(uint32_t backoffMs)
+{
+  portENTER_CRITICAL(&_lbtMux);
+  _stats.backoffMs += backoffMs;
+  _pending.backoffMs = (uint16_t)min<uint32_t>((uint32_t)_pending.backoffMs + backoffMs, UINT16_MAX);
+  portEXIT_CRITICAL(&_lbtMux);
+}
+
+void SensorSentinel_lbt_note_forced()
+{
+  portENTER_CRITICAL(&_lbtMux);
+  _stats.forced++;
+  if (_pending.forced < UINT8_MAX)
+  {
+    _pending.forced++;
+  }
+  portEXIT_CRITICAL(&_lbtMux);
+}
+
+uint8_t SensorSentinel_lbt_wait_clear(uint32_t airtimeMs)
+{
+#if LBT_MODE && !defined(NO_RADIOLIB)
+  for (uint8_t attempt = 0; attempt < LBT_MAX_ATTEMPTS; attempt++)
+  {
+    if (!SensorSentinel_lbt_channel_busy())
+    {
+      return attempt;
+    }
+    uint32_t wait = SensorSentinel_lbt_backoff_ms(attempt, airtimeMs);
+    SensorSentinel_lbt_note_backoff(wait);
+    SensorSentinel_log_d("LBT: channel busy, backing off %u ms (%u/%u)\n", wait, attempt + 1, LBT_MAX_ATTEMPTS);
+    delay(wait);
+  }
+  SensorSentinel_lbt_note_forced();
+  SensorSentinel_log_w("LBT: channel still busy after %u checks, sending anyway\n", LBT_MAX_ATTEMPTS);
+  return LBT_MAX_ATTEMPTS;
+#else
+  return 0;
+#endif
+}
+
+bool SensorSentinel_lbt_take_report(SensorSentinel_tx_report_t *report)
+{
+  if (!report)
+  {
+    return false;
+  }
+  portENTER_CRITICAL(&_lbtMux);
+  *report = _pending;
+  portEXIT_CRITICAL(&_lbtMux);
+  return LBT_REPORT && (report->busy || report->forced || report->backoffMs);
+}
+
+void SensorSentinel_lbt_report_sent(const SensorSentinel_tx_report_t *report)
+{
+  if (!report)
+  {
+    return;
+  }
+  portENTER_CRITICAL(&_lbtMux);
+  _pending.busy -= min(_pending.busy, report->busy);
+  _pending.forced -= min(_pending.forced, report->forced);
+  _pending.backoffMs -= min(_pending.backoffMs, report->backoffMs);
+  _stats.reports++;
+  portEXIT_CRITICAL(&_lbtMux);
+}
+
+void SensorSentinel_lbt_get_stats(SensorSentinel_lbt_stats_t *stats)
+{
+  if (!stats)
+  {
+    return;
+  }
+  portENTER_CRITICAL(&_lbtMux);
+  *stats = _stats;
+  portEXIT_CRITICAL(&_lbtMux);
+}
@@ -0,0 +1,149 @@
+/**
+ * @file SensorSentinel_lbt_helper.h
+ * @brief Listen-before-talk: channel activity detection before each uplink,
+ *        jittered exponential backoff and per-node timing jitter
+ *
+ * Senders on the same interval that were powered up together wake in
+ * lockstep and keep colliding. Each node therefore draws its sleep time and
+ * repeat delays from a small PRNG seeded with its node ID: no two nodes
+ * share a schedule, and a node's own schedule is reproducible.
+ *
+ * Before a frame goes on air the radio runs channel activity detection
+ * (CAD). While CAD finds a LoRa preamble the frame waits a random time in a
+ * window that starts at the frame's time-on-air and doubles with each busy
+ * check (up to LBT_MAX_BACKOFF_MS); after LBT_MAX_ATTEMPTS busy checks it
+ * is sent anyway. The deep-sleep sender waits in
+ * SensorSentinel_lbt_wait_clear(). Queued frames (repeaters, gateways) are
+ * checked by the TX queue in the RadioLib helper and put back with a later
+ * due time, so the radio keeps receiving while they wait; urgent frames
+ * (SensorSentinel_TX_PRIORITY_URGENT, e.g. ADR hints) skip the check.
+ *
+ * LoRa gives no collision feedback without acknowledgements, so the busy
+ * checks stand in for collisions: they are the ones LBT avoided. A node
+ * reports them, with forced sends and time spent backing off, in-band on
+ * its next uplink (SensorSentinel_tx_report_t), so the backend can see
+ * where the channel is congested.
+ *
+ * Set via platformio.ini build flags: -DLBT_MODE=0, -DLBT_REPORT=0
+ */
+
+#ifndef SensorSentinel_LBT_HELPER_H
+#define SensorSentinel_LBT_HELPER_H
+
+#include <Arduino.h>
+#include "SensorSentinel_packet_helper.h"
+
+#ifndef LBT_MODE
+#define LBT_MODE 1  // CAD before TX; 0 keeps only the timing jitter
+#endif
+
+#ifndef LBT_REPORT
+#define LBT_REPORT 1  // Append SensorSentinel_tx_report_t to uplinks when nonzero
+#endif
+
+#ifndef LBT_MAX_ATTEMPTS
+#define LBT_MAX_ATTEMPTS 5  // Busy checks before a frame is sent regardless
+#endif
+#ifndef LBT_MAX_BACKOFF_MS
+#define LBT_MAX_BACKOFF_MS 4000  // Cap on one backoff window
+#endif
+
+#ifndef LBT_SLEEP_JITTER_PCT
+#define LBT_SLEEP_JITTER_PCT 10  // Deep sleep varies by +/- this much of the interval
+#endif
+#ifndef LBT_REPEAT_JITTER_MS
+#define LBT_REPEAT_JITTER_MS 400  // Spread on top of a repeater's fixed delay
+#endif
+
+/**
+ * @brief LBT counters since power-on
+ */
+typedef struct {
+  uint32_t checks;     // CAD runs
+  uint32_t busy;       // CAD runs that found the channel busy
+  uint32_t forced;     // Frames sent after LBT_MAX_ATTEMPTS busy checks
+  uint32_t backoffMs;  // Total time frames were held back
+  uint32_t reports;    // Reports carried by uplinks
+} SensorSentinel_lbt_stats_t;
+
+/**
+ * @brief Draw from the node's PRNG
+ *
+ * Seeded once from SensorSentinel_generate_node_id(); the state is kept in
+ * RTC memory across deep sleep.
+ *
+ * @param bound Exclusive upper bound
+ * @return 0..bound-1 (0 when bound is 0)
+ */
+uint32_t SensorSentinel_lbt_random(uint32_t bound);
+
+/**
+ * @brief Jittered deep-sleep time for a send interval
+ * @param intervalSecs Nominal interval
+ * @return intervalSecs +/- LBT_SLEEP_JITTER_PCT, in ms (mean is the interval)
+ */
+uint64_t SensorSentinel_lbt_sleep_ms(uint32_t intervalSecs);
+
+/**
+ * @brief Random delay for a frame after its attempt-th busy check
+ * @param attempt Busy checks so far, from 0
+ * @param airtimeMs Time-on-air of the frame; the first window
+ * @return Delay in ms, at most LBT_MAX_BACKOFF_MS
+ */
+uint32_t SensorSentinel_lbt_backoff_ms(uint8_t attempt, uint32_t airtimeMs);
+
+/**
+ * @brief Run one CAD and count it
+ *
+ * The caller holds the radio (SensorSentinel_radio_lock()). Leaves the
+ * radio in standby.
+ *
+ * @return true if a LoRa preamble was detected
+ */
+bool SensorSentinel_lbt_channel_busy();
+
+/**
+ * @brief Deep-sleep sender: wait until the channel is clear
+ *
+ * Backs off with SensorSentinel_lbt_backoff_ms() while CAD finds the
+ * channel busy. The caller holds the radio.
+ *
+ * @param airtimeMs Time-on-air of the frame about to be sent
+ * @return Busy checks before the channel was clear (LBT_MAX_ATTEMPTS if it never was)
+ */
+uint8_t SensorSentinel_lbt_wait_clear(uint32_t airtimeMs);
+
+/**
+ * @brief Record a backoff decided outside SensorSentinel_lbt_wait_clear()
+ * @param backoffMs Delay the frame was given
+ */
+void SensorSentinel_lbt_note_backoff(uint32_t backoffMs);
+
+/**
+ * @brief Record a frame sent while the channel was still busy
+ */
+void SensorSentinel_lbt_note_forced();
+
+/**
+ * @brief Counters for the next uplink
+ * @param report Filled with the counts since the last report that went out
+ * @return true if there is anything to report (and LBT_REPORT is on)
+ */
+bool SensorSentinel_lbt_take_report(SensorSentinel_tx_report_t *report);
+
+/**
+ * @brief Clear what a transmitted report covered
+ *
+ * Counts added since SensorSentinel_lbt_take_report() stay for the next one.
+ *
+ * @param report As filled by SensorSentinel_lbt_take_report()
+ */
+void SensorSentinel_lbt_report_sent(const SensorSentinel_tx_report_t *report);
+
+/**
+ * @brief Get a snapshot of the LBT counters
+ * @param stats Pointer to the structure to fill
+ */
+void SensorSentinel_lbt_get_stats(SensorSentinel_lbt_stats_t *stats);
+
+#endif // SensorSentinel_LBT_HELPER_H
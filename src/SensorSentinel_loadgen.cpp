@@ -0,0 +1,287 @@
+/**
+ * @file SensorSentinel_loadgen.cpp
+ * @brief Load generator: N virtual senders from one board, for gateway capacity tests
+ *
+ * Emulates LOADGEN_NODES senders (SensorSentinel_loadgen_helper.h), each
+ * with its own node ID and counter, and sends their frames either over
+ * LoRa, to load a gateway running SensorSentinel_receiver_fwd_mqtt, or
+ * straight into MQTT as uplink records on MQTT_UPLINK_TOPIC, to load the
+ * backend without a radio.
+ *
+ * With LOADGEN_SWEEP_STEPS > 0 the offered load is swept: step i offers
+ * LOADGEN_SWEEP_START_FPS * LOADGEN_SWEEP_FACTOR^i frames/s for
+ * LOADGEN_STEP_SECS, then pauses LOADGEN_SETTLE_SECS so the gateway's
+ * queues drain and its next lora/stats report covers the whole step.
+ * Each step's start and end are published as JSON on
+ * LOADGEN_TOPIC/<client ID>; sensorsentinel_loadgen --observe (host/loadgen)
+ * pairs them with the gateway's drop and duplicate counters from
+ * lora/stats. Without a sweep the profile's interval runs forever.
+ *
+ * A LoRa radio sends one frame at a time, so above 1000 / time-on-air
+ * frames/s the schedule slips; the end marker's maxLateMs shows by how much.
+ *
+ * Build with the [env:loadgen] environment.
+ */
+
+#include "heltec_unofficial_revised.h"
+#include "SensorSentinel_packet_helper.h"
+#include "SensorSentinel_loadgen_helper.h"
+#include "SensorSentinel_mqtt_helper.h"
+#include "SensorSentinel_wifi_helper.h"
+#include "SensorSentinel_log_helper.h"
+#include <math.h>
+
+#ifndef NO_RADIOLIB
+#include "SensorSentinel_RadioLib_helper.h"
+#include "SensorSentinel_tasks_helper.h"
+#endif
+
+// ── Configuration ─────────────────────────────────────────────────────────────
+#define LOADGEN_TRANSPORT_LORA 0
+#define LOADGEN_TRANSPORT_MQTT 1
+
+#ifndef LOADGEN_TRANSPORT
+#ifdef NO_RADIOLIB
+#define LOADGEN_TRANSPORT LOADGEN_TRANSPORT_MQTT
+#else
+#define LOADGEN_TRANSPORT LOADGEN_TRANSPORT_LORA
+#endif
+#endif
+
+#if LOADGEN_TRANSPORT == LOADGEN_TRANSPORT_LORA && defined(NO_RADIOLIB)
+#error "LOADGEN_TRANSPORT_LORA needs the radio; build without NO_RADIOLIB"
+#endif
+
+#ifndef LOADGEN_NODES
+#define LOADGEN_NODES          32
+#endif
+#ifndef LOADGEN_INTERVAL_MS
+#define LOADGEN_INTERVAL_MS    10000   // Per node, without a sweep
+#endif
+#ifndef LOADGEN_JITTER_PCT
+#define LOADGEN_JITTER_PCT     20
+#endif
+#ifndef LOADGEN_GNSS_EVERY
+#define LOADGEN_GNSS_EVERY     0       // Every Nth frame of a node is GNSS; 0 = never
+#endif
+#ifndef LOADGEN_DUPLICATE_PCT
+#define LOADGEN_DUPLICATE_PCT  0       // Frames sent twice, like a repeater's copy
+#endif
+
+#ifndef LOADGEN_SWEEP_STEPS
+#define LOADGEN_SWEEP_STEPS    0       // 0 = constant load at LOADGEN_INTERVAL_MS
+#endif
+#ifndef LOADGEN_SWEEP_START_FPS
+#define LOADGEN_SWEEP_START_FPS 0.5f
+#endif
+#ifndef LOADGEN_SWEEP_FACTOR
+#define LOADGEN_SWEEP_FACTOR   2.0f
+#endif
+#ifndef LOADGEN_STEP_SECS
+#define LOADGEN_STEP_SECS      120     // Also the Serial stats period without a sweep
+#endif
+#ifndef LOADGEN_SETTLE_SECS
+#define LOADGEN_SETTLE_SECS    20      // At least one gateway MQTT_STATS_INTERVAL_SECS
+#endif
+
+#ifndef LOADGEN_TOPIC
+#define LOADGEN_TOPIC "loadgen/step"
+#endif
+
+// Link values written into the uplink header of frames sent over MQTT
+#define LOADGEN_FAKE_RSSI  -90.0f
+#define LOADGEN_FAKE_SNR   8.0f
+
+// ── State ─────────────────────────────────────────────────────────────────────
+typedef enum {
+  PHASE_RUNNING,
+  PHASE_SETTLING,
+  PHASE_DONE
+} loadgen_phase_t;
+
+static loadgen_phase_t _phase = PHASE_RUNNING;
+static int _step = 0;
+static float _offeredFps = 0;
+static unsigned long _phaseStartMs = 0;
+static uint32_t _sendErrors = 0;
+static uint32_t _totalFrames = 0;
+
+void startStep(int step);
+void endStep();
+void sendFrame(uint8_t *frame, size_t length);
+void publishMarker(const char *phase);
+void renderStatus(Print &out);
+
+void setup()
+{
+  heltec_setup();
+
+  heltec_clear_display();
+  both.println("Load generator");
+  both.printf("Nodes: %d\n", LOADGEN_NODES);
+  both.printf("Via: %s\n", LOADGEN_TRANSPORT == LOADGEN_TRANSPORT_LORA ? "LoRa" : "MQTT");
+
+  // MQTT carries the frames (LOADGEN_TRANSPORT_MQTT) or only the step
+  // markers; a LoRa run goes ahead without it
+  SensorSentinel_wifi_begin();
+  SensorSentinel_mqtt_setup(true);
+
+#if LOADGEN_TRANSPORT == LOADGEN_TRANSPORT_LORA
+  if (!heltec_radio_begin()) {
+    both.println("Radio init failed!");
+  }
+  both.printf("Airtime: %u ms\n", SensorSentinel_time_on_air_ms(sizeof(SensorSentinel_sensor_packet_t)));
+#endif
+  heltec_display_update();
+  delay(2000);
+  heltec_display_defer(renderStatus);
+
+  SensorSentinel_loadgen_profile_t profile = {};
+  profile.nodes = LOADGEN_NODES;
+  profile.baseNodeId = LOADGEN_BASE_NODE_ID;
+  profile.intervalMs = LOADGEN_INTERVAL_MS;
+  profile.jitterPct = LOADGEN_JITTER_PCT;
+  profile.gnssEvery = LOADGEN_GNSS_EVERY;
+  profile.duplicatePct = LOADGEN_DUPLICATE_PCT;
+  profile.seed = SensorSentinel_generate_node_id();
+  SensorSentinel_loadgen_begin(&profile, millis());
+
+  startStep(0);
+}
+
+void loop()
+{
+  heltec_loop();
+  SensorSentinel_wifi_maintain();
+  SensorSentinel_mqtt_maintain();
+
+  unsigned long elapsed = millis() - _phaseStartMs;
+  switch (_phase) {
+  case PHASE_RUNNING:
+  {
+    // One frame per pass, so WiFi and MQTT are serviced between frames
+    uint8_t frame[MAX_LORA_PACKET_SIZE];
+    size_t length = SensorSentinel_loadgen_next(millis(), frame, sizeof(frame));
+    if (length > 0) {
+      sendFrame(frame, length);
+    }
+    if (elapsed >= LOADGEN_STEP_SECS * 1000UL) {
+      if (LOADGEN_SWEEP_STEPS > 0) {
+        endStep();
+      } else {
+        publishMarker("progress");
+        _phaseStartMs = millis();
+      }
+    }
+    break;
+  }
+
+  case PHASE_SETTLING:
+    if (elapsed >= LOADGEN_SETTLE_SECS * 1000UL) {
+      if (_step + 1 < LOADGEN_SWEEP_STEPS) {
+        startStep(_step + 1);
+      } else {
+        _phase = PHASE_DONE;
+        publishMarker("done");
+        heltec_display_invalidate();
+      }
+    }
+    break;
+
+  case PHASE_DONE:
+    delay(10);
+    break;
+  }
+}
+
+/**
+ * Set the step's rate and reset the counters
+ */
+void startStep(int step)
+{
+  _step = step;
+  if (LOADGEN_SWEEP_STEPS > 0) {
+    _offeredFps = LOADGEN_SWEEP_START_FPS * powf(LOADGEN_SWEEP_FACTOR, step);
+    SensorSentinel_loadgen_set_rate(_offeredFps, millis());
+  } else {
+    _offeredFps = LOADGEN_NODES * 1000.0f / LOADGEN_INTERVAL_MS;
+  }
+  SensorSentinel_loadgen_reset_stats();
+  _sendErrors = 0;
+  _phase = PHASE_RUNNING;
+  _phaseStartMs = millis();
+  publishMarker("start");
+  heltec_display_invalidate();
+}
+
+/**
+ * Stop sending and let the gateway drain
+ */
+void endStep()
+{
+  publishMarker("end");
+  _phase = PHASE_SETTLING;
+  _phaseStartMs = millis();
+  heltec_display_invalidate();
+}
+
+void sendFrame(uint8_t *frame, size_t length)
+{
+  _totalFrames++;
+#if LOADGEN_TRANSPORT == LOADGEN_TRANSPORT_LORA
+  // No LBT: the point is to offer exactly the configured load
+  SensorSentinel_radio_lock();
+  int state = radio.transmit(frame, length);
+  SensorSentinel_radio_unlock();
+  if (state != RADIOLIB_ERR_NONE) {
+    _sendErrors++;
+    SensorSentinel_log_w("TX failed: %d\n", state);
+  }
+#else
+  MqttForwardStatus status = SensorSentinel_mqtt_forward_packet(frame, length, LOADGEN_FAKE_RSSI, LOADGEN_FAKE_SNR);
+  if (status != MQTT_SUCCESS && status != MQTT_BATCHED && status != MQTT_SPOOLED) {
+    _sendErrors++;
+  }
+#endif
+  if (_totalFrames % 16 == 0) {
+    heltec_display_invalidate();
+  }
+}
+
+/**
+ * Step marker on Serial and LOADGEN_TOPIC/<client ID>
+ */
+void publishMarker(const char *phase)
+{
+  SensorSentinel_loadgen_stats_t stats;
+  SensorSentinel_loadgen_get_stats(&stats);
+  char payload[320];
+  snprintf(payload, sizeof(payload),
+           "{\"phase\":\"%s\",\"step\":%d,\"steps\":%d,\"transport\":\"%s\",\"nodes\":%u,\"offeredFps\":%.3f,"
+           "\"intervalMs\":%u,\"elapsedMs\":%lu,\"sent\":%u,\"sensor\":%u,\"gnss\":%u,\"duplicates\":%u,"
+           "\"sendErrors\":%u,\"maxLateMs\":%u,\"settleSecs\":%u}",
+           phase, _step, LOADGEN_SWEEP_STEPS, LOADGEN_TRANSPORT == LOADGEN_TRANSPORT_LORA ? "lora" : "mqtt",
+           SensorSentinel_loadgen_profile()->nodes, _offeredFps, SensorSentinel_loadgen_profile()->intervalMs,
+           millis() - _phaseStartMs, stats.frames, stats.sensor, stats.gnss, stats.duplicates, _sendErrors,
+           stats.maxLateMs, (unsigned)LOADGEN_SETTLE_SECS);
+  Serial.println(payload);
+
+  String topic = String(LOADGEN_TOPIC "/") + SensorSentinel_mqtt_get_client_id();
+  SensorSentinel_mqtt_publish(topic.c_str(), payload);
+}
+
+void renderStatus(Print &out)
+{
+  SensorSentinel_loadgen_stats_t stats;
+  SensorSentinel_loadgen_get_stats(&stats);
+  out.printf("Load gen %s\n", LOADGEN_TRANSPORT == LOADGEN_TRANSPORT_LORA ? "LoRa" : "MQTT");
+  if (_phase == PHASE_DONE) {
+    out.printf("Sweep done\n");
+  } else if (LOADGEN_SWEEP_STEPS > 0) {
+    out.printf("Step %d/%d%s\n", _step + 1, LOADGEN_SWEEP_STEPS, _phase == PHASE_SETTLING ? " settle" : "");
+  }
+  out.printf("%.2f fps, %u nodes\n", _offeredFps, SensorSentinel_loadgen_profile()->nodes);
+  out.printf("Sent: %u (err %u)\n", stats.frames, _sendErrors);
+  out.printf("Late: %u ms\n", stats.maxLateMs);
+  out.printf("Total: %u\n", _totalFrames);
+}
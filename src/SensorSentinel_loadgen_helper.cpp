@@ -0,0 +1,302 @@
+/**
+ * @file SensorSentinel_loadgen_helper.cpp
+ * @brief Implementation of the virtual node scheduler and frame builder
+ */
+
+#include "SensorSentinel_loadgen_helper.h"
+#include <string.h>
+
+// One virtual node
+typedef struct {
+  uint32_t dueMs;            // Next frame
+  uint32_t counter;          // Last counter sent
+  uint32_t uptimeBase;       // Seconds "since boot" at the first frame
+  uint32_t firstMs;          // Clock at begin()
+  uint16_t analog[4];
+  uint16_t voltage;
+  uint8_t battery;
+  uint8_t digital;
+  int32_t latE7;             // Home position, 1e-7 degrees
+  int32_t lonE7;
+} _node_t;
+
+static _node_t _nodes[LOADGEN_MAX_NODES];
+static uint16_t _heap[LOADGEN_MAX_NODES];   // Node indices, earliest dueMs first
+static SensorSentinel_loadgen_profile_t _profile;
+static SensorSentinel_loadgen_stats_t _stats;
+static uint32_t _rng = 1;
+
+// Last frame, kept for a duplicate copy
+static uint8_t _pending[MAX_LORA_PACKET_SIZE];
+static size_t _pendingLength = 0;
+
+static_assert(LOADGEN_MAX_NODES <= 65536, "heap indices are 16-bit");
+
+static uint32_t _random(uint32_t bound)
+{
+  // xorshift32
+  _rng ^= _rng << 13;
+  _rng ^= _rng >> 17;
+  _rng ^= _rng << 5;
+  return bound ? _rng % bound : 0;
+}
+
+static inline bool _before(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;  // Wraps with millis()
+}
+
+static uint32_t _next_wait()
+{
+  uint32_t span = (uint32_t)((uint64_t)_profile.intervalMs * _profile.jitterPct / 100);
+  return _profile.intervalMs - span + _random(2 * span + 1);
+}
+
+// ── Heap on dueMs ─────────────────────────────────────────────────────────────
+
+static void _sift_down(uint32_t i)
+{
+  uint32_t n = _profile.nodes;
+  for (;;)
+  {
+    uint32_t smallest = i, left = 2 * i + 1, right = left + 1;
+    if (left < n && _before(_nodes[_heap[left]].dueMs, _nodes[_heap[smallest]].dueMs))
+    {
+      smallest = left;
+    }
+    if (right < n && _before(_nodes[_heap[right]].dueMs, _nodes[_heap[smallest]].dueMs))
+    {
+      smallest = right;
+    }
+    if (smallest == i)
+    {
+      return;
+    }
+    uint16_t t = _heap[i];
+    _heap[i] = _heap[smallest];
+    _heap[smallest] = t;
+    i = smallest;
+  }
+}
+
+static void _build_heap()
+{
+  for (uint32_t i = 0; i < _profile.nodes; i++)
+  {
+    _heap[i] = (uint16_t)i;
+  }
+  for (uint32_t i = _profile.nodes / 2; i-- > 0;)
+  {
+    _sift_down(i);
+  }
+}
+
+// ── Frames ────────────────────────────────────────────────────────────────────
+
+static uint16_t _drift(uint16_t value, uint16_t step, uint16_t max)
+{
+  int32_t v = (int32_t)value + (int32_t)_random(2 * step + 1) - step;
+  return (uint16_t)(v < 0 ? 0 : v > max ? max : v);
+}
+
+static size_t _build_frame(uint32_t index, uint32_t nowMs, uint8_t *out, size_t size)
+{
+  _node_t *node = &_nodes[index];
+  node->counter++;
+  uint32_t nodeId = _profile.baseNodeId + index;
+  uint32_t uptime = node->uptimeBase + (nowMs - node->firstMs) / 1000;
+
+  // A slow discharge, with the odd hop of noise
+  if (_random(64) == 0 && node->battery > 5)
+  {
+    node->battery--;
+  }
+  node->voltage = _drift(node->voltage, 5, 4200);
+
+  bool gnss = _profile.gnssEvery > 0 && node->counter % _profile.gnssEvery == 0;
+  if (gnss)
+  {
+    if (size < sizeof(SensorSentinel_gnss_packet_t))
+    {
+      return 0;
+    }
+    SensorSentinel_gnss_packet_t p;
+    memset(&p, 0, sizeof(p));
+    p.messageType = SensorSentinel_MSG_GNSS;
+    p.nodeId = nodeId;
+    p.messageCounter = node->counter;
+    p.uptime = uptime;
+    p.batteryLevel = node->battery;
+    p.batteryVoltage = node->voltage;
+    p.latitude = (node->latE7 + (int32_t)_random(2001) - 1000) / 1e7f;
+    p.longitude = (node->lonE7 + (int32_t)_random(2001) - 1000) / 1e7f;
+    p.speed = _random(500) / 10.0f;
+    p.hdop = 8 + _random(10);
+    p.course = _random(36000) / 100.0f;
+    memcpy(out, &p, sizeof(p));
+    _stats.gnss++;
+    return sizeof(p);
+  }
+
+  if (size < sizeof(SensorSentinel_sensor_packet_t))
+  {
+    return 0;
+  }
+  for (int ch = 0; ch < 4; ch++)
+  {
+    node->analog[ch] = _drift(node->analog[ch], 20, 4095);
+  }
+  if (_random(16) == 0)
+  {
+    node->digital ^= 1u << _random(8);
+  }
+  SensorSentinel_sensor_packet_t p;
+  memset(&p, 0, sizeof(p));
+  p.messageType = SensorSentinel_MSG_SENSOR;
+  p.nodeId = nodeId;
+  p.messageCounter = node->counter;
+  p.uptime = uptime;
+  p.batteryLevel = node->battery;
+  p.batteryVoltage = node->voltage;
+  memcpy(p.pins.analog, node->analog, sizeof(p.pins.analog));
+  p.pins.boolean = node->digital;
+  memcpy(out, &p, sizeof(p));
+  _stats.sensor++;
+  return sizeof(p);
+}
+
+// ── API ───────────────────────────────────────────────────────────────────────
+
+void SensorSentinel_loadgen_begin(const SensorSentinel_loadgen_profile_t *profile, uint32_t nowMs)
+{
+  _profile = *profile;
+  if (_profile.nodes == 0)
+  {
+    _profile.nodes = 1;
+  }
+  if (_profile.nodes > LOADGEN_MAX_NODES)
+  {
+    _profile.nodes = LOADGEN_MAX_NODES;
+  }
+  if (_profile.intervalMs == 0)
+  {
+    _profile.intervalMs = 1;
+  }
+  if (_profile.jitterPct > 100)
+  {
+    _profile.jitterPct = 100;
+  }
+  _rng = _profile.seed ? _profile.seed : 0x9E3779B9u;
+  memset(&_stats, 0, sizeof(_stats));
+  _pendingLength = 0;
+
+  for (uint32_t i = 0; i < _profile.nodes; i++)
+  {
+    _node_t *node = &_nodes[i];
+    node->dueMs = nowMs + _random(_profile.intervalMs);
+    node->counter = _random(1000);
+    node->uptimeBase = _random(86400);
+    node->firstMs = nowMs;
+    for (int ch = 0; ch < 4; ch++)
+    {
+      node->analog[ch] = 500 + _random(3000);
+    }
+    node->voltage = 3600 + _random(500);
+    node->battery = 40 + _random(61);
+    node->digital = (uint8_t)_random(256);
+    node->latE7 = -338600000 + (int32_t)_random(2000000);
+    node->lonE7 = 1512000000 + (int32_t)_random(2000000);
+  }
+  _build_heap();
+}
+
+uint32_t SensorSentinel_loadgen_set_rate(float framesPerSec, uint32_t nowMs)
+{
+  if (framesPerSec > 0)
+  {
+    float interval = _profile.nodes * 1000.0f / framesPerSec;
+    _profile.intervalMs = interval < 1 ? 1 : (uint32_t)(interval + 0.5f);
+  }
+  for (uint32_t i = 0; i < _profile.nodes; i++)
+  {
+    _nodes[i].dueMs = nowMs + _random(_profile.intervalMs);
+  }
+  _build_heap();
+  _pendingLength = 0;
+  return _profile.intervalMs;
+}
+
+size_t SensorSentinel_loadgen_next(uint32_t nowMs, uint8_t *out, size_t size)
+{
+  if (_pendingLength > 0 && size >= _pendingLength)
+  {
+    size_t length = _pendingLength;
+    memcpy(out, _pending, length);
+    _pendingLength = 0;
+    _stats.frames++;
+    _stats.duplicates++;
+    return length;
+  }
+
+  uint32_t index = _heap[0];
+  _node_t *node = &_nodes[index];
+  if (_before(nowMs, node->dueMs))
+  {
+    return 0;
+  }
+
+  uint32_t late = nowMs - node->dueMs;
+  if (late > _stats.maxLateMs)
+  {
+    _stats.maxLateMs = late;
+  }
+  size_t length = _build_frame(index, nowMs, out, size);
+
+  // From the due time, not now: a late sender catches up instead of drifting
+  node->dueMs += _next_wait();
+  if (_before(node->dueMs, nowMs - _profile.intervalMs))
+  {
+    node->dueMs = nowMs;  // More than an interval behind: give up on the backlog
+  }
+  _sift_down(0);
+
+  if (length == 0)
+  {
+    return 0;
+  }
+  _stats.frames++;
+  if (_profile.duplicatePct > 0 && _random(100) < _profile.duplicatePct)
+  {
+    memcpy(_pending, out, length);
+    _pendingLength = length;
+  }
+  return length;
+}
+
+uint32_t SensorSentinel_loadgen_ms_until_due(uint32_t nowMs)
+{
+  if (_pendingLength > 0)
+  {
+    return 0;
+  }
+  uint32_t due = _nodes[_heap[0]].dueMs;
+  return _before(nowMs, due) ? due - nowMs : 0;
+}
+
+const SensorSentinel_loadgen_profile_t *SensorSentinel_loadgen_profile()
+{
+  return &_profile;
+}
+
+void SensorSentinel_loadgen_get_stats(SensorSentinel_loadgen_stats_t *stats)
+{
+  if (stats)
+  {
+    *stats = _stats;
+  }
+}
+
+void SensorSentinel_loadgen_reset_stats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
@@ -0,0 +1,106 @@
+/**
+ * @file SensorSentinel_loadgen_helper.h
+ * @brief Synthetic senders: many virtual nodes from one device or process
+ *
+ * Each virtual node has its own node ID (LOADGEN base + index) and message
+ * counter and sends valid v1 sensor frames, with every gnssEvery-th frame a
+ * GNSS frame, every intervalMs +/- jitterPct. Readings drift slowly from
+ * frame to frame like a real sender's. With duplicatePct a frame is
+ * sometimes sent twice in a row, as a repeater's copy would arrive. Sensor
+ * and GNSS frames share one counter per node, so every frame is a new
+ * (nodeId, counter) pair to the gateway's dedup tables.
+ *
+ * Nodes are kept in a min-heap on their due time, so finding the next frame
+ * costs O(log N) however many nodes there are. The clock is passed in and
+ * nothing here needs Arduino, so the same generator drives the loadgen
+ * firmware (SensorSentinel_loadgen.cpp, over LoRa or MQTT) and the host
+ * build (host/loadgen).
+ */
+
+#ifndef SensorSentinel_LOADGEN_HELPER_H
+#define SensorSentinel_LOADGEN_HELPER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "SensorSentinel_packet_helper.h"
+
+#ifndef LOADGEN_MAX_NODES
+#define LOADGEN_MAX_NODES 256   // Virtual nodes; about 32 bytes of RAM each
+#endif
+
+#define LOADGEN_BASE_NODE_ID 0x4C470000u  // "LG": node IDs no real MAC hash is likely to use
+
+/**
+ * @brief What the virtual nodes send
+ */
+typedef struct {
+  uint32_t nodes;            // Virtual nodes (1..LOADGEN_MAX_NODES)
+  uint32_t baseNodeId;       // Node ID of node 0; node i is baseNodeId + i
+  uint32_t intervalMs;       // Mean time between one node's frames
+  uint8_t jitterPct;         // Each wait is intervalMs +/- this many percent
+  uint8_t gnssEvery;         // Every Nth frame of a node is GNSS; 0 = sensor only
+  uint8_t duplicatePct;      // Chance that a frame is sent again right after
+  uint32_t seed;             // PRNG seed (0 = fixed default)
+} SensorSentinel_loadgen_profile_t;
+
+/**
+ * @brief Generator counters
+ */
+typedef struct {
+  uint32_t frames;           // Frames returned, duplicates included
+  uint32_t sensor;
+  uint32_t gnss;
+  uint32_t duplicates;       // Second copies
+  uint32_t maxLateMs;        // Furthest a frame was returned past its due time
+} SensorSentinel_loadgen_stats_t;
+
+/**
+ * @brief Start the virtual nodes, their first frames spread over one interval
+ * @param profile Nodes and timing; nodes is capped at LOADGEN_MAX_NODES
+ * @param nowMs Current time
+ */
+void SensorSentinel_loadgen_begin(const SensorSentinel_loadgen_profile_t *profile, uint32_t nowMs);
+
+/**
+ * @brief Change the interval so that all nodes together offer framesPerSec
+ *
+ * Every node is rescheduled within the new interval, so a sweep step starts
+ * at its rate at once instead of waiting out the previous interval.
+ *
+ * @param framesPerSec Offered load, duplicates not counted
+ * @param nowMs Current time
+ * @return The new per-node interval in ms
+ */
+uint32_t SensorSentinel_loadgen_set_rate(float framesPerSec, uint32_t nowMs);
+
+/**
+ * @brief Get the next frame that is due
+ * @param nowMs Current time
+ * @param out Frame buffer
+ * @param size Size of out (MAX_LORA_PACKET_SIZE is always enough)
+ * @return Frame length, or 0 if no frame is due yet
+ */
+size_t SensorSentinel_loadgen_next(uint32_t nowMs, uint8_t *out, size_t size);
+
+/**
+ * @brief Time until the next frame is due
+ * @return 0 if one is due now
+ */
+uint32_t SensorSentinel_loadgen_ms_until_due(uint32_t nowMs);
+
+/**
+ * @brief Current profile (intervalMs reflects SensorSentinel_loadgen_set_rate())
+ */
+const SensorSentinel_loadgen_profile_t *SensorSentinel_loadgen_profile();
+
+/**
+ * @brief Get a snapshot of the counters
+ */
+void SensorSentinel_loadgen_get_stats(SensorSentinel_loadgen_stats_t *stats);
+
+/**
+ * @brief Clear the counters (at the start of a sweep step)
+ */
+void SensorSentinel_loadgen_reset_stats();
+
+#endif // SensorSentinel_LOADGEN_HELPER_H
@@ -0,0 +1,57 @@
+/**
+ * @file SensorSentinel_log_helper.h
+ * @brief Compile-time log levels for Serial output
+ *
+ * SensorSentinel_log_e/_w/_i/_d print through Serial.printf() when
+ * SENSOR_LOG_LEVEL is at least their level. The level is a constant, so
+ * calls above it are removed by the compiler, arguments included.
+ *
+ * Levels: 0 none, 1 error, 2 warn, 3 info, 4 debug (default).
+ * -DQUIET_MODE=1 lowers the default to errors only and defers display
+ * redraws (see heltec_display_defer()), so the receive path does no
+ * per-frame Serial or OLED work.
+ *
+ * Set via platformio.ini build flags: -DSENSOR_LOG_LEVEL=2, -DQUIET_MODE=1
+ */
+
+#ifndef SensorSentinel_LOG_HELPER_H
+#define SensorSentinel_LOG_HELPER_H
+
+#include <Arduino.h>
+
+#define SENSOR_LOG_NONE  0
+#define SENSOR_LOG_ERROR 1
+#define SENSOR_LOG_WARN  2
+#define SENSOR_LOG_INFO  3
+#define SENSOR_LOG_DEBUG 4
+
+#ifndef QUIET_MODE
+#define QUIET_MODE 0
+#endif
+
+#ifndef SENSOR_LOG_LEVEL
+#if QUIET_MODE
+#define SENSOR_LOG_LEVEL SENSOR_LOG_ERROR
+#else
+#define SENSOR_LOG_LEVEL SENSOR_LOG_DEBUG
+#endif
+#endif
+
+// True when messages at this level are compiled in; use to skip whole blocks
+#define SensorSentinel_log_enabled(level) (SENSOR_LOG_LEVEL >= (level))
+
+#define SensorSentinel_log_at(level, ...)          \
+  do                                               \
+  {                                                \
+    if (SensorSentinel_log_enabled(level))         \
+    {                                              \
+      Serial.printf(__VA_ARGS__);                  \
+    }                                              \
+  } while (0)
+
+#define SensorSentinel_log_e(...) SensorSentinel_log_at(SENSOR_LOG_ERROR, __VA_ARGS__)
+#define SensorSentinel_log_w(...) SensorSentinel_log_at(SENSOR_LOG_WARN, __VA_ARGS__)
+#define SensorSentinel_log_i(...) SensorSentinel_log_at(SENSOR_LOG_INFO, __VA_ARGS__)
+#define SensorSentinel_log_d(...) SensorSentinel_log_at(SENSOR_LOG_DEBUG, __VA_ARGS__)
+
+#endif // SensorSentinel_LOG_HELPER_H
@@ -0,0 +1,297 @@
+/**
+ * @file SensorSentinel_mesh_helper.cpp
+ * @brief Implementation of the mesh header and the repeater forwarding rules
+ */
+
+#include "SensorSentinel_mesh_helper.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Forwarding rules, from SensorSentinel_mesh_configure()
+static int _rssiThreshold = 0;
+static uint32_t _allow[MESH_ALLOW_MAX];
+static int _allowCount = 0;
+
+// Repeats waiting in the TX queue and the copies heard of each
+typedef struct {
+  uint32_t tag;
+  uint32_t queuedMs;
+  uint8_t heard;
+  bool used;
+} _pending_entry_t;
+
+static _pending_entry_t _pending[MESH_PENDING_SIZE];
+static SensorSentinel_mesh_stats_t _stats;
+
+// 32-bit finalizer (murmur3 fmix32), as in the dedup tables
+static inline uint32_t _mix(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+// ── Header ────────────────────────────────────────────────────────────────────
+
+const uint8_t *SensorSentinel_mesh_unwrap(const uint8_t *data, size_t length,
+                                          SensorSentinel_mesh_header_t *header, size_t *innerLength)
+{
+  if (!data || length == 0)
+  {
+    return NULL;
+  }
+  if (data[0] != SensorSentinel_MSG_MESH)
+  {
+    memset(header, 0, sizeof(*header));
+    *innerLength = length;
+    return data;
+  }
+  if (length <= SensorSentinel_MESH_HEADER_SIZE)
+  {
+    return NULL;
+  }
+  memcpy(header, data, SensorSentinel_MESH_HEADER_SIZE);
+  const uint8_t *inner = data + SensorSentinel_MESH_HEADER_SIZE;
+  if (header->hops == 0 || inner[0] == SensorSentinel_MSG_MESH)
+  {
+    return NULL;  // Only repeaters add a header, and only one
+  }
+  *innerLength = length - SensorSentinel_MESH_HEADER_SIZE;
+  return inner;
+}
+
+size_t SensorSentinel_mesh_wrap(uint8_t *out, size_t size, const SensorSentinel_mesh_header_t *header,
+                                const uint8_t *frame, size_t length)
+{
+  if (size < SensorSentinel_MESH_HEADER_SIZE + length)
+  {
+    return 0;
+  }
+  memcpy(out, header, SensorSentinel_MESH_HEADER_SIZE);
+  out[0] = SensorSentinel_MSG_MESH;
+  memcpy(out + SensorSentinel_MESH_HEADER_SIZE, frame, length);
+  return SensorSentinel_MESH_HEADER_SIZE + length;
+}
+
+size_t SensorSentinel_mesh_strip(uint8_t *data, size_t length, SensorSentinel_mesh_header_t *header)
+{
+  SensorSentinel_mesh_header_t h;
+  size_t innerLength;
+  const uint8_t *inner = SensorSentinel_mesh_unwrap(data, length, &h, &innerLength);
+  if (!inner)
+  {
+    return 0;
+  }
+  if (header)
+  {
+    *header = h;
+  }
+  if (inner != data)
+  {
+    memmove(data, inner, innerLength);
+  }
+  return innerLength;
+}
+
+// ── Forwarding rules ──────────────────────────────────────────────────────────
+
+int SensorSentinel_mesh_parse_allowlist(const char *text, uint32_t *nodeIds)
+{
+  int count = 0;
+  const char *p = text ? text : "";
+  for (;;)
+  {
+    while (*p == ',' || *p == ' ' || *p == '\t')
+    {
+      p++;
+    }
+    if (*p == 0)
+    {
+      return count;
+    }
+    char *end;
+    unsigned long id = strtoul(p, &end, 0);
+    if (end == p || id == 0 || id > 0xFFFFFFFFul || (*end && *end != ',' && *end != ' ' && *end != '\t'))
+    {
+      return -1;
+    }
+    if (count == MESH_ALLOW_MAX)
+    {
+      return -1;
+    }
+    if (nodeIds)
+    {
+      nodeIds[count] = (uint32_t)id;
+    }
+    count++;
+    p = end;
+  }
+}
+
+void SensorSentinel_mesh_configure(int rssiThreshold, const char *allowlist)
+{
+  _rssiThreshold = rssiThreshold;
+  int count = SensorSentinel_mesh_parse_allowlist(allowlist, _allow);
+  _allowCount = count < 0 ? 0 : count;
+}
+
+static bool _allowed(uint32_t nodeId)
+{
+  for (int i = 0; i < _allowCount; i++)
+  {
+    if (_allow[i] == nodeId)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+SensorSentinel_mesh_decision_t SensorSentinel_mesh_decide(uint32_t nodeId, const SensorSentinel_mesh_header_t *header,
+                                                          float rssi)
+{
+  SensorSentinel_mesh_decision_t decision = MESH_REPEAT;
+  float originRssi = header->hops ? header->originRssi : rssi;
+
+  if (header->hops && header->hops >= header->ttl)
+  {
+    decision = MESH_SKIP_TTL;
+  }
+  else if (_allowed(nodeId))
+  {
+    decision = MESH_REPEAT;
+  }
+  else if (_rssiThreshold != 0)
+  {
+    decision = originRssi < _rssiThreshold ? MESH_REPEAT : MESH_SKIP_RSSI;
+  }
+  else if (_allowCount > 0)
+  {
+    decision = MESH_SKIP_ALLOW;
+  }
+
+  switch (decision)
+  {
+  case MESH_REPEAT:
+    _stats.repeated++;
+    break;
+  case MESH_SKIP_TTL:
+    _stats.skippedTtl++;
+    break;
+  case MESH_SKIP_RSSI:
+    _stats.skippedRssi++;
+    break;
+  case MESH_SKIP_ALLOW:
+    _stats.skippedAllow++;
+    break;
+  }
+  return decision;
+}
+
+void SensorSentinel_mesh_next_hop(const SensorSentinel_mesh_header_t *received, float rssi, uint32_t repeaterId,
+                                  SensorSentinel_mesh_header_t *out)
+{
+  out->messageType = SensorSentinel_MSG_MESH;
+  if (received->hops == 0)
+  {
+    // First repeater: it heard the node itself
+    out->hops = 1;
+    out->ttl = MESH_TTL;
+    out->originRssi = (int8_t)(rssi < -128.0f ? -128 : rssi > 127.0f ? 127 : rssi);
+  }
+  else
+  {
+    out->hops = received->hops + 1;
+    out->ttl = received->ttl;
+    out->originRssi = received->originRssi;
+  }
+  out->lastRepeaterId = repeaterId;
+}
+
+// ── Suppression ───────────────────────────────────────────────────────────────
+
+uint32_t SensorSentinel_mesh_tag(uint32_t nodeId, uint32_t counter)
+{
+  return _mix(nodeId ^ _mix(counter)) | 1;
+}
+
+void SensorSentinel_mesh_note_queued(uint32_t tag, uint32_t nowMs)
+{
+  // A free or expired slot, else the oldest (its repeat has gone out by now)
+  _pending_entry_t *slot = &_pending[0];
+  for (int i = 0; i < MESH_PENDING_SIZE; i++)
+  {
+    _pending_entry_t *e = &_pending[i];
+    if (!e->used || nowMs - e->queuedMs > MESH_PENDING_TTL_MS)
+    {
+      slot = e;
+      break;
+    }
+    if ((int32_t)(e->queuedMs - slot->queuedMs) < 0)
+    {
+      slot = e;
+    }
+  }
+  slot->tag = tag;
+  slot->queuedMs = nowMs;
+  slot->heard = 0;
+  slot->used = true;
+}
+
+bool SensorSentinel_mesh_note_overheard(uint32_t tag, uint32_t nowMs)
+{
+  for (int i = 0; i < MESH_PENDING_SIZE; i++)
+  {
+    _pending_entry_t *e = &_pending[i];
+    if (!e->used || e->tag != tag)
+    {
+      continue;
+    }
+    if (nowMs - e->queuedMs > MESH_PENDING_TTL_MS)
+    {
+      e->used = false;
+      return false;
+    }
+    _stats.overheard++;
+    if (MESH_SUPPRESS_COPIES > 0 && ++e->heard >= MESH_SUPPRESS_COPIES)
+    {
+      e->used = false;
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+
+void SensorSentinel_mesh_note_suppressed()
+{
+  _stats.suppressed++;
+}
+
+void SensorSentinel_mesh_get_stats(SensorSentinel_mesh_stats_t *stats)
+{
+  if (stats)
+  {
+    *stats = _stats;
+  }
+}
+
+const char *SensorSentinel_mesh_decision_to_string(SensorSentinel_mesh_decision_t decision)
+{
+  switch (decision)
+  {
+  case MESH_REPEAT:
+    return "Repeat";
+  case MESH_SKIP_TTL:
+    return "TTL";
+  case MESH_SKIP_RSSI:
+    return "RSSI";
+  case MESH_SKIP_ALLOW:
+    return "Allowlist";
+  default:
+    return "Unknown";
+  }
+}
@@ -0,0 +1,197 @@
+/**
+ * @file SensorSentinel_mesh_helper.h
+ * @brief Repeater mesh controls: hop limit, selective forwarding, suppression
+ *
+ * A repeater sends its copy of a frame inside a small mesh header
+ * (SensorSentinel_MSG_MESH) carrying the hop count, the hop limit set by the
+ * first repeater, that repeater's view of the original RSSI, and the node
+ * ID of the last repeater. Senders never add one: a frame without it is
+ * heard straight from its node (hop 0).
+ *
+ * - TTL: a frame that has already made MESH_TTL hops is not repeated
+ *   again, so two repeaters in range of each other stop after MESH_TTL
+ *   copies even once dedup has forgotten the frame.
+ * - Selective forwarding (diag UI, NVS): with an RSSI threshold set, only
+ *   frames whose original RSSI is below it are repeated, since a strong
+ *   frame most likely reached the gateway already; node IDs on the
+ *   allowlist are repeated whatever their RSSI. With an allowlist and no
+ *   threshold only the listed nodes are repeated; with neither, everything.
+ * - Suppression (trickle-style): a repeat waits REPEAT_DELAY_MS plus jitter
+ *   in the TX queue. Each further copy of the same frame heard meanwhile
+ *   (another repeater's, with or without a header) counts, and once
+ *   MESH_SUPPRESS_COPIES were heard our own copy is taken back out of the
+ *   queue. Whichever repeater draws the shortest delay forwards; the others
+ *   stay quiet.
+ *
+ * Gateways strip the header before anything else sees the frame, so the
+ * uplink record and the backend are unchanged.
+ *
+ * No Arduino dependency: the clock is passed in. Repeaters built with
+ * -DMESH_MODE=0 forward frames bare, for gateways older than the header;
+ * the forwarding rules and suppression still apply.
+ */
+
+#ifndef SensorSentinel_MESH_HELPER_H
+#define SensorSentinel_MESH_HELPER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef MESH_MODE
+#define MESH_MODE 1
+#endif
+
+#ifndef MESH_TTL
+#define MESH_TTL 3                // Hops a frame may make, counting the first repeater
+#endif
+#ifndef MESH_SUPPRESS_COPIES
+#define MESH_SUPPRESS_COPIES 1    // Overheard copies that cancel a queued repeat; 0 = never cancel
+#endif
+#define MESH_ALLOW_MAX      16    // Node IDs on the allowlist
+#define MESH_PENDING_SIZE    8    // Queued repeats watched for suppression
+#define MESH_PENDING_TTL_MS 5000  // Forget a queued repeat after this long
+
+#define SensorSentinel_MSG_MESH 0x05  // Mesh header in front of a repeated frame
+
+/**
+ * @brief Mesh header: first bytes of a frame sent by a repeater
+ */
+typedef struct {
+  uint8_t messageType;         // Always SensorSentinel_MSG_MESH (0x05)
+  uint8_t hops;                // Repeaters the frame has passed, this one included
+  uint8_t ttl;                 // Hop limit, set by the first repeater
+  int8_t originRssi;           // dBm at which the first repeater heard the node
+  uint32_t lastRepeaterId;     // Node ID of the repeater that sent this copy
+} __attribute__((packed)) SensorSentinel_mesh_header_t;
+
+#define SensorSentinel_MESH_HEADER_SIZE sizeof(SensorSentinel_mesh_header_t)
+
+/**
+ * @brief What a repeater does with a new frame
+ */
+typedef enum {
+  MESH_REPEAT,        ///< Queue a copy
+  MESH_SKIP_TTL,      ///< Made its last hop already
+  MESH_SKIP_RSSI,     ///< Heard strongly enough that the gateway has it
+  MESH_SKIP_ALLOW     ///< Node not on the allowlist
+} SensorSentinel_mesh_decision_t;
+
+/**
+ * @brief Repeater counters
+ */
+typedef struct {
+  uint32_t repeated;   // New frames the rules let through
+  uint32_t skippedTtl;
+  uint32_t skippedRssi;
+  uint32_t skippedAllow;
+  uint32_t overheard;  // Further copies heard while ours waited
+  uint32_t suppressed; // Queued copies cancelled because of them
+} SensorSentinel_mesh_stats_t;
+
+/**
+ * @brief Read the mesh header of a frame, if it has one
+ * @param data Frame bytes
+ * @param length Frame length
+ * @param header Filled from the frame; hops 0 and originRssi 0 for a frame without one
+ * @param innerLength Set to the length of the frame the header wraps
+ * @return Start of the wrapped frame (data itself without a header), or NULL
+ *         if the header is truncated or wraps nothing
+ */
+const uint8_t *SensorSentinel_mesh_unwrap(const uint8_t *data, size_t length,
+                                          SensorSentinel_mesh_header_t *header, size_t *innerLength);
+
+/**
+ * @brief Put a mesh header in front of a frame
+ * @param out Destination; may not overlap frame
+ * @param size Size of out
+ * @param header Header to write (messageType is set here)
+ * @param frame Frame without a mesh header
+ * @param length Frame length
+ * @return Length written, 0 if out is too small
+ */
+size_t SensorSentinel_mesh_wrap(uint8_t *out, size_t size, const SensorSentinel_mesh_header_t *header,
+                                const uint8_t *frame, size_t length);
+
+/**
+ * @brief Remove a mesh header in place (gateways)
+ * @param data Frame bytes; the wrapped frame is moved to the start
+ * @param length Frame length
+ * @param header Filled as for SensorSentinel_mesh_unwrap(); may be NULL
+ * @return New length: unchanged without a header, 0 if the header is broken
+ */
+size_t SensorSentinel_mesh_strip(uint8_t *data, size_t length, SensorSentinel_mesh_header_t *header);
+
+/**
+ * @brief Parse a comma- or space-separated list of node IDs (decimal or 0x hex)
+ * @param text List, e.g. "0x1a2b3c4d, 305419896"; empty for none
+ * @param nodeIds Filled with up to MESH_ALLOW_MAX IDs; may be NULL to only validate
+ * @return Number of IDs, or -1 if an entry is not a node ID or there are too many
+ */
+int SensorSentinel_mesh_parse_allowlist(const char *text, uint32_t *nodeIds);
+
+/**
+ * @brief Set the forwarding rules (repeater setup, from the diag settings)
+ * @param rssiThreshold Repeat only frames first heard below this (dBm); 0 = no threshold
+ * @param allowlist Node IDs always repeated, as for SensorSentinel_mesh_parse_allowlist();
+ *        an invalid list is ignored
+ */
+void SensorSentinel_mesh_configure(int rssiThreshold, const char *allowlist);
+
+/**
+ * @brief Apply the TTL and forwarding rules to a new frame
+ * @param nodeId Node ID of the wrapped frame
+ * @param header From SensorSentinel_mesh_unwrap()
+ * @param rssi RSSI this copy was received at (dBm); the original RSSI for hop 0
+ * @return MESH_REPEAT, or why not; counted in the stats
+ */
+SensorSentinel_mesh_decision_t SensorSentinel_mesh_decide(uint32_t nodeId, const SensorSentinel_mesh_header_t *header,
+                                                          float rssi);
+
+/**
+ * @brief Build the header for this repeater's copy
+ * @param received Header of the copy this repeater heard
+ * @param rssi RSSI it was received at (dBm)
+ * @param repeaterId This repeater's node ID
+ * @param out Header to send
+ */
+void SensorSentinel_mesh_next_hop(const SensorSentinel_mesh_header_t *received, float rssi, uint32_t repeaterId,
+                                  SensorSentinel_mesh_header_t *out);
+
+/**
+ * @brief Tag that identifies a frame in the TX queue
+ * @return Nonzero value derived from the node ID and counter
+ */
+uint32_t SensorSentinel_mesh_tag(uint32_t nodeId, uint32_t counter);
+
+/**
+ * @brief Note a repeat that is waiting in the TX queue under tag
+ * @param tag From SensorSentinel_mesh_tag()
+ * @param nowMs Current time in milliseconds
+ */
+void SensorSentinel_mesh_note_queued(uint32_t tag, uint32_t nowMs);
+
+/**
+ * @brief Note a copy of a frame heard from someone else (a dedup duplicate)
+ * @param tag From SensorSentinel_mesh_tag()
+ * @param nowMs Current time in milliseconds
+ * @return true when our queued copy should now be cancelled; the caller
+ *         reports the outcome with SensorSentinel_mesh_note_suppressed()
+ */
+bool SensorSentinel_mesh_note_overheard(uint32_t tag, uint32_t nowMs);
+
+/**
+ * @brief Count a queued repeat that was cancelled (it had not gone out yet)
+ */
+void SensorSentinel_mesh_note_suppressed();
+
+/**
+ * @brief Get a snapshot of the counters
+ */
+void SensorSentinel_mesh_get_stats(SensorSentinel_mesh_stats_t *stats);
+
+/**
+ * @brief Convert a forwarding decision to a human-readable string
+ */
+const char *SensorSentinel_mesh_decision_to_string(SensorSentinel_mesh_decision_t decision);
+
+#endif // SensorSentinel_MESH_HELPER_H
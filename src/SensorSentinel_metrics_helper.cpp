@@ -0,0 +1,150 @@
+/**
+ * @file SensorSentinel_metrics_helper.cpp
+ * @brief Implementation of the hot-path latency histograms
+ */
+
+#include "SensorSentinel_metrics_helper.h"
+
+static SensorSentinel_metrics_histogram_t _histograms[METRIC_COUNT];
+static uint32_t _cyclesPerUs = 0;
+static SensorSentinel_metrics_source_t _source = NULL;
+
+static const char *const _names[METRIC_COUNT] = {
+    "process_packets",
+    "validate_packet",
+    "dedup_check",
+    "mqtt_forward",
+    "display_update",
+    "print_packet_info",
+};
+
+// Smallest i with us <= 2^i, or METRICS_BUCKETS when past the last bound
+static inline uint32_t _bucket(uint32_t us)
+{
+  if (us <= 1)
+  {
+    return 0;
+  }
+  uint32_t i = 32 - __builtin_clz(us - 1);
+  return i < METRICS_BUCKETS ? i : METRICS_BUCKETS;
+}
+
+void SensorSentinel_metrics_record(SensorSentinel_metric_t metric, uint32_t startCycles)
+{
+#if METRICS_MODE
+  uint32_t cycles = ESP.getCycleCount() - startCycles;  // Wraps cleanly
+  if (metric >= METRIC_COUNT)
+  {
+    return;
+  }
+  if (_cyclesPerUs == 0)
+  {
+    _cyclesPerUs = ESP.getCpuFreqMHz();
+  }
+
+  uint32_t us = cycles / _cyclesPerUs;
+  SensorSentinel_metrics_histogram_t *h = &_histograms[metric];
+  h->buckets[_bucket(us)]++;
+  h->count++;
+  h->sumUs += us;
+  if (us > h->maxUs)
+  {
+    h->maxUs = us;
+  }
+#endif
+}
+
+void SensorSentinel_metrics_get(SensorSentinel_metric_t metric, SensorSentinel_metrics_histogram_t *histogram)
+{
+  if (!histogram || metric >= METRIC_COUNT)
+  {
+    return;
+  }
+  *histogram = _histograms[metric];
+}
+
+void SensorSentinel_metrics_reset()
+{
+  memset(_histograms, 0, sizeof(_histograms));
+}
+
+const char *SensorSentinel_metrics_name(SensorSentinel_metric_t metric)
+{
+  return metric < METRIC_COUNT ? _names[metric] : "unknown";
+}
+
+String SensorSentinel_metrics_format()
+{
+  String out;
+  out.reserve(METRIC_COUNT * 1800 + 512);
+  char line[128];
+
+  out += "# HELP sensorsentinel_probe_duration_seconds Time spent in instrumented gateway functions\n";
+  out += "# TYPE sensorsentinel_probe_duration_seconds histogram\n";
+  for (int m = 0; m < METRIC_COUNT; m++)
+  {
+    SensorSentinel_metrics_histogram_t h;
+    SensorSentinel_metrics_get((SensorSentinel_metric_t)m, &h);
+
+    // Prometheus buckets are cumulative
+    uint32_t cumulative = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++)
+    {
+      cumulative += h.buckets[i];
+      snprintf(line, sizeof(line), "sensorsentinel_probe_duration_seconds_bucket{probe=\"%s\",le=\"%g\"} %u\n",
+               _names[m], (double)(1UL << i) / 1e6, cumulative);
+      out += line;
+    }
+    snprintf(line, sizeof(line), "sensorsentinel_probe_duration_seconds_bucket{probe=\"%s\",le=\"+Inf\"} %u\n",
+             _names[m], h.count);
+    out += line;
+    snprintf(line, sizeof(line), "sensorsentinel_probe_duration_seconds_sum{probe=\"%s\"} %.6f\n",
+             _names[m], (double)h.sumUs / 1e6);
+    out += line;
+    snprintf(line, sizeof(line), "sensorsentinel_probe_duration_seconds_count{probe=\"%s\"} %u\n",
+             _names[m], h.count);
+    out += line;
+  }
+
+  out += "# HELP sensorsentinel_probe_max_seconds Longest single call since boot\n";
+  out += "# TYPE sensorsentinel_probe_max_seconds gauge\n";
+  for (int m = 0; m < METRIC_COUNT; m++)
+  {
+    snprintf(line, sizeof(line), "sensorsentinel_probe_max_seconds{probe=\"%s\"} %.6f\n",
+             _names[m], (double)_histograms[m].maxUs / 1e6);
+    out += line;
+  }
+
+  out += "# HELP sensorsentinel_uptime_seconds Time since boot\n";
+  out += "# TYPE sensorsentinel_uptime_seconds gauge\n";
+  snprintf(line, sizeof(line), "sensorsentinel_uptime_seconds %lu\n", millis() / 1000);
+  out += line;
+
+  if (_source)
+  {
+    _source(out);
+  }
+  return out;
+}
+
+void SensorSentinel_metrics_set_source(SensorSentinel_metrics_source_t source)
+{
+  _source = source;
+}
+
+static void _metrics_sample(String &out, const char *type, const char *name, const char *help, uint32_t value)
+{
+  char line[160];
+  snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %u\n", name, help, name, type, name, value);
+  out += line;
+}
+
+void SensorSentinel_metrics_counter(String &out, const char *name, const char *help, uint32_t value)
+{
+  _metrics_sample(out, "counter", name, help, value);
+}
+
+void SensorSentinel_metrics_gauge(String &out, const char *name, const char *help, uint32_t value)
+{
+  _metrics_sample(out, "gauge", name, help, value);
+}
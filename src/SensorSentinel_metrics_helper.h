@@ -0,0 +1,152 @@
+/**
+ * @file SensorSentinel_metrics_helper.h
+ * @brief Cycle-counter probes and latency histograms for the gateway hot path
+ *
+ * Each probe reads the CPU cycle counter (ESP32 CCOUNT) on entry and exit
+ * and adds the elapsed time to a fixed log-scale histogram in RAM. Bucket i
+ * counts calls that took at most 2^i microseconds (1 us .. 32.768 ms), plus
+ * an overflow bucket. Recording costs two counter reads, a division and a
+ * few increments; no locking, so a snapshot taken while a probe is being
+ * recorded may be one sample behind.
+ *
+ * The histograms are exported as Prometheus text by
+ * SensorSentinel_metrics_format(): on /metrics of the diagnostic web server
+ * and periodically on MQTT_STATS_TOPIC.
+ *
+ * Enabled by default; disable via platformio.ini build flag: -DMETRICS_MODE=0
+ */
+
+#ifndef SensorSentinel_METRICS_HELPER_H
+#define SensorSentinel_METRICS_HELPER_H
+
+#include <Arduino.h>
+
+#ifndef METRICS_MODE
+#define METRICS_MODE 1
+#endif
+
+#define METRICS_BUCKETS 16  // Upper bounds 2^0 .. 2^15 us, plus +Inf
+
+/**
+ * @brief Instrumented functions
+ */
+typedef enum {
+  METRIC_PROCESS_PACKETS,   ///< SensorSentinel_process_packets() calls that dispatched frames
+  METRIC_VALIDATE_PACKET,   ///< SensorSentinel_validate_packet()
+  METRIC_DEDUP_CHECK,       ///< SensorSentinel_dedup_check() on the gateway
+  METRIC_MQTT_FORWARD,      ///< SensorSentinel_mqtt_forward_slot()/_packet() on the gateway
+  METRIC_DISPLAY_UPDATE,    ///< heltec_display_update()
+  METRIC_PRINT_PACKET_INFO, ///< SensorSentinel_print_packet_info()
+  METRIC_COUNT
+} SensorSentinel_metric_t;
+
+/**
+ * @brief Histogram for one probe
+ */
+typedef struct {
+  uint32_t buckets[METRICS_BUCKETS + 1];  // Non-cumulative; last is overflow
+  uint32_t count;                         // Samples recorded
+  uint64_t sumUs;                         // Total time in microseconds
+  uint32_t maxUs;                         // Longest sample
+} SensorSentinel_metrics_histogram_t;
+
+/**
+ * @brief Read the cycle counter at the start of a probe
+ * @return Cycle count to pass to SensorSentinel_metrics_record()
+ */
+static inline uint32_t SensorSentinel_metrics_start()
+{
+#if METRICS_MODE
+  return ESP.getCycleCount();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief Add the time since startCycles to a probe's histogram
+ * @param metric Probe to record
+ * @param startCycles Value returned by SensorSentinel_metrics_start()
+ */
+void SensorSentinel_metrics_record(SensorSentinel_metric_t metric, uint32_t startCycles);
+
+/**
+ * @brief Probe covering the enclosing scope
+ */
+struct SensorSentinel_metrics_scope
+{
+  SensorSentinel_metric_t metric;
+  uint32_t start;
+  explicit SensorSentinel_metrics_scope(SensorSentinel_metric_t m) : metric(m), start(SensorSentinel_metrics_start()) {}
+  ~SensorSentinel_metrics_scope() { SensorSentinel_metrics_record(metric, start); }
+};
+
+#if METRICS_MODE
+#define SensorSentinel_METRICS_SCOPE(metric) SensorSentinel_metrics_scope _metricsScope(metric)
+#else
+#define SensorSentinel_METRICS_SCOPE(metric)
+#endif
+
+/**
+ * @brief Get a copy of one probe's histogram
+ * @param metric Probe to read
+ * @param histogram Pointer to the structure to fill
+ */
+void SensorSentinel_metrics_get(SensorSentinel_metric_t metric, SensorSentinel_metrics_histogram_t *histogram);
+
+/**
+ * @brief Clear all histograms
+ */
+void SensorSentinel_metrics_reset();
+
+/**
+ * @brief Short name of a probe, used as the Prometheus "probe" label
+ * @param metric Probe
+ * @return e.g. "validate_packet"
+ */
+const char *SensorSentinel_metrics_name(SensorSentinel_metric_t metric);
+
+/**
+ * @brief Render all histograms in the Prometheus text exposition format
+ *
+ * One histogram family, sensorsentinel_probe_duration_seconds, labelled by
+ * probe, plus a sensorsentinel_probe_max_seconds gauge and the uptime,
+ * followed by whatever the registered source adds.
+ *
+ * @return Prometheus text (about 2 KB per probe)
+ */
+String SensorSentinel_metrics_format();
+
+/**
+ * @brief Appends the app's own metric families to the export
+ *
+ * The gateway registers one for its receive, dedup and forward counters
+ * (read from MQTT_STATS_TOPIC by the load generator's sweep).
+ */
+typedef void (*SensorSentinel_metrics_source_t)(String &out);
+
+/**
+ * @brief Register the source called at the end of SensorSentinel_metrics_format()
+ * @param source Callback, or NULL for none
+ */
+void SensorSentinel_metrics_set_source(SensorSentinel_metrics_source_t source);
+
+/**
+ * @brief Append one counter (HELP, TYPE and sample lines)
+ * @param out Prometheus text being built
+ * @param name Full metric name, ending in _total
+ * @param help One-line description
+ * @param value Count since boot
+ */
+void SensorSentinel_metrics_counter(String &out, const char *name, const char *help, uint32_t value);
+
+/**
+ * @brief Append one gauge (HELP, TYPE and sample lines)
+ * @param out Prometheus text being built
+ * @param name Full metric name
+ * @param help One-line description
+ * @param value Current value
+ */
+void SensorSentinel_metrics_gauge(String &out, const char *name, const char *help, uint32_t value);
+
+#endif // SensorSentinel_METRICS_HELPER_H
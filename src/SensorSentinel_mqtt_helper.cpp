@@ -5,9 +5,12 @@
 
 #include "heltec_unofficial_revised.h"
 #include <WiFi.h>  // Include this explicitly for WiFiClient
+#include <sys/time.h>
 #include "SensorSentinel_mqtt_helper.h"
 #include "SensorSentinel_wifi_helper.h"
 #include "SensorSentinel_diag.h"
+#include "SensorSentinel_spool_helper.h"
+#include "SensorSentinel_metrics_helper.h"
 
 // Move this define to here
 #ifndef MQTT_TOPIC
@@ -17,6 +20,12 @@
 // Magic constant replaced with a named constant
 #define TIME_SYNC_EPOCH 1600000000  // Sept 2020, indicates time is synced
 
+#if MQTT_UPLINK_HEADER
+#define UPLINK_RECORD_OVERHEAD SensorSentinel_UPLINK_HEADROOM
+#else
+#define UPLINK_RECORD_OVERHEAD 0
+#endif
+
 // WiFi and MQTT client instances
 extern WiFiClient wifiClient;  // Declare external reference to WiFi client
 PubSubClient mqttClient(wifiClient);  // Use the external WiFi client
@@ -30,16 +39,74 @@ MqttConfig mqttConfig = {
     .port = MQTT_PORT,
     .user = MQTT_USER,
     .password = MQTT_PASSWORD,
-    .connectionInterval = 5000,
-    .socketTimeout = 10,  // Add comma here if you plan to add more fields
+    .connectionInterval = 1000,  // First reconnect delay; backs off to MQTT_RECONNECT_MAX_MS
+    .socketTimeout = 5,  // Add comma here if you plan to add more fields
 };
 
 // Module variables
 static String mqttClientId = "";
 static unsigned long lastMqttConnectionAttempt = 0;
+static unsigned long mqttReconnectDelay = 0;  // 0 = next attempt right away
 static unsigned long lastPublishTime = 0;
 static uint32_t reconnectCounter = 0;
 static uint32_t publishCount = 0;
+static uint32_t firstForwardMs = 0;  // millis() of the first uplink publish
+
+#if MQTT_BATCH_MODE
+// Envelope being filled; published by SensorSentinel_mqtt_flush_batch()
+static uint8_t _batchBuffer[MQTT_MAX_PACKET_SIZE];
+static size_t _batchLength = 0;
+static size_t _batchCapacity = 0;
+static uint8_t _batchFrames = 0;
+static unsigned long _batchStartMs = 0;
+
+static uint32_t _batchesPublished = 0;
+static uint32_t _batchFramesPublished = 0;
+static uint32_t _batchesFailed = 0;
+static uint64_t _batchFillPctSum = 0;
+static uint32_t _batchFillPctMax = 0;
+static uint64_t _batchLatencySum = 0;
+static uint32_t _batchLatencyMax = 0;
+#endif
+
+#if MQTT_SPOOL_MODE
+static unsigned long _lastSpoolReplay = 0;
+#endif
+
+#if METRICS_MODE && MQTT_STATS_INTERVAL_SECS > 0
+static unsigned long _lastStatsPublish = 0;
+#endif
+
+#if MQTT_QOS >= 1
+#define INFLIGHT_TOPIC_MAX (sizeof(MQTT_BATCH_TOPIC) > sizeof(MQTT_UPLINK_TOPIC) ? \
+                            sizeof(MQTT_BATCH_TOPIC) - 1 : sizeof(MQTT_UPLINK_TOPIC) - 1)
+// Fixed header (max 5) + topic length (2) + topic + packet ID (2)
+#define INFLIGHT_HEADROOM  (5 + 2 + INFLIGHT_TOPIC_MAX + 2)
+// An uplink record or, with batching, a whole envelope
+#define INFLIGHT_PAYLOAD   (MQTT_BATCH_MODE && MQTT_MAX_PACKET_SIZE > SPOOL_MAX_FRAME ? \
+                            MQTT_MAX_PACKET_SIZE : SPOOL_MAX_FRAME)
+
+// A QoS 1 publish awaiting its PUBACK; the PUBLISH is kept whole for a resend
+typedef struct {
+    uint8_t buffer[INFLIGHT_HEADROOM + INFLIGHT_PAYLOAD];
+    uint8_t *packet;          // PUBLISH start in buffer (headers are built back to front)
+    size_t packetLength;
+    size_t payloadLength;     // The record or envelope at the end of the packet
+    uint32_t firstSentMs;
+    uint32_t sentMs;
+    uint16_t packetId;
+    uint8_t attempts;
+    bool batch;               // Payload is a batch envelope
+    bool used;
+} InflightEntry;
+
+static InflightEntry _inflight[MQTT_INFLIGHT_MAX];
+static uint16_t _nextPacketId = 1;
+static SensorSentinel_mqtt_ack_stats_t _ackStats = {};
+static uint64_t _ackMsSum = 0;
+static uint32_t _acksAtSecond = 0;
+static unsigned long _ackSecondStart = 0;
+#endif
 
 // Replace the getMqttStateString function with:
 
@@ -132,6 +199,18 @@ boolean SensorSentinel_mqtt_init() {
   // Log the MQTT configuration
   Serial.printf("\nMQTT Server: %s:%d\n", mqttConfig.server, mqttConfig.port);
   Serial.printf("\nMQTT Buffer Size: %u bytes\n", mqttClient.getBufferSize());
+
+#if MQTT_BATCH_MODE
+  // PUBLISH = fixed header (max 5) + topic length (2) + topic + payload
+  size_t overhead = 5 + 2 + strlen(MQTT_BATCH_TOPIC);
+  size_t bufferSize = min((size_t)mqttClient.getBufferSize(), sizeof(_batchBuffer));
+  _batchCapacity = bufferSize > overhead ? bufferSize - overhead : 0;
+  if (MQTT_BATCH_MAX_BYTES > 0 && _batchCapacity > MQTT_BATCH_MAX_BYTES) {
+    _batchCapacity = MQTT_BATCH_MAX_BYTES;
+  }
+  Serial.printf("MQTT batching: %u byte envelopes, %u ms window, topic %s\n",
+                _batchCapacity, MQTT_BATCH_WINDOW_MS, MQTT_BATCH_TOPIC);
+#endif
   
   return true;
 }
@@ -148,9 +227,9 @@ boolean SensorSentinel_mqtt_connect() {
         return true;
     }
     
-    // Rate limiting
+    // Exponential backoff between failed attempts
     unsigned long now = millis();
-    if (now - lastMqttConnectionAttempt < mqttConfig.connectionInterval) {
+    if (mqttReconnectDelay > 0 && now - lastMqttConnectionAttempt < mqttReconnectDelay) {
         return false;
     }
     
@@ -165,14 +244,326 @@ boolean SensorSentinel_mqtt_connect() {
     reconnectCounter = success ? 0 : reconnectCounter + 1;
     
     if (success) {
+        mqttReconnectDelay = 0;
         Serial.println("MQTT connected successfully");
     } else {
-        Serial.printf("MQTT connection failed: %s\n", getMqttStateString(mqttClient.state()));
+        mqttReconnectDelay = mqttReconnectDelay == 0 ? mqttConfig.connectionInterval :
+                             min(mqttReconnectDelay * 2, (unsigned long)MQTT_RECONNECT_MAX_MS);
+        Serial.printf("MQTT connection failed: %s, retry in %lu ms\n",
+                      getMqttStateString(mqttClient.state()), mqttReconnectDelay);
     }
     
     return success;
 }
 
+#if (!MQTT_BATCH_MODE && MQTT_QOS == 0) || MQTT_QOS >= 1
+// Write the PUBLISH fixed header, topic and (QoS 1) packet ID back to front
+// in the bytes in front of payload; returns the start of the packet
+static uint8_t *_build_publish(uint8_t *payload, size_t length, const char *topic, size_t topicLength,
+                               uint8_t header, uint16_t packetId) {
+    uint8_t *packet = payload;
+    if (header & MQTTQOS1) {
+        *--packet = packetId & 0xFF;
+        *--packet = packetId >> 8;
+    }
+    packet -= topicLength;
+    memcpy(packet, topic, topicLength);
+    *--packet = topicLength & 0xFF;
+    *--packet = topicLength >> 8;
+
+    // Remaining length: variable-length encoding, 7 bits per byte
+    uint8_t encoded[4];
+    size_t encodedLength = 0;
+    size_t remaining = (payload + length) - packet;
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        if (remaining > 0) digit |= 0x80;
+        encoded[encodedLength++] = digit;
+    } while (remaining > 0);
+    packet -= encodedLength;
+    memcpy(packet, encoded, encodedLength);
+    *--packet = header;
+    return packet;
+}
+#endif
+
+#if MQTT_BATCH_MODE && MQTT_SPOOL_MODE
+// Put every frame of an envelope into the spool; returns the frame count
+static uint8_t _spool_envelope(const uint8_t *envelope) {
+    uint8_t frames = envelope[1];
+    size_t offset = 2;
+    for (uint8_t i = 0; i < frames; i++) {
+        size_t length = envelope[offset] | (envelope[offset + 1] << 8);
+        SensorSentinel_spool_push(&envelope[offset + 2], length);
+        offset += 2 + length;
+    }
+    return frames;
+}
+#endif
+
+#if MQTT_QOS >= 1
+static InflightEntry *_inflight_find(uint16_t packetId) {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (_inflight[i].used && _inflight[i].packetId == packetId) return &_inflight[i];
+    }
+    return NULL;
+}
+
+static uint16_t _next_packet_id() {
+    for (;;) {
+        uint16_t id = _nextPacketId++;
+        if (_nextPacketId == 0) _nextPacketId = 1;  // 0 is not a valid packet ID
+        if (!_inflight_find(id)) return id;
+    }
+}
+
+// Give up on an unacknowledged publish: its frames go back to the spool
+static void _inflight_requeue(InflightEntry *e) {
+    const uint8_t *payload = e->packet + (e->packetLength - e->payloadLength);
+#if MQTT_SPOOL_MODE
+#if MQTT_BATCH_MODE
+    if (e->batch) {
+        _ackStats.requeued += _spool_envelope(payload);
+    } else
+#endif
+    if (SensorSentinel_spool_push(payload, e->payloadLength)) {
+        _ackStats.requeued++;
+    } else {
+        _ackStats.lost++;
+    }
+#else
+    _ackStats.lost += e->batch ? payload[1] : 1;
+#endif
+    e->used = false;
+    _ackStats.inflight--;
+}
+
+// QoS 1 publish into the in-flight window; MQTT_PUBLISH_FAILED if it is full
+static MqttForwardStatus _publish_qos1(const char *topic, const uint8_t *payload, size_t length, bool batch) {
+    InflightEntry *e = NULL;
+    for (int i = 0; i < MQTT_INFLIGHT_MAX && !e; i++) {
+        if (!_inflight[i].used) e = &_inflight[i];
+    }
+    if (!e) {
+        _ackStats.windowFull++;
+        return MQTT_PUBLISH_FAILED;
+    }
+    if (length > INFLIGHT_PAYLOAD) return MQTT_PUBLISH_FAILED;
+
+    uint8_t *copy = e->buffer + INFLIGHT_HEADROOM;
+    memcpy(copy, payload, length);
+    e->packetId = _next_packet_id();
+    e->packet = _build_publish(copy, length, topic, strlen(topic), MQTTPUBLISH | MQTTQOS1, e->packetId);
+    e->packetLength = (copy + length) - e->packet;
+    e->payloadLength = length;
+
+    if (mqttClient.write(e->packet, e->packetLength) != e->packetLength) {
+        // A partial packet leaves the stream unusable; force a reconnect
+        wifiClient.stop();
+        return MQTT_PUBLISH_FAILED;
+    }
+    e->firstSentMs = e->sentMs = millis();
+    e->attempts = 1;
+    e->batch = batch;
+    e->used = true;
+    _ackStats.published++;
+    if (++_ackStats.inflight > _ackStats.maxInflight) {
+        _ackStats.maxInflight = _ackStats.inflight;
+    }
+    return MQTT_SUCCESS;
+}
+
+static void _on_puback(uint16_t packetId) {
+    InflightEntry *e = _inflight_find(packetId);
+    if (!e) return;  // Late ack for a publish already requeued
+
+    uint32_t ackMs = millis() - e->firstSentMs;
+    _ackStats.acks++;
+    _ackMsSum += ackMs;
+    if (ackMs > _ackStats.maxAckMs) _ackStats.maxAckMs = ackMs;
+    e->used = false;
+    _ackStats.inflight--;
+}
+
+// Take the PUBACKs at the head of the stream; false if one is still arriving
+static bool _read_acks() {
+    while (wifiClient.available() > 0 && wifiClient.peek() == (MQTTPUBACK)) {
+        if (wifiClient.available() < 4) return false;
+        uint8_t ack[4];
+        wifiClient.read(ack, sizeof(ack));
+        if (ack[1] != 2) {
+            // Not a PUBACK after all: the stream is out of step
+            wifiClient.stop();
+            return false;
+        }
+        _on_puback((ack[2] << 8) | ack[3]);
+    }
+    return true;
+}
+
+// PubSubClient's loop() reads one packet per call and drops PUBACKs, so
+// strip those off the front and let it have whatever else is waiting
+static void _service_inbound() {
+    for (int i = 0; i <= MQTT_INFLIGHT_MAX; i++) {
+        if (!_read_acks()) return;
+        mqttClient.loop();
+        if (wifiClient.available() == 0) break;
+    }
+}
+
+// Resend or requeue publishes whose PUBACK is overdue
+static void _check_inflight() {
+    unsigned long now = millis();
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        InflightEntry *e = &_inflight[i];
+        if (!e->used || now - e->sentMs < MQTT_ACK_TIMEOUT_MS) continue;
+        if (e->attempts >= MQTT_ACK_MAX_ATTEMPTS) {
+            _inflight_requeue(e);
+            continue;
+        }
+        e->packet[0] |= 0x08;  // DUP
+        if (mqttClient.write(e->packet, e->packetLength) != e->packetLength) {
+            wifiClient.stop();
+            return;
+        }
+        e->sentMs = now;
+        e->attempts++;
+        _ackStats.retransmits++;
+    }
+
+    if (now - _ackSecondStart >= 1000) {
+        _ackStats.acksPerSec = _ackStats.acks - _acksAtSecond;
+        _acksAtSecond = _ackStats.acks;
+        _ackSecondStart = now;
+    }
+}
+
+// The session is gone with the connection (clean session): requeue everything
+static void _requeue_all_inflight() {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (_inflight[i].used) _inflight_requeue(&_inflight[i]);
+    }
+}
+#endif
+
+// Startup-to-first-frame-forwarded milestone
+static inline void _note_forwarded() {
+    if (firstForwardMs == 0) firstForwardMs = max(millis(), 1UL);
+}
+
+// Publish a record or envelope on topic at MQTT_QOS
+static MqttForwardStatus _publish_uplink(const char *topic, const uint8_t *data, size_t length, bool batch) {
+#if MQTT_QOS >= 1
+    MqttForwardStatus status = _publish_qos1(topic, data, length, batch);
+#else
+    MqttForwardStatus status = mqttClient.publish(topic, data, length, false) ? MQTT_SUCCESS : MQTT_PUBLISH_FAILED;
+#endif
+    if (status == MQTT_SUCCESS) _note_forwarded();
+    return status;
+}
+
+// Publish one uplink record, or add it to the pending batch envelope
+static MqttForwardStatus _publish_record(const uint8_t *data, size_t length) {
+#if MQTT_BATCH_MODE
+    size_t needed = 2 + length;
+    if (_batchCapacity < 2 + needed) {
+        // Envelope can't hold even one frame; fall back to a plain publish
+        return _publish_uplink(MQTT_UPLINK_TOPIC, data, length, false);
+    }
+
+    // Close the current envelope if this frame doesn't fit
+    if (_batchFrames > 0 && _batchLength + needed > _batchCapacity) {
+        SensorSentinel_mqtt_flush_batch();
+    }
+
+    if (_batchFrames == 0) {
+        _batchLength = 0;
+        _batchStartMs = millis();
+    }
+    _batchFrames = SensorSentinel_batch_append(_batchBuffer, &_batchLength, _batchCapacity, data, length);
+
+    // Publish right away once another minimum-size frame can't fit
+    if (_batchFrames == MQTT_BATCH_MAX_FRAMES ||
+        _batchLength + 2 + UPLINK_RECORD_OVERHEAD + sizeof(SensorSentinel_sensor_packet_t) > _batchCapacity) {
+        return SensorSentinel_mqtt_flush_batch();
+    }
+    return MQTT_BATCHED;
+#else
+    return _publish_uplink(MQTT_UPLINK_TOPIC, data, length, false);
+#endif
+}
+
+#if MQTT_SPOOL_MODE
+// Replay spooled frames oldest-first, at most SPOOL_REPLAY_BURST per interval
+static void _spool_replay() {
+    if (SensorSentinel_spool_depth() == 0 || millis() - _lastSpoolReplay < SPOOL_REPLAY_INTERVAL_MS) {
+        return;
+    }
+    _lastSpoolReplay = millis();
+
+    uint8_t frame[SPOOL_MAX_FRAME];
+    for (int i = 0; i < SPOOL_REPLAY_BURST; i++) {
+        size_t length = SensorSentinel_spool_peek(frame, sizeof(frame));
+        if (length == 0) break;
+
+        MqttForwardStatus status = _publish_record(frame, length);
+        if (status == MQTT_PUBLISH_FAILED) break;  // Leave it for the next attempt
+
+        // MQTT_SPOOLED: a failed envelope put this frame back at the tail
+        SensorSentinel_spool_pop();
+        if (status == MQTT_SPOOLED) break;
+    }
+}
+#endif
+
+// Publish a record, spooling it if the broker can't take it now
+static MqttForwardStatus _forward_record(const uint8_t *record, size_t length) {
+    MqttForwardStatus status = mqttClient.connected() ? _publish_record(record, length) : MQTT_NOT_CONNECTED;
+#if MQTT_SPOOL_MODE
+    // Keep the frame for replay instead of losing it
+    if ((status == MQTT_NOT_CONNECTED || status == MQTT_PUBLISH_FAILED) &&
+        SensorSentinel_spool_push(record, length)) {
+        status = MQTT_SPOOLED;
+    }
+#endif
+    return status;
+}
+
+#if !MQTT_BATCH_MODE && MQTT_QOS == 0
+static_assert(SensorSentinel_RX_HEADROOM >= 5 + 2 + (sizeof(MQTT_UPLINK_TOPIC) - 1) + UPLINK_RECORD_OVERHEAD,
+              "SensorSentinel_RX_HEADROOM too small for MQTT_UPLINK_TOPIC");
+
+// Build the PUBLISH fixed header and topic in the slot headroom in front of
+// record and write the complete packet in one go, bypassing PubSubClient's
+// buffer (QoS 0, not retained)
+static MqttForwardStatus _publish_in_place(uint8_t *record, size_t length) {
+    uint8_t *packet = _build_publish(record, length, MQTT_UPLINK_TOPIC, sizeof(MQTT_UPLINK_TOPIC) - 1,
+                                     MQTTPUBLISH, 0);
+
+    size_t total = (record + length) - packet;
+    if (mqttClient.write(packet, total) != total) {
+        // A partial packet leaves the stream unusable; force a reconnect
+        wifiClient.stop();
+        return MQTT_PUBLISH_FAILED;
+    }
+    _note_forwarded();
+    return MQTT_SUCCESS;
+}
+#endif
+
+#if MQTT_UPLINK_HEADER
+// Receive time as Unix epoch ms, or 0 while NTP has not synced
+static uint64_t _rx_epoch_ms(uint32_t rxMillis) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < TIME_SYNC_EPOCH) return 0;
+
+    uint64_t nowMs = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return nowMs - (uint32_t)(millis() - rxMillis);
+}
+#endif
+
 /**
  * @brief Forward a packet to the MQTT broker
  * @param data Pointer to the data to be sent
@@ -183,8 +574,129 @@ boolean SensorSentinel_mqtt_connect() {
  */
 MqttForwardStatus SensorSentinel_mqtt_forward_packet(uint8_t *data, size_t length, float rssi, float snr) {
     if (!SensorSentinel_validate_packet(data, length)) return MQTT_INVALID_PACKET;
-    if (!mqttClient.connected()) return MQTT_NOT_CONNECTED;
-    return mqttClient.publish(MQTT_TOPIC, data, length, false) ? MQTT_SUCCESS : MQTT_PUBLISH_FAILED;
+#if MQTT_UPLINK_HEADER
+    // No slot to build the header in front of; copy into one
+    static SensorSentinel_rx_slot_t slot;
+    memcpy(slot.data, data, length);
+    slot.length = length;
+    slot.rssi = rssi;
+    slot.snr = snr;
+    slot.freqError = 0;
+    slot.rxMillis = millis();
+    return SensorSentinel_mqtt_forward_slot(&slot);
+#else
+    return _forward_record(data, length);
+#endif
+}
+
+/**
+ * @brief Forward a received slot to the MQTT broker
+ * @param slot Received frame with its link metadata
+ * @return Status of the forwarding operation
+ */
+MqttForwardStatus SensorSentinel_mqtt_forward_slot(SensorSentinel_rx_slot_t *slot) {
+    if (!slot || !SensorSentinel_validate_packet(slot->data, slot->length)) return MQTT_INVALID_PACKET;
+#if MQTT_UPLINK_HEADER
+    static uint32_t gatewayId = SensorSentinel_generate_node_id();
+    uint8_t *record = SensorSentinel_build_uplink_record(slot, gatewayId, _rx_epoch_ms(slot->rxMillis));
+    size_t length = SensorSentinel_UPLINK_HEADROOM + slot->length;
+#else
+    uint8_t *record = slot->data;
+    size_t length = slot->length;
+#endif
+
+#if !MQTT_BATCH_MODE && MQTT_QOS == 0
+    // Straight from the slot to the socket; fall through to spool on failure
+    if (mqttClient.connected() && _publish_in_place(record, length) == MQTT_SUCCESS) {
+        return MQTT_SUCCESS;
+    }
+#endif
+    return _forward_record(record, length);
+}
+
+/**
+ * @brief Publish the pending batch envelope
+ */
+MqttForwardStatus SensorSentinel_mqtt_flush_batch() {
+#if MQTT_BATCH_MODE
+    if (_batchFrames == 0) return MQTT_SUCCESS;
+
+    uint32_t latency = millis() - _batchStartMs;
+    boolean ok = mqttClient.connected() &&
+                 _publish_uplink(MQTT_BATCH_TOPIC, _batchBuffer, _batchLength, true) == MQTT_SUCCESS;
+
+    if (ok) {
+        uint32_t fillPct = _batchLength * 100 / _batchCapacity;
+        _batchesPublished++;
+        _batchFramesPublished += _batchFrames;
+        _batchFillPctSum += fillPct;
+        _batchLatencySum += latency;
+        if (fillPct > _batchFillPctMax) _batchFillPctMax = fillPct;
+        if (latency > _batchLatencyMax) _batchLatencyMax = latency;
+    } else {
+        _batchesFailed++;
+#if MQTT_SPOOL_MODE
+        // Unpack the envelope into the spool so the frames are replayed
+        _spool_envelope(_batchBuffer);
+        Serial.printf("MQTT batch publish failed, %u frames spooled\n", _batchFrames);
+#else
+        Serial.printf("MQTT batch publish failed, %u frames lost\n", _batchFrames);
+#endif
+    }
+
+    _batchFrames = 0;
+    _batchLength = 0;
+#if MQTT_SPOOL_MODE
+    return ok ? MQTT_SUCCESS : MQTT_SPOOLED;
+#else
+    return ok ? MQTT_SUCCESS : MQTT_PUBLISH_FAILED;
+#endif
+#else
+    return MQTT_SUCCESS;
+#endif
+}
+
+/**
+ * @brief Get a snapshot of the batch envelope counters
+ */
+void SensorSentinel_mqtt_get_batch_stats(SensorSentinel_mqtt_batch_stats_t *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+#if MQTT_BATCH_MODE
+    stats->batches = _batchesPublished;
+    stats->frames = _batchFramesPublished;
+    stats->failed = _batchesFailed;
+    stats->capacity = _batchCapacity;
+    stats->maxFillPct = _batchFillPctMax;
+    stats->maxLatencyMs = _batchLatencyMax;
+    stats->pending = _batchFrames;
+    if (_batchesPublished > 0) {
+        stats->avgFillPct = _batchFillPctSum / _batchesPublished;
+        stats->avgFrames = _batchFramesPublished / _batchesPublished;
+        stats->avgLatencyMs = _batchLatencySum / _batchesPublished;
+    }
+#endif
+}
+
+/**
+ * @brief Get a snapshot of the QoS 1 window counters
+ */
+void SensorSentinel_mqtt_get_ack_stats(SensorSentinel_mqtt_ack_stats_t *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+#if MQTT_QOS >= 1
+    *stats = _ackStats;
+    if (_ackStats.acks > 0) {
+        stats->avgAckMs = _ackMsSum / _ackStats.acks;
+    }
+#endif
+}
+
+/**
+ * @brief Time from boot to the first uplink frame reaching the broker
+ */
+uint32_t SensorSentinel_mqtt_first_forward_ms() {
+    return firstForwardMs;
 }
 
 /**
@@ -200,25 +712,70 @@ const char* SensorSentinel_mqtt_status_to_string(MqttForwardStatus status) {
             return "Publish Failed";
         case MQTT_INVALID_PACKET:
             return "Invalid Packet";
+        case MQTT_BATCHED:
+            return "Batched";
+        case MQTT_SPOOLED:
+            return "Spooled";
         default:
             return "Unknown Status";
     }
 }
 
+/**
+ * @brief Publish a string message to an MQTT topic
+ */
+boolean SensorSentinel_mqtt_publish(const char* topic, const char* payload, boolean retained) {
+    if (!mqttClient.connected()) return false;
+    return mqttClient.publish(topic, payload, retained);
+}
+
+/**
+ * @brief Publish a payload past the PubSubClient buffer
+ */
+boolean SensorSentinel_mqtt_publish_stream(const char* topic, const uint8_t* payload, size_t length,
+                                           boolean retained) {
+    if (!mqttClient.connected()) return false;
+    if (!mqttClient.beginPublish(topic, length, retained)) return false;
+    size_t written = mqttClient.write(payload, length);
+    return mqttClient.endPublish() && written == length;
+}
+
+/**
+ * @brief Publish the latency histograms on MQTT_STATS_TOPIC
+ */
+boolean SensorSentinel_mqtt_publish_metrics() {
+#if METRICS_MODE
+    if (!mqttClient.connected()) return false;
+
+    String topic = String(MQTT_STATS_TOPIC "/") + SensorSentinel_mqtt_get_client_id();
+    String payload = SensorSentinel_metrics_format();
+
+    // Several KB: stream it rather than going through the packet buffer
+    return SensorSentinel_mqtt_publish_stream(topic.c_str(), (const uint8_t *)payload.c_str(), payload.length());
+#else
+    return false;
+#endif
+}
+
 /**
  * @brief Setup MQTT connection
  */
 boolean SensorSentinel_mqtt_setup(bool enableLogging) {
-    if (!SensorSentinel_wifi_connected()) {
-        Serial.println("Cannot setup MQTT - WiFi not connected");
-        return false;
-    }
+#if MQTT_SPOOL_MODE
+    // Recover frames spooled before a reboot, even if WiFi is down now
+    SensorSentinel_spool_begin();
+#endif
 
+    // Configure the client whether or not WiFi is up yet; the connect
+    // happens from SensorSentinel_mqtt_maintain()
     if (!SensorSentinel_mqtt_init()) {
         Serial.println("MQTT initialization failed");
         return false;
     }
 
+    if (!SensorSentinel_wifi_connected()) {
+        Serial.println("MQTT will connect once WiFi is up");
+    }
     return true;
 }
 
@@ -227,8 +784,30 @@ boolean SensorSentinel_mqtt_setup(bool enableLogging) {
  */
 boolean SensorSentinel_mqtt_maintain() {
     if (!mqttClient.connected()) {
+#if MQTT_QOS >= 1
+        _requeue_all_inflight();
+#endif
         return SensorSentinel_mqtt_connect();
     }
+#if MQTT_QOS >= 1
+    _service_inbound();
+    _check_inflight();
+#else
     mqttClient.loop();
+#endif
+#if MQTT_SPOOL_MODE
+    _spool_replay();
+#endif
+#if MQTT_BATCH_MODE
+    if (_batchFrames > 0 && millis() - _batchStartMs >= MQTT_BATCH_WINDOW_MS) {
+        SensorSentinel_mqtt_flush_batch();
+    }
+#endif
+#if METRICS_MODE && MQTT_STATS_INTERVAL_SECS > 0
+    if (millis() - _lastStatsPublish >= MQTT_STATS_INTERVAL_SECS * 1000UL) {
+        _lastStatsPublish = millis();
+        SensorSentinel_mqtt_publish_metrics();
+    }
+#endif
     return true;
 }
\ No newline at end of file
@@ -18,9 +18,108 @@ enum MqttForwardStatus {
     MQTT_SUCCESS,      ///< Packet successfully forwarded
     MQTT_NOT_CONNECTED,///< MQTT client not connected
     MQTT_PUBLISH_FAILED,///< Publish operation failed
-    MQTT_INVALID_PACKET ///< Packet validation failed
+    MQTT_INVALID_PACKET,///< Packet validation failed
+    MQTT_BATCHED,      ///< Packet added to the pending batch envelope
+    MQTT_SPOOLED       ///< Not published now; kept in the spool for replay
 };
 
+/**
+ * @brief Batched uplink (MQTT_BATCH_MODE)
+ *
+ * Instead of one publish per LoRa frame, frames are collected for up to
+ * MQTT_BATCH_WINDOW_MS or until the envelope is full and published together
+ * on MQTT_BATCH_TOPIC. Envelope layout (little-endian):
+ *
+ *   [0]    MQTT_BATCH_MARKER
+ *   [1]    frame count
+ *   then per frame: [u16 length][uplink record, see MQTT_UPLINK_HEADER]
+ *
+ * Enable via platformio.ini build flag: -DMQTT_BATCH_MODE=1
+ */
+#ifndef MQTT_BATCH_MODE
+#define MQTT_BATCH_MODE 0
+#endif
+#ifndef MQTT_BATCH_WINDOW_MS
+#define MQTT_BATCH_WINDOW_MS  250   // Oldest frame waits at most this long
+#endif
+#ifndef MQTT_BATCH_MAX_BYTES
+#define MQTT_BATCH_MAX_BYTES  0     // Envelope size cap; 0 = fill the MQTT buffer
+#endif
+#define MQTT_BATCH_MARKER     SensorSentinel_BATCH_MARKER
+#define MQTT_BATCH_MAX_FRAMES SensorSentinel_BATCH_MAX_FRAMES
+
+/**
+ * @brief Batch envelope counters
+ */
+typedef struct {
+    uint32_t batches;       // Envelopes published
+    uint32_t frames;        // Frames carried in published envelopes
+    uint32_t failed;        // Envelopes whose publish failed (frames lost)
+    uint32_t capacity;      // Envelope capacity in bytes
+    uint32_t avgFillPct;    // Mean envelope size as % of capacity
+    uint32_t maxFillPct;
+    uint32_t avgFrames;     // Mean frames per envelope
+    uint32_t avgLatencyMs;  // Mean wait of the oldest frame before publish
+    uint32_t maxLatencyMs;
+    uint32_t pending;       // Frames in the envelope being filled
+} SensorSentinel_mqtt_batch_stats_t;
+
+/**
+ * @brief Acknowledged uplink (MQTT_QOS=1)
+ *
+ * Uplink records and batch envelopes are published at QoS 1. A copy of
+ * each stays in an in-flight window of MQTT_INFLIGHT_MAX until the
+ * broker's PUBACK arrives, so up to that many publishes are outstanding at
+ * once instead of one round trip each. PubSubClient ignores PUBACKs; they
+ * are taken off the socket before its loop() sees them.
+ *
+ * - No PUBACK within MQTT_ACK_TIMEOUT_MS: sent again with the DUP flag, up
+ *   to MQTT_ACK_MAX_ATTEMPTS sends in all.
+ * - Still none, or the connection drops: the frames go back to the spool
+ *   (MQTT_SPOOL_MODE) and are replayed later as new publishes. The broker
+ *   may then deliver a frame twice; the backend dedups on node and counter.
+ * - Window full: a new frame is spooled, or reported as
+ *   MQTT_PUBLISH_FAILED without a spool.
+ *
+ * Other topics (status, stats) stay QoS 0. Enable via platformio.ini build
+ * flag: -DMQTT_QOS=1
+ */
+#ifndef MQTT_QOS
+#define MQTT_QOS 0
+#endif
+#ifndef MQTT_INFLIGHT_MAX
+#define MQTT_INFLIGHT_MAX      8      // Publishes awaiting PUBACK
+#endif
+#ifndef MQTT_ACK_TIMEOUT_MS
+#define MQTT_ACK_TIMEOUT_MS    5000
+#endif
+#ifndef MQTT_ACK_MAX_ATTEMPTS
+#define MQTT_ACK_MAX_ATTEMPTS  2      // Sends per publish before it goes back to the spool
+#endif
+
+// Broker reconnects back off from mqttConfig.connectionInterval, doubling
+// per failed attempt up to this; a successful connect resets it
+#ifndef MQTT_RECONNECT_MAX_MS
+#define MQTT_RECONNECT_MAX_MS  60000
+#endif
+
+/**
+ * @brief QoS 1 window counters
+ */
+typedef struct {
+    uint32_t published;     // Publishes that entered the window
+    uint32_t acks;          // PUBACKs matched to a publish
+    uint32_t acksPerSec;    // PUBACKs in the last full second
+    uint32_t retransmits;   // Publishes sent again with DUP set
+    uint32_t requeued;      // Frames put back in the spool unacknowledged
+    uint32_t lost;          // Frames given up on without a spool
+    uint32_t windowFull;    // Publishes refused because the window was full
+    uint32_t avgAckMs;      // Mean first send to PUBACK
+    uint32_t maxAckMs;
+    uint8_t  inflight;      // Publishes awaiting PUBACK now
+    uint8_t  maxInflight;   // Deepest the window has been since boot
+} SensorSentinel_mqtt_ack_stats_t;
+
 /**
  * @brief Synchronize time via NTP with custom parameters
  * 
@@ -68,7 +167,9 @@ boolean SensorSentinel_mqtt_init();
  * @brief Connect to the MQTT broker
  * 
  * Attempts to establish a connection to the MQTT broker using the
- * configured settings. Will use credentials if provided.
+ * configured settings. Will use credentials if provided. Returns false
+ * without trying while the reconnect backoff runs; the attempt itself
+ * still waits up to mqttConfig.socketTimeout for the broker.
  * 
  * @return boolean True if connected successfully
  */
@@ -77,8 +178,9 @@ boolean SensorSentinel_mqtt_connect();
 /**
  * @brief Set up MQTT with optional time synchronization
  * 
- * Complete setup process for MQTT: initialize, sync time if requested,
- * and establish connection to the broker.
+ * Opens the spool (MQTT_SPOOL_MODE) and initializes the client. Does not
+ * need WiFi: SensorSentinel_mqtt_maintain() connects once it is up, and
+ * frames forwarded before then are spooled.
  * 
  * @param syncTimeOnConnect Whether to synchronize time during setup (default: true)
  * @return boolean True if setup was successful
@@ -89,7 +191,8 @@ boolean SensorSentinel_mqtt_setup(boolean syncTimeOnConnect = true);
  * @brief Maintain MQTT connection
  * 
  * Should be called regularly in the main loop to ensure MQTT connection
- * remains active. Handles reconnection if needed.
+ * remains active. Handles reconnection if needed, replays spooled frames
+ * (MQTT_SPOOL_MODE) and publishes expired batch envelopes (MQTT_BATCH_MODE).
  * 
  * @return boolean True if connected, false if disconnected
  */
@@ -105,6 +208,21 @@ boolean SensorSentinel_mqtt_maintain();
  */
 boolean SensorSentinel_mqtt_publish(const char* topic, const char* payload, boolean retained = false);
 
+/**
+ * @brief Publish a payload larger than the PubSubClient buffer
+ *
+ * Streams the payload straight to the socket after the PUBLISH header, so
+ * MQTT_MAX_PACKET_SIZE does not limit it.
+ *
+ * @param topic The topic to publish to
+ * @param payload The message content
+ * @param length Payload length
+ * @param retained Whether the message should be retained by the broker (default: false)
+ * @return boolean True if the whole payload was written
+ */
+boolean SensorSentinel_mqtt_publish_stream(const char* topic, const uint8_t* payload, size_t length,
+                                           boolean retained = false);
+
 /**
  * @brief Get reference to the MQTT client object
  * 
@@ -142,6 +260,65 @@ const char* SensorSentinel_mqtt_status_to_string(MqttForwardStatus status);
  */
 MqttForwardStatus SensorSentinel_mqtt_forward_packet(uint8_t *data, size_t length, float rssi, float snr);
 
+/**
+ * @brief Forward a received slot to MQTT broker
+ *
+ * Preferred over SensorSentinel_mqtt_forward_packet() on the gateway: the
+ * uplink header is written into the slot's headroom, so header and frame
+ * are published without copying the frame.
+ *
+ * @param slot Received frame with its link metadata
+ * @return MqttForwardStatus Status of the forward operation
+ */
+MqttForwardStatus SensorSentinel_mqtt_forward_slot(SensorSentinel_rx_slot_t *slot);
+
+/**
+ * @brief Publish the pending batch envelope now
+ *
+ * Called from SensorSentinel_mqtt_maintain() once the batch window expires;
+ * call directly before sleeping or disconnecting. No-op without MQTT_BATCH_MODE.
+ *
+ * @return MqttForwardStatus MQTT_SUCCESS if nothing was pending or the publish succeeded
+ */
+MqttForwardStatus SensorSentinel_mqtt_flush_batch();
+
+/**
+ * @brief Get a snapshot of the batch envelope counters
+ * @param stats Pointer to the structure to fill
+ */
+void SensorSentinel_mqtt_get_batch_stats(SensorSentinel_mqtt_batch_stats_t *stats);
+
+/**
+ * @brief Get a snapshot of the QoS 1 window counters
+ *
+ * All zero without MQTT_QOS=1.
+ *
+ * @param stats Pointer to the structure to fill
+ */
+void SensorSentinel_mqtt_get_ack_stats(SensorSentinel_mqtt_ack_stats_t *stats);
+
+/**
+ * @brief Time from boot to the first uplink frame reaching the broker
+ *
+ * Set by the first successful publish of a record or envelope, live or
+ * replayed from the spool (written to the socket; with MQTT_QOS=1, before
+ * its PUBACK).
+ *
+ * @return millis() at that publish, 0 until it happens
+ */
+uint32_t SensorSentinel_mqtt_first_forward_ms();
+
+/**
+ * @brief Publish the hot-path latency histograms on MQTT_STATS_TOPIC
+ *
+ * Called from SensorSentinel_mqtt_maintain() every MQTT_STATS_INTERVAL_SECS.
+ * The payload is the Prometheus text from SensorSentinel_metrics_format(),
+ * streamed past the PubSubClient buffer. No-op with -DMETRICS_MODE=0.
+ *
+ * @return boolean True if the payload was published
+ */
+boolean SensorSentinel_mqtt_publish_metrics();
+
 struct MqttConfig {
     const char* server;
     int port;
@@ -157,4 +334,34 @@ extern MqttConfig mqttConfig;
 #define MQTT_TOPIC "lora/data"  // Default topic if not defined in platformio.ini
 #endif
 
+#ifndef MQTT_BATCH_TOPIC
+#define MQTT_BATCH_TOPIC MQTT_TOPIC "/batch"
+#endif
+
+// Metrics go to <MQTT_STATS_TOPIC>/<client ID>, outside MQTT_TOPIC so the
+// frame parser never sees them; 0 disables the periodic publish
+#ifndef MQTT_STATS_TOPIC
+#define MQTT_STATS_TOPIC "lora/stats"
+#endif
+#ifndef MQTT_STATS_INTERVAL_SECS
+#define MQTT_STATS_INTERVAL_SECS 60
+#endif
+
+/**
+ * Uplink records: with MQTT_UPLINK_HEADER (default) each frame is published
+ * as SensorSentinel_uplink_header_t followed by the frame on the versioned
+ * MQTT_UPLINK_TOPIC. With -DMQTT_UPLINK_HEADER=0 the bare frame goes to
+ * MQTT_TOPIC as before.
+ */
+#ifndef MQTT_UPLINK_HEADER
+#define MQTT_UPLINK_HEADER 1
+#endif
+#ifndef MQTT_UPLINK_TOPIC
+#if MQTT_UPLINK_HEADER
+#define MQTT_UPLINK_TOPIC MQTT_TOPIC "/v1"
+#else
+#define MQTT_UPLINK_TOPIC MQTT_TOPIC
+#endif
+#endif
+
 #endif // SensorSentinel_MQTT_HELPER_H
\ No newline at end of file
@@ -0,0 +1,258 @@
+/**
+ * @file SensorSentinel_net_helper.cpp
+ * @brief Implementation of the non-blocking connectivity state machine
+ */
+
+#include "SensorSentinel_net_helper.h"
+#include "heltec_unofficial_revised.h"
+#include "SensorSentinel_wifi_helper.h"
+#include "SensorSentinel_mqtt_helper.h"
+#include <WiFiManager.h>
+#include <time.h>
+
+#define TIME_SYNC_EPOCH 1600000000  // As in the MQTT helper: the clock has been set
+
+#ifdef TIMEZONE_OFFSET
+#define NET_TIMEZONE TIMEZONE_OFFSET
+#else
+#define NET_TIMEZONE 0  // UTC
+#endif
+
+static SensorSentinel_net_stats_t _stats;
+static unsigned long _stateSince = 0;
+static unsigned long _backoffMs = 0;   // Current step; 0 = none yet
+static unsigned long _waitMs = 0;      // Step plus jitter for this wait
+static bool _hardcoded = false;        // This attempt uses WIFI_SSID
+static bool _ntpStarted = false;
+static bool _firstForwardLogged = false;
+static WiFiManager *_wm = NULL;        // Created when the portal opens
+
+// Set from the WiFi event task, taken by SensorSentinel_net_maintain()
+static volatile bool _gotIp = false;
+static volatile bool _linkLost = false;
+
+static void _on_wifi_event(arduino_event_id_t event, arduino_event_info_t info)
+{
+  switch (event)
+  {
+  case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+    _gotIp = true;
+    break;
+  case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+  case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+    _linkLost = true;
+    break;
+  default:
+    break;
+  }
+}
+
+static void _enter(SensorSentinel_net_state_t state)
+{
+  _stats.state = state;
+  _stateSince = millis();
+}
+
+static void _start_attempt(bool hardcoded)
+{
+  // Nothing stored (first boot, or never configured): go straight to the fallback
+  if (!hardcoded && WiFi.SSID().length() == 0)
+  {
+    hardcoded = true;
+  }
+  _hardcoded = hardcoded;
+  _stats.wifiAttempts++;
+  if (hardcoded)
+  {
+    Serial.printf("WiFi: connecting to %s\n", WIFI_SSID);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  }
+  else
+  {
+    Serial.printf("WiFi: connecting to stored network %s\n", WiFi.SSID().c_str());
+    WiFi.begin();
+  }
+  _enter(NET_WIFI_CONNECTING);
+}
+
+static void _backoff()
+{
+  _backoffMs = _backoffMs == 0 ? NET_BACKOFF_MIN_MS : min(_backoffMs * 2, (unsigned long)NET_BACKOFF_MAX_MS);
+  _waitMs = _backoffMs + random(_backoffMs / 4 + 1);
+  Serial.printf("WiFi: retry in %lu ms\n", _waitMs);
+  _enter(NET_WIFI_BACKOFF);
+}
+
+static void _start_portal()
+{
+  String apName = "SensorSentinel-" + String(ESP.getEfuseMac() >> 16, HEX);
+  if (!_wm)
+  {
+    _wm = new WiFiManager();
+  }
+  _wm->setConfigPortalBlocking(false);
+  _wm->setConfigPortalTimeout(NET_PORTAL_SECS);
+  Serial.printf("WiFi: config portal %s open for %u s\n", apName.c_str(), NET_PORTAL_SECS);
+  _wm->startConfigPortal(apName.c_str());
+  _enter(NET_WIFI_PORTAL);
+}
+
+static void _wifi_up(unsigned long now)
+{
+  _backoffMs = 0;
+  if (_stats.wifiUpMs == 0)
+  {
+    _stats.wifiUpMs = max(now, 1UL);
+  }
+  Serial.printf("WiFi connected: %s, %lu ms after boot\n", WiFi.localIP().toString().c_str(), now);
+  if (!_ntpStarted)
+  {
+    // SNTP keeps trying in the background; polled in SensorSentinel_net_maintain()
+    configTime(NET_TIMEZONE, 0, "pool.ntp.org", "time.nist.gov", "time.google.com");
+    _ntpStarted = true;
+  }
+  _enter(NET_MQTT_CONNECTING);
+}
+
+void SensorSentinel_net_begin()
+{
+  WiFi.onEvent(_on_wifi_event);
+  WiFi.mode(WIFI_STA);
+  _start_attempt(false);
+
+  // Needs no network; frames forwarded before the broker is up are spooled
+  SensorSentinel_mqtt_setup(true);
+}
+
+bool SensorSentinel_net_maintain()
+{
+  unsigned long now = millis();
+  bool gotIp = _gotIp;
+  bool linkLost = _linkLost;
+  _gotIp = false;
+  _linkLost = false;
+
+  // Events say when to look; the status says what is true now
+  bool up = WiFi.status() == WL_CONNECTED;
+
+  switch (_stats.state)
+  {
+  case NET_WIFI_CONNECTING:
+    if (up)
+    {
+      _wifi_up(now);
+    }
+    else if (now - _stateSince >= NET_WIFI_ATTEMPT_MS)
+    {
+      WiFi.disconnect();
+      if (!_hardcoded)
+      {
+        _start_attempt(true);
+      }
+      else if (NET_PORTAL_SECS > 0 && _stats.wifiUpMs == 0 && !_wm)
+      {
+        _start_portal();
+      }
+      else
+      {
+        _backoff();
+      }
+    }
+    break;
+
+  case NET_WIFI_PORTAL:
+    if (_wm->process() || up)
+    {
+      _wifi_up(now);
+    }
+    else if (!_wm->getConfigPortalActive())
+    {
+      Serial.println("WiFi: config portal closed");
+      WiFi.mode(WIFI_STA);
+      _backoff();
+    }
+    break;
+
+  case NET_WIFI_BACKOFF:
+    if (up)
+    {
+      _wifi_up(now);  // The driver's own reconnect got there first
+    }
+    else if (now - _stateSince >= _waitMs)
+    {
+      _start_attempt(false);
+    }
+    break;
+
+  case NET_MQTT_CONNECTING:
+  case NET_ONLINE:
+    if (!up || (linkLost && !gotIp))
+    {
+      _stats.wifiDrops++;
+      Serial.printf("WiFi: link lost (%s)\n", SensorSentinel_net_state_to_string(_stats.state));
+      _backoff();
+    }
+    break;
+  }
+
+  if (_ntpStarted && _stats.timeSyncMs == 0 && time(nullptr) >= TIME_SYNC_EPOCH)
+  {
+    _stats.timeSyncMs = max(now, 1UL);
+    Serial.printf("Time synced, %lu ms after boot\n", now);
+  }
+
+  // Always: with the link down it requeues QoS 1 publishes and returns false
+  bool mqttUp = SensorSentinel_mqtt_maintain();
+  if (_stats.state == NET_MQTT_CONNECTING && mqttUp)
+  {
+    _stats.mqttConnects++;
+    if (_stats.mqttUpMs == 0)
+    {
+      _stats.mqttUpMs = max(now, 1UL);
+      Serial.printf("MQTT up, %lu ms after boot\n", now);
+    }
+    _enter(NET_ONLINE);
+  }
+  else if (_stats.state == NET_ONLINE && !mqttUp)
+  {
+    _stats.mqttDrops++;
+    _enter(NET_MQTT_CONNECTING);
+  }
+
+  _stats.firstForwardMs = SensorSentinel_mqtt_first_forward_ms();
+  if (_stats.firstForwardMs && !_firstForwardLogged)
+  {
+    _firstForwardLogged = true;
+    Serial.printf("Startup: first frame forwarded %u ms after boot (WiFi %u, time %u, MQTT %u)\n",
+                  _stats.firstForwardMs, _stats.wifiUpMs, _stats.timeSyncMs, _stats.mqttUpMs);
+  }
+  return _stats.state == NET_ONLINE;
+}
+
+void SensorSentinel_net_get_stats(SensorSentinel_net_stats_t *stats)
+{
+  if (stats)
+  {
+    *stats = _stats;
+    stats->firstForwardMs = SensorSentinel_mqtt_first_forward_ms();
+  }
+}
+
+const char *SensorSentinel_net_state_to_string(SensorSentinel_net_state_t state)
+{
+  switch (state)
+  {
+  case NET_WIFI_CONNECTING:
+    return "WiFi connecting";
+  case NET_WIFI_PORTAL:
+    return "Config portal";
+  case NET_WIFI_BACKOFF:
+    return "WiFi backoff";
+  case NET_MQTT_CONNECTING:
+    return "MQTT connecting";
+  case NET_ONLINE:
+    return "Online";
+  default:
+    return "Unknown";
+  }
+}
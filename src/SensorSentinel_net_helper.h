@@ -0,0 +1,103 @@
+/**
+ * @file SensorSentinel_net_helper.h
+ * @brief Non-blocking WiFi, NTP and MQTT bring-up and reconnect
+ *
+ * SensorSentinel_net_begin() returns straight away. SensorSentinel_net_maintain(),
+ * called on every pass of loop() or the uplink task, steps through the
+ * states below without waiting on anything, so the radio is serviced and
+ * frames are spooled (MQTT_SPOOL_MODE) from the first second of uptime:
+ *
+ *   NET_WIFI_CONNECTING  Stored credentials, then WIFI_SSID/WIFI_PASSWORD,
+ *                        NET_WIFI_ATTEMPT_MS each
+ *   NET_WIFI_PORTAL      WiFiManager config portal, non-blocking, at most
+ *                        once per boot and only if WiFi has never come up
+ *   NET_WIFI_BACKOFF     Wait before the next round, from NET_BACKOFF_MIN_MS
+ *                        doubling to NET_BACKOFF_MAX_MS, plus up to 25% jitter
+ *   NET_MQTT_CONNECTING  WiFi up; SNTP syncs in the background and the
+ *                        broker is retried with its own backoff
+ *                        (MQTT_RECONNECT_MAX_MS)
+ *   NET_ONLINE           Broker connected
+ *
+ * ESP32 WiFi events flag a new IP or a lost link; a lost link goes back to
+ * NET_WIFI_BACKOFF. The time since boot of each milestone (WiFi up, clock
+ * synced, broker connected, first frame forwarded) is kept for the metrics.
+ *
+ * A broker connect attempt still blocks in PubSubClient for up to
+ * mqttConfig.socketTimeout; with THREADED_RUNTIME that is the uplink task,
+ * not the radio.
+ */
+
+#ifndef SensorSentinel_NET_HELPER_H
+#define SensorSentinel_NET_HELPER_H
+
+#include <Arduino.h>
+
+#ifndef NET_WIFI_ATTEMPT_MS
+#define NET_WIFI_ATTEMPT_MS  10000   // Per set of credentials
+#endif
+#ifndef NET_PORTAL_SECS
+#define NET_PORTAL_SECS      120     // Config portal lifetime; 0 = never open it
+#endif
+#ifndef NET_BACKOFF_MIN_MS
+#define NET_BACKOFF_MIN_MS   1000
+#endif
+#ifndef NET_BACKOFF_MAX_MS
+#define NET_BACKOFF_MAX_MS   60000
+#endif
+
+/**
+ * @brief Connectivity states
+ */
+typedef enum {
+  NET_WIFI_CONNECTING,
+  NET_WIFI_PORTAL,
+  NET_WIFI_BACKOFF,
+  NET_MQTT_CONNECTING,
+  NET_ONLINE
+} SensorSentinel_net_state_t;
+
+/**
+ * @brief Connectivity counters and startup milestones
+ *
+ * Milestones are millis() when each first happened this boot, 0 until then.
+ */
+typedef struct {
+  SensorSentinel_net_state_t state;
+  uint32_t wifiUpMs;          // First IP address
+  uint32_t timeSyncMs;        // Clock set by SNTP
+  uint32_t mqttUpMs;          // First broker connection
+  uint32_t firstForwardMs;    // First uplink frame published
+  uint32_t wifiAttempts;      // WiFi.begin() calls
+  uint32_t wifiDrops;         // Links lost after coming up
+  uint32_t mqttConnects;      // Broker connections made
+  uint32_t mqttDrops;         // Broker connections lost with WiFi still up
+} SensorSentinel_net_stats_t;
+
+/**
+ * @brief Start bringing up WiFi and MQTT; returns immediately
+ *
+ * Registers the WiFi event handler, starts the first connect attempt and
+ * sets up the MQTT client (SensorSentinel_mqtt_setup()).
+ */
+void SensorSentinel_net_begin();
+
+/**
+ * @brief Advance the state machine and service the broker connection
+ *
+ * Calls SensorSentinel_mqtt_maintain() on every pass, so callers do not.
+ *
+ * @return true while NET_ONLINE
+ */
+bool SensorSentinel_net_maintain();
+
+/**
+ * @brief Get a snapshot of the counters and milestones
+ */
+void SensorSentinel_net_get_stats(SensorSentinel_net_stats_t *stats);
+
+/**
+ * @brief Convert a connectivity state to a human-readable string
+ */
+const char *SensorSentinel_net_state_to_string(SensorSentinel_net_state_t state);
+
+#endif // SensorSentinel_NET_HELPER_H
@@ -4,9 +4,17 @@
  */
 
 #include "SensorSentinel_packet_helper.h"
+#ifndef SensorSentinel_HOST
 #include "heltec_unofficial_revised.h"
+#endif
+#include "SensorSentinel_metrics_helper.h"
+#include "SensorSentinel_log_helper.h"
 #include <string.h> // For memcpy
 
+// Host builds (SensorSentinel_HOST, see host/) take only the frame format
+// code: validation, decoding, printing. Building frames needs the board.
+#ifndef SensorSentinel_HOST
+
 // Add after your existing global variables:
 static uint32_t cached_node_id = 0;
 
@@ -68,17 +76,85 @@ bool SensorSentinel_init_sensor_packet(SensorSentinel_sensor_packet_t *packet, u
   packet->messageCounter = counter;
   packet->uptime = millis() / 1000; // Seconds since boot
 
+  // Get pin readings; the burst also refreshes the battery reading
+  SensorSentinel_read_all_pins(&packet->pins);
+
   // Get battery information
   float batteryVolts = heltec_vbat();
   packet->batteryVoltage = (uint16_t)(batteryVolts * 1000.0f);
   packet->batteryLevel = heltec_battery_percent(batteryVolts);
 
-  // Get pin readings
-  SensorSentinel_read_all_pins(&packet->pins);
-
   return true;
 }
 
+/**
+ * @brief Build an aggregate packet from buffered pin readings
+ */
+size_t SensorSentinel_init_aggregate_packet(uint8_t *buffer, size_t size, uint32_t counter,
+                                            const SensorSentinel_pin_readings_t *samples, uint8_t count,
+                                            uint8_t mode, uint16_t intervalSecs)
+{
+  if (!buffer || !samples || count == 0 || count > AGGREGATE_MAX_SAMPLES)
+    return 0;
+
+  size_t bodySize = (mode == AGGREGATE_MODE_SUMMARY) ? sizeof(SensorSentinel_aggregate_summary_t)
+                                                     : count * sizeof(SensorSentinel_pin_readings_t);
+  size_t length = sizeof(SensorSentinel_aggregate_header_t) + bodySize;
+  if (size < length)
+    return 0;
+
+  SensorSentinel_aggregate_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.messageType = SensorSentinel_MSG_AGGREGATE;
+  header.nodeId = SensorSentinel_generate_node_id();
+  header.messageCounter = counter;
+  header.uptime = millis() / 1000;
+
+  float batteryVolts = heltec_vbat();
+  header.batteryVoltage = (uint16_t)(batteryVolts * 1000.0f);
+  header.batteryLevel = heltec_battery_percent(batteryVolts);
+
+  header.mode = mode;
+  header.sampleCount = count;
+  header.sampleIntervalSecs = intervalSecs;
+  memcpy(buffer, &header, sizeof(header));
+
+  if (mode != AGGREGATE_MODE_SUMMARY)
+  {
+    memcpy(buffer + sizeof(header), samples, bodySize);
+    return length;
+  }
+
+  SensorSentinel_aggregate_summary_t summary;
+  uint32_t sum[4] = {0, 0, 0, 0};
+  summary.digitalAny = 0;
+  summary.digitalAll = 0xFF;
+  for (int i = 0; i < 4; i++)
+  {
+    summary.analogMin[i] = UINT16_MAX;
+    summary.analogMax[i] = 0;
+  }
+  for (uint8_t s = 0; s < count; s++)
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      uint16_t v = samples[s].analog[i];
+      summary.analogMin[i] = min(summary.analogMin[i], v);
+      summary.analogMax[i] = max(summary.analogMax[i], v);
+      sum[i] += v;
+    }
+    summary.digitalAny |= samples[s].boolean;
+    summary.digitalAll &= samples[s].boolean;
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    summary.analogMean[i] = (uint16_t)((sum[i] + count / 2) / count);
+  }
+  summary.digitalLast = samples[count - 1].boolean;
+  memcpy(buffer + sizeof(header), &summary, sizeof(summary));
+  return length;
+}
+
 /**
  * @brief Initialize a GNSS packet with device information and location data if available
  *
@@ -139,6 +215,8 @@ bool SensorSentinel_init_gnss_packet(SensorSentinel_gnss_packet_t *packet, uint3
   return hasValidFix;
 }
 
+#endif // SensorSentinel_HOST
+
 /**
  * @brief Get the size of a packet based on its message type
  *
@@ -159,6 +237,14 @@ size_t SensorSentinel_get_packet_size(uint8_t messageType)
   case SensorSentinel_MSG_GNSS:
     return sizeof(SensorSentinel_gnss_packet_t);
 
+  case SensorSentinel_MSG_SENSOR_V2:
+  case SensorSentinel_MSG_GNSS_V2:
+    // Variable length: upper bound
+    return SensorSentinel_V2_MAX_FRAME;
+
+  case SensorSentinel_MSG_AGGREGATE:
+    return SensorSentinel_AGGREGATE_MAX_SIZE;
+
   default:
     // Unknown message type
     return 0;
@@ -177,6 +263,10 @@ size_t SensorSentinel_get_packet_size(uint8_t messageType)
  */
 bool SensorSentinel_print_packet_info(const void *packet, size_t length)
 {
+  SensorSentinel_METRICS_SCOPE(METRIC_PRINT_PACKET_INFO);
+
+  // Keep the raw bytes for the dump at the end
+  const void *raw = packet;
 
   // Get the message type from the first byte
   uint8_t messageType = *((uint8_t *)packet);
@@ -184,6 +274,28 @@ bool SensorSentinel_print_packet_info(const void *packet, size_t length)
   // Print common header information
   Serial.println("------ Packet Information ------");
 
+  // v2 frames are printed from their expanded v1 form
+  SensorSentinel_packet_t expanded;
+  if (messageType == SensorSentinel_MSG_SENSOR_V2 || messageType == SensorSentinel_MSG_GNSS_V2)
+  {
+    SensorSentinel_v2_header_t v2;
+    if (!SensorSentinel_v2_parse_header((const uint8_t *)packet, length, &v2))
+    {
+      Serial.println("Malformed v2 frame");
+      return false;
+    }
+    Serial.printf("Format: v2 %s frame (%u bytes)\n", v2.delta ? "delta" : "key", length);
+    if (!SensorSentinel_decode_packet((const uint8_t *)packet, length, &expanded))
+    {
+      Serial.printf("Node ID: 0x%08X\n", v2.nodeId);
+      Serial.printf("Msg #: %u\n", v2.messageCounter);
+      Serial.printf("Key frame #%u not seen yet; fields unavailable\n", v2.keyCounter);
+      return true;
+    }
+    packet = &expanded;
+    messageType = expanded.header.messageType;
+  }
+
   // Handle different packet types
   switch (messageType)
   {
@@ -215,12 +327,7 @@ bool SensorSentinel_print_packet_info(const void *packet, size_t length)
       Serial.printf("  D%d: %d\n", i, pinState);
     }
 
-    // Print reserved bytes
-    Serial.println("\nReserved Bytes:");
-    for (int i = 0; i < sizeof(sensorPacket->reserved); i++)
-    {
-      Serial.printf("  [%d]: 0x%02X\n", i, sensorPacket->reserved[i]);
-    }
+    Serial.printf("\nSkipped TX since last: %u\n", sensorPacket->skippedCount);
 
     break;
   }
@@ -260,13 +367,73 @@ bool SensorSentinel_print_packet_info(const void *packet, size_t length)
     break;
   }
 
+  case SensorSentinel_MSG_AGGREGATE:
+  {
+    const SensorSentinel_aggregate_header_t *agg = (const SensorSentinel_aggregate_header_t *)packet;
+    if (!SensorSentinel_validate_packet(packet, length))
+    {
+      Serial.println("Malformed aggregate packet");
+      return false;
+    }
+
+    Serial.println("Type: Aggregate Readings");
+    Serial.printf("Node ID: 0x%08X\n", agg->nodeId);
+    Serial.printf("Msg #: %u\n", agg->messageCounter);
+    Serial.printf("Uptime: %u seconds\n", agg->uptime);
+    Serial.printf("Battery: %u%% (%.2fV)\n", agg->batteryLevel, agg->batteryVoltage / 1000.0f);
+    Serial.printf("Samples: %u, %us apart (%s)\n", agg->sampleCount, agg->sampleIntervalSecs,
+                  agg->mode == AGGREGATE_MODE_SUMMARY ? "summary" : "all");
+
+    const uint8_t *body = (const uint8_t *)packet + sizeof(*agg);
+    if (agg->mode == AGGREGATE_MODE_SUMMARY)
+    {
+      const SensorSentinel_aggregate_summary_t *sum = (const SensorSentinel_aggregate_summary_t *)body;
+      Serial.println("\nAnalog Readings (min/mean/max):");
+      for (int i = 0; i < 4; i++)
+      {
+        Serial.printf("  A%d: %u / %u / %u\n", i, sum->analogMin[i], sum->analogMean[i], sum->analogMax[i]);
+      }
+      Serial.printf("\nDigital: last 0x%02X, any 0x%02X, all 0x%02X\n",
+                    sum->digitalLast, sum->digitalAny, sum->digitalAll);
+    }
+    else
+    {
+      const SensorSentinel_pin_readings_t *samples = (const SensorSentinel_pin_readings_t *)body;
+      Serial.println("\nReadings (A0 A1 A2 A3 digital):");
+      for (int s = 0; s < agg->sampleCount; s++)
+      {
+        Serial.printf("  [%2d] %4u %4u %4u %4u 0x%02X\n", s, samples[s].analog[0], samples[s].analog[1],
+                      samples[s].analog[2], samples[s].analog[3], samples[s].boolean);
+      }
+    }
+    break;
+  }
+
   default:
     Serial.printf("Unknown packet type: 0x%02X\n", messageType);
     return false;
   }
 
+  SensorSentinel_tx_report_t report;
+  if (SensorSentinel_get_tx_report((const uint8_t *)raw, length, &report))
+  {
+    Serial.printf("\nLBT report: %u busy, %u forced, %u ms backoff\n",
+                  report.busy, report.forced, report.backoffMs);
+  }
+
+  SensorSentinel_pin_edges_t edges;
+  if (SensorSentinel_get_pin_edges((const uint8_t *)raw, length, &edges))
+  {
+    Serial.printf("\nPin edges: changed 0x%02X, pulses", edges.changed);
+    for (int i = 0; i < SensorSentinel_BOOLEAN_COUNT; i++)
+    {
+      Serial.printf(" %u", edges.pulses[i]);
+    }
+    Serial.println();
+  }
+
   Serial.printf("\nRaw data (%u bytes): ", length);
-  const uint8_t* packetData = static_cast<const uint8_t*>(packet);
+  const uint8_t* packetData = static_cast<const uint8_t*>(raw);
   for (size_t i = 0; i < length; i++)
   {
     Serial.printf("%02X", packetData[i]);
@@ -287,44 +454,86 @@ bool SensorSentinel_print_packet_info(const void *packet, size_t length)
  */
 bool SensorSentinel_validate_packet(const void *data, size_t length)
 { 
+  SensorSentinel_METRICS_SCOPE(METRIC_VALIDATE_PACKET);
+
 // Check packet size
   if (length > MAX_LORA_PACKET_SIZE)
   {
-    Serial.println("Packet too large!");
-    Serial.printf("\nSize: %u bytes (max %u)\n", length, MAX_LORA_PACKET_SIZE);
+    SensorSentinel_log_w("Packet too large!\n");
+    SensorSentinel_log_w("\nSize: %u bytes (max %u)\n", length, MAX_LORA_PACKET_SIZE);
     return false;
   }
 
   if (!data)
   {
-    Serial.println("ERROR: Null packet pointer");
+    SensorSentinel_log_e("ERROR: Null packet pointer\n");
     return false;
   }
 
   // Need at least one byte for the message type
   if (length < 1)
   {
-    Serial.println("ERROR: Packet length zero");
+    SensorSentinel_log_w("ERROR: Packet length zero\n");
     return false;
   }
 
   // Get the message type from the first byte
   uint8_t messageType = *((const uint8_t *)data);
 
+  // v2 frames are variable length; the codec checks they parse exactly
+  if (messageType == SensorSentinel_MSG_SENSOR_V2 || messageType == SensorSentinel_MSG_GNSS_V2)
+  {
+    if (!SensorSentinel_v2_is_valid((const uint8_t *)data, length))
+    {
+      SensorSentinel_log_w("ERROR: Malformed v2 frame (%u bytes)\n", length);
+      return false;
+    }
+    return true;
+  }
+
+  // Downlink for one node (SensorSentinel_adr_helper.h), not an uplink
+  if (messageType == SensorSentinel_MSG_LINK_HINT)
+  {
+    SensorSentinel_log_d("Link hint, not forwarded\n");
+    return false;
+  }
+
+  // Aggregate: the header says how long the body is
+  if (messageType == SensorSentinel_MSG_AGGREGATE)
+  {
+    if (length < sizeof(SensorSentinel_aggregate_header_t))
+    {
+      SensorSentinel_log_w("ERROR: Aggregate packet too short (%u bytes)\n", length);
+      return false;
+    }
+    const SensorSentinel_aggregate_header_t *agg = (const SensorSentinel_aggregate_header_t *)data;
+    size_t bodySize = (agg->mode == AGGREGATE_MODE_SUMMARY) ? sizeof(SensorSentinel_aggregate_summary_t)
+                                                            : agg->sampleCount * sizeof(SensorSentinel_pin_readings_t);
+    size_t frameSize = sizeof(SensorSentinel_aggregate_header_t) + bodySize;
+    if (agg->mode > AGGREGATE_MODE_SUMMARY || agg->sampleCount == 0 ||
+        (length != frameSize && length != frameSize + SensorSentinel_TX_REPORT_SIZE))
+    {
+      SensorSentinel_log_w("ERROR: Inconsistent aggregate packet - mode %u, %u samples, %u bytes\n",
+                           agg->mode, agg->sampleCount, length);
+      return false;
+    }
+    return true;
+  }
+
   // Get the expected size for this message type
   size_t expectedSize = SensorSentinel_get_packet_size(messageType);
 
   // Check if it's a known message type
   if (expectedSize == 0)
   {
-    Serial.printf("Unknown message type 0x%02X\n", messageType);
+    SensorSentinel_log_w("Unknown message type 0x%02X\n", messageType);
   }
 
-  // Check if the data size matches the expected size
-  if (length != expectedSize)
+  // Check if the data size matches the expected size (optionally plus a TX report)
+  if (length != expectedSize && (expectedSize == 0 || length != expectedSize + SensorSentinel_TX_REPORT_SIZE))
   {
-      Serial.printf("ERROR: Incorrect packet size - expected %u bytes, got %u bytes\n",
-                    expectedSize, length);
+      SensorSentinel_log_w("ERROR: Incorrect packet size - expected %u bytes, got %u bytes\n",
+                           expectedSize, length);
     return false;
   }
 
@@ -353,6 +562,13 @@ bool SensorSentinel_copy_packet(void *dest, size_t destSize, const void *src)
     return false;
   }
 
+  if (messageType == SensorSentinel_MSG_SENSOR_V2 || messageType == SensorSentinel_MSG_GNSS_V2 ||
+      messageType == SensorSentinel_MSG_AGGREGATE)
+  {
+    Serial.printf("ERROR: Packet type 0x%02X is variable length\n", messageType);
+    return false;
+  }
+
   if (destSize < copySize)
   {
     Serial.printf("ERROR: Destination buffer too small (need %u, have %u)\n",
@@ -375,6 +591,14 @@ const char* SensorSentinel_message_type_to_string(uint8_t messageType) {
             return "Sensor";
         case SensorSentinel_MSG_GNSS:
             return "GNSS";
+        case SensorSentinel_MSG_AGGREGATE:
+            return "Aggregate";
+        case SensorSentinel_MSG_LINK_HINT:
+            return "Link hint";
+        case SensorSentinel_MSG_SENSOR_V2:
+            return "Sensor v2";
+        case SensorSentinel_MSG_GNSS_V2:
+            return "GNSS v2";
         default:
             return "Unknown";
     }
@@ -382,6 +606,12 @@ const char* SensorSentinel_message_type_to_string(uint8_t messageType) {
 
 uint32_t SensorSentinel_get_message_counter_from_packet(uint8_t *data) {
     if (!data) return 0;
+
+    // v2: varint after the (same-offset) node ID
+    if (data[0] == SensorSentinel_MSG_SENSOR_V2 || data[0] == SensorSentinel_MSG_GNSS_V2) {
+        SensorSentinel_v2_header_t v2;
+        return SensorSentinel_v2_parse_header(data, SensorSentinel_V2_MAX_FRAME, &v2) ? v2.messageCounter : 0;
+    }
     
     SensorSentinel_packet_t* packet = (SensorSentinel_packet_t*)data;
     return packet->header.messageCounter;
@@ -394,6 +624,113 @@ uint32_t SensorSentinel_extract_node_id_from_packet(uint8_t *data) {
     return packet->header.nodeId;
 }
 
+uint32_t SensorSentinel_get_uptime_from_packet(const uint8_t *data, size_t length) {
+    if (!data || length == 0) return 0;
+
+    if (data[0] == SensorSentinel_MSG_SENSOR_V2 || data[0] == SensorSentinel_MSG_GNSS_V2) {
+        SensorSentinel_v2_header_t v2;
+        if (!SensorSentinel_v2_parse_header(data, length, &v2) || v2.delta) return 0;
+        _v2_reader_t r = {data + v2.headerLength, data + length, true};
+        uint32_t uptime = _v2_varint(&r);
+        return r.ok ? uptime : 0;
+    }
+
+    // Sensor, GNSS and aggregate frames share the header up to batteryVoltage
+    uint32_t uptime;
+    if (length < offsetof(SensorSentinel_sensor_packet_t, uptime) + sizeof(uptime)) return 0;
+    memcpy(&uptime, data + offsetof(SensorSentinel_sensor_packet_t, uptime), sizeof(uptime));
+    return uptime;
+}
+
+// Length of a v1 uplink without its TX report, or 0 for other types
+static size_t _v1_frame_size(const uint8_t *data, size_t length)
+{
+  switch (data[0])
+  {
+  case SensorSentinel_MSG_SENSOR:
+  case SensorSentinel_MSG_GNSS:
+    return SensorSentinel_get_packet_size(data[0]);
+
+  case SensorSentinel_MSG_AGGREGATE:
+  {
+    if (length < sizeof(SensorSentinel_aggregate_header_t))
+    {
+      return 0;
+    }
+    const SensorSentinel_aggregate_header_t *agg = (const SensorSentinel_aggregate_header_t *)data;
+    return sizeof(*agg) + ((agg->mode == AGGREGATE_MODE_SUMMARY) ? sizeof(SensorSentinel_aggregate_summary_t)
+                                                                 : agg->sampleCount * sizeof(SensorSentinel_pin_readings_t));
+  }
+
+  default:
+    return 0;
+  }
+}
+
+size_t SensorSentinel_add_tx_report(uint8_t *frame, size_t length, size_t size,
+                                    const SensorSentinel_tx_report_t *report) {
+    if (!frame || !report || length == 0 || length + SensorSentinel_TX_REPORT_SIZE > size) {
+        return length;
+    }
+
+    if (frame[0] == SensorSentinel_MSG_SENSOR_V2 || frame[0] == SensorSentinel_MSG_GNSS_V2) {
+        size_t withReport = SensorSentinel_v2_add_report(frame, length, (const uint8_t *)report);
+        return withReport ? withReport : length;
+    }
+
+    size_t base = _v1_frame_size(frame, length);
+    if (base == 0 || length != base) {
+        return length;
+    }
+    memcpy(frame + length, report, SensorSentinel_TX_REPORT_SIZE);
+    return length + SensorSentinel_TX_REPORT_SIZE;
+}
+
+bool SensorSentinel_get_tx_report(const uint8_t *data, size_t length, SensorSentinel_tx_report_t *report) {
+    if (!data || !report || length < SensorSentinel_TX_REPORT_SIZE) {
+        return false;
+    }
+
+    bool present;
+    if (data[0] == SensorSentinel_MSG_SENSOR_V2 || data[0] == SensorSentinel_MSG_GNSS_V2) {
+        SensorSentinel_v2_header_t v2;
+        present = SensorSentinel_v2_parse_header(data, length, &v2) && v2.report;
+    } else {
+        size_t base = _v1_frame_size(data, length);
+        present = base != 0 && length == base + SensorSentinel_TX_REPORT_SIZE;
+    }
+
+    if (present) {
+        memcpy(report, data + length - SensorSentinel_TX_REPORT_SIZE, SensorSentinel_TX_REPORT_SIZE);
+    }
+    return present;
+}
+
+size_t SensorSentinel_add_pin_edges(uint8_t *frame, size_t length, size_t size,
+                                    const SensorSentinel_pin_edges_t *edges) {
+    // Mask plus up to 3 varint bytes per pin
+    if (!frame || !edges || length == 0 || frame[0] != SensorSentinel_MSG_SENSOR_V2 ||
+        length + 1 + 3 * SensorSentinel_BOOLEAN_COUNT > size) {
+        return length;
+    }
+    size_t withEdges = SensorSentinel_v2_add_edges(frame, length, edges->changed, edges->pulses);
+    return withEdges ? withEdges : length;
+}
+
+bool SensorSentinel_get_pin_edges(const uint8_t *data, size_t length, SensorSentinel_pin_edges_t *edges) {
+    if (!data || !edges || length == 0 || data[0] != SensorSentinel_MSG_SENSOR_V2) {
+        return false;
+    }
+    // Edges are not deltas: a delta frame without its key still has them
+    SensorSentinel_v2_sensor_t frame;
+    if (SensorSentinel_v2_decode_sensor(data, length, NULL, &frame) == V2_MALFORMED || frame.edgesChanged == 0) {
+        return false;
+    }
+    edges->changed = frame.edgesChanged;
+    memcpy(edges->pulses, frame.pulses, sizeof(edges->pulses));
+    return true;
+}
+
 void SensorSentinel_print_invalid_packet(const uint8_t* data, size_t length) {
     Serial.println("Invalid packet contents:");
     
@@ -416,4 +753,269 @@ void SensorSentinel_print_invalid_packet(const uint8_t* data, size_t length) {
         }
     }
     Serial.println("\n---------------------------");
-}
\ No newline at end of file
+}
+// ── v2 encoding ─────────────────────────────────────────────────────────────
+
+// Last key frames this node sent; RTC memory survives deep sleep
+RTC_DATA_ATTR static SensorSentinel_v2_sensor_t _v2SentSensorKey;
+RTC_DATA_ATTR static SensorSentinel_v2_gnss_t _v2SentGnssKey;
+
+// Key frames heard from other nodes, for decoding their deltas: one slot per
+// node in range, ~70 bytes each (sensor and GNSS). A node whose slot was
+// taken over loses its deltas until its next key frame.
+#ifndef V2_KEY_CACHE_SIZE
+#define V2_KEY_CACHE_SIZE 64
+#endif
+static SensorSentinel_v2_sensor_t _v2SensorKeys[V2_KEY_CACHE_SIZE];
+static SensorSentinel_v2_gnss_t _v2GnssKeys[V2_KEY_CACHE_SIZE];
+static uint16_t _v2SensorNext = 0;
+static uint16_t _v2GnssNext = 0;
+
+static void _v2_from_sensor(const SensorSentinel_sensor_packet_t *p, SensorSentinel_v2_sensor_t *v)
+{
+  v->nodeId = p->nodeId;
+  v->messageCounter = p->messageCounter;
+  v->uptime = p->uptime;
+  v->batteryLevel = p->batteryLevel;
+  v->batteryVoltage = p->batteryVoltage;
+  for (int i = 0; i < 4; i++)
+  {
+    v->analog[i] = p->pins.analog[i];
+  }
+  v->boolean = p->pins.boolean;
+}
+
+static void _v2_to_sensor(const SensorSentinel_v2_sensor_t *v, SensorSentinel_sensor_packet_t *p)
+{
+  memset(p, 0, sizeof(*p));
+  p->messageType = SensorSentinel_MSG_SENSOR;
+  p->nodeId = v->nodeId;
+  p->messageCounter = v->messageCounter;
+  p->uptime = v->uptime;
+  p->batteryLevel = v->batteryLevel;
+  p->batteryVoltage = v->batteryVoltage;
+  for (int i = 0; i < 4; i++)
+  {
+    p->pins.analog[i] = v->analog[i];
+  }
+  p->pins.boolean = v->boolean;
+}
+
+static void _v2_from_gnss(const SensorSentinel_gnss_packet_t *p, SensorSentinel_v2_gnss_t *v)
+{
+  v->nodeId = p->nodeId;
+  v->messageCounter = p->messageCounter;
+  v->uptime = p->uptime;
+  v->batteryLevel = p->batteryLevel;
+  v->batteryVoltage = p->batteryVoltage;
+  v->latitudeE7 = (int32_t)lround((double)p->latitude * 1e7);
+  v->longitudeE7 = (int32_t)lround((double)p->longitude * 1e7);
+  v->speedX10 = (uint16_t)constrain(lroundf(p->speed * 10.0f), 0L, 65535L);
+  v->hdop = p->hdop;
+  v->courseX100 = (uint16_t)(constrain(lroundf(p->course * 100.0f), 0L, 35999L));
+}
+
+static void _v2_to_gnss(const SensorSentinel_v2_gnss_t *v, SensorSentinel_gnss_packet_t *p)
+{
+  memset(p, 0, sizeof(*p));
+  p->messageType = SensorSentinel_MSG_GNSS;
+  p->nodeId = v->nodeId;
+  p->messageCounter = v->messageCounter;
+  p->uptime = v->uptime;
+  p->batteryLevel = v->batteryLevel;
+  p->batteryVoltage = v->batteryVoltage;
+  p->latitude = v->latitudeE7 / 1e7f;
+  p->longitude = v->longitudeE7 / 1e7f;
+  p->speed = v->speedX10 / 10.0f;
+  p->hdop = v->hdop;
+  p->course = v->courseX100 / 100.0f;
+}
+
+size_t SensorSentinel_encode_packet_v2(const SensorSentinel_packet_t *packet, uint8_t *out, size_t size)
+{
+  if (!packet || !out || size < SensorSentinel_V2_MAX_FRAME)
+  {
+    return 0;
+  }
+
+  bool isKey = false;
+  size_t length = 0;
+  switch (packet->header.messageType)
+  {
+  case SensorSentinel_MSG_SENSOR:
+  {
+    SensorSentinel_v2_sensor_t frame;
+    _v2_from_sensor(&packet->sensor, &frame);
+    length = SensorSentinel_v2_encode_sensor(&frame, &_v2SentSensorKey, out, &isKey);
+    if (isKey)
+    {
+      _v2SentSensorKey = frame;
+    }
+    break;
+  }
+
+  case SensorSentinel_MSG_GNSS:
+  {
+    SensorSentinel_v2_gnss_t frame;
+    _v2_from_gnss(&packet->gnss, &frame);
+    length = SensorSentinel_v2_encode_gnss(&frame, &_v2SentGnssKey, out, &isKey);
+    if (isKey)
+    {
+      _v2SentGnssKey = frame;
+    }
+    break;
+  }
+
+  default:
+    return 0;
+  }
+  return length;
+}
+
+void SensorSentinel_force_key_frame_v2()
+{
+  _v2SentSensorKey.nodeId = 0;
+  _v2SentGnssKey.nodeId = 0;
+}
+
+bool SensorSentinel_decode_packet(const uint8_t *data, size_t length, SensorSentinel_packet_t *out)
+{
+  if (!data || !out || length == 0)
+  {
+    return false;
+  }
+
+  switch (data[0])
+  {
+  case SensorSentinel_MSG_SENSOR:
+  case SensorSentinel_MSG_GNSS:
+    if (length != SensorSentinel_get_packet_size(data[0]) &&
+        length != SensorSentinel_get_packet_size(data[0]) + SensorSentinel_TX_REPORT_SIZE)
+    {
+      return false;
+    }
+    memcpy(out, data, SensorSentinel_get_packet_size(data[0]));  // Without the TX report
+    return true;
+
+  case SensorSentinel_MSG_SENSOR_V2:
+  {
+    SensorSentinel_v2_header_t h;
+    if (!SensorSentinel_v2_parse_header(data, length, &h))
+    {
+      return false;
+    }
+
+    // The key a delta refers to, if we heard it
+    const SensorSentinel_v2_sensor_t *key = NULL;
+    for (int i = 0; i < V2_KEY_CACHE_SIZE && h.delta; i++)
+    {
+      if (_v2SensorKeys[i].nodeId == h.nodeId)
+      {
+        key = &_v2SensorKeys[i];
+        break;
+      }
+    }
+
+    SensorSentinel_v2_sensor_t frame;
+    if (SensorSentinel_v2_decode_sensor(data, length, key, &frame) != V2_OK)
+    {
+      return false;
+    }
+    if (!h.delta)
+    {
+      // Replace this node's previous key, or the oldest slot
+      int slot = -1;
+      for (int i = 0; i < V2_KEY_CACHE_SIZE && slot < 0; i++)
+      {
+        if (_v2SensorKeys[i].nodeId == h.nodeId) slot = i;
+      }
+      if (slot < 0)
+      {
+        slot = _v2SensorNext;
+        _v2SensorNext = (_v2SensorNext + 1) % V2_KEY_CACHE_SIZE;
+      }
+      _v2SensorKeys[slot] = frame;
+    }
+    _v2_to_sensor(&frame, &out->sensor);
+    return true;
+  }
+
+  case SensorSentinel_MSG_GNSS_V2:
+  {
+    SensorSentinel_v2_header_t h;
+    if (!SensorSentinel_v2_parse_header(data, length, &h))
+    {
+      return false;
+    }
+
+    const SensorSentinel_v2_gnss_t *key = NULL;
+    for (int i = 0; i < V2_KEY_CACHE_SIZE && h.delta; i++)
+    {
+      if (_v2GnssKeys[i].nodeId == h.nodeId)
+      {
+        key = &_v2GnssKeys[i];
+        break;
+      }
+    }
+
+    SensorSentinel_v2_gnss_t frame;
+    if (SensorSentinel_v2_decode_gnss(data, length, key, &frame) != V2_OK)
+    {
+      return false;
+    }
+    if (!h.delta)
+    {
+      int slot = -1;
+      for (int i = 0; i < V2_KEY_CACHE_SIZE && slot < 0; i++)
+      {
+        if (_v2GnssKeys[i].nodeId == h.nodeId) slot = i;
+      }
+      if (slot < 0)
+      {
+        slot = _v2GnssNext;
+        _v2GnssNext = (_v2GnssNext + 1) % V2_KEY_CACHE_SIZE;
+      }
+      _v2GnssKeys[slot] = frame;
+    }
+    _v2_to_gnss(&frame, &out->gnss);
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
+uint8_t *SensorSentinel_build_uplink_record(SensorSentinel_rx_slot_t *slot, uint32_t gatewayId,
+                                            uint64_t rxEpochMs) {
+    SensorSentinel_uplink_header_t header;
+    header.version = SensorSentinel_UPLINK_VERSION;
+    header.gatewayId = gatewayId;
+    header.rxEpochMs = rxEpochMs;
+    header.rssi = (int16_t)lroundf(slot->rssi * 10.0f);
+    header.snr = (int16_t)lroundf(slot->snr * 10.0f);
+    header.freqError = (int32_t)lroundf(slot->freqError);
+    header.length = (uint16_t)slot->length;
+
+    uint8_t *record = slot->data - sizeof(header);
+    memcpy(record, &header, sizeof(header));
+    return record;
+}
+
+uint8_t SensorSentinel_batch_append(uint8_t *envelope, size_t *length, size_t capacity,
+                                    const uint8_t *record, size_t recordLength) {
+    size_t used = *length > 0 ? *length : 2;
+    uint8_t frames = *length > 0 ? envelope[1] : 0;
+    if (frames == SensorSentinel_BATCH_MAX_FRAMES || recordLength > 0xFFFF ||
+        used + 2 + recordLength > capacity) {
+        return 0;
+    }
+
+    envelope[0] = SensorSentinel_BATCH_MARKER;
+    envelope[used++] = recordLength & 0xFF;
+    envelope[used++] = (recordLength >> 8) & 0xFF;
+    memcpy(&envelope[used], record, recordLength);
+    *length = used + recordLength;
+    envelope[1] = ++frames;
+    return frames;
+}
@@ -18,16 +18,26 @@
 
 #include <Arduino.h>
 #include "SensorSentinel_pins_helper.h"  // For SensorSentinel_pin_readings_t structure
+#include "SensorSentinel_codec_v2.h"    // Compact v2 frames (SensorSentinel_MSG_*_V2)
 
 /**
  * @brief Message types for different packet categories
  */
 #define SensorSentinel_MSG_SENSOR        0x01  // Basic sensor data packet
 #define SensorSentinel_MSG_GNSS         0x02  // GNSS location data packet
+#define SensorSentinel_MSG_AGGREGATE    0x03  // Several pin readings in one packet
+#define SensorSentinel_MSG_LINK_HINT    0x04  // Gateway-to-node link stats for ADR (never forwarded)
+// 0x05 is SensorSentinel_MSG_MESH, the repeater header (SensorSentinel_mesh_helper.h)
 
 // Configuration
 #define MAX_LORA_PACKET_SIZE 256 // Maximum packet size we can handle
 
+// Over-the-air format for frames this node sends: 1 = fixed structs below,
+// 2 = compact v2 encoding (SensorSentinel_codec_v2.h). Receivers accept both.
+#ifndef PACKET_FORMAT
+#define PACKET_FORMAT 1
+#endif
+
 /**
  * @brief Basic sensor packet structure
  * 
@@ -45,9 +55,10 @@ typedef struct {
 
   // Sensor data
   SensorSentinel_pin_readings_t pins;  // All pin readings in a standard format
-  
-  // Reserved for future expansion
-  uint8_t reserved[2];
+
+  // Wakes since the previous frame whose TX was skipped because nothing
+  // changed (report-by-exception); was reserved, so older senders send 0
+  uint16_t skippedCount;
 } __attribute__((packed)) SensorSentinel_sensor_packet_t;
 
 /**
@@ -76,6 +87,88 @@ typedef struct {
   uint8_t reserved[2];
 } __attribute__((packed)) SensorSentinel_gnss_packet_t;
 
+/**
+ * @brief Aggregate packet: readings from several wakes sent at once
+ *
+ * The header is followed by either sampleCount SensorSentinel_pin_readings_t
+ * (oldest first, AGGREGATE_MODE_SAMPLES) or one
+ * SensorSentinel_aggregate_summary_t (AGGREGATE_MODE_SUMMARY). Samples are
+ * sampleIntervalSecs apart; the last one was taken just before sending.
+ */
+#define AGGREGATE_MODE_SAMPLES 0   // Every reading
+#define AGGREGATE_MODE_SUMMARY 1   // Min/max/mean per analog pin
+
+#ifndef AGGREGATE_MAX_SAMPLES
+#define AGGREGATE_MAX_SAMPLES  16  // RTC buffer size; also the largest N
+#endif
+
+typedef struct {
+  // Header information (same layout as the other packets up to batteryVoltage)
+  uint8_t messageType;         // Always SensorSentinel_MSG_AGGREGATE (0x03)
+  uint32_t nodeId;             // Unique node identifier (from MAC address)
+  uint32_t messageCounter;     // Sequence number (shared with sensor packets)
+  uint32_t uptime;             // uptime in seconds
+  uint8_t batteryLevel;        // Battery level (0-100%)
+  uint16_t batteryVoltage;     // Battery voltage in millivolts
+
+  uint8_t mode;                // AGGREGATE_MODE_SAMPLES or AGGREGATE_MODE_SUMMARY
+  uint8_t sampleCount;         // Readings covered (1..AGGREGATE_MAX_SAMPLES)
+  uint16_t sampleIntervalSecs; // Time between readings
+} __attribute__((packed)) SensorSentinel_aggregate_header_t;
+
+typedef struct {
+  uint16_t analogMin[4];
+  uint16_t analogMax[4];
+  uint16_t analogMean[4];
+  uint8_t digitalLast;         // Pin states at the last reading
+  uint8_t digitalAny;          // Bits high in at least one reading
+  uint8_t digitalAll;          // Bits high in every reading
+} __attribute__((packed)) SensorSentinel_aggregate_summary_t;
+
+#define SensorSentinel_AGGREGATE_MAX_SIZE \
+  (sizeof(SensorSentinel_aggregate_header_t) + AGGREGATE_MAX_SAMPLES * sizeof(SensorSentinel_pin_readings_t))
+
+/**
+ * @brief Link hint: downlink from a gateway with the node's recent link stats
+ *
+ * Sent by gateways with ADR_MODE in answer to uplinks whose counter is a
+ * multiple of ADR_ACK_EVERY (see SensorSentinel_adr_helper.h). The stats
+ * cover the frames heard from the node since the previous hint. It is not
+ * a valid uplink: SensorSentinel_validate_packet() rejects it, so gateways
+ * and repeaters never forward one.
+ */
+typedef struct {
+  uint8_t messageType;         // Always SensorSentinel_MSG_LINK_HINT (0x04)
+  uint32_t nodeId;             // Node the hint is for
+  uint32_t messageCounter;     // Uplink it answers
+  uint32_t gatewayId;          // Node ID of the gateway that measured the link
+  int8_t snrMax;               // Best SNR in the window, dB x 4
+  int8_t snrMean;              // Mean SNR in the window, dB x 4
+  int8_t rssiMean;             // Mean RSSI in the window, dBm
+  uint8_t frames;              // Uplinks in the window
+} __attribute__((packed)) SensorSentinel_link_hint_t;
+
+/**
+ * @brief Listen-before-talk report: optional trailer on uplinks
+ *
+ * A sender appends its LBT counters (SensorSentinel_lbt_helper.h) to an
+ * uplink when any is nonzero. v1 sensor, GNSS and aggregate frames are then
+ * SensorSentinel_TX_REPORT_SIZE bytes longer than their type implies; v2
+ * frames set SensorSentinel_V2_FLAG_REPORT and carry it after the body.
+ * The counts cover the channel checks since the last frame that carried a
+ * report, not those made for this frame.
+ */
+typedef struct {
+  uint8_t busy;                // CAD checks that found the channel busy
+  uint8_t forced;              // Frames sent after LBT_MAX_ATTEMPTS busy checks
+  uint16_t backoffMs;          // Time frames were held back, ms (saturates)
+} __attribute__((packed)) SensorSentinel_tx_report_t;
+
+#define SensorSentinel_TX_REPORT_SIZE sizeof(SensorSentinel_tx_report_t)
+
+static_assert(sizeof(SensorSentinel_tx_report_t) == SensorSentinel_V2_REPORT_SIZE,
+              "v1 and v2 TX report trailers must match");
+
 /**
  * @brief Union for handling different packet types
  *
@@ -92,6 +185,52 @@ typedef union {
   SensorSentinel_gnss_packet_t gnss;
 } SensorSentinel_packet_t;
 
+/**
+ * @brief Uplink record header (gateway to MQTT)
+ *
+ * Prepended by the gateway to every forwarded frame so the backend knows
+ * which gateway heard it, when, and how well. A record is the header
+ * followed directly by the frame it describes.
+ */
+#define SensorSentinel_UPLINK_VERSION 0xA1  // Distinct from message types and the batch marker
+
+typedef struct {
+  uint8_t version;             // Always SensorSentinel_UPLINK_VERSION
+  uint32_t gatewayId;          // Node ID of the receiving gateway
+  uint64_t rxEpochMs;          // Receive time, Unix epoch ms (0 until NTP has synced)
+  int16_t rssi;                // Signal strength, dBm x 10
+  int16_t snr;                 // Signal-to-noise ratio, dB x 10
+  int32_t freqError;           // Frequency error, Hz
+  uint16_t length;             // Length of the frame that follows
+} __attribute__((packed)) SensorSentinel_uplink_header_t;
+
+#define SensorSentinel_UPLINK_HEADROOM sizeof(SensorSentinel_uplink_header_t)
+
+// Space reserved in front of each received frame: MQTT PUBLISH fixed header
+// (up to 5 bytes) + topic length (2) + topic + uplink header
+#ifndef SensorSentinel_RX_HEADROOM
+#define SensorSentinel_RX_HEADROOM 64
+#endif
+static_assert(SensorSentinel_RX_HEADROOM >= SensorSentinel_UPLINK_HEADROOM,
+              "SensorSentinel_RX_HEADROOM must hold at least the uplink header");
+
+/**
+ * @brief One received frame with its link metadata
+ *
+ * The radio reads straight into data. headroom sits directly in front of
+ * it so the uplink header and the MQTT PUBLISH header can be written in
+ * place, and the whole packet sent as one contiguous buffer.
+ */
+typedef struct {
+  uint8_t headroom[SensorSentinel_RX_HEADROOM]; // Headers are built here, back to front
+  uint8_t data[MAX_LORA_PACKET_SIZE]; // Raw frame bytes
+  size_t length;                      // Number of valid bytes in data
+  float rssi;                         // Signal strength (dBm)
+  float snr;                          // Signal-to-noise ratio (dB)
+  float freqError;                    // Frequency error (Hz)
+  uint32_t rxMillis;                  // millis() captured in the DIO1 interrupt
+} SensorSentinel_rx_slot_t;
+
 /**
  * @brief Get a unique node ID based on the ESP32's MAC address
  * 
@@ -110,6 +249,25 @@ uint32_t SensorSentinel_generate_node_id();
  */
 bool SensorSentinel_init_sensor_packet(SensorSentinel_sensor_packet_t* packet, uint32_t counter);
 
+/**
+ * @brief Build an aggregate packet from buffered pin readings
+ *
+ * Fills the header like SensorSentinel_init_sensor_packet() and appends the
+ * samples or their summary.
+ *
+ * @param buffer Destination, at least SensorSentinel_AGGREGATE_MAX_SIZE bytes
+ * @param size Size of buffer
+ * @param counter Message sequence counter value
+ * @param samples Readings, oldest first
+ * @param count Number of readings (1..AGGREGATE_MAX_SAMPLES)
+ * @param mode AGGREGATE_MODE_SAMPLES or AGGREGATE_MODE_SUMMARY
+ * @param intervalSecs Time between readings
+ * @return Packet length, or 0 on error
+ */
+size_t SensorSentinel_init_aggregate_packet(uint8_t *buffer, size_t size, uint32_t counter,
+                                            const SensorSentinel_pin_readings_t *samples, uint8_t count,
+                                            uint8_t mode, uint16_t intervalSecs);
+
 /**
  * @brief Initialize a GNSS packet with device information
  * 
@@ -126,6 +284,7 @@ bool SensorSentinel_init_gnss_packet(SensorSentinel_gnss_packet_t* packet, uint3
  * @brief Get the size of a packet based on its message type
  * 
  * Returns the appropriate size in bytes for a given message type.
+ * v2 and aggregate frames are variable length; for those the maximum is returned.
  * 
  * @param messageType The type of message (SensorSentinel_MSG_SENSOR or SensorSentinel_MSG_GNSS)
  * @return The size of the packet in bytes
@@ -192,13 +351,15 @@ bool SensorSentinel_validate_packet(const void* data, size_t length);
  * @brief Convert a message type to a human-readable string
  * 
  * @param messageType The message type byte (SensorSentinel_MSG_SENSOR or SensorSentinel_MSG_GNSS)
- * @return const char* Returns "Sensor", "GNSS", or "Unknown"
+ * @return const char* Returns "Sensor", "GNSS", "Sensor v2", "GNSS v2" or "Unknown"
  */
 const char* SensorSentinel_message_type_to_string(uint8_t messageType);
 
 /**
  * @brief Get the message counter from a packet
  * 
+ * Works for v1 and v2 frames; validate the frame first.
+ * 
  * @param data Pointer to the packet data
  * @return uint32_t The message counter value
  */
@@ -211,4 +372,132 @@ uint32_t SensorSentinel_get_message_counter_from_packet(uint8_t *data);
  */
 uint32_t SensorSentinel_extract_node_id_from_packet(uint8_t *data);
 
+/**
+ * @brief Get the sender's uptime from a valid uplink frame
+ *
+ * v1 frames carry it at a fixed offset and v2 key frames as the first body
+ * field; a v2 delta frame only has it relative to its key frame.
+ *
+ * @param data Frame bytes
+ * @param length Frame length
+ * @return Uptime in seconds, or 0 if the frame does not carry it in full
+ */
+uint32_t SensorSentinel_get_uptime_from_packet(const uint8_t *data, size_t length);
+
+/**
+ * @brief Append a TX report trailer to an uplink frame
+ * @param frame Frame of any uplink type (v1 or v2)
+ * @param length Frame length
+ * @param size Size of the frame buffer
+ * @param report Counters to append
+ * @return New length, or length unchanged if the frame has no room, already
+ *         carries a report or is not an uplink
+ */
+size_t SensorSentinel_add_tx_report(uint8_t *frame, size_t length, size_t size,
+                                    const SensorSentinel_tx_report_t *report);
+
+/**
+ * @brief Read the TX report trailer of a valid uplink frame
+ * @param data Frame bytes
+ * @param length Frame length
+ * @param report Filled when the frame carries one
+ * @return true if the frame carries a report
+ */
+bool SensorSentinel_get_tx_report(const uint8_t *data, size_t length, SensorSentinel_tx_report_t *report);
+
+/**
+ * @brief Append boolean pin edges (PINS_EDGE_MODE) to a v2 sensor frame
+ *
+ * Call before SensorSentinel_add_tx_report(): the report stays last.
+ *
+ * @param frame Frame bytes
+ * @param length Frame length
+ * @param size Size of the frame buffer
+ * @param edges Edges from SensorSentinel_pins_take_edges()
+ * @return New length, or length unchanged if no pin changed, the frame has
+ *         no room or is not a v2 sensor frame without edges and report
+ */
+size_t SensorSentinel_add_pin_edges(uint8_t *frame, size_t length, size_t size,
+                                    const SensorSentinel_pin_edges_t *edges);
+
+/**
+ * @brief Read the pin edges of a valid uplink frame
+ * @param data Frame bytes
+ * @param length Frame length
+ * @param edges Filled when the frame carries them
+ * @return true if the frame carries edges (v2 sensor frames only)
+ */
+bool SensorSentinel_get_pin_edges(const uint8_t *data, size_t length, SensorSentinel_pin_edges_t *edges);
+
+/**
+ * @brief Encode a sensor or GNSS packet in the compact v2 format
+ *
+ * Delta frames are taken against the last key frame this node encoded,
+ * which is kept in RTC memory so it survives deep sleep.
+ *
+ * @param packet Packet to encode (messageType selects sensor or GNSS)
+ * @param out Destination buffer
+ * @param size Size of out (SensorSentinel_V2_MAX_FRAME is always enough)
+ * @return Encoded length, or 0 on error
+ */
+size_t SensorSentinel_encode_packet_v2(const SensorSentinel_packet_t *packet, uint8_t *out, size_t size);
+
+/**
+ * @brief Make the next v2 frame of each type a key frame
+ *
+ * For when the receivers may have missed the key frame that later deltas
+ * would refer to (see SensorSentinel_adr_listen()).
+ */
+void SensorSentinel_force_key_frame_v2();
+
+/**
+ * @brief Decode any supported frame into its v1 structure
+ *
+ * v1 frames are copied. v2 frames are expanded; delta frames use the key
+ * frame last decoded from the same node, so they fail until one was seen.
+ *
+ * @param data Frame bytes
+ * @param length Frame length
+ * @param out Decoded packet (messageType is the v1 type)
+ * @return true if out holds the frame's values
+ */
+bool SensorSentinel_decode_packet(const uint8_t *data, size_t length, SensorSentinel_packet_t *out);
+
+/**
+ * @brief Write the uplink header into a slot's headroom
+ *
+ * @param slot Received frame and its metadata
+ * @param gatewayId Node ID of this gateway
+ * @param rxEpochMs Receive time in Unix epoch milliseconds (0 if unknown)
+ * @return Start of the contiguous header + frame record (the last
+ *         SensorSentinel_UPLINK_HEADROOM bytes of the headroom), which is
+ *         SensorSentinel_UPLINK_HEADROOM + slot->length bytes long
+ */
+uint8_t *SensorSentinel_build_uplink_record(SensorSentinel_rx_slot_t *slot, uint32_t gatewayId,
+                                            uint64_t rxEpochMs);
+
+/**
+ * @brief Batch envelope: several uplink records in one MQTT payload
+ *
+ * Layout (little-endian): [SensorSentinel_BATCH_MARKER][u8 frame count],
+ * then per record [u16 length][record]. Built by the gateway with
+ * MQTT_BATCH_MODE (SensorSentinel_mqtt_helper.h).
+ */
+#define SensorSentinel_BATCH_MARKER     0xB1  // Distinct from message types and the uplink version
+#define SensorSentinel_BATCH_MAX_FRAMES 255
+
+/**
+ * @brief Append a record to a batch envelope
+ *
+ * @param envelope Envelope buffer; started when *length is 0
+ * @param length Bytes used in envelope, updated on success
+ * @param capacity Size of envelope
+ * @param record Record bytes
+ * @param recordLength Record length
+ * @return Frames in the envelope after appending, or 0 if the record does
+ *         not fit (the envelope is left as it was)
+ */
+uint8_t SensorSentinel_batch_append(uint8_t *envelope, size_t *length, size_t capacity,
+                                    const uint8_t *record, size_t recordLength);
+
 #endif // SensorSentinel_PACKET__HELPER_H
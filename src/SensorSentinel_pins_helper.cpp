@@ -5,12 +5,110 @@
 
 #include "SensorSentinel_pins_helper.h"
 #include "heltec_unofficial_revised.h"
+#include "SensorSentinel_adc_helper.h"
 #include <Arduino.h>
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+#if PINS_EDGE_MODE
+#include <freertos/FreeRTOS.h>
+#endif
 
 // Actual arrays for pin access
 const uint8_t SensorSentinel_analog_pins[SensorSentinel_ANALOG_COUNT] = SensorSentinel_ANALOG_PINS;
 const uint8_t SensorSentinel_boolean_pins[SensorSentinel_BOOLEAN_COUNT] = SensorSentinel_BOOLEAN_PINS;
 
+// GPIO_IN_REG holds GPIO0-31, GPIO_IN1_REG the rest; only registers with a
+// boolean pin in them are read (on the V3 all eight are in GPIO_IN1_REG)
+static bool _pinsBegun = false;
+static bool _readIn = false;
+static bool _readIn1 = false;
+static uint8_t _outputs = 0;  // Pins SensorSentinel_write_boolean() made outputs
+
+#if PINS_EDGE_MODE
+static portMUX_TYPE _edgeMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint8_t _edgeChanged = 0;
+static volatile uint16_t _edgePulses[SensorSentinel_BOOLEAN_COUNT];
+
+// arg: pin index | GPIO number << 8, so the ISR touches nothing in flash. A
+// pulse shorter than the interrupt latency (a few us) is seen as a change
+// with the pin already low, and is not counted.
+static void IRAM_ATTR _on_edge(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg & 0xFF;
+    uint32_t pin = (uint32_t)(uintptr_t)arg >> 8;
+    uint32_t level = (REG_READ(pin < 32 ? GPIO_IN_REG : GPIO_IN1_REG) >> (pin & 31)) & 1;
+    portENTER_CRITICAL_ISR(&_edgeMux);
+    _edgeChanged |= 1 << index;
+    if (level && _edgePulses[index] != 0xFFFF) {
+        _edgePulses[index]++;
+    }
+    portEXIT_CRITICAL_ISR(&_edgeMux);
+}
+#endif
+
+/**
+ * @brief Configure the boolean pins once
+ */
+void SensorSentinel_pins_begin() {
+    if (_pinsBegun) return;
+    _pinsBegun = true;
+
+    for (uint8_t i = 0; i < SensorSentinel_BOOLEAN_COUNT; i++) {
+        uint8_t pin = SensorSentinel_boolean_pins[i];
+        pinMode(pin, INPUT);
+        if (pin < 32) {
+            _readIn = true;
+        } else {
+            _readIn1 = true;
+        }
+#if PINS_EDGE_MODE
+        attachInterruptArg(pin, _on_edge, (void *)(uintptr_t)(i | pin << 8), CHANGE);
+#endif
+    }
+}
+
+/**
+ * @brief Take the edges latched since the last call
+ */
+bool SensorSentinel_pins_take_edges(SensorSentinel_pin_edges_t* edges) {
+    memset(edges, 0, sizeof(*edges));
+#if PINS_EDGE_MODE
+    SensorSentinel_pins_begin();
+    portENTER_CRITICAL(&_edgeMux);
+    edges->changed = _edgeChanged;
+    for (uint8_t i = 0; i < SensorSentinel_BOOLEAN_COUNT; i++) {
+        edges->pulses[i] = _edgePulses[i];
+        _edgePulses[i] = 0;
+    }
+    _edgeChanged = 0;
+    portEXIT_CRITICAL(&_edgeMux);
+#endif
+    return edges->changed != 0;
+}
+
+// Pins written as outputs go back to being inputs before they are read
+static void _restore_inputs(uint8_t mask) {
+    for (uint8_t i = 0; i < SensorSentinel_BOOLEAN_COUNT; i++) {
+        if (mask & _outputs & (1 << i)) {
+            pinMode(SensorSentinel_boolean_pins[i], INPUT);
+            _outputs &= ~(1 << i);
+        }
+    }
+}
+
+// Levels of all boolean pins, one bit per pin, from one read per register
+static uint8_t _read_levels() {
+    uint32_t in = _readIn ? REG_READ(GPIO_IN_REG) : 0;
+    uint32_t in1 = _readIn1 ? REG_READ(GPIO_IN1_REG) : 0;
+    uint8_t result = 0;
+    for (uint8_t i = 0; i < SensorSentinel_BOOLEAN_COUNT; i++) {
+        uint8_t pin = SensorSentinel_boolean_pins[i];
+        if (((pin < 32 ? in : in1) >> (pin & 31)) & 1) {
+            result |= (1 << i);
+        }
+    }
+    return result;
+}
+
 /**
  * @brief Reads an analog value from one of the available pins
  * 
@@ -18,8 +116,11 @@ const uint8_t SensorSentinel_boolean_pins[SensorSentinel_BOOLEAN_COUNT] = Sensor
  * @return Analog value (0-4095) or -1 if index is out of bounds
  */
 int16_t SensorSentinel_read_analog(uint8_t index) {
-    return (index < SensorSentinel_ANALOG_COUNT) ? 
-           analogRead(SensorSentinel_analog_pins[index]) : -1;
+    if (index >= SensorSentinel_ANALOG_COUNT) return -1;
+
+    uint16_t mv = 0;
+    SensorSentinel_adc_read_pins(&SensorSentinel_analog_pins[index], 1, &mv);
+    return SensorSentinel_adc_mv_to_counts(mv);
 }
 
 /**
@@ -30,10 +131,10 @@ int16_t SensorSentinel_read_analog(uint8_t index) {
  */
 int8_t SensorSentinel_read_boolean(uint8_t index) {
     if (index >= SensorSentinel_BOOLEAN_COUNT) return -1;
-    
-    uint8_t pin = SensorSentinel_boolean_pins[index];
-    pinMode(pin, INPUT);
-    return digitalRead(pin);
+
+    SensorSentinel_pins_begin();
+    _restore_inputs(1 << index);
+    return (_read_levels() >> index) & 1;
 }
 
 /**
@@ -46,8 +147,12 @@ int8_t SensorSentinel_read_boolean(uint8_t index) {
 int8_t SensorSentinel_write_boolean(uint8_t index, uint8_t value) {
     if (index >= SensorSentinel_BOOLEAN_COUNT) return -1;
     
+    SensorSentinel_pins_begin();
     uint8_t pin = SensorSentinel_boolean_pins[index];
-    pinMode(pin, OUTPUT);
+    if (!(_outputs & (1 << index))) {
+        pinMode(pin, OUTPUT);
+        _outputs |= 1 << index;
+    }
     digitalWrite(pin, value);
     return 0;
 }
@@ -62,9 +167,11 @@ int8_t SensorSentinel_write_boolean(uint8_t index, uint8_t value) {
 void SensorSentinel_read_all_analog(uint16_t* values, uint8_t arraySize) {
     uint8_t count = (arraySize < SensorSentinel_ANALOG_COUNT) ? arraySize : SensorSentinel_ANALOG_COUNT;
     
-    // Read available pins
+    // One oversampled burst over the available pins, plus the battery when due
+    uint16_t mv[SensorSentinel_ANALOG_COUNT];
+    SensorSentinel_adc_read_with_vbat(SensorSentinel_analog_pins, count, mv);
     for (uint8_t i = 0; i < count; i++) {
-        values[i] = analogRead(SensorSentinel_analog_pins[i]);
+        values[i] = SensorSentinel_adc_mv_to_counts(mv[i]);
     }
     
     // Zero fill remaining slots
@@ -76,21 +183,15 @@ void SensorSentinel_read_all_analog(uint16_t* values, uint8_t arraySize) {
 /**
  * @brief Reads all boolean pins and packs them into a byte
  * 
- * @param maxBits Maximum number of bits to read (1-8)
+ * The pins are configured once; each call is a single read of the GPIO
+ * input register(s), so all eight are sampled at the same instant.
+ * 
  * @return Byte with each bit representing a pin state
  */
 uint8_t SensorSentinel_read_all_boolean() {
-    uint8_t result = 0;
-    uint8_t count = (8 < SensorSentinel_BOOLEAN_COUNT) ? 8 : SensorSentinel_BOOLEAN_COUNT;
-    
-    for (uint8_t i = 0; i < count; i++) {
-        uint8_t pin = SensorSentinel_boolean_pins[i];
-        pinMode(pin, INPUT);
-        if (digitalRead(pin)) {
-            result |= (1 << i);
-        }
-    }
-    return result;
+    SensorSentinel_pins_begin();
+    _restore_inputs(0xFF);
+    return _read_levels();
 }
 
 /**
@@ -99,8 +200,21 @@ uint8_t SensorSentinel_read_all_boolean() {
  * @param readings Pointer to structure where readings will be stored
  */
 void SensorSentinel_read_all_pins(SensorSentinel_pin_readings_t* readings) {
+#if HELTEC_WARM_BOOT
+    // A warm boot skipped the display, and with it Vext; power it for the read
+    bool vext = heltec_warm_boot() && !heltec_display_ready();
+    if (vext) {
+        heltec_ve(true);
+        delay(HELTEC_VEXT_SETTLE_MS);
+    }
+#endif
     SensorSentinel_read_all_analog(readings->analog, 4);
     readings->boolean = SensorSentinel_read_all_boolean();
+#if HELTEC_WARM_BOOT
+    if (vext) {
+        heltec_ve(false);
+    }
+#endif
 }
 
 /**
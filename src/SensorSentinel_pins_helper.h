@@ -20,6 +20,21 @@
 #define SensorSentinel_ANALOG_COUNT    4  // All boards have 4 analog pins
 #define SensorSentinel_BOOLEAN_COUNT   8  // All boards have 8 boolean pins
 
+/**
+ * Edge capture: with -DPINS_EDGE_MODE=1 every boolean pin gets a GPIO
+ * interrupt on both edges. Between two SensorSentinel_pins_take_edges()
+ * calls it latches which pins changed and counts rising edges per pin, so a
+ * pulse shorter than the send interval is still reported. Interrupts only
+ * run while the CPU is awake: on a deep-sleep sender that is the few
+ * milliseconds of each wake, so it is meant for repeaters (which send their
+ * own readings on a timer) and other always-on nodes. The counts travel in
+ * v2 sensor frames (PACKET_FORMAT=2, SensorSentinel_codec_v2.h); v1 frames
+ * have no room left for them.
+ */
+#ifndef PINS_EDGE_MODE
+#define PINS_EDGE_MODE 0
+#endif
+
 #if defined(WOKWI)
   // Wokwi available pins
   #define SensorSentinel_ANALOG_PINS     {32, 33, 34, 35}
@@ -57,11 +72,30 @@ typedef struct {
   uint8_t boolean;      // 8 boolean values packed as bits
 } __attribute__((packed)) SensorSentinel_pin_readings_t;
 
+/**
+ * @brief Boolean pin edges latched between two reads (PINS_EDGE_MODE)
+ */
+typedef struct {
+  uint8_t changed;      // Pins with any edge, one per bit
+  uint16_t pulses[8];   // Rising edges per pin (saturates)
+} SensorSentinel_pin_edges_t;
+
 // Pin arrays (defined in SensorSentinel_pins_helper.cpp)
 extern const uint8_t SensorSentinel_analog_pins[SensorSentinel_ANALOG_COUNT];
 extern const uint8_t SensorSentinel_boolean_pins[SensorSentinel_BOOLEAN_COUNT];
 
 // Function declarations
+/**
+ * @brief Configure the boolean pins as inputs (and their interrupts with
+ *        PINS_EDGE_MODE); the read functions call it on first use
+ */
+void SensorSentinel_pins_begin();
+/**
+ * @brief Take the edges latched since the last call and clear them
+ * @param edges Filled; all zero without PINS_EDGE_MODE
+ * @return true if any pin changed
+ */
+bool SensorSentinel_pins_take_edges(SensorSentinel_pin_edges_t* edges);
 int16_t SensorSentinel_read_analog(uint8_t index);
 int8_t SensorSentinel_read_boolean(uint8_t index);
 int8_t SensorSentinel_write_boolean(uint8_t index, uint8_t value);
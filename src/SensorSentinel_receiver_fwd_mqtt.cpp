@@ -6,44 +6,70 @@
  * - Sensor packets go to lora/sensor
  * - GNSS packets go to lora/gnss
  * Uses the SensorSentinel_mqtt_helper for MQTT connectivity.
+ * With -DADR_MODE=1 it also answers senders with link hints
+ * (SensorSentinel_adr_helper.h). Per-node loss, reordering and reboots
+ * (SensorSentinel_seq_helper.h) go to MQTT_STATS_TOPIC/<client ID>/nodes.
+ * Frames relayed by repeaters lose their mesh header here
+ * (SensorSentinel_mesh_helper.h), before anything else looks at them.
+ * WiFi and MQTT come up in the background (SensorSentinel_net_helper.h):
+ * frames are received and spooled from the start.
  */
 
 #include "heltec_unofficial_revised.h"
 #include "SensorSentinel_packet_helper.h"
 #include "SensorSentinel_mqtt_helper.h"
 #include "SensorSentinel_wifi_helper.h"
+#include "SensorSentinel_net_helper.h"
 #include "SensorSentinel_diag.h"
+#include "SensorSentinel_dedup_helper.h"
+#include "SensorSentinel_spool_helper.h"
+#include "SensorSentinel_metrics_helper.h"
+#include "SensorSentinel_log_helper.h"
+#include "SensorSentinel_adr_helper.h"
+#include "SensorSentinel_seq_helper.h"
+#include "SensorSentinel_mesh_helper.h"
 
 #ifndef NO_RADIOLIB
 #include "SensorSentinel_RadioLib_helper.h"
+#include "SensorSentinel_tasks_helper.h"
 #endif
 
 // Global variables
-uint8_t packetBuffer[MAX_LORA_PACKET_SIZE]; // Buffer to hold received packet
 unsigned long lastPacketTime = 0;
 uint32_t packetsReceived = 0;
 uint32_t packetsForwarded = 0;
-
-// Variables for packet processing
-String packetMessageType; // Current packet message type
-
-#define PACKET_CACHE_SIZE 50  // Remember last 50 packets
-
-// Packet cache to prevent duplicate MQTT messages
-struct ReceivedPacketCache {
-    uint32_t nodeId;
-    uint32_t messageCounter;
-    unsigned long timestamp;
-};
-ReceivedPacketCache receivedCache[PACKET_CACHE_SIZE];
-uint8_t receivedCacheIndex = 0;
+uint32_t packetsInvalid = 0;
+uint32_t packetsRelayed = 0;   // Valid frames that came through a repeater
+
+// Last packet, shown by renderStatus()
+typedef struct {
+  uint8_t messageType;
+  uint32_t messageCounter;
+  uint32_t nodeId;
+  float rssi;
+  size_t length;
+  SensorSentinel_dedup_result_t dedup;
+  MqttForwardStatus mqttStatus;
+} LastRx;
+
+static LastRx _lastRx;
+static portMUX_TYPE _lastRxMux = portMUX_INITIALIZER_UNLOCKED;  // Written by the packet callback, read by loop()
+
+#if THREADED_RUNTIME && !defined(NO_RADIOLIB)
+// The packet callback runs in the uplink task; the LED and display belong
+// to loop(), which picks this up in serviceRxActivity()
+static volatile bool _rxActivity = false;
+#define RX_LED_PULSE_MS 50
+#endif
 
 // Function prototypes
 void onBinaryPacketReceived(uint8_t *data, size_t length, float rssi, float snr);
-bool isPacketAlreadyProcessed(uint32_t nodeId, uint32_t messageCounter);
-void addToReceivedCache(uint32_t nodeId, uint32_t messageCounter);
-
-#define STARTUP_DISPLAY_DELAY 2000
+void maintainUplink();
+void renderStatus(Print &out);
+void printStats();
+void formatCounters(String &out);
+void publishNodeSummary();
+void serviceRxActivity();
 
 void setup()
 {
@@ -64,6 +90,12 @@ void setup()
               heltec_battery_percent(),
               heltec_vbat());
 
+  // Duplicate filter for repeated/re-received frames
+  SensorSentinel_dedup_init();
+#if SEQ_MODE
+  SensorSentinel_seq_init();
+#endif
+
 // Subscribe to binary packet reception
 #ifndef NO_RADIOLIB
   if (SensorSentinel_subscribe(NULL, onBinaryPacketReceived))
@@ -74,26 +106,33 @@ void setup()
   {
     both.println("Subscribe failed!");
   }
+
+#if THREADED_RUNTIME
+  // Start receiving into the ring before anything touches the network
+  SensorSentinel_tasks_begin_radio();
+#endif
 #else
   both.println("No radio, No sub");
 #endif
 
 
-  // Let the helper libraries handle WiFi and MQTT connection
-  SensorSentinel_wifi_begin();
-  SensorSentinel_mqtt_setup(true); // With time sync
+  // WiFi, NTP and MQTT come up from maintainUplink(); nothing here waits
+  SensorSentinel_net_begin();
 
-  // Add IP address display before the display update
-  if (SensorSentinel_wifi_connected()) {
-    both.printf("IP: %s\n", WiFi.localIP().toString().c_str());
-  } else {
-    both.println("No WiFi");
-  }
+  // lora/stats carries the same text as /metrics, so a load test can read
+  // the drop and duplicate counters
+  SensorSentinel_metrics_set_source(formatCounters);
 
+  both.println("WiFi connecting...");
   heltec_display_update();
-  delay(STARTUP_DISPLAY_DELAY);
-  // Initialize received packet cache
-  memset(receivedCache, 0, sizeof(receivedCache));
+
+  // Per-packet screen; the startup screen stays until the first packet
+  heltec_display_defer(renderStatus);
+
+#if THREADED_RUNTIME && !defined(NO_RADIOLIB)
+  // From here on the uplink task owns mqttClient
+  SensorSentinel_tasks_begin_uplink(maintainUplink);
+#endif
 }
 
 void loop()
@@ -101,14 +140,276 @@ void loop()
   // Handle system tasks
   heltec_loop();
 
+#if THREADED_RUNTIME && !defined(NO_RADIOLIB)
+  // Radio and uplink run in their own tasks; LED and display stay here
+  serviceRxActivity();
+  delay(10);
+#else
 #ifndef NO_RADIOLIB
   // Process any pending packet receptions
   SensorSentinel_process_packets();
 #endif
 
   // Let helpers maintain WiFi and MQTT connections
-  SensorSentinel_wifi_maintain();
-  SensorSentinel_mqtt_maintain();
+  maintainUplink();
+#endif
+}
+
+/**
+ * Keep WiFi and MQTT connections alive (loop() or uplink task)
+ */
+void maintainUplink()
+{
+  SensorSentinel_net_maintain();
+
+  // Prometheus /metrics on port 80 once there is a station address; not
+  // before, so it can't collide with the WiFiManager portal
+  if (SensorSentinel_wifi_connected()) {
+    SensorSentinel_diag_metrics_begin();
+  }
+  SensorSentinel_diag_metrics_loop();
+#if SEQ_MODE && SEQ_SUMMARY_INTERVAL_SECS > 0
+  publishNodeSummary();
+#endif
+}
+
+/**
+ * Publish the sequence table, one page of SEQ_SUMMARY_PAGE_NODES per call
+ *
+ * A summary starts every SEQ_SUMMARY_INTERVAL_SECS and is spread over the
+ * following passes so no single pass blocks on a large payload. The radio
+ * task may update a record while it is formatted; a page can then mix one
+ * node's old and new counts, which the next summary corrects.
+ */
+void publishNodeSummary()
+{
+  static unsigned long lastSummary = 0;
+  static uint32_t cursor = 0;
+  static uint32_t page = 0;
+  static bool active = false;
+  static char payload[SEQ_SUMMARY_PAGE_NODES * 176 + 64];
+
+  if (!active) {
+    if (millis() - lastSummary < SEQ_SUMMARY_INTERVAL_SECS * 1000UL) {
+      return;
+    }
+    lastSummary = millis();
+    cursor = 0;
+    page = 0;
+    active = true;
+  }
+
+  int head = snprintf(payload, sizeof(payload), "{\"page\":%u,\"nodes\":", page);
+  size_t length = head;
+  length += SensorSentinel_seq_format_json(payload + length, sizeof(payload) - length - 16, &cursor,
+                                           SEQ_SUMMARY_PAGE_NODES, millis());
+  bool last = cursor >= SEQ_NODE_TABLE_SIZE;
+  length += snprintf(payload + length, sizeof(payload) - length, ",\"last\":%s}", last ? "true" : "false");
+
+  String topic = String(MQTT_STATS_TOPIC "/") + SensorSentinel_mqtt_get_client_id() + "/nodes";
+  if (!SensorSentinel_mqtt_publish_stream(topic.c_str(), (const uint8_t *)payload, length)) {
+    active = false;  // Offline: try again with a fresh summary next interval
+    return;
+  }
+  page++;
+  active = !last;
+}
+
+#if THREADED_RUNTIME && !defined(NO_RADIOLIB)
+/**
+ * Blink the LED and mark the screen changed for frames the uplink task handled
+ */
+void serviceRxActivity()
+{
+  static unsigned long ledOnAt = 0;
+  if (_rxActivity) {
+    _rxActivity = false;
+    heltec_led(25);
+    ledOnAt = max(millis(), 1UL);
+    heltec_display_invalidate();
+  } else if (ledOnAt && millis() - ledOnAt >= RX_LED_PULSE_MS) {
+    heltec_led(0);
+    ledOnAt = 0;
+  }
+}
+#endif
+
+/**
+ * Draw the last-packet screen from _lastRx (deferred, see heltec_display_defer)
+ */
+void renderStatus(Print &out)
+{
+  LastRx lastRx;
+  portENTER_CRITICAL(&_lastRxMux);
+  lastRx = _lastRx;
+  portEXIT_CRITICAL(&_lastRxMux);
+
+  out.printf("\nReceived Type: %s\n", SensorSentinel_message_type_to_string(lastRx.messageType));
+  out.printf("Msg #: %u\n", lastRx.messageCounter);
+  out.printf("NodeID: %u\n", lastRx.nodeId);
+  out.printf("RSSI: %.1f dB\n", lastRx.rssi);
+  out.printf("Size: %u bytes\n", lastRx.length);
+  out.printf("Total Rx: %u\n", packetsReceived);
+  if (lastRx.dedup == DEDUP_NEW) {
+    out.printf("MQTT: %s\n", SensorSentinel_mqtt_status_to_string(lastRx.mqttStatus));
+  } else {
+    out.printf("%s - SKIPPED\n", SensorSentinel_dedup_result_to_string(lastRx.dedup));
+  }
+}
+
+/**
+ * Print ring, dedup, spool and batch counters (info level)
+ */
+void printStats()
+{
+  if (!SensorSentinel_log_enabled(SENSOR_LOG_INFO)) {
+    return;
+  }
+  Serial.printf("\nPackets received: %u (%u via repeaters), Forwarded: %u\n",
+                packetsReceived, packetsRelayed, packetsForwarded);
+#ifndef NO_RADIOLIB
+  SensorSentinel_rx_stats_t rxStats;
+  SensorSentinel_get_rx_stats(&rxStats);
+  Serial.printf("RX ring: depth %u, high-water %u, overflows %u, missed %u\n",
+                rxStats.depth, rxStats.highWater, rxStats.overflows, rxStats.missed);
+#endif
+  SensorSentinel_dedup_stats_t dedupStats;
+  SensorSentinel_dedup_get_stats(&dedupStats);
+  Serial.printf("Dedup: hits %u, misses %u, stale %u, evictions %u\n",
+                dedupStats.hits, dedupStats.misses, dedupStats.stale, dedupStats.evictions);
+#if ADR_MODE
+  SensorSentinel_adr_stats_t adrStats;
+  SensorSentinel_adr_get_stats(&adrStats);
+  Serial.printf("ADR: %u nodes, %u hints (%u dropped), evictions %u\n",
+                adrStats.nodes, adrStats.hints, adrStats.dropped, adrStats.evictions);
+#endif
+#if SEQ_MODE
+  SensorSentinel_seq_stats_t seqStats;
+  SensorSentinel_seq_get_stats(&seqStats);
+  Serial.printf("Sequence: %u nodes, lost %u in %u gaps, reorders %u, reboots %u\n",
+                seqStats.nodes, seqStats.lost, seqStats.gaps, seqStats.reorders, seqStats.reboots);
+#endif
+#if MQTT_SPOOL_MODE
+  SensorSentinel_spool_stats_t spoolStats;
+  SensorSentinel_spool_get_stats(&spoolStats);
+  Serial.printf("Spool: depth %u (%u bytes, %u on flash), replayed %u, dropped %u\n",
+                spoolStats.depth, spoolStats.bytes, spoolStats.flashDepth,
+                spoolStats.replayed, spoolStats.dropped);
+#endif
+#if MQTT_BATCH_MODE
+  SensorSentinel_mqtt_batch_stats_t batchStats;
+  SensorSentinel_mqtt_get_batch_stats(&batchStats);
+  Serial.printf("MQTT batches: %u (%u failed), avg %u frames, fill avg %u%% max %u%%, latency avg %u ms max %u ms\n",
+                batchStats.batches, batchStats.failed, batchStats.avgFrames,
+                batchStats.avgFillPct, batchStats.maxFillPct,
+                batchStats.avgLatencyMs, batchStats.maxLatencyMs);
+#endif
+#if MQTT_QOS >= 1
+  SensorSentinel_mqtt_ack_stats_t ackStats;
+  SensorSentinel_mqtt_get_ack_stats(&ackStats);
+  Serial.printf("MQTT QoS1: in flight %u (max %u), acks %u (%u/s, avg %u ms max %u ms), "
+                "retransmits %u, requeued %u, window full %u\n",
+                ackStats.inflight, ackStats.maxInflight, ackStats.acks, ackStats.acksPerSec,
+                ackStats.avgAckMs, ackStats.maxAckMs, ackStats.retransmits, ackStats.requeued,
+                ackStats.windowFull);
+#endif
+  SensorSentinel_net_stats_t netStats;
+  SensorSentinel_net_get_stats(&netStats);
+  Serial.printf("Network: %s, WiFi drops %u, MQTT drops %u; startup WiFi %u ms, time %u ms, MQTT %u ms, "
+                "first forward %u ms\n",
+                SensorSentinel_net_state_to_string(netStats.state), netStats.wifiDrops, netStats.mqttDrops,
+                netStats.wifiUpMs, netStats.timeSyncMs, netStats.mqttUpMs, netStats.firstForwardMs);
+  Serial.println("---------------------------");
+  Serial.println("---------------------------\n\n");
+}
+
+/**
+ * Receive, dedup and forward counters for the metrics export
+ */
+void formatCounters(String &out)
+{
+  SensorSentinel_metrics_counter(out, "sensorsentinel_rx_valid_total", "Valid frames received", packetsReceived);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_rx_invalid_total", "Frames that failed validation",
+                                 packetsInvalid);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_forwarded_total", "New frames published or batched",
+                                 packetsForwarded);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_rx_relayed_total", "Valid frames heard via a repeater",
+                                 packetsRelayed);
+#ifndef NO_RADIOLIB
+  SensorSentinel_rx_stats_t rxStats;
+  SensorSentinel_get_rx_stats(&rxStats);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_ring_received_total", "Frames captured into the RX ring",
+                                 rxStats.received);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_ring_overflows_total", "Frames dropped, RX ring full",
+                                 rxStats.overflows);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_ring_missed_total", "Frames overwritten before they were read",
+                                 rxStats.missed);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_rx_read_errors_total", "CRC or SPI errors on read",
+                                 rxStats.readErrors);
+#endif
+  SensorSentinel_dedup_stats_t dedupStats;
+  SensorSentinel_dedup_get_stats(&dedupStats);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_dedup_hits_total", "Duplicate frames skipped",
+                                 dedupStats.hits);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_dedup_stale_total", "Frames skipped as stale",
+                                 dedupStats.stale);
+#if SEQ_MODE
+  SensorSentinel_seq_stats_t seqStats;
+  SensorSentinel_seq_get_stats(&seqStats);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_seq_gaps_total", "Counter skips ahead, all nodes",
+                                 seqStats.gaps);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_seq_reorders_total", "Frames heard after a later one",
+                                 seqStats.reorders);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_seq_reboots_total", "Node restarts seen in counters or uptime",
+                                 seqStats.reboots);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_seq_evictions_total", "Node records given to another node",
+                                 seqStats.evictions);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_seq_lost_frames", "Counters skipped and not heard late",
+                               seqStats.lost);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_seq_nodes", "Nodes in the sequence table", seqStats.nodes);
+#endif
+#if MQTT_SPOOL_MODE
+  SensorSentinel_spool_stats_t spoolStats;
+  SensorSentinel_spool_get_stats(&spoolStats);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_spool_dropped_total", "Spooled frames lost",
+                                 spoolStats.dropped);
+#endif
+#if MQTT_QOS >= 1
+  SensorSentinel_mqtt_ack_stats_t ackStats;
+  SensorSentinel_mqtt_get_ack_stats(&ackStats);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_mqtt_published_total", "QoS 1 publishes sent",
+                                 ackStats.published);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_mqtt_acks_total", "PUBACKs received", ackStats.acks);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_mqtt_retransmits_total", "Publishes resent with DUP",
+                                 ackStats.retransmits);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_mqtt_requeued_total",
+                                 "Unacknowledged frames put back in the spool", ackStats.requeued);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_mqtt_unacked_lost_total", "Unacknowledged frames given up",
+                                 ackStats.lost);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_mqtt_window_full_total", "Publishes refused, window full",
+                                 ackStats.windowFull);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_mqtt_inflight", "Publishes awaiting PUBACK", ackStats.inflight);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_mqtt_acks_per_second", "PUBACKs in the last full second",
+                               ackStats.acksPerSec);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_mqtt_ack_ms_avg", "Mean first send to PUBACK",
+                               ackStats.avgAckMs);
+#endif
+  SensorSentinel_net_stats_t netStats;
+  SensorSentinel_net_get_stats(&netStats);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_wifi_attempts_total", "WiFi connect attempts",
+                                 netStats.wifiAttempts);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_wifi_drops_total", "WiFi links lost", netStats.wifiDrops);
+  SensorSentinel_metrics_counter(out, "sensorsentinel_mqtt_connects_total", "Broker connections made",
+                                 netStats.mqttConnects);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_net_state", "0 WiFi connecting .. 4 online", netStats.state);
+  // Startup milestones, ms after boot; 0 until reached
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_startup_wifi_ms", "Boot to first WiFi IP", netStats.wifiUpMs);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_startup_time_sync_ms", "Boot to clock set by SNTP",
+                               netStats.timeSyncMs);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_startup_mqtt_ms", "Boot to first broker connection",
+                               netStats.mqttUpMs);
+  SensorSentinel_metrics_gauge(out, "sensorsentinel_startup_first_forward_ms", "Boot to first frame published",
+                               netStats.firstForwardMs);
 }
 
 /**
@@ -117,97 +418,123 @@ void loop()
 
 void onBinaryPacketReceived(uint8_t *data, size_t length, float rssi, float snr)
 {
+#if !THREADED_RUNTIME || defined(NO_RADIOLIB)
   // Turn on LED to indicate reception
   heltec_led(25);
+#endif
 
-  // Clear display for output
-  heltec_clear_display();
-
-   // Store packet in buffer
-  memcpy(packetBuffer, data, length);
+  // data points into the RadioLib helper's receive slot; it is used in
+  // place through validation, dedup and publish, and freed on return
+
+  // A repeater's copy: move the frame up over the mesh header, so the
+  // uplink record is the node's own frame whichever path it took
+  SensorSentinel_mesh_header_t mesh = {};
+  if (length > 0 && data[0] == SensorSentinel_MSG_MESH) {
+    length = SensorSentinel_mesh_strip(data, length, &mesh);
+    SensorSentinel_rx_slot_t *slot = SensorSentinel_rx_current();
+    if (slot && slot->data == data) {
+      slot->length = length;
+    }
+  }
 
   // Basic validation - check if it's a known message type with the right size
-  bool isValidPacket = SensorSentinel_validate_packet(packetBuffer, length);
+  bool isValidPacket = length > 0 && SensorSentinel_validate_packet(data, length);
 
   if (isValidPacket)
   {
-    uint8_t messageType = *((uint8_t *)data);
-    packetMessageType = SensorSentinel_message_type_to_string(messageType);
-
-    // Display the extracted information
-    both.printf("\nReceived Type: %s\n", packetMessageType.c_str());
-    both.printf("Msg #: %u\n", SensorSentinel_get_message_counter_from_packet(packetBuffer));
-    both.printf("NodeID: %u\n", SensorSentinel_extract_node_id_from_packet(packetBuffer));
+    // Check if the packet has already been processed
+    uint32_t nodeId = SensorSentinel_extract_node_id_from_packet(data);
+    uint32_t messageCounter = SensorSentinel_get_message_counter_from_packet(data);
+
+    LastRx lastRx = {};
+    lastRx.messageType = *((uint8_t *)data);
+    lastRx.messageCounter = messageCounter;
+    lastRx.nodeId = nodeId;
+    lastRx.rssi = rssi;
+    lastRx.length = length;
+    if (mesh.hops > 0) {
+      packetsRelayed++;
+      SensorSentinel_log_d("Relayed: %u hop(s), last repeater %u, original RSSI %d dBm\n",
+                           mesh.hops, mesh.lastRepeaterId, mesh.originRssi);
+    }
 
-    // Common display elements (outside the if/else block)
-    both.printf("RSSI: %.1f dB\n", rssi);
-    both.printf("Size: %u bytes\n", length);
-    both.printf("Total Rx: %u\n", packetsReceived + 1);
+    // Serial output for valid packets (hex dump and all fields)
+    if (SensorSentinel_log_enabled(SENSOR_LOG_DEBUG)) {
+      SensorSentinel_print_packet_info(data, length);
+      Serial.println("---------------------------");
+    }
 
-    // Serial output for valid packets
-    SensorSentinel_print_packet_info(packetBuffer, length);
-    Serial.println("---------------------------");
+    // Records the frame as seen when it is new
+    uint32_t dedupStart = SensorSentinel_metrics_start();
+    SensorSentinel_dedup_result_t dedup = SensorSentinel_dedup_check(nodeId, messageCounter);
+    SensorSentinel_metrics_record(METRIC_DEDUP_CHECK, dedupStart);
+    lastRx.dedup = dedup;
+    bool forwarded = false;
+
+#if SEQ_MODE
+    // Every new frame, stale ones included: those are the reordered ones
+    if (dedup != DEDUP_DUPLICATE) {
+      SensorSentinel_seq_observe(nodeId, messageCounter, SensorSentinel_get_uptime_from_packet(data, length),
+                                 rssi, snr, millis());
+    }
+#endif
 
-    // Check if the packet has already been processed
-    uint32_t nodeId = SensorSentinel_extract_node_id_from_packet(packetBuffer);
-    uint32_t messageCounter = SensorSentinel_get_message_counter_from_packet(packetBuffer);
+#if ADR_MODE
+    // Before the MQTT publish: the node is listening for the hint right now.
+    // A relayed copy measured the repeater's link, not the node's.
+    if (mesh.hops == 0) {
+      SensorSentinel_adr_observe(nodeId, messageCounter, rssi, snr, dedup == DEDUP_NEW);
+    }
+#endif
 
-    if (!isPacketAlreadyProcessed(nodeId, messageCounter)) {
-        Serial.printf("NEW: Processing packet from Node %u (Msg #%u)\n", nodeId, messageCounter);
-        
-        // Add to cache BEFORE processing to prevent race conditions
-        addToReceivedCache(nodeId, messageCounter);
-        
-        // Forward the packet to MQTT using new helper function
-        MqttForwardStatus mqttStatus = SensorSentinel_mqtt_forward_packet(packetBuffer, length, rssi, snr);
+    if (dedup == DEDUP_NEW) {
+        SensorSentinel_log_i("NEW: Processing packet from Node %u (Msg #%u)\n", nodeId, messageCounter);
         
-        // Display MQTT status
-        both.printf("MQTT: %s\n", SensorSentinel_mqtt_status_to_string(mqttStatus));
+        // Forward the ring slot itself so the uplink header (gateway ID, RX
+        // time, RSSI/SNR, frequency error) is built in place in front of it
+        uint32_t forwardStart = SensorSentinel_metrics_start();
+        SensorSentinel_rx_slot_t *slot = SensorSentinel_rx_current();
+        MqttForwardStatus mqttStatus = slot ? SensorSentinel_mqtt_forward_slot(slot)
+                                            : SensorSentinel_mqtt_forward_packet(data, length, rssi, snr);
+        SensorSentinel_metrics_record(METRIC_MQTT_FORWARD, forwardStart);
+        lastRx.mqttStatus = mqttStatus;
         
-        if (mqttStatus == MQTT_SUCCESS) {
+        // A batched frame is published with its envelope from maintainUplink()
+        if (mqttStatus == MQTT_SUCCESS || mqttStatus == MQTT_BATCHED) {
             packetsForwarded++;
-            // Serial output for packet statistics
-            Serial.printf("\nPackets received: %u, Forwarded: %u\n", packetsReceived + 1, packetsForwarded);
-            Serial.println("---------------------------");
-            Serial.println("---------------------------\n\n");
-          }
+            forwarded = true;
+        }
     } else {
-        Serial.printf("DUPLICATE: Already processed packet from Node %u (Msg #%u) - SKIPPING MQTT\n", 
-                      nodeId, messageCounter);
-        both.println("Duplicate - SKIPPED");
+        SensorSentinel_log_i("%s: Already processed packet from Node %u (Msg #%u) - SKIPPING MQTT\n", 
+                             SensorSentinel_dedup_result_to_string(dedup), nodeId, messageCounter);
     }
 
-    heltec_display_update();
-
     // Update counters and timers
     packetsReceived++;
     lastPacketTime = millis();
 
-    // Turn off LED
-    heltec_led(0);
-  } // ← This closes the if (isValidPacket) block
-} // ← ADD THIS MISSING CLOSING BRACE FOR onBinaryPacketReceived!
-
-/**
- * Check if we've already processed this packet
- */
-bool isPacketAlreadyProcessed(uint32_t nodeId, uint32_t messageCounter) {
-    for (int i = 0; i < PACKET_CACHE_SIZE; i++) {
-        if (receivedCache[i].nodeId == nodeId && 
-            receivedCache[i].messageCounter == messageCounter) {
-            return true; // Already processed
-        }
+    if (forwarded) {
+        printStats();
     }
-    return false; // New packet
-}
 
-/**
- * Remember that we've processed this packet
- */
-void addToReceivedCache(uint32_t nodeId, uint32_t messageCounter) {
-    receivedCache[receivedCacheIndex].nodeId = nodeId;
-    receivedCache[receivedCacheIndex].messageCounter = messageCounter;
-    receivedCache[receivedCacheIndex].timestamp = millis();
-    
-    receivedCacheIndex = (receivedCacheIndex + 1) % PACKET_CACHE_SIZE;
-}
\ No newline at end of file
+    portENTER_CRITICAL(&_lastRxMux);
+    _lastRx = lastRx;
+    portEXIT_CRITICAL(&_lastRxMux);
+
+    // Redrawn from loop() on the display refresh timer
+#if THREADED_RUNTIME && !defined(NO_RADIOLIB)
+    _rxActivity = true;
+#else
+    heltec_display_invalidate();
+#endif
+  }
+  else
+  {
+    packetsInvalid++;
+  }
+
+#if !THREADED_RUNTIME || defined(NO_RADIOLIB)
+  // Turn off LED
+  heltec_led(0);
+#endif
+}
@@ -9,20 +9,67 @@
  *   GNSS packet sent every 3rd wake. Send interval configurable via
  *   diagnostic web UI and persisted in NVS.
  *
+ *   With aggregation (diag "agg_n" > 1) each wake only reads the pins into
+ *   an RTC buffer; one SensorSentinel_MSG_AGGREGATE frame carrying all the
+ *   readings (or their min/max/mean, "agg_mode") goes out every N wakes.
+ *   A digital pin change sends at once. The boolean pins are not RTC GPIOs,
+ *   so a change is only seen at the next wake, not when it happens.
+ *
+ *   With report-by-exception (diag heartbeat K > 1) a single-packet wake is
+ *   not transmitted while every analog pin is within its deadband of the
+ *   last sent value and no digital pin changed; a heartbeat still goes out
+ *   every K wakes. The next frame's skippedCount says how many were skipped.
+ *
+ *   With -DULP_MODE=1 the wakes in between are left to the ULP coprocessor
+ *   (SensorSentinel_ulp_helper.h): it takes the readings while the main
+ *   cores sleep and wakes them only when an analog pin leaves its deadband
+ *   around the last sent value, a watched pin changes, or N (aggregation)
+ *   or K (heartbeat) readings are due.
+ *
+ *   With -DADR_MODE=1 the sender listens briefly after every ADR_ACK_EVERY-th
+ *   frame for the gateway's link hint and tunes its TX power (and SF, where
+ *   allowed) to the margin (SensorSentinel_adr_helper.h).
+ *
+ *   Each sleep is the interval +/- LBT_SLEEP_JITTER_PCT, drawn from a PRNG
+ *   seeded with the node ID, and each frame waits for CAD to find the
+ *   channel clear (SensorSentinel_lbt_helper.h).
+ *
  * REPEATER_MODE = true  (mains-powered repeater):
  *   Stays awake continuously. Listens for packets from other nodes and
  *   re-transmits them (with deduplication to prevent loops). Also sends
- *   its own sensor data on a timer. No deep sleep.
+ *   its own sensor data on a timer. No deep sleep. Repeats wait
+ *   REPEAT_DELAY_MS plus a per-node random delay, so repeaters that heard
+ *   the same frame do not answer it in unison.
+ *
+ *   Repeated copies carry a mesh header with the hop count (limited to
+ *   MESH_TTL), the original RSSI and this repeater's ID. A repeat is
+ *   cancelled if another repeater is heard forwarding the frame first, and
+ *   the diag UI can restrict repeating to weak frames (RSSI threshold) and
+ *   to listed node IDs (SensorSentinel_mesh_helper.h).
+ *
+ *   With -DPINS_EDGE_MODE=1 and PACKET_FORMAT=2 its own frames also carry
+ *   the boolean pins that changed since the last one and their pulse counts
+ *   (SensorSentinel_pins_helper.h).
  *
  * Set via platformio.ini build flag: -DREPEATER_MODE=1
+ *
+ * In repeater mode, -DTHREADED_RUNTIME=1 moves radio servicing into a
+ * dedicated task (see SensorSentinel_tasks_helper.h).
  */
 
 #include "heltec_unofficial_revised.h"
 #include "SensorSentinel_packet_helper.h"
 #include "SensorSentinel_diag.h"
+#include "SensorSentinel_dedup_helper.h"
+#include "SensorSentinel_log_helper.h"
+#include "SensorSentinel_ulp_helper.h"
+#include "SensorSentinel_adr_helper.h"
+#include "SensorSentinel_lbt_helper.h"
+#include "SensorSentinel_mesh_helper.h"
 
 #ifndef NO_RADIOLIB
 #include "SensorSentinel_RadioLib_helper.h"
+#include "SensorSentinel_tasks_helper.h"
 #endif
 
 // ── Mode selection ─────────────────────────────────────────────────────────────
@@ -35,29 +82,79 @@ RTC_DATA_ATTR uint32_t sensorPacketCounter = 0;
 RTC_DATA_ATTR uint32_t gnssPacketCounter   = 0;
 RTC_DATA_ATTR uint8_t  wakeCount           = 0;
 
+#if !REPEATER_MODE
+// Readings not yet sent, oldest first; cleared only after a successful TX
+RTC_DATA_ATTR SensorSentinel_pin_readings_t aggregateSamples[AGGREGATE_MAX_SAMPLES];
+RTC_DATA_ATTR uint8_t  aggregateCount      = 0;
+RTC_DATA_ATTR uint8_t  lastDigital         = 0;   // Boolean pins at the previous wake
+
+// Report-by-exception: readings in the last transmitted sensor packet
+RTC_DATA_ATTR SensorSentinel_pin_readings_t lastSentPins;
+RTC_DATA_ATTR bool     lastSentValid       = false;
+RTC_DATA_ATTR uint16_t skippedWakes        = 0;
+#endif
+
 // ── Repeater state ─────────────────────────────────────────────────────────────
 #if REPEATER_MODE
-#define REPEAT_DELAY_MS   200   // Pause before re-transmitting (keep short, radio is deaf during TX)
-#define PACKET_CACHE_SIZE  50
+#define REPEAT_DELAY_MS   200   // Earliest re-transmit after RX (radio keeps listening meanwhile)
+#define REPEAT_TX_PRIORITY  1   // Forwarded frames go ahead of our own
+#define OWN_TX_PRIORITY     0
+#define OWN_TX_PENDING      4   // Own frames waiting in the TX queue at once
+
+// Own frames queued but not on air yet, so the outcome and the LBT report
+// are only settled by onOwnTxDone(). Own tags are even, repeat tags odd.
+typedef struct {
+  uint32_t tag;                  // 0 = free
+  uint8_t  messageType;
+  uint32_t messageCounter;
+  bool     reporting;
+  SensorSentinel_tx_report_t report;
+} OwnTx;
+
+static OwnTx            _ownTx[OWN_TX_PENDING];
+static portMUX_TYPE     _ownTxMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t         _ownTxSeq = 0;
 
-struct PacketCacheEntry { uint32_t nodeId; uint32_t messageCounter; };
-static PacketCacheEntry _seenPackets[PACKET_CACHE_SIZE];
-static uint8_t          _cacheIndex = 0;
 static unsigned long    _lastOwnSensorTx = 0;
 static uint32_t         _packetsRepeated = 0;
 static unsigned long    _sensorIntervalMs = 60000; // loaded from NVS in setup()
+
+// Last repeated frame, shown by renderRepeatStatus()
+static struct {
+  uint32_t nodeId;
+  uint32_t messageCounter;
+  float    rssi;
+} _lastRepeat;
 #endif
 
 // ── Forward declarations ───────────────────────────────────────────────────────
 void sendSensorPacket();
 void sendGnssPacket();
 void flashLedForMode(int interval);
+#if !REPEATER_MODE
+void sampleForAggregate(int every, bool sendNow);
+void pushAggregateSample(const SensorSentinel_pin_readings_t *reading);
+void sendAggregatePacket();
+bool unchangedSinceLastTx(const SensorSentinel_pin_readings_t *pins);
+#if ULP_MODE
+void collectUlpReadings(int aggregateEvery, SensorSentinel_ulp_wake_t reason);
+bool armUlp(int aggregateEvery, int interval);
+#endif
+#endif
+#ifndef NO_RADIOLIB
+// transmitOwnFrame() result in repeater mode: on its way, outcome logged later
+#define OWN_TX_QUEUED 1   // RadioLib codes are 0 (RADIOLIB_ERR_NONE) or negative
+int transmitOwnFrame(uint8_t *data, size_t length);
+#endif
 
 #if REPEATER_MODE
 void onPacketReceived(uint8_t *data, size_t length, float rssi, float snr);
-bool alreadySeen(uint32_t nodeId, uint32_t messageCounter);
-void markSeen(uint32_t nodeId, uint32_t messageCounter);
-void repeatPacket(uint8_t *data, size_t length);
+void repeatPacket(const uint8_t *frame, size_t length, const SensorSentinel_mesh_header_t *received,
+                  float rssi, uint32_t tag);
+void renderRepeatStatus(Print &out);
+#ifndef NO_RADIOLIB
+void onOwnTxDone(uint32_t tag, int state);
+#endif
 #endif
 
 // ── setup() ───────────────────────────────────────────────────────────────────
@@ -76,15 +173,33 @@ void setup() {
   heltec_display_update();
   delay(2000);
 
-  memset(_seenPackets, 0, sizeof(_seenPackets));
+  // Per-frame screen; the startup screen stays until the first repeat
+  heltec_display_defer(renderRepeatStatus);
+
+  SensorSentinel_dedup_init();
+  SensorSentinel_pins_begin();  // With PINS_EDGE_MODE, edges latch from here on
   _sensorIntervalMs = (unsigned long)SensorSentinel_diag_get_sensor_interval() * 1000UL;
 
+  // Which frames to repeat; forward everything unless the diag UI narrowed it
+  int repeatRssi = SensorSentinel_diag_get_repeat_rssi();
+  String repeatAllow = SensorSentinel_diag_get_repeat_allowlist();
+  SensorSentinel_mesh_configure(repeatRssi, repeatAllow.c_str());
+  SensorSentinel_log_i("Repeater: RSSI threshold %d dBm (0 = off), allowlist [%s], TTL %d\n",
+                       repeatRssi, repeatAllow.c_str(), MESH_TTL);
+
 #ifndef NO_RADIOLIB
+  SensorSentinel_set_tx_done_callback(onOwnTxDone);
   if (SensorSentinel_subscribe(NULL, onPacketReceived)) {
     Serial.println("Repeater: listening for packets");
   } else {
     Serial.println("Repeater: subscribe failed");
   }
+
+#if THREADED_RUNTIME
+  // Radio task fills the ring; uplink task runs onPacketReceived()
+  SensorSentinel_tasks_begin_radio();
+  SensorSentinel_tasks_begin_uplink(NULL);
+#endif
 #endif
 
   // Fall through to loop() — no deep sleep
@@ -92,6 +207,11 @@ void setup() {
 #else
   // ── Sender (deep sleep) mode ──────────────────────────────────────────────
   bool timerWake = heltec_wakeup_was_timer();
+  SensorSentinel_ulp_wake_t ulpWake = SensorSentinel_ulp_wake_reason();
+#if ULP_MODE
+  SensorSentinel_ulp_stop();
+  timerWake = timerWake || ulpWake != ULP_WAKE_NONE;
+#endif
 
   if (!timerWake) {
     SensorSentinel_diag_check();
@@ -109,9 +229,20 @@ void setup() {
     delay(2000);
 
     wakeCount = 0;
+    lastSentValid = false;  // Always report after a reset or button wake
   }
 
-  sendSensorPacket();
+  int aggregateEvery = SensorSentinel_diag_get_aggregate_count();
+#if ULP_MODE
+  collectUlpReadings(aggregateEvery, ulpWake);
+#endif
+  if (aggregateEvery <= 1) {
+    sendSensorPacket();
+  } else {
+    // A button/power-on wake flushes the buffer so a restart shows up at once
+    bool exception = (ulpWake == ULP_WAKE_THRESHOLD || ulpWake == ULP_WAKE_EDGE);
+    sampleForAggregate(aggregateEvery, !timerWake || exception);
+  }
 
 #ifdef GNSS
   if (wakeCount % 3 == 0) {
@@ -120,7 +251,14 @@ void setup() {
 #endif
 
   wakeCount++;
-  heltec_deep_sleep(SensorSentinel_diag_get_interval());
+  int interval = SensorSentinel_diag_get_interval();
+#if ULP_MODE
+  if (armUlp(aggregateEvery, interval)) {
+    // Timer only as a fallback should the ULP never wake us
+    heltec_deep_sleep(interval * (ULP_MAX_SAMPLES + 2));
+  }
+#endif
+  heltec_deep_sleep_ms(SensorSentinel_lbt_sleep_ms(interval));
 #endif
 }
 
@@ -129,7 +267,7 @@ void loop() {
 #if REPEATER_MODE
   heltec_loop();
 
-#ifndef NO_RADIOLIB
+#if !defined(NO_RADIOLIB) && !THREADED_RUNTIME
   SensorSentinel_process_packets();
 #endif
 
@@ -161,144 +299,473 @@ void sendSensorPacket() {
   bool initSuccess = SensorSentinel_init_sensor_packet(&packet, sensorPacketCounter);
 
   if (!initSuccess) {
-    Serial.println("ERROR: init sensor pkt fail");
+    SensorSentinel_log_e("ERROR: init sensor pkt fail\n");
     return;
   }
 
-  Serial.printf("Sending Sensor #%u  NodeID: %u  Bat: %u%%\n",
-                packet.messageCounter, packet.nodeId, packet.batteryLevel);
+#if !REPEATER_MODE
+  if (unchangedSinceLastTx(&packet.pins)) {
+    skippedWakes++;
+    SensorSentinel_log_i("No change beyond deadband, TX skipped (%u)\n", skippedWakes);
+    return;
+  }
+  packet.skippedCount = skippedWakes;
+#endif
+
+  SensorSentinel_log_i("Sending Sensor #%u  NodeID: %u  Bat: %u%%\n",
+                       packet.messageCounter, packet.nodeId, packet.batteryLevel);
+
+  uint8_t *frame = (uint8_t*)&packet;
+  size_t frameLength = sizeof(packet);
+#if PACKET_FORMAT == 2
+  uint8_t compact[SensorSentinel_V2_MAX_FRAME];
+  frameLength = SensorSentinel_encode_packet_v2((SensorSentinel_packet_t*)&packet, compact, sizeof(compact));
+  frame = compact;
+#if PINS_EDGE_MODE
+  SensorSentinel_pin_edges_t edges;
+  if (SensorSentinel_pins_take_edges(&edges)) {
+    frameLength = SensorSentinel_add_pin_edges(compact, frameLength, sizeof(compact), &edges);
+    SensorSentinel_log_d("Pin edges: changed 0x%02X\n", edges.changed);
+  }
+#endif
+  SensorSentinel_log_d("v2 frame: %u bytes (v1: %u)\n", frameLength, sizeof(packet));
+#endif
 
   heltec_led(25);
 
 #ifndef NO_RADIOLIB
-  int state = radio.transmit((uint8_t*)&packet, sizeof(packet));
-  if (state == RADIOLIB_ERR_NONE) {
+  int state = transmitOwnFrame(frame, frameLength);
+  if (state == OWN_TX_QUEUED) {
+    // The counter is spent either way: a lost frame shows as a gap upstream
+    sensorPacketCounter++;
+    SensorSentinel_log_i("Sensor queued\n");
+  } else if (state == RADIOLIB_ERR_NONE) {
     sensorPacketCounter++;
-    Serial.println("Sensor TX OK");
+#if !REPEATER_MODE
+    lastSentPins = packet.pins;
+    lastSentValid = true;
+    skippedWakes = 0;
+#endif
+    SensorSentinel_log_i("Sensor TX OK\n");
   } else {
-    Serial.printf("ERROR: TX failed: %d\n", state);
+    SensorSentinel_log_e("ERROR: TX failed: %d\n", state);
   }
 #else
   sensorPacketCounter++;
-  Serial.println("No Radio");
+#if !REPEATER_MODE
+  lastSentPins = packet.pins;
+  lastSentValid = true;
+  skippedWakes = 0;
+#endif
+  SensorSentinel_log_i("No Radio\n");
 #endif
 
   heltec_led(0);
-  SensorSentinel_print_packet_info(&packet, sizeof(packet));
-  Serial.println("---------------------------\n");
-
-#if REPEATER_MODE
-  // Resume listening after TX
-  SensorSentinel_subscribe(NULL, onPacketReceived);
-#endif
+  if (SensorSentinel_log_enabled(SENSOR_LOG_DEBUG)) {
+    SensorSentinel_print_packet_info(&packet, sizeof(packet));
+    Serial.println("---------------------------\n");
+  }
 }
 
 void sendGnssPacket() {
   SensorSentinel_gnss_packet_t packet;
   SensorSentinel_init_gnss_packet(&packet, gnssPacketCounter);
 
-  Serial.printf("Sending GNSS #%u  NodeID: %u  Bat: %u%%\n",
-                packet.messageCounter, packet.nodeId, packet.batteryLevel);
+  SensorSentinel_log_i("Sending GNSS #%u  NodeID: %u  Bat: %u%%\n",
+                       packet.messageCounter, packet.nodeId, packet.batteryLevel);
+
+  uint8_t *frame = (uint8_t*)&packet;
+  size_t frameLength = sizeof(packet);
+#if PACKET_FORMAT == 2
+  uint8_t compact[SensorSentinel_V2_MAX_FRAME];
+  frameLength = SensorSentinel_encode_packet_v2((SensorSentinel_packet_t*)&packet, compact, sizeof(compact));
+  frame = compact;
+  SensorSentinel_log_d("v2 frame: %u bytes (v1: %u)\n", frameLength, sizeof(packet));
+#endif
 
   heltec_led(25);
 
 #ifndef NO_RADIOLIB
-  int state = radio.transmit((uint8_t*)&packet, sizeof(packet));
-  if (state == RADIOLIB_ERR_NONE) {
+  int state = transmitOwnFrame(frame, frameLength);
+  if (state == OWN_TX_QUEUED) {
     gnssPacketCounter++;
-    Serial.println("GNSS TX OK");
+    SensorSentinel_log_i("GNSS queued\n");
+  } else if (state == RADIOLIB_ERR_NONE) {
+    gnssPacketCounter++;
+    SensorSentinel_log_i("GNSS TX OK\n");
   } else {
-    Serial.printf("ERROR: TX failed: %d\n", state);
+    SensorSentinel_log_e("ERROR: TX failed: %d\n", state);
   }
 #else
   gnssPacketCounter++;
-  Serial.println("No Radio");
+  SensorSentinel_log_i("No Radio\n");
+#endif
+
+  heltec_led(0);
+  if (SensorSentinel_log_enabled(SENSOR_LOG_DEBUG)) {
+    SensorSentinel_print_packet_info(&packet, sizeof(packet));
+    Serial.println("---------------------------\n");
+  }
+}
+
+#if !REPEATER_MODE
+bool unchangedSinceLastTx(const SensorSentinel_pin_readings_t *pins) {
+  int heartbeat = SensorSentinel_diag_get_heartbeat();
+  if (heartbeat <= 1 || !lastSentValid || skippedWakes + 1 >= heartbeat) {
+    return false;
+  }
+  if (pins->boolean != lastSentPins.boolean) {
+    return false;
+  }
+
+  uint16_t deadbands[SensorSentinel_ANALOG_COUNT];
+  SensorSentinel_diag_get_deadbands(deadbands);
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++) {
+    if (abs((int)pins->analog[i] - (int)lastSentPins.analog[i]) > deadbands[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void sampleForAggregate(int every, bool sendNow) {
+  SensorSentinel_pin_readings_t reading;
+  SensorSentinel_read_all_pins(&reading);
+
+  bool edge = (reading.boolean != lastDigital);
+  lastDigital = reading.boolean;
+  pushAggregateSample(&reading);
+
+  if (!sendNow && !edge && aggregateCount < every) {
+    SensorSentinel_log_i("Reading %u/%d buffered\n", aggregateCount, every);
+    return;
+  }
+  if (edge) {
+    SensorSentinel_log_i("Digital pins changed (0x%02X), sending now\n", reading.boolean);
+  }
+  sendAggregatePacket();
+}
+
+void pushAggregateSample(const SensorSentinel_pin_readings_t *reading) {
+  // Full only when sends keep failing: drop the oldest reading
+  if (aggregateCount >= AGGREGATE_MAX_SAMPLES) {
+    memmove(&aggregateSamples[0], &aggregateSamples[1],
+            (AGGREGATE_MAX_SAMPLES - 1) * sizeof(SensorSentinel_pin_readings_t));
+    aggregateCount = AGGREGATE_MAX_SAMPLES - 1;
+  }
+  aggregateSamples[aggregateCount++] = *reading;
+}
+
+void sendAggregatePacket() {
+  uint8_t frame[SensorSentinel_AGGREGATE_MAX_SIZE];
+  uint8_t mode = (uint8_t)SensorSentinel_diag_get_aggregate_mode();
+  size_t frameLength = SensorSentinel_init_aggregate_packet(frame, sizeof(frame), sensorPacketCounter,
+                                                            aggregateSamples, aggregateCount, mode,
+                                                            (uint16_t)SensorSentinel_diag_get_interval());
+  if (frameLength == 0) {
+    SensorSentinel_log_e("ERROR: init aggregate pkt fail\n");
+    return;
+  }
+
+  SensorSentinel_log_i("Sending Aggregate #%u  %u readings  %u bytes\n",
+                       sensorPacketCounter, aggregateCount, frameLength);
+
+  heltec_led(25);
+
+#ifndef NO_RADIOLIB
+  int state = transmitOwnFrame(frame, frameLength);
+  if (state == RADIOLIB_ERR_NONE) {
+    sensorPacketCounter++;
+    lastSentPins = aggregateSamples[aggregateCount - 1];
+    lastSentValid = true;
+    aggregateCount = 0;
+    SensorSentinel_log_i("Aggregate TX OK\n");
+  } else {
+    // Readings stay buffered for the next wake
+    SensorSentinel_log_e("ERROR: TX failed: %d\n", state);
+  }
+#else
+  sensorPacketCounter++;
+  lastSentPins = aggregateSamples[aggregateCount - 1];
+  lastSentValid = true;
+  aggregateCount = 0;
+  SensorSentinel_log_i("No Radio\n");
 #endif
 
   heltec_led(0);
-  SensorSentinel_print_packet_info(&packet, sizeof(packet));
-  Serial.println("---------------------------\n");
+  if (SensorSentinel_log_enabled(SENSOR_LOG_DEBUG)) {
+    SensorSentinel_print_packet_info(frame, frameLength);
+    Serial.println("---------------------------\n");
+  }
+}
+#endif
+
+#if !REPEATER_MODE && ULP_MODE
+// Readings the ULP took while we slept: into the aggregate buffer, or
+// counted as skipped wakes when sending single packets
+void collectUlpReadings(int aggregateEvery, SensorSentinel_ulp_wake_t reason) {
+  SensorSentinel_pin_readings_t readings[ULP_MAX_SAMPLES];
+  uint8_t count = SensorSentinel_ulp_take_readings(readings, ULP_MAX_SAMPLES, lastDigital);
+  if (count == 0) {
+    return;
+  }
+  SensorSentinel_log_i("ULP: %u readings, woke on %s\n", count, SensorSentinel_ulp_wake_to_string(reason));
+
+  if (aggregateEvery > 1) {
+    for (uint8_t i = 0; i < count; i++) {
+      pushAggregateSample(&readings[i]);
+    }
+  } else {
+    skippedWakes += count;
+  }
+}
+
+// Hand the next wakes to the ULP. Returns false when every wake sends anyway
+// or the ULP is unavailable; the caller then sleeps on the timer as usual.
+bool armUlp(int aggregateEvery, int interval) {
+  int every = (aggregateEvery > 1) ? aggregateEvery : SensorSentinel_diag_get_heartbeat();
+  int pending = (aggregateEvery > 1) ? aggregateCount : skippedWakes;
+  if (every <= 1) {
+    return false;
+  }
+
+  // The main cores take the reading that completes the N (or K) on wake
+  SensorSentinel_ulp_config_t config;
+  config.target = (uint8_t)constrain(every - 1 - pending, 1, ULP_MAX_SAMPLES);
+  config.periodSecs = interval;
+  config.digital = SensorSentinel_read_all_boolean();
+
+  uint16_t deadbands[SensorSentinel_ANALOG_COUNT];
+  SensorSentinel_diag_get_deadbands(deadbands);
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++) {
+    if (lastSentValid) {
+      int value = lastSentPins.analog[i];
+      config.low[i] = (uint16_t)max(value - deadbands[i], 0);
+      config.high[i] = (uint16_t)min(value + deadbands[i], 0xFFFF);
+    } else {
+      config.low[i] = 0;
+      config.high[i] = 0xFFFF;
+    }
+  }
+  return SensorSentinel_ulp_start(&config);
+}
+#endif
+
+#ifndef NO_RADIOLIB
+int transmitOwnFrame(uint8_t *data, size_t length) {
+  // LBT counts since the last report ride along with this frame
+  uint8_t frame[MAX_LORA_PACKET_SIZE];
+  if (length > sizeof(frame)) {
+    return RADIOLIB_ERR_UNKNOWN;
+  }
+  memcpy(frame, data, length);
+  SensorSentinel_tx_report_t report;
+  bool reporting = false;
+  if (SensorSentinel_lbt_take_report(&report)) {
+    size_t withReport = SensorSentinel_add_tx_report(frame, length, sizeof(frame), &report);
+    reporting = (withReport > length);
+    length = withReport;
+  }
 
 #if REPEATER_MODE
-  SensorSentinel_subscribe(NULL, onPacketReceived);
+  // Queued: the radio keeps listening until the frame goes on air, and
+  // onOwnTxDone() settles it. No pending slot means earlier frames are
+  // still stuck in the queue; adding more would not help.
+  uint32_t tag = 0;
+  portENTER_CRITICAL(&_ownTxMux);
+  for (int i = 0; i < OWN_TX_PENDING; i++) {
+    if (_ownTx[i].tag == 0) {
+      if (++_ownTxSeq >= 0x80000000) {
+        _ownTxSeq = 1;  // Tag 0 means none
+      }
+      tag = _ownTxSeq << 1;
+      _ownTx[i].tag = tag;
+      _ownTx[i].messageType = frame[0];
+      _ownTx[i].messageCounter = SensorSentinel_get_message_counter_from_packet(frame);
+      _ownTx[i].reporting = reporting;
+      _ownTx[i].report = report;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&_ownTxMux);
+  if (tag == 0) {
+    return RADIOLIB_ERR_UNKNOWN;
+  }
+  if (!SensorSentinel_tx_enqueue(frame, length, OWN_TX_PRIORITY, 0, tag)) {
+    onOwnTxDone(tag, RADIOLIB_ERR_UNKNOWN);  // Frees the slot
+    return RADIOLIB_ERR_UNKNOWN;
+  }
+  return OWN_TX_QUEUED;
+#else
+  // Deep-sleep sender: block until TX completes, we sleep right after.
+  // After a warm boot the radio is still asleep until now.
+  if (!heltec_radio_begin()) {
+    return RADIOLIB_ERR_CHIP_NOT_FOUND;
+  }
+  SensorSentinel_adr_apply();
+  SensorSentinel_radio_lock();
+  SensorSentinel_lbt_wait_clear(SensorSentinel_time_on_air_ms(length));
+  int state = radio.transmit(frame, length);
+  SensorSentinel_radio_unlock();
+  if (state == RADIOLIB_ERR_NONE && reporting) {
+    SensorSentinel_lbt_report_sent(&report);
+  }
+
+  // millis() starts when the app does, so this is wake (after the bootloader) to TX done
+  SensorSentinel_log_i("Wake to TX complete: %lu ms (%s boot)\n", millis(), heltec_warm_boot() ? "warm" : "cold");
+
+  // Every ADR_ACK_EVERY frames the gateway answers with its view of the link
+  if (state == RADIOLIB_ERR_NONE) {
+    SensorSentinel_adr_listen(SensorSentinel_get_message_counter_from_packet(frame));
+  }
+  return state;
 #endif
 }
+#endif
 
 // ── Repeater-only functions ────────────────────────────────────────────────────
 #if REPEATER_MODE
 
-bool alreadySeen(uint32_t nodeId, uint32_t messageCounter) {
-  for (int i = 0; i < PACKET_CACHE_SIZE; i++) {
-    if (_seenPackets[i].nodeId == nodeId &&
-        _seenPackets[i].messageCounter == messageCounter) {
-      return true;
+#ifndef NO_RADIOLIB
+// An own frame left the TX queue: only now is it sent and its LBT report delivered
+void onOwnTxDone(uint32_t tag, int state) {
+  if (tag & 1) {
+    return;  // A repeat
+  }
+  OwnTx done = {};
+  portENTER_CRITICAL(&_ownTxMux);
+  for (int i = 0; i < OWN_TX_PENDING; i++) {
+    if (_ownTx[i].tag == tag) {
+      done = _ownTx[i];
+      _ownTx[i].tag = 0;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&_ownTxMux);
+  if (done.tag == 0) {
+    return;
+  }
+
+  const char *type = SensorSentinel_message_type_to_string(done.messageType);
+  if (state == RADIOLIB_ERR_NONE) {
+    if (done.reporting) {
+      SensorSentinel_lbt_report_sent(&done.report);
     }
+    SensorSentinel_log_i("%s #%u TX OK\n", type, done.messageCounter);
+  } else {
+    // The LBT counts stay pending and ride along with the next frame
+    SensorSentinel_log_e("ERROR: %s #%u TX failed: %d\n", type, done.messageCounter, state);
   }
-  return false;
 }
+#endif
+
+void renderRepeatStatus(Print &out) {
+  out.printf("Repeat node %u\n", _lastRepeat.nodeId);
+  out.printf("Msg #%u\n", _lastRepeat.messageCounter);
+  out.printf("RSSI: %.1f dB\n", _lastRepeat.rssi);
+  out.printf("Total fwd: %u\n", _packetsRepeated);
 
-void markSeen(uint32_t nodeId, uint32_t messageCounter) {
-  _seenPackets[_cacheIndex] = { nodeId, messageCounter };
-  _cacheIndex = (_cacheIndex + 1) % PACKET_CACHE_SIZE;
+  SensorSentinel_mesh_stats_t mesh;
+  SensorSentinel_mesh_get_stats(&mesh);
+  out.printf("Suppressed: %u\n", mesh.suppressed);
 }
 
-void repeatPacket(uint8_t *data, size_t length) {
-  // NOTE: Single-radio limitation — the radio is deaf during this entire TX window
-  // (REPEAT_DELAY_MS + transmission time, typically 200ms–2s depending on SF).
-  // Any packets arriving from other nodes during this window are lost.
-  // A two-radio design would solve this, but is not supported by these boards.
-  delay(REPEAT_DELAY_MS);
-  heltec_led(50);
-  int state = radio.transmit(data, length);
-  heltec_led(0);
+void repeatPacket(const uint8_t *frame, size_t length, const SensorSentinel_mesh_header_t *received,
+                  float rssi, uint32_t tag) {
+  const uint8_t *data = frame;
+#if MESH_MODE
+  // Our hop goes in front; a frame too long for the header is sent bare
+  uint8_t wrapped[MAX_LORA_PACKET_SIZE];
+  SensorSentinel_mesh_header_t header;
+  SensorSentinel_mesh_next_hop(received, rssi, SensorSentinel_generate_node_id(), &header);
+  size_t wrappedLength = SensorSentinel_mesh_wrap(wrapped, sizeof(wrapped), &header, frame, length);
+  if (wrappedLength > 0) {
+    data = wrapped;
+    length = wrappedLength;
+  }
+#endif
 
-  if (state == RADIOLIB_ERR_NONE) {
+  // The radio stays in RX while the frame waits in the TX queue; it is only
+  // deaf for the frame's time-on-air (plus turnaround) once TX starts.
+  // Frames arriving during that window are still lost — a single-radio limit.
+  uint32_t airtime = SensorSentinel_time_on_air_ms(length);
+
+  uint32_t delayMs = REPEAT_DELAY_MS + SensorSentinel_lbt_random(LBT_REPEAT_JITTER_MS);
+  if (SensorSentinel_tx_enqueue(data, length, REPEAT_TX_PRIORITY, delayMs, tag)) {
+    SensorSentinel_mesh_note_queued(tag, millis());
     _packetsRepeated++;
-    Serial.printf("Repeat TX OK (total: %u)\n", _packetsRepeated);
+    SensorSentinel_tx_stats_t tx;
+    SensorSentinel_get_tx_stats(&tx);
+    SensorSentinel_log_i("Repeat queued (%u ms on air, depth %u, avg deaf %u ms, total: %u)\n",
+                         airtime, tx.depth, tx.avgDeafMs, _packetsRepeated);
   } else {
-    Serial.printf("Repeat TX failed: %d\n", state);
+    SensorSentinel_log_w("Repeat TX queue full, dropped\n");
   }
-
-  // Resume listening after TX
-  SensorSentinel_subscribe(NULL, onPacketReceived);
 }
 
 void onPacketReceived(uint8_t *data, size_t length, float rssi, float snr) {
-  // NOTE: If two packets arrive before this callback completes, the radio's
-  // single receive buffer means only one will be processed. The interrupt flag
-  // (_packetReceived) is a single bool — there is no queue. High-traffic
-  // environments will see packet loss at the repeater. This is a hardware
-  // constraint of single-radio LoRa nodes.
-  if (!SensorSentinel_validate_packet(data, length)) {
-    Serial.println("Repeater: invalid packet, skipping");
+  // NOTE: Frames are queued in the RadioLib helper's receive ring, so a burst
+  // that arrives while we are busy here is delivered on the next calls.
+  // Frames that arrive while the radio itself is transmitting are still
+  // lost — that is a hardware constraint of single-radio LoRa nodes.
+  // Link hints are for nodes in range of the gateway that sent them
+  if (length > 0 && data[0] == SensorSentinel_MSG_LINK_HINT) {
     return;
   }
 
-  uint32_t nodeId     = SensorSentinel_extract_node_id_from_packet(data);
-  uint32_t msgCounter = SensorSentinel_get_message_counter_from_packet(data);
+  // Another repeater's copy carries a mesh header in front of the frame
+  SensorSentinel_mesh_header_t mesh;
+  size_t frameLength = 0;
+  uint8_t *frame = (uint8_t *)SensorSentinel_mesh_unwrap(data, length, &mesh, &frameLength);
+  if (!frame || !SensorSentinel_validate_packet(frame, frameLength)) {
+    SensorSentinel_log_w("Repeater: invalid packet, skipping\n");
+    return;
+  }
+
+  uint32_t nodeId     = SensorSentinel_extract_node_id_from_packet(frame);
+  uint32_t msgCounter = SensorSentinel_get_message_counter_from_packet(frame);
+  uint32_t tag        = SensorSentinel_mesh_tag(nodeId, msgCounter);
 
   // Don't repeat our own packets
   if (nodeId == SensorSentinel_generate_node_id()) {
     return;
   }
 
-  if (alreadySeen(nodeId, msgCounter)) {
-    Serial.printf("Repeater: duplicate from %u #%u, skipping\n", nodeId, msgCounter);
+  // Records the frame as seen when it is new
+  SensorSentinel_dedup_result_t dedup = SensorSentinel_dedup_check(nodeId, msgCounter);
+  if (dedup != DEDUP_NEW) {
+    // Someone else forwarded it while our copy waits: ours is not needed
+    if (dedup == DEDUP_DUPLICATE && SensorSentinel_mesh_note_overheard(tag, millis()) &&
+        SensorSentinel_tx_cancel(tag)) {
+      SensorSentinel_mesh_note_suppressed();
+      SensorSentinel_log_i("Repeater: %u #%u forwarded by %u, repeat cancelled\n",
+                           nodeId, msgCounter, mesh.lastRepeaterId);
+      heltec_display_invalidate();
+      return;
+    }
+    SensorSentinel_log_i("Repeater: %s from %u #%u, skipping\n",
+                         SensorSentinel_dedup_result_to_string(dedup), nodeId, msgCounter);
     return;
   }
 
-  markSeen(nodeId, msgCounter);
+  SensorSentinel_mesh_decision_t decision = SensorSentinel_mesh_decide(nodeId, &mesh, rssi);
+  if (decision != MESH_REPEAT) {
+    SensorSentinel_log_i("Repeater: %u #%u not repeated (%s, hop %u)\n", nodeId, msgCounter,
+                         SensorSentinel_mesh_decision_to_string(decision), mesh.hops);
+    return;
+  }
 
-  Serial.printf("Repeater: forwarding from %u #%u (RSSI %.1f)\n", nodeId, msgCounter, rssi);
+  SensorSentinel_log_i("Repeater: forwarding from %u #%u (RSSI %.1f, hop %u)\n", nodeId, msgCounter, rssi,
+                       mesh.hops + 1);
 
-  heltec_clear_display();
-  both.printf("Repeat node %u\n", nodeId);
-  both.printf("Msg #%u\n", msgCounter);
-  both.printf("RSSI: %.1f dB\n", rssi);
-  both.printf("Total fwd: %u\n", _packetsRepeated + 1);
-  heltec_display_update();
+  _lastRepeat.nodeId = nodeId;
+  _lastRepeat.messageCounter = msgCounter;
+  _lastRepeat.rssi = rssi;
+
+  repeatPacket(frame, frameLength, &mesh, rssi, tag);
 
-  repeatPacket(data, length);
+  // Redrawn from loop() on the display refresh timer
+  heltec_display_invalidate();
 }
 
 #endif // REPEATER_MODE
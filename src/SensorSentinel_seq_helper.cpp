@@ -0,0 +1,296 @@
+/**
+ * @file SensorSentinel_seq_helper.cpp
+ * @brief Implementation of the per-node sequence table
+ */
+
+#include "SensorSentinel_seq_helper.h"
+#include "SensorSentinel_dedup_helper.h"  // Reboot rules
+#include <stdio.h>
+#include <string.h>
+
+#if (SEQ_NODE_TABLE_SIZE & (SEQ_NODE_TABLE_SIZE - 1)) != 0
+#error "SEQ_NODE_TABLE_SIZE must be a power of 2"
+#endif
+static_assert(SEQ_WINDOW == 32, "the missing-counter window is one uint32_t");
+
+typedef struct {
+  uint32_t nodeId;
+  uint32_t lastCounter;
+  uint32_t missing;          // Bit k-1 set: counter lastCounter - k not heard yet
+  uint32_t lastUptime;
+  uint32_t seenMs;
+  uint32_t frames;
+  uint32_t lost;
+  uint32_t gaps;
+  uint16_t reorders;
+  uint16_t reboots;
+  int16_t rssiQ4;            // 1/16 dB
+  int16_t snrQ4;
+  bool used;
+} _node_entry_t;
+
+static _node_entry_t _nodes[SEQ_NODE_TABLE_SIZE];
+static SensorSentinel_seq_stats_t _stats;
+
+// 32-bit finalizer (murmur3 fmix32), as in the dedup tables
+static inline uint32_t _mix(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+// Find the node's record, or claim a free slot or the one heard from longest ago
+static _node_entry_t *_lookup(uint32_t nodeId, bool *fresh)
+{
+  uint32_t base = _mix(nodeId);
+  _node_entry_t *victim = NULL;
+
+  for (uint32_t i = 0; i < SEQ_PROBE_LIMIT; i++)
+  {
+    _node_entry_t *e = &_nodes[(base + i) & (SEQ_NODE_TABLE_SIZE - 1)];
+    if (e->used && e->nodeId == nodeId)
+    {
+      *fresh = false;
+      return e;
+    }
+    if (!e->used)
+    {
+      if (!victim || victim->used)
+      {
+        victim = e;
+      }
+    }
+    else if (!victim || (victim->used && (int32_t)(e->seenMs - victim->seenMs) < 0))
+    {
+      victim = e;
+    }
+  }
+
+  if (victim->used)
+  {
+    _stats.evictions++;
+  }
+  else
+  {
+    _stats.nodes++;
+  }
+  memset(victim, 0, sizeof(*victim));
+  victim->used = true;
+  victim->nodeId = nodeId;
+  *fresh = true;
+  return victim;
+}
+
+static inline int16_t _q4(float value)
+{
+  float q = value * 16.0f;
+  return (int16_t)(q < -32768.0f ? -32768 : q > 32767.0f ? 32767 : q);
+}
+
+static inline int16_t _ewma(int16_t average, int16_t sample)
+{
+  return (int16_t)(average + (sample - average) / (1 << SEQ_EWMA_SHIFT));
+}
+
+// Start the sequence over at counter (first frame, or after a reboot)
+static void _restart(_node_entry_t *e, uint32_t counter, uint32_t uptime)
+{
+  e->lastCounter = counter;
+  e->lastUptime = uptime;
+  e->missing = 0;
+}
+
+SensorSentinel_seq_event_t SensorSentinel_seq_observe(uint32_t nodeId, uint32_t counter, uint32_t uptime,
+                                                      float rssi, float snr, uint32_t nowMs)
+{
+  bool fresh;
+  _node_entry_t *e = _lookup(nodeId, &fresh);
+  SensorSentinel_seq_event_t event;
+
+  if (fresh)
+  {
+    _restart(e, counter, uptime);
+    e->rssiQ4 = _q4(rssi);
+    e->snrQ4 = _q4(snr);
+    event = SEQ_FIRST;
+  }
+  else if (counter > e->lastCounter)
+  {
+    uint32_t ahead = counter - e->lastCounter;
+    if (uptime && e->lastUptime && uptime < e->lastUptime)
+    {
+      // Counter kept across the restart (RTC or flash), uptime was not
+      _restart(e, counter, uptime);
+      event = SEQ_REBOOT;
+    }
+    else
+    {
+      e->missing = ahead >= SEQ_WINDOW ? 0 : e->missing << ahead;
+      if (ahead > 1)
+      {
+        uint32_t skipped = ahead - 1;
+        e->missing |= skipped >= SEQ_WINDOW ? 0xFFFFFFFFu : (1u << skipped) - 1;
+        e->lost += skipped;
+        e->gaps++;
+        _stats.lost += skipped;
+        _stats.gaps++;
+      }
+      e->lastCounter = counter;
+      if (uptime)
+      {
+        e->lastUptime = uptime;
+      }
+      event = ahead > 1 ? SEQ_GAP : SEQ_NEXT;
+    }
+  }
+  else
+  {
+    uint32_t behind = e->lastCounter - counter;
+    uint32_t bit = behind >= 1 && behind <= SEQ_WINDOW ? 1u << (behind - 1) : 0;
+    if (bit && (e->missing & bit))
+    {
+      // Fills a gap: no longer lost
+      e->missing &= ~bit;
+      e->lost--;
+      _stats.lost--;
+      event = SEQ_LATE;
+    }
+    else if (counter < DEDUP_RESTART_COUNTER || behind > DEDUP_REBOOT_GAP)
+    {
+      _restart(e, counter, uptime);
+      event = SEQ_REBOOT;
+    }
+    else if (behind <= SEQ_WINDOW)
+    {
+      _stats.repeats++;
+      return SEQ_REPEAT;  // Heard already; a late copy that outlived the dedup TTL
+    }
+    else
+    {
+      event = SEQ_LATE;  // Too far back to know whether it was counted lost
+    }
+  }
+
+  if (event == SEQ_LATE)
+  {
+    e->reorders++;
+    _stats.reorders++;
+  }
+  else if (event == SEQ_REBOOT)
+  {
+    e->reboots++;
+    _stats.reboots++;
+  }
+  if (!fresh)
+  {
+    e->rssiQ4 = _ewma(e->rssiQ4, _q4(rssi));
+    e->snrQ4 = _ewma(e->snrQ4, _q4(snr));
+  }
+  e->frames++;
+  e->seenMs = nowMs;
+  _stats.frames++;
+  return event;
+}
+
+void SensorSentinel_seq_init()
+{
+  memset(_nodes, 0, sizeof(_nodes));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+bool SensorSentinel_seq_next_node(uint32_t *cursor, uint32_t nowMs, SensorSentinel_seq_node_t *node)
+{
+  for (; *cursor < SEQ_NODE_TABLE_SIZE; (*cursor)++)
+  {
+    const _node_entry_t *e = &_nodes[*cursor];
+    if (!e->used)
+    {
+      continue;
+    }
+    node->nodeId = e->nodeId;
+    node->lastCounter = e->lastCounter;
+    node->lastUptime = e->lastUptime;
+    node->ageMs = nowMs - e->seenMs;
+    node->frames = e->frames;
+    node->lost = e->lost;
+    node->gaps = e->gaps;
+    node->reorders = e->reorders;
+    node->reboots = e->reboots;
+    node->rssi = e->rssiQ4 / 16.0f;
+    node->snr = e->snrQ4 / 16.0f;
+    (*cursor)++;
+    return true;
+  }
+  return false;
+}
+
+size_t SensorSentinel_seq_format_json(char *out, size_t size, uint32_t *cursor, uint32_t maxNodes,
+                                      uint32_t nowMs)
+{
+  if (size < 3)
+  {
+    return 0;
+  }
+  size_t length = 0;
+  out[length++] = '[';
+  SensorSentinel_seq_node_t n;
+  for (uint32_t count = 0; count < maxNodes; count++)
+  {
+    uint32_t at = *cursor;
+    if (!SensorSentinel_seq_next_node(cursor, nowMs, &n))
+    {
+      break;
+    }
+    int w = snprintf(out + length, size - length,
+                     "%s{\"nodeId\":%u,\"counter\":%u,\"uptime\":%u,\"ageSecs\":%u,\"frames\":%u,\"lost\":%u,"
+                     "\"gaps\":%u,\"reorders\":%u,\"reboots\":%u,\"rssi\":%.1f,\"snr\":%.1f}",
+                     count ? "," : "", (unsigned)n.nodeId, (unsigned)n.lastCounter, (unsigned)n.lastUptime,
+                     (unsigned)(n.ageMs / 1000), (unsigned)n.frames, (unsigned)n.lost, (unsigned)n.gaps,
+                     (unsigned)n.reorders, (unsigned)n.reboots, n.rssi, n.snr);
+    if (w < 0 || (size_t)w + 2 > size - length)
+    {
+      if (count > 0)
+      {
+        *cursor = at;  // Did not fit: it leads the next call
+      }
+      break;
+    }
+    length += w;
+  }
+  out[length++] = ']';
+  out[length] = 0;
+  return length;
+}
+
+void SensorSentinel_seq_get_stats(SensorSentinel_seq_stats_t *stats)
+{
+  if (stats)
+  {
+    *stats = _stats;
+  }
+}
+
+const char *SensorSentinel_seq_event_to_string(SensorSentinel_seq_event_t event)
+{
+  switch (event)
+  {
+  case SEQ_FIRST:
+    return "First";
+  case SEQ_NEXT:
+    return "Next";
+  case SEQ_GAP:
+    return "Gap";
+  case SEQ_LATE:
+    return "Late";
+  case SEQ_REPEAT:
+    return "Repeat";
+  case SEQ_REBOOT:
+    return "Reboot";
+  default:
+    return "Unknown";
+  }
+}
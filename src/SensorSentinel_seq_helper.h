@@ -0,0 +1,153 @@
+/**
+ * @file SensorSentinel_seq_helper.h
+ * @brief Per-node sequence tracking at the gateway: loss, reordering, reboots
+ *
+ * Every new frame (not a duplicate) updates its node's record in a
+ * bounded-probe hash table laid out like the dedup node table, so the cost
+ * per frame does not grow with the number of nodes:
+ *
+ * - gaps: a counter more than one past the last opens a gap; the frames in
+ *   it count as lost until they turn up.
+ * - reorders: a counter below the last that fills one of the last
+ *   SEQ_WINDOW gaps is a late frame (via a repeater, or a spooled
+ *   uplink); it is taken off the lost count. A copy of a frame already
+ *   seen in that window is ignored.
+ * - reboots: a counter back near zero or far below the last (the dedup
+ *   rules), or an uptime that went backwards while the counter advanced.
+ * - link: EWMA of RSSI and SNR, weight 1/2^SEQ_EWMA_SHIFT per frame.
+ *
+ * Lost frames at a steady RSSI point at collisions or the gateway's own RX
+ * path (see the ring counters); a node that stops sending shows as a
+ * growing age with no gap. Records are not expired, since a silent node is
+ * what the table is for; when a probe window is full the node heard
+ * longest ago gives up its slot.
+ *
+ * No Arduino dependency: the clock is passed in, so the table can be
+ * exercised on the host. The gateway publishes it page by page as JSON on
+ * MQTT_STATS_TOPIC/<client ID>/nodes every SEQ_SUMMARY_INTERVAL_SECS
+ * (SensorSentinel_receiver_fwd_mqtt.cpp); nothing is sent per frame.
+ *
+ * Disable via platformio.ini build flag: -DSEQ_MODE=0
+ */
+
+#ifndef SensorSentinel_SEQ_HELPER_H
+#define SensorSentinel_SEQ_HELPER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef SEQ_MODE
+#define SEQ_MODE 1
+#endif
+
+// Tracked nodes (power of two); 44 bytes each
+#ifndef SEQ_NODE_TABLE_SIZE
+#define SEQ_NODE_TABLE_SIZE 1024
+#endif
+#define SEQ_PROBE_LIMIT 8         // Slots examined per lookup
+#define SEQ_WINDOW      32        // Counters behind the last whose arrival is tracked
+#ifndef SEQ_EWMA_SHIFT
+#define SEQ_EWMA_SHIFT  3         // New sample weight 1/8
+#endif
+
+#ifndef SEQ_SUMMARY_INTERVAL_SECS
+#define SEQ_SUMMARY_INTERVAL_SECS 300  // 0 = keep the table but never publish it
+#endif
+#ifndef SEQ_SUMMARY_PAGE_NODES
+#define SEQ_SUMMARY_PAGE_NODES 16      // Nodes per MQTT message (about 170 bytes each)
+#endif
+
+/**
+ * @brief What a frame meant for its node's sequence
+ */
+typedef enum {
+  SEQ_FIRST,    ///< First frame from this node (or it took over an evicted slot)
+  SEQ_NEXT,     ///< Counter one past the last
+  SEQ_GAP,      ///< Counter further ahead; the frames between are counted lost
+  SEQ_LATE,     ///< Older counter that had not been seen: reordered
+  SEQ_REPEAT,   ///< Older counter already seen; nothing counted
+  SEQ_REBOOT    ///< Counter or uptime reset; the sequence restarts here
+} SensorSentinel_seq_event_t;
+
+/**
+ * @brief Snapshot of one node's record
+ */
+typedef struct {
+  uint32_t nodeId;
+  uint32_t lastCounter;      // Highest counter of the current boot
+  uint32_t lastUptime;       // Uptime its frame carried (0 if unknown)
+  uint32_t ageMs;            // Since the last frame
+  uint32_t frames;           // New frames heard
+  uint32_t lost;             // Counters skipped and not (yet) heard late
+  uint32_t gaps;             // Times the counter skipped ahead
+  uint32_t reorders;         // Frames that arrived after a later one
+  uint32_t reboots;
+  float rssi;                // EWMA, dBm
+  float snr;                 // EWMA, dB
+} SensorSentinel_seq_node_t;
+
+/**
+ * @brief Table totals (lost can go down as late frames arrive)
+ */
+typedef struct {
+  uint32_t nodes;            // Records in use
+  uint32_t frames;
+  uint32_t lost;
+  uint32_t gaps;
+  uint32_t reorders;
+  uint32_t repeats;
+  uint32_t reboots;
+  uint32_t evictions;        // Records overwritten by another node
+} SensorSentinel_seq_stats_t;
+
+/**
+ * @brief Clear the table and the totals
+ */
+void SensorSentinel_seq_init();
+
+/**
+ * @brief Account for a new frame (call for frames dedup did not reject as duplicates)
+ * @param nodeId Node ID from the frame
+ * @param counter Message counter from the frame
+ * @param uptime Uptime from the frame, 0 if unknown (SensorSentinel_get_uptime_from_packet())
+ * @param rssi Signal strength (dBm)
+ * @param snr Signal-to-noise ratio (dB)
+ * @param nowMs Current time in milliseconds
+ * @return What the frame meant for the node's sequence
+ */
+SensorSentinel_seq_event_t SensorSentinel_seq_observe(uint32_t nodeId, uint32_t counter, uint32_t uptime,
+                                                      float rssi, float snr, uint32_t nowMs);
+
+/**
+ * @brief Walk the table
+ * @param cursor Slot to start from (0 for the first call); advanced past the node returned
+ * @param nowMs Current time, for ageMs
+ * @param node Filled with the next record
+ * @return false once the table is exhausted
+ */
+bool SensorSentinel_seq_next_node(uint32_t *cursor, uint32_t nowMs, SensorSentinel_seq_node_t *node);
+
+/**
+ * @brief Write up to maxNodes records from cursor as a JSON array
+ * @param out Buffer; about 170 bytes per node are needed
+ * @param size Size of out
+ * @param cursor As for SensorSentinel_seq_next_node(); SEQ_NODE_TABLE_SIZE when done
+ * @param maxNodes Records per call
+ * @param nowMs Current time, for ageSecs
+ * @return Length written (the array is always closed), 0 if out is too small;
+ *         a record that does not fit even alone is skipped
+ */
+size_t SensorSentinel_seq_format_json(char *out, size_t size, uint32_t *cursor, uint32_t maxNodes,
+                                      uint32_t nowMs);
+
+/**
+ * @brief Get a snapshot of the totals
+ */
+void SensorSentinel_seq_get_stats(SensorSentinel_seq_stats_t *stats);
+
+/**
+ * @brief Convert a sequence event to a human-readable string
+ */
+const char *SensorSentinel_seq_event_to_string(SensorSentinel_seq_event_t event);
+
+#endif // SensorSentinel_SEQ_HELPER_H
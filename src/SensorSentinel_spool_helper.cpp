@@ -0,0 +1,439 @@
+/**
+ * @file SensorSentinel_spool_helper.cpp
+ * @brief Implementation of the RAM + LittleFS store-and-forward spool
+ */
+
+#include "SensorSentinel_spool_helper.h"
+#include <LittleFS.h>
+
+// One frame held in RAM
+typedef struct {
+  uint16_t length;
+  uint8_t data[SPOOL_MAX_FRAME];
+} _spool_slot_t;
+
+static _spool_slot_t _ram[SPOOL_RAM_SLOTS];
+static uint32_t _ramHead = 0;   // Oldest slot
+static uint32_t _ramCount = 0;
+static uint32_t _ramBytes = 0;
+
+static bool _begun = false;
+static bool _flashOk = false;
+
+// Segments on flash are numbered _segHead.._segTail (oldest..newest)
+static uint32_t _segHead = 0;
+static uint32_t _segTail = 0;
+static uint32_t _segCount = 0;
+static uint32_t _tailFileBytes = 0;                   // Size of the newest segment file
+static uint32_t _segRecords[SPOOL_MAX_SEGMENTS];      // Unread frames per segment
+static uint32_t _segBytes[SPOOL_MAX_SEGMENTS];        // Unread frame bytes per segment
+static uint32_t _flashRecords = 0;
+static uint32_t _flashBytes = 0;
+
+// Replay cursor into the oldest segment
+static File _readFile;
+static bool _reading = false;
+static uint32_t _readOffset = 0;
+
+// Frame handed out by the last peek
+static size_t _peekLength = 0;
+static bool _peekFromFlash = false;
+static bool _ramFirst = false;  // RAM head was held back from a spill and is older than flash
+
+static uint32_t _spooled = 0;
+static uint32_t _replayed = 0;
+static uint32_t _dropped = 0;
+static uint32_t _flashErrors = 0;
+
+static void _seg_path(uint32_t seq, char *path, size_t size)
+{
+  snprintf(path, size, SPOOL_DIR "/%08lx.seg", (unsigned long)seq);
+}
+
+// Walk a segment file, counting its frames and frame bytes
+static void _seg_scan(uint32_t seq, uint32_t *records, uint32_t *bytes)
+{
+  char path[32];
+  _seg_path(seq, path, sizeof(path));
+  *records = 0;
+  *bytes = 0;
+
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f)
+  {
+    return;
+  }
+
+  uint8_t hdr[2];
+  while (f.read(hdr, 2) == 2)
+  {
+    uint16_t length = hdr[0] | (hdr[1] << 8);
+    if (length == 0 || length > SPOOL_MAX_FRAME || !f.seek(f.position() + length))
+    {
+      break;
+    }
+    (*records)++;
+    *bytes += length;
+  }
+  f.close();
+}
+
+// Delete leftover segment files numbered below seq
+static void _seg_remove_older(uint32_t seq)
+{
+  File dir = LittleFS.open(SPOOL_DIR);
+  if (!dir || !dir.isDirectory())
+  {
+    return;
+  }
+
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+  {
+    char path[32];
+    uint32_t fileSeq = strtoul(f.name(), NULL, 16);
+    f.close();
+    if (fileSeq < seq)
+    {
+      _seg_path(fileSeq, path, sizeof(path));
+      LittleFS.remove(path);
+    }
+  }
+  dir.close();
+}
+
+// Delete the oldest segment; unread frames left in it are counted as dropped
+static void _seg_remove_head()
+{
+  if (_segCount == 0)
+  {
+    return;
+  }
+
+  if (_reading)
+  {
+    _readFile.close();
+    _reading = false;
+  }
+  _readOffset = 0;
+  if (_peekFromFlash)
+  {
+    _peekLength = 0;  // The peeked frame went with the segment
+  }
+
+  uint32_t idx = _segHead % SPOOL_MAX_SEGMENTS;
+  _dropped += _segRecords[idx];
+  _flashRecords -= _segRecords[idx];
+  _flashBytes -= _segBytes[idx];
+  _segRecords[idx] = 0;
+  _segBytes[idx] = 0;
+
+  char path[32];
+  _seg_path(_segHead, path, sizeof(path));
+  LittleFS.remove(path);
+
+  _segHead++;
+  _segCount--;
+}
+
+// Start a new newest segment, making room if the flash budget is used up
+static void _seg_new()
+{
+  if (_segCount >= SPOOL_MAX_SEGMENTS)
+  {
+    Serial.println("Spool: flash full, dropping oldest segment");
+    _seg_remove_head();
+  }
+
+  _segTail++;
+  if (_segCount == 0)
+  {
+    _segHead = _segTail;
+  }
+  _segCount++;
+  _tailFileBytes = 0;
+  _segRecords[_segTail % SPOOL_MAX_SEGMENTS] = 0;
+  _segBytes[_segTail % SPOOL_MAX_SEGMENTS] = 0;
+}
+
+// Append the RAM ring to the newest segment in one write. A frame peeked
+// from RAM stays behind so the pop that follows still finds it.
+static bool _spill_ram()
+{
+  uint32_t keep = (_peekLength && !_peekFromFlash) ? 1 : 0;
+  if (!_flashOk || _ramCount <= keep)
+  {
+    return false;
+  }
+
+  // Never append to the file replay has open
+  if (_segCount == 0 || _tailFileBytes >= SPOOL_SEGMENT_BYTES || (_reading && _segHead == _segTail))
+  {
+    _seg_new();
+  }
+
+  char path[32];
+  _seg_path(_segTail, path, sizeof(path));
+  File f = LittleFS.open(path, FILE_APPEND);
+  if (!f)
+  {
+    _flashErrors++;
+    return false;
+  }
+
+  uint32_t written = 0;
+  for (uint32_t i = keep; i < _ramCount; i++)
+  {
+    const _spool_slot_t *slot = &_ram[(_ramHead + i) % SPOOL_RAM_SLOTS];
+    uint8_t hdr[2] = {(uint8_t)(slot->length & 0xFF), (uint8_t)(slot->length >> 8)};
+    if (f.write(hdr, 2) != 2 || f.write(slot->data, slot->length) != slot->length)
+    {
+      // Keep whatever made it out whole; the rest stays in RAM
+      _flashErrors++;
+      _tailFileBytes = SPOOL_SEGMENT_BYTES;  // Don't append after a torn record
+      break;
+    }
+
+    uint32_t idx = _segTail % SPOOL_MAX_SEGMENTS;
+    _segRecords[idx]++;
+    _segBytes[idx] += slot->length;
+    _flashRecords++;
+    _flashBytes += slot->length;
+    _tailFileBytes += 2 + slot->length;
+    _ramBytes -= slot->length;
+    written++;
+  }
+  f.close();
+
+  uint32_t head = (_ramHead + written) % SPOOL_RAM_SLOTS;
+  if (keep && written > 0)
+  {
+    // Slide the held frame up against the unspilled rest; replay takes it first
+    _ram[head] = _ram[_ramHead];
+    _ramFirst = true;
+  }
+  _ramHead = head;
+  _ramCount -= written;
+  return written > 0;
+}
+
+bool SensorSentinel_spool_begin()
+{
+  if (_begun)
+  {
+    return true;
+  }
+  _begun = true;
+
+#if SPOOL_FLASH
+  // Formats the partition on first use
+  if (!LittleFS.begin(true))
+  {
+    Serial.println("Spool: LittleFS mount failed, RAM only");
+    return true;
+  }
+  if (!LittleFS.exists(SPOOL_DIR))
+  {
+    LittleFS.mkdir(SPOOL_DIR);
+  }
+  _flashOk = true;
+
+  // Recover segments from a previous boot
+  uint32_t minSeq = UINT32_MAX;
+  uint32_t maxSeq = 0;
+  File dir = LittleFS.open(SPOOL_DIR);
+  if (dir && dir.isDirectory())
+  {
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+    {
+      char *end = NULL;
+      uint32_t seq = strtoul(f.name(), &end, 16);
+      if (end && strcmp(end, ".seg") == 0)
+      {
+        minSeq = min(minSeq, seq);
+        maxSeq = max(maxSeq, seq);
+      }
+      f.close();
+    }
+    dir.close();
+  }
+
+  if (minSeq != UINT32_MAX)
+  {
+    // Keep only the newest SPOOL_MAX_SEGMENTS
+    _segHead = (maxSeq - minSeq >= SPOOL_MAX_SEGMENTS) ? maxSeq - (SPOOL_MAX_SEGMENTS - 1) : minSeq;
+    _segTail = maxSeq;
+    if (_segHead != minSeq)
+    {
+      _seg_remove_older(_segHead);
+    }
+
+    _segCount = _segTail - _segHead + 1;
+    for (uint32_t seq = _segHead; seq <= _segTail; seq++)
+    {
+      uint32_t idx = seq % SPOOL_MAX_SEGMENTS;
+      _seg_scan(seq, &_segRecords[idx], &_segBytes[idx]);
+      _flashRecords += _segRecords[idx];
+      _flashBytes += _segBytes[idx];
+    }
+
+    // The newest segment may end in a torn record; append to a fresh one
+    _tailFileBytes = SPOOL_SEGMENT_BYTES;
+
+    Serial.printf("Spool: recovered %u frames in %u segments\n", _flashRecords, _segCount);
+  }
+#endif
+
+  return true;
+}
+
+bool SensorSentinel_spool_push(const uint8_t *data, size_t length)
+{
+  if (!data || length == 0 || length > SPOOL_MAX_FRAME)
+  {
+    return false;
+  }
+  SensorSentinel_spool_begin();
+
+  if (_ramCount == SPOOL_RAM_SLOTS && !_spill_ram())
+  {
+    // No flash: make room by dropping the oldest RAM frame
+    if (_peekLength && !_peekFromFlash)
+    {
+      _peekLength = 0;
+    }
+    _ramFirst = false;
+    _ramBytes -= _ram[_ramHead].length;
+    _ramHead = (_ramHead + 1) % SPOOL_RAM_SLOTS;
+    _ramCount--;
+    _dropped++;
+  }
+
+  _spool_slot_t *slot = &_ram[(_ramHead + _ramCount) % SPOOL_RAM_SLOTS];
+  memcpy(slot->data, data, length);
+  slot->length = length;
+  _ramCount++;
+  _ramBytes += length;
+  _spooled++;
+  return true;
+}
+
+size_t SensorSentinel_spool_peek(uint8_t *buffer, size_t maxLength)
+{
+  SensorSentinel_spool_begin();
+  _peekLength = 0;
+
+  // Flash holds the oldest frames, unless a spill held the RAM head back
+  while (!_ramFirst && _flashRecords > 0 && _segCount > 0)
+  {
+    if (!_reading)
+    {
+      char path[32];
+      _seg_path(_segHead, path, sizeof(path));
+      _readFile = LittleFS.open(path, FILE_READ);
+      if (!_readFile)
+      {
+        _flashErrors++;
+        _seg_remove_head();
+        continue;
+      }
+      _reading = true;
+      _readOffset = 0;
+    }
+
+    uint8_t hdr[2];
+    if (!_readFile.seek(_readOffset) || _readFile.read(hdr, 2) != 2)
+    {
+      // End of segment (or torn tail): done with it
+      _seg_remove_head();
+      continue;
+    }
+
+    uint16_t length = hdr[0] | (hdr[1] << 8);
+    if (length == 0 || length > SPOOL_MAX_FRAME || _readFile.read(buffer, min((size_t)length, maxLength)) != length)
+    {
+      if (length <= SPOOL_MAX_FRAME && length > maxLength)
+      {
+        return 0;  // Caller's buffer is too small; leave the frame in place
+      }
+      _flashErrors++;
+      _seg_remove_head();
+      continue;
+    }
+
+    _peekLength = length;
+    _peekFromFlash = true;
+    return length;
+  }
+
+  if (_ramCount > 0)
+  {
+    const _spool_slot_t *slot = &_ram[_ramHead];
+    if (slot->length > maxLength)
+    {
+      return 0;
+    }
+    memcpy(buffer, slot->data, slot->length);
+    _peekLength = slot->length;
+    _peekFromFlash = false;
+    return slot->length;
+  }
+
+  return 0;
+}
+
+void SensorSentinel_spool_pop()
+{
+  if (_peekLength == 0)
+  {
+    return;
+  }
+
+  if (_peekFromFlash)
+  {
+    uint32_t idx = _segHead % SPOOL_MAX_SEGMENTS;
+    _readOffset += 2 + _peekLength;
+    _segRecords[idx]--;
+    _segBytes[idx] -= _peekLength;
+    _flashRecords--;
+    _flashBytes -= _peekLength;
+
+    // Delete a fully replayed segment right away
+    if (_segRecords[idx] == 0)
+    {
+      _seg_remove_head();
+    }
+  }
+  else
+  {
+    _ramBytes -= _ram[_ramHead].length;
+    _ramHead = (_ramHead + 1) % SPOOL_RAM_SLOTS;
+    _ramCount--;
+    _ramFirst = false;
+  }
+
+  _replayed++;
+  _peekLength = 0;
+}
+
+uint32_t SensorSentinel_spool_depth()
+{
+  return _ramCount + _flashRecords;
+}
+
+void SensorSentinel_spool_get_stats(SensorSentinel_spool_stats_t *stats)
+{
+  if (!stats)
+  {
+    return;
+  }
+
+  stats->depth = _ramCount + _flashRecords;
+  stats->bytes = _ramBytes + _flashBytes;
+  stats->ramDepth = _ramCount;
+  stats->flashDepth = _flashRecords;
+  stats->segments = _segCount;
+  stats->spooled = _spooled;
+  stats->replayed = _replayed;
+  stats->dropped = _dropped;
+  stats->flashErrors = _flashErrors;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file SensorSentinel_spool_helper.h
+ * @brief Store-and-forward spool for frames that could not be published
+ *
+ * Frames that fail to reach the broker (WiFi/MQTT down, publish error) are
+ * kept here and replayed oldest-first once the connection is back:
+ *
+ * - A RAM ring of SPOOL_RAM_SLOTS frames takes new entries.
+ * - When the ring is full its contents are appended in one write to a
+ *   LittleFS segment file (SPOOL_DIR/<seq>.seg), so flash sees few, large
+ *   writes. Records are [u16 length][frame bytes], little-endian.
+ * - At most SPOOL_MAX_SEGMENTS segments are kept; beyond that the oldest
+ *   segment is deleted and its frames are counted as dropped. Without flash
+ *   the oldest RAM entry is dropped instead.
+ *
+ * Flash always holds older frames than RAM, so replay drains segments
+ * first. Segments survive a reboot and are picked up again by
+ * SensorSentinel_spool_begin(); frames in RAM do not. A partly replayed
+ * segment is replayed from its start after a reboot, so the backend may
+ * see a few frames twice.
+ *
+ * Enabled by default; disable via platformio.ini build flag: -DMQTT_SPOOL_MODE=0
+ */
+
+#ifndef SensorSentinel_SPOOL_HELPER_H
+#define SensorSentinel_SPOOL_HELPER_H
+
+#include <Arduino.h>
+#include "SensorSentinel_packet_helper.h"
+
+#ifndef MQTT_SPOOL_MODE
+#define MQTT_SPOOL_MODE 1
+#endif
+
+#ifndef SPOOL_RAM_SLOTS
+#define SPOOL_RAM_SLOTS          32      // Frames held in RAM before spilling
+#endif
+#ifndef SPOOL_FLASH
+#define SPOOL_FLASH              1       // 0 = RAM only
+#endif
+#define SPOOL_DIR                "/spool"
+#define SPOOL_SEGMENT_BYTES      16384   // Start a new segment past this size
+#ifndef SPOOL_MAX_SEGMENTS
+#define SPOOL_MAX_SEGMENTS       32      // Flash budget: segments x segment size
+#endif
+#define SPOOL_REPLAY_INTERVAL_MS 50      // Replay rate limit...
+#define SPOOL_REPLAY_BURST       4       // ...frames per interval
+
+// Largest entry: a frame with its uplink header
+#define SPOOL_MAX_FRAME          (MAX_LORA_PACKET_SIZE + SensorSentinel_UPLINK_HEADROOM)
+
+/**
+ * @brief Spool counters
+ */
+typedef struct {
+  uint32_t depth;        // Frames waiting (RAM + flash)
+  uint32_t bytes;        // Frame bytes waiting (RAM + flash)
+  uint32_t ramDepth;     // Frames waiting in RAM
+  uint32_t flashDepth;   // Frames waiting in flash segments
+  uint32_t segments;     // Segment files on flash
+  uint32_t spooled;      // Frames accepted since boot
+  uint32_t replayed;     // Frames removed after a successful replay
+  uint32_t dropped;      // Frames discarded because the spool was full
+  uint32_t flashErrors;  // Failed segment writes/reads
+} SensorSentinel_spool_stats_t;
+
+/**
+ * @brief Mount the filesystem and recover segments left from a previous boot
+ *
+ * Safe to call more than once; the other functions call it on first use.
+ *
+ * @return true if the spool is usable (RAM always is; flash if mounted)
+ */
+bool SensorSentinel_spool_begin();
+
+/**
+ * @brief Add a frame to the spool (newest)
+ * @param data Frame bytes
+ * @param length Frame length (1..SPOOL_MAX_FRAME)
+ * @return true if stored (an older frame may have been dropped to make room)
+ */
+bool SensorSentinel_spool_push(const uint8_t *data, size_t length);
+
+/**
+ * @brief Copy the oldest frame without removing it
+ * @param buffer Destination buffer
+ * @param maxLength Size of the destination buffer
+ * @return Frame length, or 0 if the spool is empty
+ */
+size_t SensorSentinel_spool_peek(uint8_t *buffer, size_t maxLength);
+
+/**
+ * @brief Remove the frame returned by the last SensorSentinel_spool_peek()
+ * @note Pushes made between the peek and the pop (a failed publish re-spooling,
+ *       a RAM spill) leave the peeked frame in place for this pop
+ */
+void SensorSentinel_spool_pop();
+
+/**
+ * @brief Number of frames waiting
+ */
+uint32_t SensorSentinel_spool_depth();
+
+/**
+ * @brief Get a snapshot of the spool counters
+ * @param stats Pointer to the structure to fill
+ */
+void SensorSentinel_spool_get_stats(SensorSentinel_spool_stats_t *stats);
+
+#endif // SensorSentinel_SPOOL_HELPER_H
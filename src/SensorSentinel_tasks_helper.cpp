@@ -0,0 +1,127 @@
+/**
+ * @file SensorSentinel_tasks_helper.cpp
+ * @brief Implementation of the optional radio/uplink FreeRTOS tasks
+ */
+
+#include "SensorSentinel_tasks_helper.h"
+#include "SensorSentinel_RadioLib_helper.h"
+
+static TaskHandle_t _radioTask = NULL;
+static TaskHandle_t _uplinkTask = NULL;
+static SemaphoreHandle_t _radioMutex = NULL;
+static SensorSentinel_task_hook_t _uplinkHook = NULL;
+
+// Radio task: sleep until DIO1 fires or a queued TX is due, then service the radio
+static void _radioTaskLoop(void *param)
+{
+  for (;;)
+  {
+    // While a frame is on air the TX-done interrupt will wake us
+    uint32_t waitMs = SensorSentinel_tx_next_due_ms();
+    if (waitMs > RADIO_TASK_POLL_MS || SensorSentinel_tx_busy())
+    {
+      waitMs = RADIO_TASK_POLL_MS;
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+
+    bool captured = false;
+    if (SensorSentinel_radio_lock())
+    {
+      captured = SensorSentinel_radio_service();
+      SensorSentinel_radio_unlock();
+    }
+
+    if (captured && _uplinkTask)
+    {
+      xTaskNotifyGive(_uplinkTask);
+    }
+  }
+}
+
+// Uplink task: drain the ring into the callbacks, then run the hook
+static void _uplinkTaskLoop(void *param)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UPLINK_TASK_POLL_MS));
+
+    SensorSentinel_dispatch_packets();
+
+    if (_uplinkHook)
+    {
+      _uplinkHook();
+    }
+  }
+}
+
+bool SensorSentinel_tasks_begin_radio()
+{
+  if (_radioTask)
+  {
+    return true;
+  }
+
+  _radioMutex = xSemaphoreCreateMutex();
+  if (!_radioMutex)
+  {
+    Serial.println("ERROR: radio mutex allocation failed");
+    return false;
+  }
+
+  if (xTaskCreatePinnedToCore(_radioTaskLoop, "ss_radio", RADIO_TASK_STACK, NULL,
+                              RADIO_TASK_PRIORITY, &_radioTask, RADIO_TASK_CORE) != pdPASS)
+  {
+    Serial.println("ERROR: radio task creation failed");
+    _radioTask = NULL;
+    return false;
+  }
+
+  SensorSentinel_set_rx_notify_task(_radioTask);
+  Serial.printf("Radio task started on core %d\n", RADIO_TASK_CORE);
+  return true;
+}
+
+bool SensorSentinel_tasks_begin_uplink(SensorSentinel_task_hook_t hook)
+{
+  if (_uplinkTask)
+  {
+    return true;
+  }
+
+  _uplinkHook = hook;
+
+  if (xTaskCreatePinnedToCore(_uplinkTaskLoop, "ss_uplink", UPLINK_TASK_STACK, NULL,
+                              UPLINK_TASK_PRIORITY, &_uplinkTask, UPLINK_TASK_CORE) != pdPASS)
+  {
+    Serial.println("ERROR: uplink task creation failed");
+    _uplinkTask = NULL;
+    return false;
+  }
+
+  Serial.printf("Uplink task started on core %d\n", UPLINK_TASK_CORE);
+  return true;
+}
+
+bool SensorSentinel_tasks_running()
+{
+  return _radioTask != NULL;
+}
+
+bool SensorSentinel_radio_lock(uint32_t timeoutMs)
+{
+  if (!_radioMutex)
+  {
+    return true;
+  }
+
+  TickType_t ticks = (timeoutMs == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+  return xSemaphoreTake(_radioMutex, ticks) == pdTRUE;
+}
+
+void SensorSentinel_radio_unlock()
+{
+  if (_radioMutex)
+  {
+    xSemaphoreGive(_radioMutex);
+  }
+}
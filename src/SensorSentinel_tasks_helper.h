@@ -0,0 +1,88 @@
+/**
+ * @file SensorSentinel_tasks_helper.h
+ * @brief Optional threaded runtime: radio and uplink FreeRTOS tasks
+ *
+ * Single-threaded builds service the radio, WiFi and MQTT one after the
+ * other from loop(), so any blocking network call leaves the radio deaf.
+ * With THREADED_RUNTIME=1 the work is split across both cores:
+ *
+ * - Radio task (RADIO_TASK_CORE): owns `radio`. Woken by the DIO1 interrupt
+ *   or a due entry in the TX queue, it reads frames into the RadioLib
+ *   helper's receive ring and starts queued transmissions.
+ * - Uplink task (UPLINK_TASK_CORE): drains the ring into the subscribed
+ *   callbacks and runs a caller-supplied hook (e.g. WiFi/MQTT maintenance),
+ *   so it owns `mqttClient`.
+ *
+ * Code outside the radio task that needs the radio (e.g. a repeater that
+ * transmits) must bracket the access with SensorSentinel_radio_lock()/unlock().
+ *
+ * Enable via platformio.ini build flag: -DTHREADED_RUNTIME=1
+ */
+
+#ifndef SensorSentinel_TASKS_HELPER_H
+#define SensorSentinel_TASKS_HELPER_H
+
+#include <Arduino.h>
+
+#ifndef THREADED_RUNTIME
+#define THREADED_RUNTIME 0
+#endif
+
+// Task placement and sizing (WiFi/lwIP run on core 0 on the ESP32-S3)
+#ifndef RADIO_TASK_CORE
+#define RADIO_TASK_CORE      1
+#endif
+#ifndef UPLINK_TASK_CORE
+#define UPLINK_TASK_CORE     0
+#endif
+#define RADIO_TASK_PRIORITY  (configMAX_PRIORITIES - 2)
+#define UPLINK_TASK_PRIORITY 2
+#define RADIO_TASK_STACK     4096
+#define UPLINK_TASK_STACK    8192
+#define RADIO_TASK_POLL_MS   50   // Safety poll in case an interrupt is missed
+#define UPLINK_TASK_POLL_MS  10   // Upper bound between uplink hook runs
+
+/**
+ * @brief Hook run by the uplink task on every iteration
+ */
+typedef void (*SensorSentinel_task_hook_t)();
+
+/**
+ * @brief Start the radio task
+ *
+ * Call after SensorSentinel_subscribe(). Safe to start before WiFi is up:
+ * frames are buffered in the receive ring until the uplink task drains them.
+ *
+ * @return true if the task is running
+ */
+bool SensorSentinel_tasks_begin_radio();
+
+/**
+ * @brief Start the uplink task
+ * @param hook Function called after each drain of the receive ring (optional)
+ * @return true if the task is running
+ */
+bool SensorSentinel_tasks_begin_uplink(SensorSentinel_task_hook_t hook);
+
+/**
+ * @brief Check whether the radio task has been started
+ * @return true if the threaded runtime owns the radio
+ */
+bool SensorSentinel_tasks_running();
+
+/**
+ * @brief Take exclusive access to the radio
+ *
+ * No-op (always succeeds) when the radio task is not running.
+ *
+ * @param timeoutMs Maximum time to wait in milliseconds
+ * @return true if the lock was taken
+ */
+bool SensorSentinel_radio_lock(uint32_t timeoutMs = portMAX_DELAY);
+
+/**
+ * @brief Release the radio taken with SensorSentinel_radio_lock()
+ */
+void SensorSentinel_radio_unlock();
+
+#endif // SensorSentinel_TASKS_HELPER_H
@@ -0,0 +1,300 @@
+/**
+ * @file SensorSentinel_ulp_helper.cpp
+ * @brief ULP-FSM program that samples the pins during deep sleep
+ */
+
+#include "SensorSentinel_ulp_helper.h"
+#include "SensorSentinel_log_helper.h"
+
+#if ULP_MODE
+#include "esp_sleep.h"
+#include "driver/adc.h"
+#include "driver/rtc_io.h"
+#include "soc/rtc_cntl_reg.h"
+#include "soc/rtc_io_reg.h"
+#if CONFIG_IDF_TARGET_ESP32
+#include "esp32/ulp.h"
+#define ULP_TIMER_REG RTC_CNTL_STATE0_REG
+#else
+#include "esp32s3/ulp.h"
+#define ULP_TIMER_REG RTC_CNTL_ULP_CP_TIMER_REG
+#endif
+
+// RTC slow memory layout, in 32-bit words (the ULP uses the low 16 bits).
+// The program is loaded after the data.
+#define W_COUNT    0                                   // Readings in the buffer
+#define W_TARGET   1                                   // Wake when W_COUNT reaches this
+#define W_REASON   2                                   // SensorSentinel_ulp_wake_t of the last wake
+#define W_LOW      3                                   // [ANALOG_COUNT] window low bounds
+#define W_HIGH     (W_LOW + SensorSentinel_ANALOG_COUNT)
+#define W_DIGITAL  (W_HIGH + SensorSentinel_ANALOG_COUNT)    // [BOOLEAN_COUNT] expected levels
+#define W_BUF      (W_DIGITAL + SensorSentinel_BOOLEAN_COUNT) // [ULP_MAX_SAMPLES][ANALOG_COUNT]
+#define PROG_START (W_BUF + ULP_MAX_SAMPLES * SensorSentinel_ANALOG_COUNT)
+
+// Labels
+#define L_THRESHOLD 1
+#define L_EDGE      2
+#define L_WAKE      3
+#define L_DONE      4
+#define L_PIN       10  // + boolean pin index
+
+#define PROG_MAX    128
+
+static size_t _emit(ulp_insn_t *program, size_t n, const ulp_insn_t *insns, size_t count)
+{
+  if (n + count > PROG_MAX)
+  {
+    return PROG_MAX + 1;  // Caught before loading
+  }
+  memcpy(&program[n], insns, count * sizeof(ulp_insn_t));
+  return n + count;
+}
+#define EMIT(...)                                                    \
+  do                                                                 \
+  {                                                                  \
+    const ulp_insn_t _step[] = {__VA_ARGS__};                        \
+    n = _emit(program, n, _step, sizeof(_step) / sizeof(_step[0]));  \
+  } while (0)
+
+// SAR ADC1 channel of each analog pin, or -1
+static int8_t _adcChannel(uint8_t pin)
+{
+  int8_t channel = digitalPinToAnalogChannel(pin);
+  return (channel >= 0 && channel < SOC_ADC_MAX_CHANNEL_NUM) ? channel : -1;
+}
+#endif
+
+bool SensorSentinel_ulp_start(const SensorSentinel_ulp_config_t *config)
+{
+#if ULP_MODE
+  if (!config || config->target == 0 || config->target > ULP_MAX_SAMPLES || config->periodSecs == 0)
+  {
+    return false;
+  }
+
+  int8_t channels[SensorSentinel_ANALOG_COUNT];
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++)
+  {
+    channels[i] = _adcChannel(SensorSentinel_analog_pins[i]);
+    if (channels[i] < 0)
+    {
+      SensorSentinel_log_w("ULP: GPIO%u is not on ADC1\n", SensorSentinel_analog_pins[i]);
+      return false;
+    }
+  }
+
+  ulp_insn_t program[PROG_MAX];
+  size_t n = 0;
+
+  // R2 = 0: base for the data words. R3 = offset of this reading in W_BUF.
+  EMIT(I_MOVI(R2, 0),
+       I_LD(R3, R2, W_COUNT),
+       I_LSHI(R3, R3, 2));
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++)
+  {
+    EMIT(I_ADC(R0, 0, channels[i]),
+         I_ST(R0, R3, W_BUF + i));
+  }
+  EMIT(I_LD(R1, R2, W_COUNT),
+       I_ADDI(R1, R1, 1),
+       I_ST(R1, R2, W_COUNT));
+
+  // Windows: reading - low and high - reading overflow when outside
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++)
+  {
+    EMIT(I_LD(R0, R3, W_BUF + i),
+         I_LD(R1, R2, W_LOW + i),
+         I_SUBR(R1, R0, R1),
+         M_BXF(L_THRESHOLD),
+         I_LD(R1, R2, W_HIGH + i),
+         I_SUBR(R1, R1, R0),
+         M_BXF(L_THRESHOLD));
+  }
+
+  // Watched boolean pins: level differs from the expected one
+  uint8_t watched = SensorSentinel_ulp_watched_pins();
+  for (int j = 0; j < SensorSentinel_BOOLEAN_COUNT; j++)
+  {
+    if (!(watched & (1 << j)))
+    {
+      continue;
+    }
+    gpio_num_t gpio = (gpio_num_t)SensorSentinel_boolean_pins[j];
+    int bit = RTC_GPIO_IN_NEXT_S + rtc_io_number_get(gpio);
+    rtc_gpio_init(gpio);
+    rtc_gpio_set_direction(gpio, RTC_GPIO_MODE_INPUT_ONLY);
+    EMIT(I_RD_REG(RTC_GPIO_IN_REG, bit, bit),
+         I_LD(R1, R2, W_DIGITAL + j),
+         I_SUBR(R0, R0, R1),
+         M_BXZ(L_PIN + j),
+         M_BX(L_EDGE),
+         M_LABEL(L_PIN + j));
+  }
+
+  // Buffer full: count - target overflows while below
+  EMIT(I_LD(R0, R2, W_COUNT),
+       I_LD(R1, R2, W_TARGET),
+       I_SUBR(R0, R0, R1),
+       M_BXF(L_DONE),
+       I_MOVI(R0, ULP_WAKE_FULL),
+       M_BX(L_WAKE),
+       M_LABEL(L_THRESHOLD),
+       I_MOVI(R0, ULP_WAKE_THRESHOLD),
+       M_BX(L_WAKE),
+       M_LABEL(L_EDGE),
+       I_MOVI(R0, ULP_WAKE_EDGE),
+       M_LABEL(L_WAKE),
+       I_ST(R0, R2, W_REASON),
+       I_WAKE(),
+       I_WR_REG_BIT(ULP_TIMER_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN_S, 0),  // Idle until re-armed
+       M_LABEL(L_DONE),
+       I_HALT());
+
+  if (n > PROG_MAX)
+  {
+    SensorSentinel_log_w("ULP: program too long\n");
+    SensorSentinel_ulp_stop();
+    return false;
+  }
+
+  // Data
+  RTC_SLOW_MEM[W_COUNT] = 0;
+  RTC_SLOW_MEM[W_TARGET] = config->target;
+  RTC_SLOW_MEM[W_REASON] = ULP_WAKE_NONE;
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++)
+  {
+    RTC_SLOW_MEM[W_LOW + i] = config->low[i];
+    RTC_SLOW_MEM[W_HIGH + i] = config->high[i];
+  }
+  for (int j = 0; j < SensorSentinel_BOOLEAN_COUNT; j++)
+  {
+    RTC_SLOW_MEM[W_DIGITAL + j] = (config->digital >> j) & 1;
+  }
+
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++)
+  {
+    adc1_config_channel_atten((adc1_channel_t)channels[i], ADC_ATTEN_DB_11);  // analogRead() default
+  }
+  adc1_ulp_enable();
+
+  size_t size = n;
+  esp_err_t err = ulp_process_macros_and_load(PROG_START, program, &size);
+  if (err != ESP_OK)
+  {
+    SensorSentinel_log_w("ULP: load failed (%d), %u instructions\n", err, n);
+    SensorSentinel_ulp_stop();
+    return false;
+  }
+
+  ulp_set_wakeup_period(0, config->periodSecs * 1000000UL);
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+  esp_sleep_enable_ulp_wakeup();
+  err = ulp_run(PROG_START);
+  if (err != ESP_OK)
+  {
+    SensorSentinel_log_w("ULP: start failed (%d)\n", err);
+    SensorSentinel_ulp_stop();
+    return false;
+  }
+
+  SensorSentinel_log_i("ULP: sampling every %us, wake after %u readings\n", config->periodSecs, config->target);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void SensorSentinel_ulp_stop()
+{
+#if ULP_MODE
+  CLEAR_PERI_REG_MASK(ULP_TIMER_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+
+  uint8_t watched = SensorSentinel_ulp_watched_pins();
+  for (int j = 0; j < SensorSentinel_BOOLEAN_COUNT; j++)
+  {
+    if (watched & (1 << j))
+    {
+      rtc_gpio_deinit((gpio_num_t)SensorSentinel_boolean_pins[j]);
+    }
+  }
+#endif
+}
+
+SensorSentinel_ulp_wake_t SensorSentinel_ulp_wake_reason()
+{
+#if ULP_MODE
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_ULP)
+  {
+    return ULP_WAKE_NONE;
+  }
+  uint32_t reason = RTC_SLOW_MEM[W_REASON] & 0xFFFF;
+  return reason <= ULP_WAKE_FULL ? (SensorSentinel_ulp_wake_t)reason : ULP_WAKE_NONE;
+#else
+  return ULP_WAKE_NONE;
+#endif
+}
+
+uint8_t SensorSentinel_ulp_take_readings(SensorSentinel_pin_readings_t *readings, uint8_t max, uint8_t digital)
+{
+#if ULP_MODE
+  // RTC slow memory is only initialised by SensorSentinel_ulp_start(); after
+  // a power-on reset the count may be garbage
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED || !readings)
+  {
+    return 0;
+  }
+
+  uint32_t count = RTC_SLOW_MEM[W_COUNT] & 0xFFFF;
+  if (count > ULP_MAX_SAMPLES)
+  {
+    count = ULP_MAX_SAMPLES;
+  }
+  if (count > max)
+  {
+    count = max;
+  }
+  for (uint32_t s = 0; s < count; s++)
+  {
+    for (int i = 0; i < SensorSentinel_ANALOG_COUNT; i++)
+    {
+      readings[s].analog[i] = RTC_SLOW_MEM[W_BUF + s * SensorSentinel_ANALOG_COUNT + i] & 0xFFFF;
+    }
+    readings[s].boolean = digital;
+  }
+  RTC_SLOW_MEM[W_COUNT] = 0;
+  return (uint8_t)count;
+#else
+  return 0;
+#endif
+}
+
+uint8_t SensorSentinel_ulp_watched_pins()
+{
+  uint8_t mask = 0;
+#if ULP_MODE
+  for (int j = 0; j < SensorSentinel_BOOLEAN_COUNT; j++)
+  {
+    if (rtc_gpio_is_valid_gpio((gpio_num_t)SensorSentinel_boolean_pins[j]))
+    {
+      mask |= 1 << j;
+    }
+  }
+#endif
+  return mask;
+}
+
+const char *SensorSentinel_ulp_wake_to_string(SensorSentinel_ulp_wake_t reason)
+{
+  switch (reason)
+  {
+  case ULP_WAKE_THRESHOLD:
+    return "threshold";
+  case ULP_WAKE_EDGE:
+    return "edge";
+  case ULP_WAKE_FULL:
+    return "buffer full";
+  default:
+    return "none";
+  }
+}
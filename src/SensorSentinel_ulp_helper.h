@@ -0,0 +1,104 @@
+/**
+ * @file SensorSentinel_ulp_helper.h
+ * @brief Pin sampling by the ULP coprocessor while the main cores sleep
+ *
+ * A timer wake costs a full boot (heltec_setup(), display, radio) even when
+ * nothing is sent. With ULP_MODE the deep-sleep sender leaves sampling to
+ * the ULP-FSM coprocessor instead: every period it reads the analog pins
+ * (SAR ADC1) into a buffer in RTC slow memory and wakes the main cores only
+ * when
+ *   - an analog reading is outside its [low, high] window,
+ *   - a watched boolean pin changed level, or
+ *   - the buffer holds the target number of readings.
+ *
+ * Only boolean pins that are RTC GPIOs can be watched (GPIO0-21 on the
+ * ESP32-S3; none of the V3 boolean pins are); the rest are read when the
+ * main cores wake. Analog pins must be on ADC1. Vext is off in deep sleep,
+ * so sensors must be powered some other way.
+ *
+ * The program is built at runtime with the ULP macro API. It needs the FSM
+ * ULP enabled in sdkconfig with at least 512 bytes of
+ * ULP_COPROC_RESERVE_MEM; when it cannot be loaded SensorSentinel_ulp_start()
+ * returns false and the caller keeps using timer wakes.
+ *
+ * Enable via platformio.ini build flag: -DULP_MODE=1
+ */
+
+#ifndef SensorSentinel_ULP_HELPER_H
+#define SensorSentinel_ULP_HELPER_H
+
+#include <Arduino.h>
+#include "SensorSentinel_pins_helper.h"
+
+#ifndef ULP_MODE
+#define ULP_MODE 0
+#endif
+
+#define ULP_MAX_SAMPLES 8  // Readings the ULP can buffer (RTC slow memory is small)
+
+/**
+ * @brief Why the ULP woke the main cores
+ */
+typedef enum {
+  ULP_WAKE_NONE,       ///< Not a ULP wake
+  ULP_WAKE_THRESHOLD,  ///< An analog reading left its window
+  ULP_WAKE_EDGE,       ///< A watched boolean pin changed level
+  ULP_WAKE_FULL        ///< The buffer reached its target
+} SensorSentinel_ulp_wake_t;
+
+/**
+ * @brief What the ULP samples and when it wakes the main cores
+ */
+typedef struct {
+  uint16_t low[SensorSentinel_ANALOG_COUNT];   // Wake when a reading is below...
+  uint16_t high[SensorSentinel_ANALOG_COUNT];  // ...or above its window
+  uint8_t digital;                             // Boolean pin states now; watched pins wake on a change
+  uint8_t target;                              // Readings to buffer before waking (1..ULP_MAX_SAMPLES)
+  uint32_t periodSecs;                         // Time between readings
+} SensorSentinel_ulp_config_t;
+
+/**
+ * @brief Load the ULP program and start sampling; call right before deep sleep
+ *
+ * Enables the ULP wakeup source. The buffer starts empty.
+ *
+ * @param config Windows, target and period
+ * @return true if the ULP is running, false if unavailable (ULP_MODE=0,
+ *         analog pin not on ADC1, program does not fit)
+ */
+bool SensorSentinel_ulp_start(const SensorSentinel_ulp_config_t *config);
+
+/**
+ * @brief Stop the ULP and hand the watched pins back to the GPIO matrix
+ *
+ * Call early after every wake, before reading the boolean pins.
+ */
+void SensorSentinel_ulp_stop();
+
+/**
+ * @brief Get why this wake happened, if the ULP caused it
+ * @return ULP_WAKE_NONE for timer, button and power-on wakes
+ */
+SensorSentinel_ulp_wake_t SensorSentinel_ulp_wake_reason();
+
+/**
+ * @brief Copy out and clear the readings buffered by the ULP
+ * @param readings Destination, oldest first
+ * @param max Size of readings
+ * @param digital Boolean value stored with each reading (the ULP does not record them)
+ * @return Number of readings copied
+ */
+uint8_t SensorSentinel_ulp_take_readings(SensorSentinel_pin_readings_t *readings, uint8_t max, uint8_t digital);
+
+/**
+ * @brief Boolean pins the ULP can watch on this board
+ * @return Bit i set when SensorSentinel_boolean_pins[i] is an RTC GPIO
+ */
+uint8_t SensorSentinel_ulp_watched_pins();
+
+/**
+ * @brief Convert a wake reason to a short string
+ */
+const char *SensorSentinel_ulp_wake_to_string(SensorSentinel_ulp_wake_t reason);
+
+#endif // SensorSentinel_ULP_HELPER_H
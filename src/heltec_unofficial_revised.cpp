@@ -5,6 +5,8 @@
  */  
 
 #include "heltec_unofficial_revised.h"  
+#include "SensorSentinel_metrics_helper.h"
+#include "SensorSentinel_adc_helper.h"
 
 // Battery calibration  
 const float min_voltage = 3.04;  
@@ -57,16 +59,25 @@ bool buttonClicked = false;
 
 
 
+static bool _warmBoot = false;
+static bool _radioReady = false;
+static bool _displayReady = false;
+
 // ====== Implementation of PrintSplitter methods ======  
+// b is the display, which has no frame buffer until setup_display() ran
 size_t PrintSplitter::write(uint8_t c) {  
-  a.write(c);  
-  size_t r = b.write(c);  
+  size_t r = a.write(c);  
+  if (_displayReady) {
+    r = b.write(c);  
+  }
   return r;  
 }  
 
 size_t PrintSplitter::write(const uint8_t *buffer, size_t size) {  
-  a.write(buffer, size);  
-  size_t r = b.write(buffer, size);  
+  size_t r = a.write(buffer, size);  
+  if (_displayReady) {
+    r = b.write(buffer, size);  
+  }
   return r;  
 }  
 
@@ -115,6 +126,10 @@ const char* heltec_get_board_name() {
  * @brief Updates the display buffer to the screen.  
  */  
 void heltec_display_update() {  
+  SensorSentinel_METRICS_SCOPE(METRIC_DISPLAY_UPDATE);
+  if (!_displayReady) {
+    return;
+  }
   #ifndef HELTEC_NO_DISPLAY  
     #if defined(BOARD_HELTEC_V3_2) || defined(WOKWI)
       display.display();  
@@ -122,6 +137,49 @@ void heltec_display_update() {
   #endif  
 }  
 
+static heltec_render_callback_t _displayRender = NULL;
+static volatile bool _displayDirty = false;
+static unsigned long _displayLastRedraw = 0;
+
+/**
+ * @brief Registers the status screen render callback.
+ */
+void heltec_display_defer(heltec_render_callback_t render) {
+  _displayRender = render;
+  _displayDirty = false;
+}
+
+/**
+ * @brief Marks the status screen as changed.
+ */
+void heltec_display_invalidate() {
+  #if DISPLAY_DEFERRED
+    _displayDirty = true;
+  #else
+    if (_displayRender) {
+      heltec_clear_display();
+      _displayRender(both);
+      heltec_display_update();
+    }
+  #endif
+}
+
+/**
+ * @brief Redraws the status screen when due.
+ */
+void heltec_display_service() {
+  #if DISPLAY_DEFERRED && !defined(HELTEC_NO_DISPLAY)
+    if (!_displayReady || !_displayDirty || !_displayRender || millis() - _displayLastRedraw < DISPLAY_REFRESH_MS) {
+      return;
+    }
+    _displayDirty = false;
+    _displayLastRedraw = millis();
+    heltec_clear_display();
+    _displayRender(display);
+    heltec_display_update();
+  #endif
+}
+
 /**  
  * @brief Controls the LED brightness based on the given percentage.  
  * @param percent The brightness percentage of the LED (0-100).  
@@ -176,19 +234,9 @@ void heltec_tft_power(bool state) {
  * @return The battery voltage in volts.  
  */  
 float heltec_vbat() {  
-  pinMode(VBAT_CTRL, OUTPUT);  
-  digitalWrite(VBAT_CTRL, LOW);  
-  delay(5);  
-  
-  float vbat;  
-  #ifdef ARDUINO_heltec_wireless_tracker  
-    vbat = analogRead(VBAT_ADC) * 4.9 / 4095.0; // 12-bit ADC, Vbat_Read*4.9  
-  #else  
-    vbat = analogRead(VBAT_ADC) / 238.7; // Original calibration  
-  #endif  
-  
-  pinMode(VBAT_CTRL, INPUT);  
-  return vbat;  
+  // Calibrated pin voltage, measured at most once per ADC_VBAT_CACHE_MS  
+  float pinVolts = SensorSentinel_adc_vbat_mv() / 1000.0f;  
+  return pinVolts * VBAT_DIVIDER;  
 }  
 
 /**  
@@ -312,6 +360,9 @@ void heltec_display_power(bool on) {
  * @param rotation Display rotation (default = 0).  
  */  
 void heltec_clear_display(uint8_t textSize, uint8_t rotation) {
+    if (!_displayReady) {
+        return;
+    }
     #ifndef HELTEC_NO_DISPLAY
     board_type_t board = get_board_type();
     
@@ -360,6 +411,9 @@ void heltec_clear_display(uint8_t textSize, uint8_t rotation) {
  * @param seconds The number of seconds to sleep before waking up (default = 0).  
  */  
 static void shutdown_display() {
+    if (!_displayReady) {
+        return;  // Still off from the previous sleep
+    }
     #ifndef HELTEC_NO_DISPLAY
     board_type_t board = get_board_type();
     
@@ -413,6 +467,10 @@ static void shutdown_pins() {
 }
 
 void heltec_deep_sleep(int seconds) {
+    heltec_deep_sleep_ms(seconds > 0 ? (uint64_t)seconds * 1000 : 0);
+}
+
+void heltec_deep_sleep_ms(uint64_t ms) {
     #ifdef WiFi_h
     WiFi.disconnect(true);
     #endif
@@ -420,8 +478,13 @@ void heltec_deep_sleep(int seconds) {
     shutdown_display();
     
     #ifndef NO_RADIOLIB
-    radio.begin();
-    radio.sleep(false);
+    // After a warm boot that never used the radio it is still asleep
+    if (_radioReady || !_warmBoot) {
+        if (!_radioReady) {
+            radio.begin();
+        }
+        radio.sleep(false);
+    }
     #endif
     
     heltec_ve(false);
@@ -433,8 +496,8 @@ void heltec_deep_sleep(int seconds) {
     button.waitForRelease();
     #endif
     
-    if (seconds > 0) {
-        esp_sleep_enable_timer_wakeup((int64_t)seconds * 1000000);
+    if (ms > 0) {
+        esp_sleep_enable_timer_wakeup(ms * 1000);
     }
     
     esp_deep_sleep_start();
@@ -465,12 +528,14 @@ static void setup_display() {
             Wire.begin(SDA_OLED, SCL_OLED);
             if(!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
                 Serial.println("SSD1306 allocation failed");
+                return;
             } else {
                 Serial.println("OLED initialized OK");
             }
             #endif
             break;
     }
+    _displayReady = true;
     heltec_clear_display();
     #else
     Serial.println(heltec_get_board_name());
@@ -479,29 +544,24 @@ static void setup_display() {
 
 static void setup_radio() {
     #ifndef NO_RADIOLIB
-    int radioStatus = radio.begin();
+    // All modem settings go to begin(), which applies them once (one image
+    // calibration) instead of again through the individual setters
+    board_type_t board = get_board_type();
+    bool sx1276 = (board == BOARD_WIRELESS_STICK || board == BOARD_WIRELESS_STICK_LITE);
+    int8_t power = sx1276 ? HELTEC_SX1276_POWER : HELTEC_SX1262_POWER;
+
+    int radioStatus = radio.begin(HELTEC_LORA_FREQ, HELTEC_LORA_BW, HELTEC_LORA_SF,
+                                  HELTEC_LORA_CR, HELTEC_LORA_SYNC, power);
     if (radioStatus != RADIOLIB_ERR_NONE) {
         Serial.printf("Radio initialization failed with code %d\n", radioStatus);
         return;
     }
-    
-    Serial.println("Radio initialized OK");
-    
-    // Common settings
-    radio.setFrequency(HELTEC_LORA_FREQ);
-    radio.setBandwidth(HELTEC_LORA_BW);
-    radio.setSpreadingFactor(HELTEC_LORA_SF);
-    radio.setCodingRate(HELTEC_LORA_CR);
-    radio.setSyncWord(HELTEC_LORA_SYNC);
-    
-    // Power settings based on radio chip
-    board_type_t board = get_board_type();
-    if (board == BOARD_WIRELESS_STICK || board == BOARD_WIRELESS_STICK_LITE) {
-        radio.setOutputPower(HELTEC_SX1276_POWER);
-    } else {
-        radio.setOutputPower(HELTEC_SX1262_POWER);
+    if (!sx1276) {
         radio.setCurrentLimit(HELTEC_SX1262_CURRENT);
     }
+    _radioReady = true;
+
+    Serial.println("Radio initialized OK");
     #endif
 }
 
@@ -511,15 +571,25 @@ static void setup_radio() {
  */  
 void heltec_setup() {  
   Serial.begin(115200);  
-  delay(100);  
+
+  #if HELTEC_WARM_BOOT
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    _warmBoot = (cause == ESP_SLEEP_WAKEUP_TIMER || cause == ESP_SLEEP_WAKEUP_ULP);
+  #endif
+  if (!_warmBoot) {
+    delay(100);  
+  }
   
   // Initialize SPI for radio  
   #ifdef ARDUINO_heltec_wireless_tracker  
     hspi->begin(SCK, MISO, MOSI, SS);  
   #endif  
   
-    setup_display();
-    setup_radio();
+    // Warm boot: display stays off, radio is brought up on first use
+    if (!_warmBoot) {
+      setup_display();
+      setup_radio();
+    }
     
     // Initialize LED
     ledcSetup(LED_CHAN, 5000, 8);
@@ -531,6 +601,21 @@ void heltec_setup() {
     #endif
 }
 
+bool heltec_warm_boot() {
+  return _warmBoot;
+}
+
+bool heltec_radio_begin() {
+  if (!_radioReady) {
+    setup_radio();
+  }
+  return _radioReady;
+}
+
+bool heltec_display_ready() {
+  return _displayReady;
+}
+
 /**
  * @brief Main loop function that should be called regularly
  * Handles button updates and other periodic tasks
@@ -542,4 +627,5 @@ void heltec_loop() {
       buttonClicked = true;
     }
   #endif
+  heltec_display_service();
 }
\ No newline at end of file
@@ -43,6 +43,7 @@ extern HotButton button;
   #define VEXT      GPIO_NUM_36 // External power control  
   #define VBAT_CTRL GPIO_NUM_37 // Battery voltage measurement control  
   #define VBAT_ADC  GPIO_NUM_1  // Battery voltage ADC pin  
+  #define VBAT_DIVIDER 4.9f     // (390k + 100k) / 100k battery divider  
   // SPI & Radio pins (SX1262) - common across all S3 boards  
   #define SS        GPIO_NUM_8  
   #define DIO1      GPIO_NUM_14  
@@ -57,6 +58,7 @@ extern HotButton button;
   #define VEXT      GPIO_NUM_21 // External power control  
   #define VBAT_CTRL GPIO_NUM_37 // Battery voltage measurement control  
   #define VBAT_ADC  GPIO_NUM_1  // Battery voltage ADC pin  
+  #define VBAT_DIVIDER 4.9f     // (390k + 100k) / 100k battery divider  
   // SPI & Radio pins (SX1276)  
   #define SS        GPIO_NUM_18  
   #define DIO1      GPIO_NUM_35  
@@ -198,12 +200,43 @@ const char* heltec_get_board_name();
  */
 float heltec_temperature();
 
+// Warm boot: on a timer (or ULP) wake from deep sleep, heltec_setup() leaves
+// the display off and the radio asleep; heltec_radio_begin() brings the radio
+// up on first use. SensorSentinel_read_all_pins() powers Vext for the read, so
+// sensors on it still see power. 0 = full setup on every boot.
+#ifndef HELTEC_WARM_BOOT
+#define HELTEC_WARM_BOOT 1
+#endif
+
+// Time sensors on Vext get to settle before a warm-boot pin read
+#ifndef HELTEC_VEXT_SETTLE_MS
+#define HELTEC_VEXT_SETTLE_MS 20
+#endif
+
 /**
  * @brief Initializes the Heltec library
  * This function should be the first thing in setup() of your sketch
  */
 void heltec_setup();
 
+/**
+ * @brief Checks if heltec_setup() took the warm-boot path
+ * @return True if the display and radio were left uninitialized
+ */
+bool heltec_warm_boot();
+
+/**
+ * @brief Initializes the radio if it is not yet (after a warm boot)
+ * @return True if the radio is ready
+ */
+bool heltec_radio_begin();
+
+/**
+ * @brief Checks if the display was initialized this boot
+ * @return False after a warm boot; drawing is then skipped
+ */
+bool heltec_display_ready();
+
 /**
  * @brief The main loop for the Heltec library
  * This function should be called in loop() of your sketch
@@ -236,6 +269,43 @@ void heltec_display_power(bool on);
  */
 void heltec_clear_display(uint8_t textSize = 1, uint8_t rotation = 1);
 
+// Deferred display: redraw from heltec_loop() at most every DISPLAY_REFRESH_MS,
+// and only after heltec_display_invalidate(). 0 = draw on every invalidate.
+#ifndef DISPLAY_DEFERRED
+#define DISPLAY_DEFERRED 1
+#endif
+#ifndef DISPLAY_REFRESH_MS
+#define DISPLAY_REFRESH_MS 250
+#endif
+
+/**
+ * @brief Draws the screen contents; out is the display (or both, if immediate)
+ */
+typedef void (*heltec_render_callback_t)(Print &out);
+
+/**
+ * @brief Registers the function that draws the status screen
+ *
+ * The current screen is left as is until the first heltec_display_invalidate().
+ *
+ * @param render Render callback, or NULL to stop redrawing
+ */
+void heltec_display_defer(heltec_render_callback_t render);
+
+/**
+ * @brief Marks the status screen as changed
+ *
+ * Cheap enough to call per packet: with DISPLAY_DEFERRED it only sets a
+ * flag. With -DDISPLAY_DEFERRED=0 it redraws immediately through both.
+ */
+void heltec_display_invalidate();
+
+/**
+ * @brief Redraws the status screen if it changed and the refresh interval passed
+ * Called from heltec_loop()
+ */
+void heltec_display_service();
+
 // Power management functions
 /**
  * @brief Controls the LED brightness
@@ -257,6 +327,10 @@ void heltec_tft_power(bool state);
 
 /**
  * @brief Measures the battery voltage
+ *
+ * Uses the calibrated, oversampled reading from the ADC helper, which is
+ * cached for ADC_VBAT_CACHE_MS so repeated calls in one wake cost nothing.
+ *
  * @return The battery voltage in volts
  */
 float heltec_vbat();
@@ -274,6 +348,12 @@ int heltec_battery_percent(float vbat = -1);
  */
 void heltec_deep_sleep(int seconds = 0);
 
+/**
+ * @brief Puts the device into deep sleep mode with a millisecond timer
+ * @param ms The number of milliseconds to sleep (0 = indefinite)
+ */
+void heltec_deep_sleep_ms(uint64_t ms);
+
 /**
  * @brief Checks if wakeup was caused by button press
  * @return True if wakeup was from button press
@@ -77,22 +77,47 @@ done
 # ── Section 3: Database schema ─────────────────────────────────────────────────
 section "Database schema"
 
-for table in owners devices digital_pins analog_pins alerts events; do
+for table in owners devices digital_pins analog_pins alerts events events_1m events_1h; do
   COUNT=$(pg "SELECT COUNT(*) FROM information_schema.tables WHERE table_name='$table' AND table_schema='public';")
   assert_eq "Table '$table' exists" "1" "$COUNT"
 done
 
-for index in idx_events_device_id idx_events_created_at idx_events_node_id idx_devices_node_id; do
+for index in idx_events_device_id idx_events_created_at idx_events_node_id; do
   COUNT=$(pg "SELECT COUNT(*) FROM pg_indexes WHERE indexname='$index';")
   assert_eq "Index '$index' exists" "1" "$COUNT"
 done
 
+COUNT=$(pg "SELECT COUNT(*) FROM pg_indexes WHERE indexname='idx_devices_node_id';")
+assert_eq "Redundant index 'idx_devices_node_id' absent (UNIQUE covers node_id)" "0" "$COUNT"
+
+AM=$(pg "SELECT am.amname FROM pg_class c JOIN pg_am am ON am.oid = c.relam WHERE c.relname='idx_events_created_at';")
+assert_eq "Index 'idx_events_created_at' is BRIN" "brin" "$AM"
+
+STRATEGY=$(pg "SELECT partstrat FROM pg_partitioned_table WHERE partrelid='events'::regclass;")
+assert_eq "Table 'events' is range-partitioned" "r" "$STRATEGY"
+
+TODAY=$(pg "SELECT COUNT(*) FROM pg_class WHERE relname='events_p' || to_char(CURRENT_DATE, 'YYYYMMDD');")
+assert_eq "Today's events partition exists" "1" "$TODAY"
+
+for func in create_event_partition ensure_event_partitions rollup_events event_rollup; do
+  FUNC=$(pg "SELECT COUNT(*) FROM pg_proc WHERE proname='$func';")
+  assert_eq "Function '$func' exists" "1" "$FUNC"
+done
+
 FUNC=$(pg "SELECT COUNT(*) FROM pg_proc WHERE proname='create_device_pins';")
 assert_eq "Trigger function 'create_device_pins' exists" "1" "$FUNC"
 
 FUNC=$(pg "SELECT COUNT(*) FROM pg_proc WHERE proname='prune_events';")
 assert_eq "Function 'prune_events' exists" "1" "$FUNC"
 
+FUNC=$(pg "SELECT COUNT(*) FROM pg_proc WHERE proname='notify_config_change';")
+assert_eq "Trigger function 'notify_config_change' exists" "1" "$FUNC"
+
+for trigger in trg_devices_config trg_digital_pins_config trg_analog_pins_config trg_owners_config trg_events_rollup; do
+  COUNT=$(pg "SELECT COUNT(*) FROM pg_trigger WHERE tgname='$trigger';")
+  assert_eq "Trigger '$trigger' exists" "1" "$COUNT"
+done
+
 # ── Section 4: Database behaviour ─────────────────────────────────────────────
 section "Database behaviour"
 
@@ -106,6 +131,13 @@ if [ -n "$TEST_DEVICE_ID" ]; then
   assert_eq "Device insert auto-creates 8 digital pins" "8" "$DIGITAL"
   assert_eq "Device insert auto-creates 4 analog pins" "4" "$ANALOG"
 
+  # Events land in their day's partition
+  pg "INSERT INTO events (device_id, node_id, message_type, payload) VALUES ($TEST_DEVICE_ID, 9999999999, 'sensor', '{}'), ($TEST_DEVICE_ID, 9999999999, 'sensor', '{}');" > /dev/null
+  PART=$(pg "SELECT DISTINCT tableoid::regclass FROM events WHERE node_id=9999999999;")
+  assert_eq "Multi-row event insert routed to today's partition" "events_p$(pg "SELECT to_char(CURRENT_DATE, 'YYYYMMDD');")" "$PART"
+  pg "DELETE FROM events WHERE node_id=9999999999;" > /dev/null
+  pg "DELETE FROM events_1m WHERE node_id=9999999999; DELETE FROM events_1h WHERE node_id=9999999999;" > /dev/null
+
   # Clean up test device
   pg "DELETE FROM devices WHERE node_id=9999999999;" > /dev/null
   pass "Test device cleaned up"
@@ -113,6 +145,58 @@ else
   skip "Could not insert test device (conflict?)"
 fi
 
+# Retention drops whole partitions past the cutoff
+OLD="events_p$(pg "SELECT to_char(CURRENT_DATE - 40, 'YYYYMMDD');")"
+pg "SELECT create_event_partition(CURRENT_DATE - 40);" > /dev/null
+assert_eq "Old events partition created" "1" "$(pg "SELECT COUNT(*) FROM pg_class WHERE relname='$OLD';")"
+pg "SELECT prune_events(30);" > /dev/null
+assert_eq "prune_events(30) drops the 40-day-old partition" "0" "$(pg "SELECT COUNT(*) FROM pg_class WHERE relname='$OLD';")"
+AHEAD=$(pg "SELECT COUNT(*) FROM pg_class WHERE relname='events_p' || to_char(CURRENT_DATE + 7, 'YYYYMMDD');")
+assert_eq "prune_events() keeps a week of partitions ahead" "1" "$AHEAD"
+
+# Rollups: every INSERT statement folds into events_1m and events_1h
+RNODE=9999999998
+RAT="date_trunc('hour', LOCALTIMESTAMP) + INTERVAL '5 minutes'"
+ROLL="events, readings, analog0_min, analog0_max, analog0_sum, analog1_min, analog1_max, analog1_sum, digital_any, digital_all, battery_min, battery_max, battery_sum, rx_count, rssi_min, rssi_max, rssi_sum, snr_sum"
+rollup_row() {
+  pg "SELECT concat_ws(',', $ROLL) FROM $1 WHERE node_id=$RNODE AND bucket=date_trunc('$2', $RAT);"
+}
+pg "DELETE FROM events WHERE node_id=$RNODE; DELETE FROM events_1m WHERE node_id=$RNODE; DELETE FROM events_1h WHERE node_id=$RNODE;" > /dev/null
+
+pg "INSERT INTO events (node_id, message_type, payload, created_at) VALUES
+    ($RNODE, 'sensor', '{\"analog\":[100,200,300,400],\"digital\":5,\"battery\":80,\"rx\":{\"rssi\":-90,\"snr\":5}}', $RAT),
+    ($RNODE, 'sensor', '{\"analog\":[150,100,350,450],\"digital\":4,\"battery\":70,\"rx\":{\"rssi\":-100,\"snr\":7}}', $RAT + INTERVAL '10 seconds'),
+    ($RNODE, 'gnss', '{\"battery\":75}', $RAT + INTERVAL '20 seconds');" > /dev/null
+FIRST="3,2,100,150,250,100,200,300,5,4,70,80,225,2,-100,-90,-190,12"
+assert_eq "Multi-row insert rolls up into events_1m" "$FIRST" "$(rollup_row events_1m minute)"
+assert_eq "Multi-row insert rolls up into events_1h" "$FIRST" "$(rollup_row events_1h hour)"
+
+pg "INSERT INTO events (node_id, message_type, payload, created_at) VALUES
+    ($RNODE, 'sensor', '{\"analog\":[50,500,0,0],\"digital\":1,\"battery\":90,\"rx\":{\"rssi\":-80,\"snr\":1}}', $RAT + INTERVAL '30 seconds');" > /dev/null
+MERGED="4,3,50,150,300,100,500,800,5,0,70,90,315,3,-100,-80,-270,13"
+assert_eq "Second insert merges into the events_1m bucket" "$MERGED" "$(rollup_row events_1m minute)"
+assert_eq "Second insert merges into the events_1h bucket" "$MERGED" "$(rollup_row events_1h hour)"
+
+# Out-of-range or non-integer wire fields store NULL instead of failing the batch
+pg "INSERT INTO events (node_id, message_type, payload, created_at) VALUES
+    ($RNODE, 'sensor', '{\"analog\":[65535,\"x\",1.5,100000],\"digital\":70000,\"battery\":-1}', $RAT + INTERVAL '40 seconds'),
+    ($RNODE, 'sensor', '{\"analog\":[60,600,0,0],\"digital\":2,\"battery\":85}', $RAT + INTERVAL '50 seconds');" > /dev/null
+assert_eq "Malformed row does not cost its batch" "2" "$(pg "SELECT COUNT(*) FROM events WHERE node_id=$RNODE AND created_at >= $RAT + INTERVAL '40 seconds';")"
+assert_eq "Malformed fields are stored as NULL" "65535,,,,," "$(pg "SELECT concat_ws(',', analog0, COALESCE(analog1::TEXT, ''), COALESCE(analog2::TEXT, ''), COALESCE(analog3::TEXT, ''), COALESCE(digital::TEXT, ''), COALESCE(battery::TEXT, '')) FROM events WHERE node_id=$RNODE AND created_at = $RAT + INTERVAL '40 seconds';")"
+assert_eq "u16 maxima roll up" "6,5,50,65535,65895" "$(pg "SELECT concat_ws(',', events, readings, analog0_min, analog0_max, analog0_sum) FROM events_1m WHERE node_id=$RNODE AND bucket=date_trunc('minute', $RAT);")"
+
+# The minute rollup ages out with the events; the hour rollup stays
+for rollup in events_1m events_1h; do
+  pg "INSERT INTO $rollup (bucket, node_id, events, readings, analog0_sum, analog1_sum, analog2_sum, analog3_sum, battery_sum, rx_count, rssi_sum, snr_sum)
+      VALUES (CURRENT_DATE - 40, $RNODE, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0);" > /dev/null
+done
+pg "SELECT prune_events(30);" > /dev/null
+assert_eq "prune_events(30) deletes old events_1m rows" "0" "$(pg "SELECT COUNT(*) FROM events_1m WHERE node_id=$RNODE AND bucket < CURRENT_DATE - 30;")"
+assert_eq "prune_events(30) keeps old events_1h rows" "1" "$(pg "SELECT COUNT(*) FROM events_1h WHERE node_id=$RNODE AND bucket < CURRENT_DATE - 30;")"
+assert_eq "prune_events(30) keeps current events_1m rows" "1" "$(pg "SELECT COUNT(*) FROM events_1m WHERE node_id=$RNODE AND bucket >= CURRENT_DATE - 30;")"
+
+pg "DELETE FROM events WHERE node_id=$RNODE; DELETE FROM events_1m WHERE node_id=$RNODE; DELETE FROM events_1h WHERE node_id=$RNODE;" > /dev/null
+
 # ── Section 5: NocoDB ──────────────────────────────────────────────────────────
 section "NocoDB"
 
@@ -170,6 +254,18 @@ assert_eq "Node-RED UI accessible" "200" "$NR_STATUS"
 FLOWS=$(curl -sf "http://localhost:1880/flows" 2>/dev/null | python3 -c "import sys,json; d=json.load(sys.stdin); print(len(d) if isinstance(d,list) else 0)" 2>/dev/null || echo "0")
 assert_gt "Node-RED has flows deployed" "0" "$FLOWS"
 
+# ── Section 8: Ingest bridge ───────────────────────────────────────────────────
+section "Ingest bridge"
+
+STATUS=$(docker inspect --format='{{.State.Status}}' ingest 2>/dev/null || echo "missing")
+if [ "$STATUS" = "missing" ]; then
+  skip "ingest not deployed — start with: docker compose --profile ingest up -d"
+else
+  assert_eq "ingest is running" "running" "$STATUS"
+  assert_contains "ingest loaded the device cache" "devices loaded" "$(docker logs ingest 2>&1)"
+  assert_contains "ingest connected to MQTT" "connected to" "$(docker logs ingest 2>&1)"
+fi
+
 # ── Summary ────────────────────────────────────────────────────────────────────
 echo ""
 echo "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━"